@@ -8,6 +8,7 @@ noinst_HEADERS +=\
 	api/omenquireinternal.h\
 	api/postlist.h\
 	api/queryinternal.h\
+	api/querystatsinternal.h\
 	api/queryvector.h\
 	api/replication.h\
 	api/smallvector.h\
@@ -40,8 +41,10 @@ lib_src +=\
 	api/postlist.cc\
 	api/query.cc\
 	api/queryinternal.cc\
+	api/querystats.cc\
 	api/registry.cc\
 	api/replication.cc\
+	api/shardedwriter.cc\
 	api/smallvector.cc\
 	api/snipper.cc\
 	api/sortable-serialise.cc\
@@ -92,6 +92,7 @@ class Compactor::Internal : public Xapian::Internal::intrusive_base {
     int compact_to_stub;
     size_t block_size;
     compaction_level compaction;
+    unsigned n_threads;
 
     Xapian::docid tot_off;
     Xapian::docid last_docid;
@@ -106,7 +107,7 @@ class Compactor::Internal : public Xapian::Internal::intrusive_base {
   public:
     Internal()
 	: renumber(true), multipass(false),
-	  block_size(8192), compaction(FULL), tot_off(0),
+	  block_size(8192), compaction(FULL), n_threads(0), tot_off(0),
 	  last_docid(0), backend(UNKNOWN)
     {
     }
@@ -146,6 +147,12 @@ Compactor::set_compaction_level(compaction_level compaction)
     internal->compaction = compaction;
 }
 
+void
+Compactor::set_threads(unsigned n_threads)
+{
+    internal->n_threads = n_threads;
+}
+
 void
 Compactor::set_destdir(const string & destdir)
 {
@@ -461,7 +468,7 @@ Compactor::Internal::compact(Xapian::Compactor & compactor)
     } else if (backend == BRASS) {
 #ifdef XAPIAN_HAS_BRASS_BACKEND
 	compact_brass(compactor, destdir.c_str(), sources, offset, block_size,
-		      compaction, multipass, last_docid);
+		      compaction, multipass, last_docid, n_threads);
 #else
 	(void)compactor;
 	throw Xapian::FeatureUnavailableError("Brass backend disabled at build time");
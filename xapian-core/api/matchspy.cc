@@ -28,6 +28,7 @@
 #include <xapian/queryparser.h>
 #include <xapian/registry.h>
 
+#include <algorithm>
 #include <map>
 #include <string>
 #include <vector>
@@ -37,12 +38,14 @@
 #include "noreturn.h"
 #include "omassert.h"
 #include "net/length.h"
+#include "serialise-double.h"
 #include "stringutils.h"
 #include "str.h"
 #include "termlist.h"
 
 #include <cfloat>
 #include <cmath>
+#include <cstring>
 
 using namespace std;
 using namespace Xapian;
@@ -90,29 +93,204 @@ static void unsupported_method() {
     throw Xapian::InvalidOperationError("Method not supported for this type of termlist");
 }
 
+/** The values counted by a ValueCountMatchSpy, with their frequencies.
+ *
+ *  This is an open-addressing hash table.  The values are stored one after
+ *  another in a single string, so counting a value which has already been
+ *  seen doesn't need to allocate memory.
+ */
+class ValueCounts {
+    /// An entry in the table.
+    struct Entry {
+	/// Offset of the value in @a strings.
+	size_t offset;
+
+	/// Length of the value.
+	size_t len;
+
+	/// Hash of the value.
+	unsigned hash;
+
+	/// The frequency of the value.
+	Xapian::doccount freq;
+    };
+
+    /// The values, one after another.
+    string strings;
+
+    /// The entries, in the order the values were first seen.
+    vector<Entry> entries;
+
+    /** The hash table.
+     *
+     *  Each bucket is an index into entries plus one, or 0 if empty.  The
+     *  size is always 0 or a power of 2.
+     */
+    vector<unsigned> buckets;
+
+    /// Calculate the hash of a value (FNV-1a).
+    static unsigned hash_value(const char * p, size_t len) {
+	unsigned h = 2166136261u;
+	while (len--) {
+	    h ^= static_cast<unsigned char>(*p++);
+	    h *= 16777619u;
+	}
+	return h;
+    }
+
+    /// Resize the hash table to @a n buckets.
+    void rehash(size_t n) {
+	vector<unsigned> new_buckets(n);
+	size_t mask = n - 1;
+	for (size_t i = 0; i != entries.size(); ++i) {
+	    size_t b = entries[i].hash & mask;
+	    while (new_buckets[b]) b = (b + 1) & mask;
+	    new_buckets[b] = unsigned(i + 1);
+	}
+	swap(buckets, new_buckets);
+    }
+
+  public:
+    /// The number of different values.
+    size_t size() const { return entries.size(); }
+
+    /// Add @a freq to the frequency of a value.
+    void add(const char * p, size_t len, Xapian::doccount freq) {
+	// Keep the table no more than half full.
+	if (entries.size() * 2 >= buckets.size())
+	    rehash(buckets.empty() ? 16 : buckets.size() * 2);
+	unsigned h = hash_value(p, len);
+	size_t mask = buckets.size() - 1;
+	size_t b = h & mask;
+	while (buckets[b]) {
+	    Entry & e = entries[buckets[b] - 1];
+	    if (e.hash == h && e.len == len &&
+		memcmp(strings.data() + e.offset, p, len) == 0) {
+		e.freq += freq;
+		return;
+	    }
+	    b = (b + 1) & mask;
+	}
+	Entry e;
+	e.offset = strings.size();
+	e.len = len;
+	e.hash = h;
+	e.freq = freq;
+	strings.append(p, len);
+	entries.push_back(e);
+	buckets[b] = unsigned(entries.size());
+    }
+
+    /// Add @a freq to the frequency of @a value.
+    void add(const string & value, Xapian::doccount freq) {
+	add(value.data(), value.size(), freq);
+    }
+
+    /// Get the value of entry @a i.
+    string get_value(size_t i) const {
+	return string(strings, entries[i].offset, entries[i].len);
+    }
+
+    /// Get the frequency of entry @a i.
+    Xapian::doccount get_freq(size_t i) const {
+	return entries[i].freq;
+    }
+
+    /// Compare the values of entries @a i and @a j.
+    int compare(size_t i, size_t j) const {
+	const Entry & a = entries[i];
+	const Entry & b = entries[j];
+	int r = memcmp(strings.data() + a.offset, strings.data() + b.offset,
+		       min(a.len, b.len));
+	if (r) return r;
+	return a.len < b.len ? -1 : (a.len > b.len ? 1 : 0);
+    }
+};
+
+/** Compare entries in a ValueCounts object by value.
+ */
+class ValueCountsCmpByValue {
+    const ValueCounts & counts;
+
+  public:
+    ValueCountsCmpByValue(const ValueCounts & counts_) : counts(counts_) { }
+
+    bool operator()(unsigned a, unsigned b) const {
+	return counts.compare(a, b) < 0;
+    }
+};
+
+/** Compare entries in a ValueCounts object by frequency.
+ *
+ *  The comparison is firstly by frequency (higher is better), then by value
+ *  (earlier lexicographic sort is better).
+ */
+class ValueCountsCmpByFreq {
+    const ValueCounts & counts;
+
+  public:
+    ValueCountsCmpByFreq(const ValueCounts & counts_) : counts(counts_) { }
+
+    bool operator()(unsigned a, unsigned b) const {
+	Xapian::doccount freq_a = counts.get_freq(a);
+	Xapian::doccount freq_b = counts.get_freq(b);
+	if (freq_a != freq_b) return freq_a > freq_b;
+	return counts.compare(a, b) < 0;
+    }
+};
+
+/// Get the entries of @a counts in ascending order of value.
+static void
+get_sorted_entries(vector<unsigned> & result, const ValueCounts & counts)
+{
+    result.resize(counts.size());
+    for (size_t i = 0; i != result.size(); ++i) {
+	result[i] = unsigned(i);
+    }
+    sort(result.begin(), result.end(), ValueCountsCmpByValue(counts));
+}
+
+struct Xapian::ValueCountMatchSpy::Internal : public Xapian::Internal::intrusive_base
+{
+    /// The slot to count.
+    Xapian::valueno slot;
+
+    /// Total number of documents seen by the match spy.
+    Xapian::doccount total;
+
+    /// The values seen so far, together with their frequency.
+    ValueCounts values;
+
+    Internal() : slot(Xapian::BAD_VALUENO), total(0) {}
+    Internal(Xapian::valueno slot_) : slot(slot_), total(0) {}
+};
+
 /// A termlist iterator over the contents of a ValueCountMatchSpy
 class ValueCountTermList : public TermList {
   private:
-    map<string, Xapian::doccount>::const_iterator it;
+    /// The entries, in ascending order of value.
+    vector<unsigned> order;
+    vector<unsigned>::const_iterator it;
     bool started;
     intrusive_ptr<Xapian::ValueCountMatchSpy::Internal> spy;
   public:
 
     ValueCountTermList(ValueCountMatchSpy::Internal * spy_) : spy(spy_) {
-	it = spy->values.begin();
+	get_sorted_entries(order, spy->values);
+	it = order.begin();
 	started = false;
     }
 
     string get_termname() const {
 	Assert(started);
 	Assert(!at_end());
-	return it->first;
+	return spy->values.get_value(*it);
     }
 
     Xapian::doccount get_termfreq() const {
 	Assert(started);
 	Assert(!at_end());
-	return it->second;
+	return spy->values.get_freq(*it);
     }
 
     TermList * next() {
@@ -126,7 +304,7 @@ class ValueCountTermList : public TermList {
     }
 
     TermList * skip_to(const string & term) {
-	while (it != spy->values.end() && it->first < term) {
+	while (it != order.end() && spy->values.get_value(*it) < term) {
 	    ++it;
 	}
 	started = true;
@@ -135,7 +313,7 @@ class ValueCountTermList : public TermList {
 
     bool at_end() const {
 	Assert(started);
-	return it == spy->values.end();
+	return it == order.end();
     }
 
     Xapian::termcount get_approx_size() const { unsupported_method(); return 0; }
@@ -164,27 +342,6 @@ class StringAndFrequency {
     Xapian::doccount get_frequency() const { return frequency; }
 };
 
-/** Compare two StringAndFrequency objects.
- *
- *  The comparison is firstly by frequency (higher is better), then by string
- *  (earlier lexicographic sort is better).
- */
-class StringAndFreqCmpByFreq {
-  public:
-    /// Default constructor
-    StringAndFreqCmpByFreq() {}
-
-    /// Return true if a has a higher frequency than b.
-    /// If equal, compare by the str, to provide a stable sort order.
-    bool operator()(const StringAndFrequency &a,
-		    const StringAndFrequency &b) const {
-	if (a.get_frequency() > b.get_frequency()) return true;
-	if (a.get_frequency() < b.get_frequency()) return false;
-	if (a.get_string() > b.get_string()) return false;
-	return true;
-    }
-};
-
 /// A termlist iterator over a vector of StringAndFrequency objects.
 class StringAndFreqTermList : public TermList {
   private:
@@ -245,63 +402,79 @@ class StringAndFreqTermList : public TermList {
     Xapian::termcount positionlist_count() const { unsupported_method(); return 0; }
 };
 
-/** Get the most frequent items from a map from string to frequency.
+/** Get the most frequent values counted in a ValueCounts object.
  *
- *  This takes input such as that in ValueCountMatchSpy::Internal::values and
- *  returns a vector of the most frequent items in the input.
+ *  The candidates are kept in a heap of at most @a maxitems entries, with
+ *  the worst at the top, so most values only need comparing with that.
  *
  *  @param result A vector which will be filled with the most frequent
  *                items, in descending order of frequency.  Items with
  *                the same frequency will be sorted in ascending
  *                alphabetical order.
  *
- *  @param items The map from string to frequency, from which the most
- *               frequent items will be selected.
+ *  @param items The counts from which the most frequent items will be
+ *		 selected.
  *
  *  @param maxitems The maximum number of items to return.
  */
 static void
 get_most_frequent_items(vector<StringAndFrequency> & result,
-			const map<string, doccount> & items,
+			const ValueCounts & items,
 			size_t maxitems)
 {
     result.clear();
-    result.reserve(maxitems);
-    StringAndFreqCmpByFreq cmpfn;
-    bool is_heap(false);
-
-    for (map<string, doccount>::const_iterator i = items.begin();
-	 i != items.end(); ++i) {
-	Assert(result.size() <= maxitems);
-	result.push_back(StringAndFrequency(i->first, i->second));
-	if (result.size() > maxitems) {
-	    // Make the list back into a heap.
-	    if (is_heap) {
-		// Only the new element isn't in the right place.
-		push_heap(result.begin(), result.end(), cmpfn);
-	    } else {
-		// Need to build heap from scratch.
-		make_heap(result.begin(), result.end(), cmpfn);
-		is_heap = true;
-	    }
-	    pop_heap(result.begin(), result.end(), cmpfn);
-	    result.pop_back();
+    if (maxitems == 0) return;
+    ValueCountsCmpByFreq cmpfn(items);
+    vector<unsigned> heap;
+    heap.reserve(min(maxitems, items.size()));
+
+    for (unsigned i = 0; i != items.size(); ++i) {
+	if (heap.size() < maxitems) {
+	    heap.push_back(i);
+	    if (heap.size() == maxitems)
+		make_heap(heap.begin(), heap.end(), cmpfn);
+	    continue;
 	}
+	// The heap is full, so only take this item if it beats the worst.
+	if (!cmpfn(i, heap.front())) continue;
+	pop_heap(heap.begin(), heap.end(), cmpfn);
+	heap.back() = i;
+	push_heap(heap.begin(), heap.end(), cmpfn);
     }
 
-    if (is_heap) {
-	sort_heap(result.begin(), result.end(), cmpfn);
+    if (heap.size() == maxitems) {
+	sort_heap(heap.begin(), heap.end(), cmpfn);
     } else {
-	sort(result.begin(), result.end(), cmpfn);
+	sort(heap.begin(), heap.end(), cmpfn);
+    }
+
+    result.reserve(heap.size());
+    vector<unsigned>::const_iterator i;
+    for (i = heap.begin(); i != heap.end(); ++i) {
+	result.push_back(StringAndFrequency(items.get_value(*i),
+					    items.get_freq(*i)));
     }
 }
 
+ValueCountMatchSpy::ValueCountMatchSpy() : internal() {}
+
+ValueCountMatchSpy::ValueCountMatchSpy(Xapian::valueno slot_)
+    : internal(new Internal(slot_)) {}
+
+ValueCountMatchSpy::~ValueCountMatchSpy() {}
+
+size_t
+ValueCountMatchSpy::get_total() const
+{
+    return internal.get() ? internal->total : 0;
+}
+
 void
 ValueCountMatchSpy::operator()(const Document &doc, double) {
     Assert(internal.get());
     ++(internal->total);
     string val(doc.get_value(internal->slot));
-    if (!val.empty()) ++(internal->values[val]);
+    if (!val.empty()) internal->values.add(val, 1);
 }
 
 TermIterator
@@ -359,14 +532,24 @@ string
 ValueCountMatchSpy::serialise_results() const {
     LOGCALL(REMOTE, string, "ValueCountMatchSpy::serialise_results", NO_ARGS);
     Assert(internal.get());
+    const ValueCounts & values = internal->values;
+    // The values are sent in sorted order, with each sharing as much of a
+    // prefix with the previous value as it can.
+    vector<unsigned> order;
+    get_sorted_entries(order, values);
     string result;
     result += encode_length(internal->total);
-    result += encode_length(internal->values.size());
-    for (map<string, doccount>::const_iterator i = internal->values.begin();
-	 i != internal->values.end(); ++i) {
-	result += encode_length(i->first.size());
-	result += i->first;
-	result += encode_length(i->second);
+    result += encode_length(values.size());
+    string prev;
+    vector<unsigned>::const_iterator i;
+    for (i = order.begin(); i != order.end(); ++i) {
+	string value = values.get_value(*i);
+	size_t reuse = common_prefix_length(prev, value);
+	result += encode_length(reuse);
+	result += encode_length(value.size() - reuse);
+	result.append(value, reuse, string::npos);
+	result += encode_length(values.get_freq(*i));
+	swap(prev, value);
     }
     RETURN(result);
 }
@@ -380,16 +563,22 @@ ValueCountMatchSpy::merge_results(const string & s) {
 
     internal->total += decode_length(&p, end, false);
 
-    map<string, doccount>::size_type items = decode_length(&p, end, false);
-    while (p != end) {
-	while (items != 0) {
-	    size_t vallen = decode_length(&p, end, true);
-	    string val(p, vallen);
-	    p += vallen;
-	    doccount freq = decode_length(&p, end, false);
-	    internal->values[val] += freq;
-	    --items;
-	}
+    size_t items = decode_length(&p, end, false);
+    string val;
+    while (items != 0) {
+	size_t reuse = decode_length(&p, end, false);
+	size_t len = decode_length(&p, end, true);
+	if (reuse > val.size())
+	    throw NetworkError("Bad serialised ValueCountMatchSpy results");
+	val.resize(reuse);
+	val.append(p, len);
+	p += len;
+	doccount freq = decode_length(&p, end, false);
+	internal->values.add(val, freq);
+	--items;
+    }
+    if (p != end) {
+	throw NetworkError("Junk at end of serialised ValueCountMatchSpy results");
     }
 }
 
@@ -406,3 +595,339 @@ ValueCountMatchSpy::get_description() const {
     }
     return d;
 }
+
+struct Xapian::NumericHistogramMatchSpy::Internal
+    : public Xapian::Internal::intrusive_base
+{
+    /// The slot to look at.
+    Xapian::valueno slot;
+
+    /// The start of the first bucket.
+    double start;
+
+    /// The width of the buckets, or the ratio between them if logarithmic.
+    double step;
+
+    /// Are the buckets logarithmic?
+    bool logarithmic;
+
+    /// The number of values in each bucket.
+    vector<Xapian::doccount> counts;
+
+    /// The number of values before the first bucket.
+    Xapian::doccount underflow;
+
+    /// The number of values after the last bucket.
+    Xapian::doccount overflow;
+
+    /// Total number of documents seen by the match spy.
+    Xapian::doccount total;
+
+    /// The number of documents with a value.
+    Xapian::doccount count;
+
+    /// The smallest value seen.
+    double min;
+
+    /// The largest value seen.
+    double max;
+
+    /// The sum of the values seen.
+    double sum;
+
+    Internal(Xapian::valueno slot_, double start_, double step_,
+	     unsigned num_buckets, bool logarithmic_)
+	: slot(slot_), start(start_), step(step_), logarithmic(logarithmic_),
+	  counts(num_buckets), underflow(0), overflow(0), total(0), count(0),
+	  min(HUGE_VAL), max(-HUGE_VAL), sum(0.0)
+    {
+	if (num_buckets == 0) {
+	    throw InvalidArgumentError("NumericHistogramMatchSpy needs at "
+				       "least one bucket");
+	}
+	if (logarithmic ? !(start > 0.0 && step > 1.0) : !(step > 0.0)) {
+	    throw InvalidArgumentError("Bad bucket parameters for "
+				       "NumericHistogramMatchSpy");
+	}
+    }
+
+    /// Return the start of bucket @a i.
+    double bucket_start(size_t i) const {
+	if (logarithmic) return start * pow(step, double(i));
+	return start + step * double(i);
+    }
+
+    /// Add @a value to the histogram.
+    void add(double value) {
+	++count;
+	sum += value;
+	if (value < min) min = value;
+	if (value > max) max = value;
+
+	if (!(value >= start)) {
+	    ++underflow;
+	    return;
+	}
+	double x;
+	if (logarithmic) {
+	    x = log(value / start) / log(step);
+	} else {
+	    x = (value - start) / step;
+	}
+	size_t n = counts.size();
+	size_t i = (x < double(n)) ? size_t(x) : n;
+	// Correct for rounding errors in working out the bucket, treating the
+	// overflow as bucket n.
+	if (i && value < bucket_start(i)) {
+	    --i;
+	} else if (i < n && value >= bucket_start(i + 1)) {
+	    ++i;
+	}
+	if (i == n) {
+	    ++overflow;
+	    return;
+	}
+	++counts[i];
+    }
+};
+
+NumericHistogramMatchSpy::NumericHistogramMatchSpy() : internal() {}
+
+NumericHistogramMatchSpy::NumericHistogramMatchSpy(Xapian::valueno slot_,
+						   double start, double step,
+						   unsigned num_buckets,
+						   bool logarithmic)
+    : internal(new Internal(slot_, start, step, num_buckets, logarithmic)) {}
+
+NumericHistogramMatchSpy::~NumericHistogramMatchSpy() {}
+
+Xapian::doccount
+NumericHistogramMatchSpy::get_total() const
+{
+    return internal.get() ? internal->total : 0;
+}
+
+Xapian::doccount
+NumericHistogramMatchSpy::get_count() const
+{
+    return internal.get() ? internal->count : 0;
+}
+
+double
+NumericHistogramMatchSpy::get_min() const
+{
+    return internal.get() ? internal->min : HUGE_VAL;
+}
+
+double
+NumericHistogramMatchSpy::get_max() const
+{
+    return internal.get() ? internal->max : -HUGE_VAL;
+}
+
+double
+NumericHistogramMatchSpy::get_sum() const
+{
+    return internal.get() ? internal->sum : 0.0;
+}
+
+unsigned
+NumericHistogramMatchSpy::get_num_buckets() const
+{
+    return internal.get() ? unsigned(internal->counts.size()) : 0;
+}
+
+double
+NumericHistogramMatchSpy::get_bucket_start(unsigned i) const
+{
+    Assert(internal.get());
+    if (i > internal->counts.size()) {
+	throw RangeError("Bucket number out of range");
+    }
+    return internal->bucket_start(i);
+}
+
+Xapian::doccount
+NumericHistogramMatchSpy::get_bucket_count(unsigned i) const
+{
+    Assert(internal.get());
+    if (i >= internal->counts.size()) {
+	throw RangeError("Bucket number out of range");
+    }
+    return internal->counts[i];
+}
+
+Xapian::doccount
+NumericHistogramMatchSpy::get_underflow_count() const
+{
+    return internal.get() ? internal->underflow : 0;
+}
+
+Xapian::doccount
+NumericHistogramMatchSpy::get_overflow_count() const
+{
+    return internal.get() ? internal->overflow : 0;
+}
+
+void
+NumericHistogramMatchSpy::operator()(const Document &doc, double) {
+    Assert(internal.get());
+    ++(internal->total);
+    double value = doc.get_numeric_value(internal->slot);
+    // An empty value unserialises to -infinity.
+    if (value != -HUGE_VAL) internal->add(value);
+}
+
+MatchSpy *
+NumericHistogramMatchSpy::clone() const {
+    Assert(internal.get());
+    return new NumericHistogramMatchSpy(internal->slot, internal->start,
+					internal->step,
+					unsigned(internal->counts.size()),
+					internal->logarithmic);
+}
+
+string
+NumericHistogramMatchSpy::name() const {
+    return "Xapian::NumericHistogramMatchSpy";
+}
+
+string
+NumericHistogramMatchSpy::serialise() const {
+    Assert(internal.get());
+    string result;
+    result += encode_length(internal->slot);
+    result += serialise_double(internal->start);
+    result += serialise_double(internal->step);
+    result += encode_length(internal->counts.size());
+    result += char(internal->logarithmic);
+    return result;
+}
+
+MatchSpy *
+NumericHistogramMatchSpy::unserialise(const string & s, const Registry &) const
+{
+    const char * p = s.data();
+    const char * end = p + s.size();
+
+    valueno new_slot = decode_length(&p, end, false);
+    double new_start = unserialise_double(&p, end);
+    double new_step = unserialise_double(&p, end);
+    unsigned num_buckets = decode_length(&p, end, false);
+    if (p == end) {
+	throw NetworkError("Bad serialised NumericHistogramMatchSpy");
+    }
+    bool new_logarithmic = (*p++ != '\0');
+    if (p != end) {
+	throw NetworkError("Junk at end of serialised NumericHistogramMatchSpy");
+    }
+    // The constructor would throw InvalidArgumentError for these, but the
+    // problem is with what we were sent, not how we were called.
+    if (num_buckets == 0 ||
+	(new_logarithmic ? !(new_start > 0.0 && new_step > 1.0)
+			 : !(new_step > 0.0))) {
+	throw NetworkError("Bad serialised NumericHistogramMatchSpy");
+    }
+
+    return new NumericHistogramMatchSpy(new_slot, new_start, new_step,
+					num_buckets, new_logarithmic);
+}
+
+string
+NumericHistogramMatchSpy::serialise_results() const {
+    LOGCALL(REMOTE, string, "NumericHistogramMatchSpy::serialise_results", NO_ARGS);
+    Assert(internal.get());
+    string result;
+    // Include the bucket parameters so merge_results() can check they match.
+    result += serialise_double(internal->start);
+    result += serialise_double(internal->step);
+    result += internal->logarithmic ? '1' : '0';
+    result += encode_length(internal->counts.size());
+    result += encode_length(internal->total);
+    result += encode_length(internal->count);
+    if (internal->count == 0) RETURN(result);
+    result += serialise_double(internal->min);
+    result += serialise_double(internal->max);
+    result += serialise_double(internal->sum);
+    result += encode_length(internal->underflow);
+    result += encode_length(internal->overflow);
+    vector<Xapian::doccount>::const_iterator i;
+    for (i = internal->counts.begin(); i != internal->counts.end(); ++i) {
+	result += encode_length(*i);
+    }
+    RETURN(result);
+}
+
+void
+NumericHistogramMatchSpy::merge_results(const string & s) {
+    LOGCALL_VOID(REMOTE, "NumericHistogramMatchSpy::merge_results", s);
+    Assert(internal.get());
+    const char * p = s.data();
+    const char * end = p + s.size();
+
+    double start = unserialise_double(&p, end);
+    double step = unserialise_double(&p, end);
+    if (p == end || (*p != '0' && *p != '1')) {
+	throw NetworkError("Bad serialised NumericHistogramMatchSpy results");
+    }
+    bool logarithmic = (*p++ == '1');
+    size_t num_buckets = decode_length(&p, end, false);
+    if (start != internal->start || step != internal->step ||
+	logarithmic != internal->logarithmic ||
+	num_buckets != internal->counts.size()) {
+	throw NetworkError("NumericHistogramMatchSpy results have different "
+			   "buckets");
+    }
+
+    // Decode everything before changing anything, so bad results aren't
+    // partly merged.
+    Xapian::doccount total = decode_length(&p, end, false);
+    Xapian::doccount count = decode_length(&p, end, false);
+    double min = HUGE_VAL, max = -HUGE_VAL, sum = 0.0;
+    Xapian::doccount underflow = 0, overflow = 0;
+    vector<Xapian::doccount> counts;
+    if (count) {
+	min = unserialise_double(&p, end);
+	max = unserialise_double(&p, end);
+	sum = unserialise_double(&p, end);
+	underflow = decode_length(&p, end, false);
+	overflow = decode_length(&p, end, false);
+	counts.reserve(num_buckets);
+	for (size_t i = 0; i != num_buckets; ++i) {
+	    counts.push_back(decode_length(&p, end, false));
+	}
+    }
+    if (p != end) {
+	throw NetworkError("Junk at end of serialised NumericHistogramMatchSpy results");
+    }
+
+    internal->total += total;
+    if (count) {
+	internal->count += count;
+	if (min < internal->min) internal->min = min;
+	if (max > internal->max) internal->max = max;
+	internal->sum += sum;
+	internal->underflow += underflow;
+	internal->overflow += overflow;
+	for (size_t i = 0; i != num_buckets; ++i) {
+	    internal->counts[i] += counts[i];
+	}
+    }
+}
+
+string
+NumericHistogramMatchSpy::get_description() const {
+    string d = "NumericHistogramMatchSpy(";
+    if (internal.get()) {
+	d += str(internal->total);
+	d += " docs seen, ";
+	d += str(internal->count);
+	d += " values in ";
+	d += str(internal->counts.size());
+	d += internal->logarithmic ? " logarithmic" : " fixed width";
+	d += " buckets)";
+    } else {
+	d += ")";
+    }
+    return d;
+}
@@ -161,7 +161,7 @@ Database::postlist_begin(const string &tname) const
 
     // Handle the common case of a single database specially.
     if (internal.size() == 1)
-	RETURN(PostingIterator(internal[0]->open_post_list(tname)));
+	RETURN(PostingIterator(internal[0]->open_post_list(tname, NULL)));
 
     if (rare(internal.empty()))
 	RETURN(PostingIterator());
@@ -170,7 +170,7 @@ Database::postlist_begin(const string &tname) const
     try {
 	vector<intrusive_ptr<Database::Internal> >::const_iterator i;
 	for (i = internal.begin(); i != internal.end(); ++i) {
-	    pls.push_back((*i)->open_post_list(tname));
+	    pls.push_back((*i)->open_post_list(tname, NULL));
 	    pls.back()->next();
 	}
 	Assert(pls.begin() != pls.end());
@@ -473,6 +473,53 @@ Database::get_document(Xapian::docid did) const
     RETURN(Document(internal[n]->open_document(m, false)));
 }
 
+vector<Document>
+Database::get_documents(const vector<Xapian::docid> & dids) const
+{
+    LOGCALL(API, vector<Document>, "Database::get_documents", dids);
+    unsigned int multiplier = internal.size();
+    if (rare(multiplier == 0))
+	no_subdatabases();
+
+    // Sort the (real docid, index in dids) pairs for each subdatabase, so
+    // the backend can read the documents in docid order.
+    vector<vector<pair<Xapian::docid, size_t> > > wanted(multiplier);
+    for (size_t i = 0; i != dids.size(); ++i) {
+	Xapian::docid did = dids[i];
+	if (did == 0)
+	    docid_zero_invalid();
+	Xapian::doccount n = (did - 1) % multiplier; // which actual database
+	Xapian::docid m = (did - 1) / multiplier + 1; // real docid in that database
+	wanted[n].push_back(make_pair(m, i));
+    }
+
+    vector<Document> result(dids.size());
+    vector<Xapian::docid> sub_dids;
+    vector<Document> sub_docs;
+    for (unsigned int n = 0; n != multiplier; ++n) {
+	vector<pair<Xapian::docid, size_t> > & w = wanted[n];
+	if (w.empty()) continue;
+	sort(w.begin(), w.end());
+	sub_dids.clear();
+	vector<pair<Xapian::docid, size_t> >::const_iterator j;
+	for (j = w.begin(); j != w.end(); ++j) {
+	    // Only ask for each document once.
+	    if (sub_dids.empty() || sub_dids.back() != j->first)
+		sub_dids.push_back(j->first);
+	}
+	sub_docs.clear();
+	sub_docs.reserve(sub_dids.size());
+	internal[n]->open_documents(sub_dids, sub_docs);
+	AssertEq(sub_docs.size(), sub_dids.size());
+	size_t k = 0;
+	for (j = w.begin(); j != w.end(); ++j) {
+	    if (sub_dids[k] != j->first) ++k;
+	    result[j->second] = sub_docs[k];
+	}
+    }
+    RETURN(result);
+}
+
 bool
 Database::term_exists(const string & tname) const
 {
@@ -790,6 +837,30 @@ WritableDatabase::commit()
 	internal[i]->commit();
 }
 
+void
+WritableDatabase::set_flush_memory(size_t bytes)
+{
+    LOGCALL_VOID(API, "WritableDatabase::set_flush_memory", bytes);
+    size_t n_dbs = internal.size();
+    if (rare(n_dbs == 0))
+	no_subdatabases();
+    for (size_t i = 0; i != n_dbs; ++i)
+	internal[i]->set_flush_memory(bytes);
+}
+
+size_t
+WritableDatabase::get_buffered_memory() const
+{
+    LOGCALL(API, size_t, "WritableDatabase::get_buffered_memory", NO_ARGS);
+    size_t n_dbs = internal.size();
+    if (rare(n_dbs == 0))
+	no_subdatabases();
+    size_t result = 0;
+    for (size_t i = 0; i != n_dbs; ++i)
+	result += internal[i]->get_buffered_memory();
+    RETURN(result);
+}
+
 void
 WritableDatabase::begin_transaction(bool flushed)
 {
@@ -33,6 +33,7 @@
 #include "unicode/description_append.h"
 
 #include <xapian/error.h>
+#include <xapian/queryparser.h> // For sortable_unserialise().
 #include <xapian/types.h>
 #include <xapian/valueiterator.h>
 
@@ -60,6 +61,13 @@ Document::get_value(Xapian::valueno slot) const
     RETURN(internal->get_value(slot));
 }
 
+double
+Document::get_numeric_value(Xapian::valueno slot) const
+{
+    LOGCALL(API, double, "Document::get_numeric_value", slot);
+    RETURN(internal->get_numeric_value(slot));
+}
+
 string
 Document::get_data() const
 {
@@ -279,6 +287,20 @@ Xapian::Document::Internal::get_value(Xapian::valueno slot) const
     if (!database.get()) return string();
     return do_get_value(slot);
 }
+
+double
+Xapian::Document::Internal::get_numeric_value(Xapian::valueno slot) const
+{
+    if (values_here || !database.get())
+	return sortable_unserialise(get_value(slot));
+    return do_get_numeric_value(slot);
+}
+
+double
+Xapian::Document::Internal::do_get_numeric_value(Xapian::valueno slot) const
+{
+    return sortable_unserialise(do_get_value(slot));
+}
 	
 string
 Xapian::Document::Internal::get_data() const
@@ -41,6 +41,7 @@
 #include "matcher/multimatch.h"
 #include "omassert.h"
 #include "api/omenquireinternal.h"
+#include "api/querystatsinternal.h"
 #include "str.h"
 #include "weight/weightinternal.h"
 
@@ -466,9 +467,37 @@ MSet::Internal::get_description() const
 void
 MSet::Internal::read_docs() const
 {
+    // Read all the documents together, which lets the backends read them in
+    // docid order.
+    vector<Xapian::docid> dids;
+    dids.reserve(requested_docs.size());
     set<Xapian::doccount>::const_iterator i;
     for (i = requested_docs.begin(); i != requested_docs.end(); ++i) {
-	indexeddocs[*i] = enquire->read_doc(items[*i - firstitem]);
+	dids.push_back(items[*i - firstitem].did);
+    }
+    vector<Document> docs;
+    try {
+	docs = enquire->read_docs(dids);
+    } catch (const Error &) {
+	// Fall back to reading the documents one at a time, so one which
+	// can't be read doesn't stop the others being cached.  Any which fail
+	// stay requested, so the error is reported when that document is
+	// asked for.
+	i = requested_docs.begin();
+	while (i != requested_docs.end()) {
+	    try {
+		indexeddocs[*i] = enquire->read_doc(items[*i - firstitem]);
+	    } catch (const Error &) {
+		++i;
+		continue;
+	    }
+	    requested_docs.erase(i++);
+	}
+	return;
+    }
+    size_t j = 0;
+    for (i = requested_docs.begin(); i != requested_docs.end(); ++i) {
+	indexeddocs[*i] = docs[j++];
 	LOGLINE(MATCH, "stored doc at index " << *i << " is " << indexeddocs[*i]);
     }
     /* Clear list of requested but not fetched documents. */
@@ -638,7 +667,9 @@ Enquire::Internal::Internal(const Database &db_, ErrorHandler * errorhandler_)
   : db(db_), query(), collapse_key(Xapian::BAD_VALUENO), collapse_max(0),
     order(Enquire::ASCENDING), percent_cutoff(0), weight_cutoff(0),
     sort_key(Xapian::BAD_VALUENO), sort_by(REL), sort_value_forward(true),
-    sorter(0), time_limit(0.0), errorhandler(errorhandler_), weight(0),
+    sorter(0), time_limit(0.0), match_threads(0), query_stats(NULL),
+    errorhandler(errorhandler_),
+    weight(0),
     eweightname("trad"), expand_k(1.0)
 {
     if (db.internal.empty()) {
@@ -689,12 +720,19 @@ Enquire::Internal::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	check_at_least = max(check_at_least, maxitems);
     }
 
+    QueryStats::Internal * qstats = NULL;
+    if (query_stats) {
+	qstats = query_stats->internal.get();
+	qstats->clear();
+    }
+
     AutoPtr<Xapian::Weight::Internal> stats(new Xapian::Weight::Internal);
     ::MultiMatch match(db, query, qlen, rset,
 		       collapse_max, collapse_key,
 		       percent_cutoff, weight_cutoff,
 		       order, sort_key, sort_by, sort_value_forward,
-		       time_limit, errorhandler, *(stats.get()), weight, spies,
+		       time_limit, match_threads, errorhandler, *(stats.get()),
+		       weight, spies, qstats,
 		       (sorter != NULL),
 		       (mdecider != NULL));
     // Run query and put results into supplied Xapian::MSet object.
@@ -884,6 +922,14 @@ Enquire::Internal::read_doc(const Xapian::Internal::MSetItem &item) const
     }
 }
 
+vector<Document>
+Enquire::Internal::read_docs(const vector<Xapian::docid> & dids) const
+{
+    // The caller falls back to read_doc() if this fails, which calls the
+    // errorhandler.
+    return db.get_documents(dids);
+}
+
 // Methods of Xapian::Enquire
 
 Enquire::Enquire(const Enquire & other) : internal(other.internal)
@@ -1059,6 +1105,20 @@ Enquire::set_time_limit(double time_limit)
     internal->time_limit = time_limit;
 }
 
+void
+Enquire::set_match_threads(unsigned n_threads)
+{
+    LOGCALL_VOID(API, "Xapian::Enquire::set_match_threads", n_threads);
+    internal->match_threads = n_threads;
+}
+
+void
+Enquire::set_query_stats(QueryStats * stats)
+{
+    LOGCALL_VOID(API, "Xapian::Enquire::set_query_stats", stats);
+    internal->query_stats = stats;
+}
+
 MSet
 Enquire::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 		  Xapian::doccount check_at_least, const RSet *rset,
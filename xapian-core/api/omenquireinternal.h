@@ -153,6 +153,12 @@ class Enquire::Internal : public Xapian::Internal::intrusive_base {
 
 	double time_limit;
 
+	/// Number of threads to use to match sub-databases (0 means 1).
+	unsigned match_threads;
+
+	/// The object to fill in with statistics for each match, or NULL.
+	QueryStats * query_stats;
+
 	/** The error handler, if set.  (0 if not set).
 	 */
 	ErrorHandler * errorhandler;
@@ -183,6 +189,18 @@ class Enquire::Internal : public Xapian::Internal::intrusive_base {
 	 */
 	Xapian::Document read_doc(const Xapian::Internal::MSetItem &item) const;
 
+	/** Read several previously requested documents from the database.
+	 *
+	 *  Unlike read_doc(), this doesn't call the errorhandler if reading
+	 *  fails.
+	 *
+	 *  @param dids  The docids of the documents.
+	 *
+	 *  @return      The documents, in the same order as @a dids.
+	 */
+	std::vector<Xapian::Document>
+	read_docs(const std::vector<Xapian::docid> & dids) const;
+
 	void set_query(const Query & query_, termcount qlen_);
 	const Query & get_query();
 	MSet get_mset(Xapian::doccount first, Xapian::doccount maxitems,
@@ -28,6 +28,7 @@
 
 #include "backends/database.h"
 #include "backends/document.h"
+#include "backends/valuelist.h"
 #include "matcher/multimatch.h"
 
 #include "xapian/document.h"
@@ -231,7 +232,8 @@ ValueWeightPostingSource::get_weight() const
 {
     Assert(!at_end());
     Assert(started);
-    return sortable_unserialise(*value_it);
+    // Avoid converting via a string if the value is stored as a number.
+    return value_it.internal->get_numeric_value();
 }
 
 ValueWeightPostingSource *
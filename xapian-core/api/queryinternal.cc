@@ -35,6 +35,7 @@
 #include "matcher/externalpostlist.h"
 #include "matcher/maxpostlist.h"
 #include "matcher/multiandpostlist.h"
+#include "matcher/multiorpostlist.h"
 #include "matcher/multixorpostlist.h"
 #include "matcher/orpostlist.h"
 #include "matcher/phrasepostlist.h"
@@ -66,6 +67,12 @@ using Xapian::Internal::AndContext;
 using Xapian::Internal::OrContext;
 using Xapian::Internal::XorContext;
 
+/** Use MultiOrPostList for weighted ORs with at least this many subqueries.
+ *
+ *  Below this, a tree of OrPostList objects does better.
+ */
+const size_t MULTIOR_MIN_SUBQUERIES = 4;
+
 namespace Xapian {
 
 namespace Internal {
@@ -158,6 +165,7 @@ class OrContext : public Context {
 
     PostList * postlist(QueryOptimiser* qopt);
     PostList * postlist_max(QueryOptimiser* qopt);
+    PostList * postlist_maxscore(QueryOptimiser* qopt);
 };
 
 void
@@ -241,6 +249,22 @@ OrContext::postlist_max(QueryOptimiser* qopt)
     return pl;
 }
 
+PostList *
+OrContext::postlist_maxscore(QueryOptimiser* qopt)
+{
+    // For a few sub-postlists, a tree of OrPostList objects is better as it
+    // can decay to AND and AND_MAYBE as w_min rises.
+    if (pls.size() < MULTIOR_MIN_SUBQUERIES)
+	return postlist(qopt);
+
+    PostList * pl;
+    pl = new MultiOrPostList(pls.begin(), pls.end(), qopt->matcher,
+			     qopt->db_size);
+
+    pls.clear();
+    return pl;
+}
+
 class XorContext : public Context {
   public:
     explicit XorContext(size_t reserve) : Context(reserve) { }
@@ -1250,7 +1274,9 @@ QueryOr::postlist(QueryOptimiser * qopt, double factor) const
     LOGCALL(QUERY, PostingIterator::Internal *, "QueryOr::postlist", qopt | factor);
     OrContext ctx(subqueries.size());
     do_or_like(ctx, qopt, factor);
-    RETURN(ctx.postlist(qopt));
+    if (factor == 0.0)
+	RETURN(ctx.postlist(qopt));
+    RETURN(ctx.postlist_maxscore(qopt));
 }
 
 void
@@ -1368,7 +1394,9 @@ QueryEliteSet::postlist(QueryOptimiser * qopt, double factor) const
     LOGCALL(QUERY, PostingIterator::Internal *, "QueryEliteSet::postlist", qopt | factor);
     OrContext ctx(subqueries.size());
     do_or_like(ctx, qopt, factor, set_size);
-    RETURN(ctx.postlist(qopt));
+    if (factor == 0.0)
+	RETURN(ctx.postlist(qopt));
+    RETURN(ctx.postlist_maxscore(qopt));
 }
 
 void
@@ -0,0 +1,243 @@
+/** @file querystats.cc
+ * @brief Statistics about the work done to run a query.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "xapian/querystats.h"
+#include "querystatsinternal.h"
+
+#include <xapian/error.h>
+
+#include "net/length.h"
+#include "str.h"
+
+using namespace std;
+
+namespace Xapian {
+
+/// The names of the tables, indexed by QueryStats::Internal::table_id.
+static const char * const table_names[] = {
+    "postlist", "position", "record", "spelling", "synonym", "termlist"
+};
+
+QueryStats::Internal::table_id
+QueryStats::Internal::get_table_id(const string & name)
+{
+    for (int i = 0; i != N_TABLES; ++i) {
+	if (name == table_names[i]) return table_id(i);
+    }
+    return NO_TABLE;
+}
+
+void
+QueryStats::Internal::clear()
+{
+    for (int i = 0; i <= N_TABLES; ++i) {
+	blocks_read[i] = 0;
+	block_cache_hits[i] = 0;
+    }
+    postings_decoded = 0;
+    skip_to_calls = 0;
+    documents_scored = 0;
+    documents_rejected = 0;
+    values_fetched = 0;
+    prepare_time = 0.0;
+    postlist_time = 0.0;
+    match_time = 0.0;
+    mset_time = 0.0;
+}
+
+void
+QueryStats::Internal::add_counts(const Internal & o)
+{
+    for (int i = 0; i <= N_TABLES; ++i) {
+	blocks_read[i] += o.blocks_read[i];
+	block_cache_hits[i] += o.block_cache_hits[i];
+    }
+    postings_decoded += o.postings_decoded;
+    skip_to_calls += o.skip_to_calls;
+    documents_scored += o.documents_scored;
+    documents_rejected += o.documents_rejected;
+    values_fetched += o.values_fetched;
+}
+
+string
+QueryStats::Internal::serialise_counts() const
+{
+    string result;
+    for (int i = 0; i != N_TABLES; ++i) {
+	result += encode_length(blocks_read[i]);
+	result += encode_length(block_cache_hits[i]);
+    }
+    result += encode_length(postings_decoded);
+    result += encode_length(skip_to_calls);
+    result += encode_length(documents_scored);
+    result += encode_length(documents_rejected);
+    result += encode_length(values_fetched);
+    return result;
+}
+
+void
+QueryStats::Internal::add_serialised_counts(const string & s)
+{
+    const char * p = s.data();
+    const char * p_end = p + s.size();
+    for (int i = 0; i != N_TABLES; ++i) {
+	blocks_read[i] += decode_length(&p, p_end, false);
+	block_cache_hits[i] += decode_length(&p, p_end, false);
+    }
+    postings_decoded += decode_length(&p, p_end, false);
+    skip_to_calls += decode_length(&p, p_end, false);
+    documents_scored += decode_length(&p, p_end, false);
+    documents_rejected += decode_length(&p, p_end, false);
+    values_fetched += decode_length(&p, p_end, false);
+    if (p != p_end) {
+	throw Xapian::NetworkError("Junk at end of serialised QueryStats");
+    }
+}
+
+QueryStats::QueryStats() : internal(new QueryStats::Internal)
+{
+}
+
+QueryStats::QueryStats(const QueryStats & other) : internal(other.internal)
+{
+}
+
+QueryStats &
+QueryStats::operator=(const QueryStats & other)
+{
+    internal = other.internal;
+    return *this;
+}
+
+QueryStats::~QueryStats()
+{
+}
+
+void
+QueryStats::clear()
+{
+    internal->clear();
+}
+
+unsigned long
+QueryStats::get_blocks_read(const string & table) const
+{
+    return internal->blocks_read[Internal::get_table_id(table)];
+}
+
+unsigned long
+QueryStats::get_block_cache_hits(const string & table) const
+{
+    return internal->block_cache_hits[Internal::get_table_id(table)];
+}
+
+unsigned long
+QueryStats::get_postings_decoded() const
+{
+    return internal->postings_decoded;
+}
+
+unsigned long
+QueryStats::get_skip_to_calls() const
+{
+    return internal->skip_to_calls;
+}
+
+Xapian::doccount
+QueryStats::get_documents_scored() const
+{
+    return internal->documents_scored;
+}
+
+Xapian::doccount
+QueryStats::get_documents_rejected() const
+{
+    return internal->documents_rejected;
+}
+
+unsigned long
+QueryStats::get_values_fetched() const
+{
+    return internal->values_fetched;
+}
+
+double
+QueryStats::get_prepare_time() const
+{
+    return internal->prepare_time;
+}
+
+double
+QueryStats::get_postlist_time() const
+{
+    return internal->postlist_time;
+}
+
+double
+QueryStats::get_match_time() const
+{
+    return internal->match_time;
+}
+
+double
+QueryStats::get_mset_time() const
+{
+    return internal->mset_time;
+}
+
+string
+QueryStats::get_description() const
+{
+    string desc = "QueryStats(";
+    for (int i = 0; i != Internal::N_TABLES; ++i) {
+	desc += table_names[i];
+	desc += "_blocks=";
+	desc += str(internal->blocks_read[i]);
+	if (internal->block_cache_hits[i]) {
+	    desc += " (";
+	    desc += str(internal->block_cache_hits[i]);
+	    desc += " cached)";
+	}
+	desc += ", ";
+    }
+    desc += "postings_decoded=";
+    desc += str(internal->postings_decoded);
+    desc += ", skip_to_calls=";
+    desc += str(internal->skip_to_calls);
+    desc += ", documents_scored=";
+    desc += str(internal->documents_scored);
+    desc += ", documents_rejected=";
+    desc += str(internal->documents_rejected);
+    desc += ", values_fetched=";
+    desc += str(internal->values_fetched);
+    desc += ", prepare_time=";
+    desc += str(internal->prepare_time);
+    desc += ", postlist_time=";
+    desc += str(internal->postlist_time);
+    desc += ", match_time=";
+    desc += str(internal->match_time);
+    desc += ", mset_time=";
+    desc += str(internal->mset_time);
+    desc += ')';
+    return desc;
+}
+
+}
@@ -0,0 +1,103 @@
+/** @file querystatsinternal.h
+ * @brief Statistics about the work done to run a query.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_QUERYSTATSINTERNAL_H
+#define XAPIAN_INCLUDED_QUERYSTATSINTERNAL_H
+
+#include <xapian/querystats.h>
+
+#include <string>
+
+namespace Xapian {
+
+/** The statistics for a query.
+ *
+ *  The matcher and backends update the members directly.  An object is
+ *  only ever updated by one thread at a time - worker threads each have
+ *  their own, which are combined by add_counts() once they finish.
+ */
+class QueryStats::Internal : public Xapian::Internal::intrusive_base {
+    /// Don't allow assignment.
+    void operator=(const Internal &);
+
+    /// Don't allow copying.
+    Internal(const Internal &);
+
+  public:
+    /// The tables which block reads are counted for.
+    enum table_id {
+	POSTLIST, POSITION, RECORD, SPELLING, SYNONYM, TERMLIST,
+	N_TABLES,
+	/// Used for tables which block reads aren't counted for.
+	NO_TABLE = N_TABLES
+    };
+
+    /** Return the table_id for the table called @a name.
+     *
+     *  NO_TABLE is returned for an unknown name.
+     */
+    static table_id get_table_id(const std::string & name);
+
+    unsigned long blocks_read[N_TABLES + 1];
+
+    unsigned long block_cache_hits[N_TABLES + 1];
+
+    unsigned long postings_decoded;
+
+    unsigned long skip_to_calls;
+
+    Xapian::doccount documents_scored;
+
+    Xapian::doccount documents_rejected;
+
+    unsigned long values_fetched;
+
+    double prepare_time;
+
+    double postlist_time;
+
+    double match_time;
+
+    double mset_time;
+
+    Internal() { clear(); }
+
+    /// Reset all the statistics to zero.
+    void clear();
+
+    /** Add the counts from @a o to ours.
+     *
+     *  The times aren't added, as the work they measure may have overlapped
+     *  with ours.
+     */
+    void add_counts(const Internal & o);
+
+    /// Serialise the counts to a string.
+    std::string serialise_counts() const;
+
+    /** Add the counts from a string produced by serialise_counts().
+     *
+     *  Used to include the counts from a remote database.
+     */
+    void add_serialised_counts(const std::string & s);
+};
+
+}
+
+#endif // XAPIAN_INCLUDED_QUERYSTATSINTERNAL_H
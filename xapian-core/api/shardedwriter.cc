@@ -0,0 +1,228 @@
+/** @file shardedwriter.cc
+ * @brief Index documents from several threads, then merge the results.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include <xapian/shardedwriter.h>
+
+#include <xapian/compactor.h>
+#include <xapian/constants.h>
+#include <xapian/database.h>
+#include <xapian/document.h>
+#include <xapian/error.h>
+
+#include "fileutils.h"
+#include "filetests.h"
+#include "mutex.h"
+#include "str.h"
+
+#include <vector>
+
+using namespace std;
+
+namespace Xapian {
+
+class ShardedWriter::Internal : public Xapian::Internal::intrusive_base {
+    /// One of the temporary databases.
+    struct Shard {
+	string path;
+
+	Xapian::WritableDatabase db;
+
+	/// Held while a thread is adding a document to db.
+	Mutex mutex;
+
+	explicit Shard(const string & path_)
+	    : path(path_),
+	      db(path, Xapian::DB_CREATE|Xapian::DB_BACKEND_BRASS)
+	{ }
+    };
+
+    string destdir;
+
+    vector<Shard *> shards;
+
+    /// Protects next_shard.
+    Mutex next_shard_mutex;
+
+    /// The shard the next document should try first.
+    size_t next_shard;
+
+    /// True once the shards have been committed and closed.
+    bool closed;
+
+    bool finished;
+
+    /// Close and remove all the shards.
+    void remove_shards();
+
+  public:
+    Internal(const string & destdir_, unsigned n_shards);
+
+    ~Internal();
+
+    void add_document(const Xapian::Document & document);
+
+    void finish(Xapian::Compactor & compactor);
+};
+
+ShardedWriter::Internal::Internal(const string & destdir_, unsigned n_shards)
+    : destdir(destdir_), next_shard(0), closed(false), finished(false)
+{
+    if (n_shards == 0)
+	throw Xapian::InvalidArgumentError("ShardedWriter needs at least one shard");
+
+    // Remove any trailing directory separators so the shards are created
+    // alongside the destination rather than inside it.
+    string::size_type len = destdir.size();
+    while (len > 1 && (destdir[len - 1] == '/' || destdir[len - 1] == '\\'))
+	--len;
+    string prefix(destdir, 0, len);
+    prefix += ".shard";
+
+    shards.reserve(n_shards);
+    try {
+	for (unsigned i = 0; i != n_shards; ++i) {
+	    // The shards get removed again, so refuse to use a path which
+	    // already exists rather than wiping out whatever is there.
+	    string path = prefix + str(i);
+	    if (file_exists(path) || dir_exists(path)) {
+		string msg = "ShardedWriter shard path already exists: ";
+		msg += path;
+		throw Xapian::DatabaseCreateError(msg);
+	    }
+	    shards.push_back(new Shard(path));
+	}
+    } catch (...) {
+	remove_shards();
+	throw;
+    }
+}
+
+ShardedWriter::Internal::~Internal()
+{
+    try {
+	remove_shards();
+    } catch (...) {
+	// Ignore any errors - we can't usefully report them here.
+    }
+}
+
+void
+ShardedWriter::Internal::remove_shards()
+{
+    while (!shards.empty()) {
+	Shard * shard = shards.back();
+	shards.pop_back();
+	string path = shard->path;
+	delete shard;
+	removedir(path);
+    }
+}
+
+void
+ShardedWriter::Internal::add_document(const Xapian::Document & document)
+{
+    if (finished || closed)
+	throw Xapian::InvalidOperationError("ShardedWriter::finish() has already been called");
+
+    size_t first;
+    {
+	MutexLock lock(next_shard_mutex);
+	first = next_shard;
+	if (++next_shard == shards.size()) next_shard = 0;
+    }
+
+    // Use the first shard which isn't busy, starting from a different one
+    // each time so the documents are spread evenly.  If they're all busy,
+    // wait for the one we started from.
+    Shard * shard = NULL;
+    size_t i = first;
+    do {
+	if (shards[i]->mutex.try_lock()) {
+	    shard = shards[i];
+	    break;
+	}
+	if (++i == shards.size()) i = 0;
+    } while (i != first);
+    if (!shard) {
+	shard = shards[first];
+	shard->mutex.lock();
+    }
+
+    try {
+	shard->db.add_document(document);
+    } catch (...) {
+	shard->mutex.unlock();
+	throw;
+    }
+    shard->mutex.unlock();
+}
+
+void
+ShardedWriter::Internal::finish(Xapian::Compactor & compactor)
+{
+    if (finished)
+	throw Xapian::InvalidOperationError("ShardedWriter::finish() has already been called");
+
+    if (!closed) {
+	for (size_t i = 0; i != shards.size(); ++i) {
+	    shards[i]->db.commit();
+	    shards[i]->db.close();
+	}
+	closed = true;
+    }
+
+    compactor.set_destdir(destdir);
+    for (size_t i = 0; i != shards.size(); ++i) {
+	compactor.add_source(shards[i]->path);
+    }
+    compactor.compact();
+
+    // Only remove the shards once the merged database has been written, so
+    // a failed compaction can be retried.
+    finished = true;
+    remove_shards();
+}
+
+ShardedWriter::ShardedWriter(const string & destdir, unsigned n_shards)
+    : internal(new ShardedWriter::Internal(destdir, n_shards)) { }
+
+ShardedWriter::~ShardedWriter() { }
+
+void
+ShardedWriter::add_document(const Xapian::Document & document)
+{
+    internal->add_document(document);
+}
+
+void
+ShardedWriter::finish(Xapian::Compactor & compactor)
+{
+    internal->finish(compactor);
+}
+
+void
+ShardedWriter::finish()
+{
+    Xapian::Compactor compactor;
+    internal->finish(compactor);
+}
+
+}
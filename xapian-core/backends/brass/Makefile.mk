@@ -6,6 +6,7 @@ if BUILD_BACKEND_BRASS
 noinst_HEADERS +=\
 	backends/brass/brass_alldocspostlist.h\
 	backends/brass/brass_alltermslist.h\
+	backends/brass/brass_blockcache.h\
 	backends/brass/brass_btreebase.h\
 	backends/brass/brass_changes.h\
 	backends/brass/brass_check.h\
@@ -20,6 +21,7 @@ noinst_HEADERS +=\
 	backends/brass/brass_inverter.h\
 	backends/brass/brass_lazytable.h\
 	backends/brass/brass_metadata.h\
+	backends/brass/brass_pins.h\
 	backends/brass/brass_positionlist.h\
 	backends/brass/brass_postlist.h\
 	backends/brass/brass_record.h\
@@ -38,6 +40,7 @@ noinst_HEADERS +=\
 lib_src +=\
 	backends/brass/brass_alldocspostlist.cc\
 	backends/brass/brass_alltermslist.cc\
+	backends/brass/brass_blockcache.cc\
 	backends/brass/brass_btreebase.cc\
 	backends/brass/brass_changes.cc\
 	backends/brass/brass_check.cc\
@@ -51,6 +54,7 @@ lib_src +=\
 	backends/brass/brass_freelist.cc\
 	backends/brass/brass_inverter.cc\
 	backends/brass/brass_metadata.cc\
+	backends/brass/brass_pins.cc\
 	backends/brass/brass_positionlist.cc\
 	backends/brass/brass_postlist.cc\
 	backends/brass/brass_record.cc\
@@ -0,0 +1,174 @@
+/** @file brass_blockcache.cc
+ * @brief Process-wide cache of blocks read from brass tables.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "brass_blockcache.h"
+
+#include "debuglog.h"
+#include "omassert.h"
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+BrassBlockCache::BrassBlockCache()
+    : next_table_id(1), max_size(0), size(0), hits(0), misses(0)
+{
+    const char *p = getenv("XAPIAN_BLOCK_CACHE_SIZE");
+    if (p)
+	max_size = strtoul(p, NULL, 10);
+}
+
+BrassBlockCache &
+BrassBlockCache::get_instance()
+{
+    static BrassBlockCache cache;
+    return cache;
+}
+
+void
+BrassBlockCache::trim(size_t limit)
+{
+    while (size > limit) {
+	AssertRel(entries.size(),>,0);
+	const Entry & entry = entries.back();
+	size -= entry.block.size();
+	index.erase(entry.key);
+	map<unsigned, table_map::iterator>::iterator t;
+	t = table_id_index.find(entry.key.table_id);
+	AssertRel(t->second->second.blocks,>,0);
+	--t->second->second.blocks;
+	entries.pop_back();
+	check_unused(t->second);
+    }
+}
+
+void
+BrassBlockCache::check_unused(table_map::iterator i)
+{
+    if (i->second.refs || i->second.blocks) return;
+    table_id_index.erase(i->second.id);
+    table_ids.erase(i);
+}
+
+size_t
+BrassBlockCache::get_max_size() const
+{
+    MutexLock lock(mutex);
+    return max_size;
+}
+
+void
+BrassBlockCache::set_max_size(size_t max_size_)
+{
+    LOGCALL_VOID(DB, "BrassBlockCache::set_max_size", max_size_);
+    MutexLock lock(mutex);
+    max_size = max_size_;
+    trim(max_size);
+}
+
+unsigned
+BrassBlockCache::get_table_id(const string & uuid, const string & path)
+{
+    MutexLock lock(mutex);
+    string key(uuid);
+    key += path;
+    table_map::iterator i = table_ids.find(key);
+    if (i == table_ids.end()) {
+	// Ids aren't reused, so blocks from a table which is no longer known
+	// can't be mistaken for another's.  0 is reserved to mean "not cached".
+	i = table_ids.insert(make_pair(key, TableInfo(next_table_id++))).first;
+	table_id_index.insert(make_pair(i->second.id, i));
+    }
+    ++i->second.refs;
+    return i->second.id;
+}
+
+void
+BrassBlockCache::release_table_id(unsigned table_id)
+{
+    MutexLock lock(mutex);
+    map<unsigned, table_map::iterator>::iterator t;
+    t = table_id_index.find(table_id);
+    Assert(t != table_id_index.end());
+    AssertRel(t->second->second.refs,>,0);
+    --t->second->second.refs;
+    check_unused(t->second);
+}
+
+bool
+BrassBlockCache::read(unsigned table_id, brass_revision_number_t revision,
+		      uint4 n, byte * p, unsigned block_size)
+{
+    MutexLock lock(mutex);
+    map<Key, entry_list::iterator>::const_iterator i;
+    i = index.find(Key(table_id, revision, n));
+    if (i == index.end()) {
+	++misses;
+	return false;
+    }
+    ++hits;
+    entry_list::iterator e = i->second;
+    AssertEq(e->block.size(), block_size);
+    memcpy(p, e->block.data(), block_size);
+    // Move the entry to the most recently used end.
+    if (e != entries.begin())
+	entries.splice(entries.begin(), entries, e);
+    return true;
+}
+
+void
+BrassBlockCache::add(unsigned table_id, brass_revision_number_t revision,
+		     uint4 n, const byte * p, unsigned block_size)
+{
+    MutexLock lock(mutex);
+    // The cache may have been shrunk since this table checked it was enabled.
+    if (block_size > max_size) return;
+    Key key(table_id, revision, n);
+    if (index.find(key) != index.end()) {
+	// Another reader added this block while we were reading it.
+	return;
+    }
+    trim(max_size - block_size);
+    entries.push_front(Entry(key));
+    entries.front().block.assign(reinterpret_cast<const char *>(p),
+				 block_size);
+    index.insert(make_pair(key, entries.begin()));
+    size += block_size;
+    map<unsigned, table_map::iterator>::iterator t;
+    t = table_id_index.find(table_id);
+    Assert(t != table_id_index.end());
+    ++t->second->second.blocks;
+}
+
+unsigned long
+BrassBlockCache::get_hits() const
+{
+    MutexLock lock(mutex);
+    return hits;
+}
+
+unsigned long
+BrassBlockCache::get_misses() const
+{
+    MutexLock lock(mutex);
+    return misses;
+}
@@ -0,0 +1,187 @@
+/** @file brass_blockcache.h
+ * @brief Process-wide cache of blocks read from brass tables.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_BRASS_BLOCKCACHE_H
+#define XAPIAN_INCLUDED_BRASS_BLOCKCACHE_H
+
+#include "brass_types.h"
+#include "mutex.h"
+
+#include <list>
+#include <map>
+#include <string>
+
+/** A size-bounded LRU cache of blocks read from brass tables.
+ *
+ *  A single instance is shared by all the read-only brass tables opened
+ *  by the process.  Blocks are keyed on the table they come from, the
+ *  revision the table is open at, and the block number - brass uses
+ *  copy-on-write, so the contents of a block number can change between
+ *  revisions, but a block can't change while a revision which uses it is
+ *  still readable.
+ *
+ *  The initial size of the cache in bytes is taken from the environment
+ *  variable XAPIAN_BLOCK_CACHE_SIZE when it is first used, and can be
+ *  changed with Xapian::Brass::set_block_cache_size().  The default is 0,
+ *  which disables the cache.
+ *
+ *  All methods are safe to call from multiple threads.
+ */
+class BrassBlockCache {
+    /// Don't allow copying.
+    BrassBlockCache(const BrassBlockCache &);
+
+    /// Don't allow assignment.
+    void operator=(const BrassBlockCache &);
+
+    struct Key {
+	unsigned table_id;
+
+	brass_revision_number_t revision;
+
+	uint4 n;
+
+	Key(unsigned table_id_, brass_revision_number_t revision_, uint4 n_)
+	    : table_id(table_id_), revision(revision_), n(n_) { }
+
+	bool operator<(const Key & o) const {
+	    if (table_id != o.table_id) return table_id < o.table_id;
+	    if (revision != o.revision) return revision < o.revision;
+	    return n < o.n;
+	}
+    };
+
+    struct Entry {
+	Key key;
+
+	std::string block;
+
+	explicit Entry(const Key & key_) : key(key_) { }
+    };
+
+    typedef std::list<Entry> entry_list;
+
+    /// Entries in order of use, most recently used first.
+    entry_list entries;
+
+    /// Index into entries.
+    std::map<Key, entry_list::iterator> index;
+
+    struct TableInfo {
+	/// The table_id used in Key.
+	unsigned id;
+
+	/// The number of open tables using this id.
+	unsigned refs;
+
+	/// The number of blocks from this table in the cache.
+	size_t blocks;
+
+	explicit TableInfo(unsigned id_) : id(id_), refs(0), blocks(0) { }
+    };
+
+    typedef std::map<std::string, TableInfo> table_map;
+
+    /** Map from table identity to information about it.
+     *
+     *  An entry is kept while any table is using the id, or any of its
+     *  blocks are cached, so a database which is reopened can still find
+     *  its blocks, but entries for databases which are no longer used
+     *  don't accumulate.
+     */
+    table_map table_ids;
+
+    /// Index into table_ids by id.
+    std::map<unsigned, table_map::iterator> table_id_index;
+
+    /// The id to give the next table added to table_ids.
+    unsigned next_table_id;
+
+    /// The maximum number of bytes of block data to hold.
+    size_t max_size;
+
+    /// The number of bytes of block data currently held.
+    size_t size;
+
+    /// Number of lookups which found the block in the cache.
+    unsigned long hits;
+
+    /// Number of lookups which didn't find the block in the cache.
+    unsigned long misses;
+
+    mutable Mutex mutex;
+
+    /// Discard least recently used entries until size <= limit.
+    void trim(size_t limit);
+
+    /// Remove the table_ids entry for @a i if nothing needs it any more.
+    void check_unused(table_map::iterator i);
+
+    BrassBlockCache();
+
+  public:
+    /// Get the process-wide cache.
+    static BrassBlockCache & get_instance();
+
+    /// Is the cache enabled?
+    bool enabled() const { return get_max_size() != 0; }
+
+    /// Get the maximum size of the cache in bytes.
+    size_t get_max_size() const;
+
+    /** Set the maximum size of the cache in bytes (0 disables it).
+     *
+     *  Blocks are discarded as needed to fit the new size.
+     */
+    void set_max_size(size_t max_size_);
+
+    /** Get the id to key blocks from a table on.
+     *
+     *  Each call must be matched by a call to release_table_id() once the
+     *  table no longer uses the id.
+     *
+     *  @param uuid	The UUID of the database the table is part of.
+     *  @param path	The path of the table (without "DB" or "base?").
+     */
+    unsigned get_table_id(const std::string & uuid, const std::string & path);
+
+    /// Release an id returned by get_table_id().
+    void release_table_id(unsigned table_id);
+
+    /** Look for a block in the cache.
+     *
+     *  @param p	Buffer of size @a block_size to copy the block into.
+     *
+     *  @return true if the block was found (and copied to @a p).
+     */
+    bool read(unsigned table_id, brass_revision_number_t revision, uint4 n,
+	      byte * p, unsigned block_size);
+
+    /// Add a block to the cache.
+    void add(unsigned table_id, brass_revision_number_t revision, uint4 n,
+	     const byte * p, unsigned block_size);
+
+    /// Number of lookups which found the block in the cache.
+    unsigned long get_hits() const;
+
+    /// Number of lookups which didn't find the block in the cache.
+    unsigned long get_misses() const;
+};
+
+#endif // XAPIAN_INCLUDED_BRASS_BLOCKCACHE_H
@@ -181,7 +181,8 @@ void
 BrassTable_base::write_to_file(const string &filename,
 			       char base_letter,
 			       const char * tablename,
-			       BrassChanges * changes)
+			       BrassChanges * changes,
+			       int * fd_ptr)
 {
     string buf;
     BrassFreeList::pack(buf);
@@ -215,16 +216,23 @@ BrassTable_base::write_to_file(const string &filename,
 	} else if (strcmp(tablename, "termlist") == 0) {
 	    v = 5;
 	} else {
-	    return; // FIXME
+	    v = 0xff; // FIXME
 	}
-	if (base_letter == 'B')
-	    v |= 1 << 3;
-	v |= 0x80;
-	string changes_buf;
-	changes_buf += char(v);
-	pack_uint(changes_buf, buf.size());
-	changes->write_block(changes_buf);
-	changes->write_block(buf);
+	if (v != 0xff) {
+	    if (base_letter == 'B')
+		v |= 1 << 3;
+	    v |= 0x80;
+	    string changes_buf;
+	    changes_buf += char(v);
+	    pack_uint(changes_buf, buf.size());
+	    changes->write_block(changes_buf);
+	    changes->write_block(buf);
+	}
+    }
+
+    if (fd_ptr) {
+	*fd_ptr = h.release();
+	return;
     }
 
     if (!no_sync)
@@ -74,11 +74,18 @@ class BrassTable_base : public BrassFreeList {
 	    sequential = sequential_;
 	}
 
-	/** Write the btree base file to disk. */
+	/** Write the btree base file to disk.
+	 *
+	 *  @param fd_ptr	If non-NULL, the file isn't flushed to disk, but
+	 *			is left open and its file descriptor stored in
+	 *			@a *fd_ptr, and the caller is responsible for
+	 *			flushing and closing it.
+	 */
 	void write_to_file(const std::string &filename,
 			   char base_letter,
 			   const char * tablename,
-			   BrassChanges * changes);
+			   BrassChanges * changes,
+			   int * fd_ptr = NULL);
 
 	void swap(BrassTable_base &other);
 
@@ -36,9 +36,12 @@
 #include "brass_table.h"
 #include "brass_compact.h"
 #include "brass_cursor.h"
+#include "autoptr.h"
 #include "filetests.h"
 #include "internaltypes.h"
+#include "mutex.h"
 #include "pack.h"
+#include "threadpool.h"
 #include "backends/valuestats.h"
 
 #include "../byte_length_strings.h"
@@ -50,6 +53,39 @@ using namespace std;
 // the same name in other flint-derived backends.
 namespace BrassCompact {
 
+/** How many blocks to read ahead in the tables being compacted.
+ *
+ *  Each input table is read through once from start to end, so it's worth
+ *  reading further ahead than usual.
+ */
+const unsigned COMPACT_READAHEAD_BLOCKS = 64;
+
+/** Make calls to the Compactor's virtual methods one at a time.
+ *
+ *  Tables may be compacted in several threads at once, but a subclass of
+ *  Xapian::Compactor needn't be thread-safe.
+ */
+class CompactorCalls {
+    Xapian::Compactor & compactor;
+
+    Mutex mutex;
+
+  public:
+    explicit CompactorCalls(Xapian::Compactor & compactor_)
+	: compactor(compactor_) { }
+
+    void set_status(const string & table, const string & status) {
+	MutexLock lock(mutex);
+	compactor.set_status(table, status);
+    }
+
+    string resolve_duplicate_metadata(const string & key,
+				      size_t num_tags, const string tags[]) {
+	MutexLock lock(mutex);
+	return compactor.resolve_duplicate_metadata(key, num_tags, tags);
+    }
+};
+
 static inline bool
 is_metainfo_key(const string & key)
 {
@@ -106,7 +142,9 @@ class PostlistCursor : private BrassCursor {
 	// the first chunk for each term in the merged database as we merge.
 	read_tag();
 	key = current_key;
-	tag = current_tag;
+	// The chunk data is passed through unchanged apart from the header,
+	// so take the tag rather than copying it.
+	tag.swap(current_tag);
 	tf = cf = 0;
 	if (is_metainfo_key(key)) return true;
 	if (is_user_metadata_key(key)) return true;
@@ -194,8 +232,45 @@ encode_valuestats(Xapian::doccount freq,
     return value;
 }
 
+/** The cursors for a merge, which are deleted with this object.
+ *
+ *  @a C is PostlistCursor or PositionCursor, each of which takes ownership
+ *  of the table it's a cursor over.
+ */
+template<class C>
+class CursorList {
+    /// Don't allow copying.
+    CursorList(const CursorList &);
+
+    /// Don't allow assignment.
+    void operator=(const CursorList &);
+
+    vector<C *> cursors;
+
+  public:
+    CursorList() { }
+
+    ~CursorList() {
+	for (size_t i = 0; i != cursors.size(); ++i) delete cursors[i];
+    }
+
+    /** Add a cursor over table @a in.
+     *
+     *  The cursor takes ownership of @a in, which is deleted even if
+     *  creating the cursor fails.
+     */
+    C * add(BrassTable * in, Xapian::docid offset) {
+	AutoPtr<BrassTable> table(in);
+	cursors.reserve(cursors.size() + 1);
+	C * cur = new C(in, offset);
+	table.release();
+	cursors.push_back(cur);
+	return cur;
+    }
+};
+
 static void
-merge_postlists(Xapian::Compactor & compactor,
+merge_postlists(CompactorCalls & compactor,
 		BrassTable * out, vector<Xapian::docid>::const_iterator offset,
 		vector<string>::const_iterator b,
 		vector<string>::const_iterator e,
@@ -205,19 +280,18 @@ merge_postlists(Xapian::Compactor & compactor,
     Xapian::termcount doclen_lbound = static_cast<Xapian::termcount>(-1);
     Xapian::termcount wdf_ubound = 0;
     Xapian::termcount doclen_ubound = 0;
+    CursorList<PostlistCursor> cursors;
     priority_queue<PostlistCursor *, vector<PostlistCursor *>, PostlistCursorGt> pq;
     for ( ; b != e; ++b, ++offset) {
-	BrassTable *in = new BrassTable("postlist", *b, true);
+	AutoPtr<BrassTable> in(new BrassTable("postlist", *b, true));
 	in->open(0);
+	in->set_readahead(COMPACT_READAHEAD_BLOCKS);
 	if (in->empty()) {
 	    // Skip empty tables.
-	    delete in;
 	    continue;
 	}
 
-	// PostlistCursor takes ownership of BrassTable in and is
-	// responsible for deleting it.
-	PostlistCursor * cur = new PostlistCursor(in, *offset);
+	PostlistCursor * cur = cursors.add(in.release(), *offset);
 	// Merge the METAINFO tags from each database into one.
 	// They have a key consisting of a single zero byte.
 	// They may be absent, if the database contains no documents.  If it
@@ -255,13 +329,9 @@ merge_postlists(Xapian::Compactor & compactor,
 	    }
 	    tot_totlen += totlen;
 	    if (tot_totlen < totlen) {
-		throw "totlen wrapped!";
-	    }
-	    if (cur->next()) {
-		pq.push(cur);
-	    } else {
-		delete cur;
+		throw Xapian::DatabaseError("Total document length overflowed during compaction");
 	    }
+	    if (cur->next()) pq.push(cur);
 	} else {
 	    pq.push(cur);
 	}
@@ -306,11 +376,7 @@ merge_postlists(Xapian::Compactor & compactor,
 	    tags.push_back(cur->tag);
 
 	    pq.pop();
-	    if (cur->next()) {
-		pq.push(cur);
-	    } else {
-		delete cur;
-	    }
+	    if (cur->next()) pq.push(cur);
 	}
 	if (tags.size() > 1) {
 	    Assert(!last_key.empty());
@@ -376,11 +442,7 @@ merge_postlists(Xapian::Compactor & compactor,
 	    }
 
 	    pq.pop();
-	    if (cur->next()) {
-		pq.push(cur);
-	    } else {
-		delete cur;
-	    }
+	    if (cur->next()) pq.push(cur);
 	}
 
 	if (freq) {
@@ -396,11 +458,7 @@ merge_postlists(Xapian::Compactor & compactor,
 	Assert(!is_user_metadata_key(key));
 	out->add(key, cur->tag);
 	pq.pop();
-	if (cur->next()) {
-	    pq.push(cur);
-	} else {
-	    delete cur;
-	}
+	if (cur->next()) pq.push(cur);
     }
 
     Xapian::termcount tf = 0, cf = 0; // Initialise to avoid warnings.
@@ -418,7 +476,7 @@ merge_postlists(Xapian::Compactor & compactor,
 		pack_uint(first_tag, tf);
 		pack_uint(first_tag, cf);
 		pack_uint(first_tag, tags[0].first - 1);
-		string tag = tags[0].second;
+		string & tag = tags[0].second;
 		tag[0] = (tags.size() == 1) ? '1' : '0';
 		first_tag += tag;
 		out->add(last_key, first_tag);
@@ -431,12 +489,11 @@ merge_postlists(Xapian::Compactor & compactor,
 			throw Xapian::DatabaseCorruptError("Bad postlist chunk key");
 		}
 
-		vector<pair<Xapian::docid, string> >::const_iterator i;
+		vector<pair<Xapian::docid, string> >::iterator i;
 		i = tags.begin();
 		while (++i != tags.end()) {
-		    tag = i->second;
-		    tag[0] = (i + 1 == tags.end()) ? '1' : '0';
-		    out->add(pack_brass_postlist_key(term, i->first), tag);
+		    i->second[0] = (i + 1 == tags.end()) ? '1' : '0';
+		    out->add(pack_brass_postlist_key(term, i->first), i->second);
 		}
 	    }
 	    tags.clear();
@@ -446,12 +503,9 @@ merge_postlists(Xapian::Compactor & compactor,
 	}
 	tf += cur->tf;
 	cf += cur->cf;
-	tags.push_back(make_pair(cur->firstdid, cur->tag));
-	if (cur->next()) {
-	    pq.push(cur);
-	} else {
-	    delete cur;
-	}
+	tags.push_back(make_pair(cur->firstdid, string()));
+	tags.back().second.swap(cur->tag);
+	if (cur->next()) pq.push(cur);
     }
 }
 
@@ -484,6 +538,7 @@ merge_spellings(BrassTable * out,
     for ( ; b != e; ++b) {
 	BrassTable *in = new BrassTable("spelling", *b, true, DONT_COMPRESS, true);
 	in->open(0);
+	in->set_readahead(COMPACT_READAHEAD_BLOCKS);
 	if (!in->empty()) {
 	    // The MergeCursor takes ownership of BrassTable in and is
 	    // responsible for deleting it.
@@ -598,6 +653,7 @@ merge_synonyms(BrassTable * out,
     for ( ; b != e; ++b) {
 	BrassTable *in = new BrassTable("synonym", *b, true, DONT_COMPRESS, true);
 	in->open(0);
+	in->set_readahead(COMPACT_READAHEAD_BLOCKS);
 	if (!in->empty()) {
 	    // The MergeCursor takes ownership of BrassTable in and is
 	    // responsible for deleting it.
@@ -675,11 +731,59 @@ merge_synonyms(BrassTable * out,
     }
 }
 
+/// One of the merges in a pass of multimerge_postlists().
+class PostlistMergeJob : public ThreadJob {
+    CompactorCalls & compactor;
+
+    string dest;
+
+    vector<Xapian::docid>::const_iterator offset;
+
+    vector<string>::const_iterator b, e;
+
+    Xapian::docid last_docid;
+
+  public:
+    /// Any exception thrown by the merge.
+    ThreadJobError error;
+
+    PostlistMergeJob(CompactorCalls & compactor_, const string & dest_,
+		     vector<Xapian::docid>::const_iterator offset_,
+		     vector<string>::const_iterator b_,
+		     vector<string>::const_iterator e_,
+		     Xapian::docid last_docid_)
+	: compactor(compactor_), dest(dest_), offset(offset_), b(b_), e(e_),
+	  last_docid(last_docid_) { }
+
+    void merge() {
+	// Don't compress temporary tables, even if the final table would
+	// be.
+	BrassTable tmptab("postlist", dest, false);
+	// Use maximum blocksize for temporary tables.
+	tmptab.create_and_open(Xapian::DB_DANGEROUS|Xapian::DB_NO_SYNC,
+			       65536);
+	tmptab.set_sorted_append();
+
+	merge_postlists(compactor, &tmptab, offset, b, e, last_docid);
+	tmptab.flush_db();
+	tmptab.commit(1);
+    }
+
+    void run() {
+	try {
+	    merge();
+	} catch (...) {
+	    error.record();
+	}
+    }
+};
+
 static void
-multimerge_postlists(Xapian::Compactor & compactor,
+multimerge_postlists(CompactorCalls & compactor,
 		     BrassTable * out, const char * tmpdir,
 		     Xapian::docid last_docid,
-		     vector<string> tmp, vector<Xapian::docid> off)
+		     vector<string> tmp, vector<Xapian::docid> off,
+		     ThreadBudget & budget)
 {
     unsigned int c = 0;
     while (tmp.size() > 3) {
@@ -687,34 +791,41 @@ multimerge_postlists(Xapian::Compactor & compactor,
 	tmpout.reserve(tmp.size() / 2);
 	vector<Xapian::docid> newoff;
 	newoff.resize(tmp.size() / 2);
-	for (unsigned int i = 0, j; i < tmp.size(); i = j) {
-	    j = i + 2;
-	    if (j == tmp.size() - 1) ++j;
-
-	    string dest = tmpdir;
-	    char buf[64];
-	    sprintf(buf, "/tmp%u_%u.", c, i / 2);
-	    dest += buf;
-
-	    // Don't compress temporary tables, even if the final table would
-	    // be.
-	    BrassTable tmptab("postlist", dest, false);
-	    // Use maximum blocksize for temporary tables.
-	    tmptab.create_and_open(Xapian::DB_DANGEROUS|Xapian::DB_NO_SYNC,
-				   65536);
-
-	    merge_postlists(compactor, &tmptab, off.begin() + i,
-			    tmp.begin() + i, tmp.begin() + j, last_docid);
-	    if (c > 0) {
-		for (unsigned int k = i; k < j; ++k) {
-		    unlink((tmp[k] + "DB").c_str());
-		    unlink((tmp[k] + "baseA").c_str());
-		    unlink((tmp[k] + "baseB").c_str());
-		}
+	// The merges in each pass are independent, so run them in parallel.
+	vector<ThreadJob *> jobs;
+	jobs.reserve(tmp.size() / 2);
+	try {
+	    for (unsigned int i = 0, j; i < tmp.size(); i = j) {
+		j = i + 2;
+		if (j == tmp.size() - 1) ++j;
+
+		string dest = tmpdir;
+		char buf[64];
+		sprintf(buf, "/tmp%u_%u.", c, i / 2);
+		dest += buf;
+
+		jobs.push_back(new PostlistMergeJob(compactor, dest,
+						    off.begin() + i,
+						    tmp.begin() + i,
+						    tmp.begin() + j,
+						    last_docid));
+		tmpout.push_back(dest);
+	    }
+	    run_jobs(jobs, budget);
+	    for (size_t k = 0; k != jobs.size(); ++k) {
+		static_cast<PostlistMergeJob *>(jobs[k])->error.rethrow();
+	    }
+	} catch (...) {
+	    for (size_t k = 0; k != jobs.size(); ++k) delete jobs[k];
+	    throw;
+	}
+	for (size_t k = 0; k != jobs.size(); ++k) delete jobs[k];
+	if (c > 0) {
+	    for (size_t k = 0; k < tmp.size(); ++k) {
+		unlink((tmp[k] + "DB").c_str());
+		unlink((tmp[k] + "baseA").c_str());
+		unlink((tmp[k] + "baseB").c_str());
 	    }
-	    tmpout.push_back(dest);
-	    tmptab.flush_db();
-	    tmptab.commit(1);
 	}
 	swap(tmp, tmpout);
 	swap(off, newoff);
@@ -741,6 +852,7 @@ merge_docid_keyed(const char * tablename,
 
 	BrassTable in(tablename, inputs[i], true, DONT_COMPRESS, lazy);
 	in.open(0);
+	in.set_readahead(COMPACT_READAHEAD_BLOCKS);
 	if (in.empty()) continue;
 
 	BrassCursor cur(&in);
@@ -762,7 +874,8 @@ merge_docid_keyed(const char * tablename,
 		key.resize(0);
 		pack_uint_preserving_sort(key, did);
 		if (d != e) {
-		    // Copy over the termname for the position table.
+		    // Copy over the suffix of the value slots key in the
+		    // termlist table.
 		    key.append(d, e - d);
 		}
 	    } else {
@@ -774,178 +887,354 @@ merge_docid_keyed(const char * tablename,
     }
 }
 
-}
+class PositionCursor : private BrassCursor {
+    Xapian::docid offset;
 
-using namespace BrassCompact;
+  public:
+    string key, tag;
+    bool compressed;
 
-void
-compact_brass(Xapian::Compactor & compactor,
-	      const char * destdir, const vector<string> & sources,
-	      const vector<Xapian::docid> & offset, size_t block_size,
-	      Xapian::Compactor::compaction_level compaction, bool multipass,
-	      Xapian::docid last_docid) {
-    enum table_type {
-	POSTLIST, RECORD, TERMLIST, POSITION, VALUE, SPELLING, SYNONYM
-    };
-    struct table_list {
-	// The "base name" of the table.
-	const char * name;
-	// The type.
-	table_type type;
-	// zlib compression strategy to use on tags.
-	int compress_strategy;
-	// Create tables after position lazily.
-	bool lazy;
-    };
-
-    static const table_list tables[] = {
-	// name		type		compress_strategy	lazy
-	{ "postlist",	POSTLIST,	DONT_COMPRESS,		false },
-	{ "record",	RECORD,		Z_DEFAULT_STRATEGY,	false },
-	{ "termlist",	TERMLIST,	Z_DEFAULT_STRATEGY,	false },
-	{ "position",	POSITION,	DONT_COMPRESS,		true },
-	{ "spelling",	SPELLING,	Z_DEFAULT_STRATEGY,	true },
-	{ "synonym",	SYNONYM,	Z_DEFAULT_STRATEGY,	true }
-    };
-    const table_list * tables_end = tables +
-	(sizeof(tables) / sizeof(tables[0]));
+    PositionCursor(BrassTable *in, Xapian::docid offset_)
+	: BrassCursor(in), offset(offset_), compressed(false)
+    {
+	find_entry(string());
+	next();
+    }
 
-    for (const table_list * t = tables; t < tables_end; ++t) {
-	// The postlist table requires an N-way merge, adjusting the
-	// headers of various blocks.  The spelling and synonym tables also
-	// need special handling.  The other tables have keys sorted in
-	// docid order, so we can merge them by simply copying all the keys
-	// from each source table in turn.
-	compactor.set_status(t->name, string());
-
-	string dest = destdir;
-	dest += '/';
-	dest += t->name;
-	dest += '.';
-
-	bool output_will_exist = !t->lazy;
-
-	// Sometimes stat can fail for benign reasons (e.g. >= 2GB file
-	// on certain systems).
-	bool bad_stat = false;
-
-	off_t in_size = 0;
-
-	vector<string> inputs;
-	inputs.reserve(sources.size());
-	size_t inputs_present = 0;
-	for (vector<string>::const_iterator src = sources.begin();
-	     src != sources.end(); ++src) {
-	    string s(*src);
-	    s += t->name;
-	    s += '.';
-
-	    off_t db_size = file_size(s + "DB");
-	    if (errno == 0) {
-		in_size += db_size / 1024;
-		output_will_exist = true;
-		++inputs_present;
-	    } else if (errno != ENOENT) {
-		// We get ENOENT for an optional table.
-		bad_stat = true;
-		output_will_exist = true;
-		++inputs_present;
-	    }
-	    inputs.push_back(s);
-	}
-
-	// If any inputs lack a termlist table, suppress it in the output.
-	if (t->type == TERMLIST && inputs_present != sources.size()) {
-	    if (inputs_present != 0) {
-		string m = str(inputs_present);
-		m += " of ";
-		m += str(sources.size());
-		m += " inputs present, so suppressing output";
-		compactor.set_status(t->name, m);
-		continue;
-	    }
-	    output_will_exist = false;
+    ~PositionCursor()
+    {
+	delete BrassCursor::get_table();
+    }
+
+    bool next() {
+	if (!BrassCursor::next()) return false;
+	compressed = read_tag(true);
+	tag.swap(current_tag);
+	if (!offset) {
+	    key = current_key;
+	    return true;
 	}
+	// The key is the term name followed by the docid, which needs
+	// adjusting.
+	const char * d = current_key.data();
+	const char * e = d + current_key.size();
+	string tname;
+	Xapian::docid did;
+	if (!unpack_string_preserving_sort(&d, e, tname) ||
+	    !unpack_uint_preserving_sort(&d, e, &did) || d != e)
+	    throw Xapian::DatabaseCorruptError("Bad position key");
+	key.resize(0);
+	pack_string_preserving_sort(key, tname);
+	pack_uint_preserving_sort(key, did + offset);
+	return true;
+    }
+};
 
-	if (!output_will_exist) {
-	    compactor.set_status(t->name, "doesn't exist");
+class PositionCursorGt {
+  public:
+    /** Return true if and only if a's key is strictly greater than b's key.
+     */
+    bool operator()(const PositionCursor *a, const PositionCursor *b) {
+	return a->key > b->key;
+    }
+};
+
+static void
+merge_positions(BrassTable *out, const vector<string> & inputs,
+		const vector<Xapian::docid> & offset)
+{
+    // The keys are ordered by term name first, so unlike the other docid
+    // keyed tables we need to merge the sources rather than copy each in
+    // turn.
+    CursorList<PositionCursor> cursors;
+    priority_queue<PositionCursor *, vector<PositionCursor *>, PositionCursorGt> pq;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+	AutoPtr<BrassTable> in(new BrassTable("position", inputs[i], true,
+					      DONT_COMPRESS, true));
+	in->open(0);
+	in->set_readahead(COMPACT_READAHEAD_BLOCKS);
+	if (in->empty()) {
+	    // Skip empty tables.
 	    continue;
 	}
+	pq.push(cursors.add(in.release(), offset[i]));
+    }
 
-	BrassTable out(t->name, dest, false, t->compress_strategy, t->lazy);
-	if (!t->lazy) {
-	    out.create_and_open(Xapian::DB_DANGEROUS, block_size);
-	} else {
-	    out.erase();
-	    out.set_block_size(Xapian::DB_DANGEROUS, block_size);
+    while (!pq.empty()) {
+	PositionCursor * cur = pq.top();
+	pq.pop();
+	out->add(cur->key, cur->tag, cur->compressed);
+	if (cur->next()) pq.push(cur);
+    }
+}
+
+enum table_type {
+    POSTLIST, RECORD, TERMLIST, POSITION, VALUE, SPELLING, SYNONYM
+};
+
+struct table_list {
+    // The "base name" of the table.
+    const char * name;
+    // The type.
+    table_type type;
+    // zlib compression strategy to use on tags.
+    int compress_strategy;
+    // Create tables after position lazily.
+    bool lazy;
+};
+
+static const table_list tables[] = {
+    // name		type		compress_strategy	lazy
+    { "postlist",	POSTLIST,	DONT_COMPRESS,		false },
+    { "record",	RECORD,		Z_DEFAULT_STRATEGY,	false },
+    { "termlist",	TERMLIST,	Z_DEFAULT_STRATEGY,	false },
+    { "position",	POSITION,	DONT_COMPRESS,		true },
+    { "spelling",	SPELLING,	Z_DEFAULT_STRATEGY,	true },
+    { "synonym",	SYNONYM,	Z_DEFAULT_STRATEGY,	true }
+};
+
+/// The parameters shared by the compaction of each table.
+struct CompactParams {
+    const char * destdir;
+    const vector<string> * sources;
+    const vector<Xapian::docid> * offset;
+    size_t block_size;
+    Xapian::Compactor::compaction_level compaction;
+    bool multipass;
+    Xapian::docid last_docid;
+    /// The threads which the compaction of each table may use.
+    ThreadBudget * budget;
+};
+
+static void
+compact_table(CompactorCalls & compactor, const table_list * t,
+	      const CompactParams & params)
+{
+    const char * destdir = params.destdir;
+    const vector<string> & sources = *params.sources;
+    const vector<Xapian::docid> & offset = *params.offset;
+    size_t block_size = params.block_size;
+    Xapian::Compactor::compaction_level compaction = params.compaction;
+    bool multipass = params.multipass;
+    Xapian::docid last_docid = params.last_docid;
+
+    // The postlist table requires an N-way merge, adjusting the
+    // headers of various blocks.  The spelling and synonym tables also
+    // need special handling.  The other tables have keys sorted in
+    // docid order, so we can merge them by simply copying all the keys
+    // from each source table in turn.
+    compactor.set_status(t->name, string());
+
+    string dest = destdir;
+    dest += '/';
+    dest += t->name;
+    dest += '.';
+
+    bool output_will_exist = !t->lazy;
+
+    // Sometimes stat can fail for benign reasons (e.g. >= 2GB file
+    // on certain systems).
+    bool bad_stat = false;
+
+    off_t in_size = 0;
+
+    vector<string> inputs;
+    inputs.reserve(sources.size());
+    size_t inputs_present = 0;
+    for (vector<string>::const_iterator src = sources.begin();
+	 src != sources.end(); ++src) {
+	string s(*src);
+	s += t->name;
+	s += '.';
+
+	off_t db_size = file_size(s + "DB");
+	if (errno == 0) {
+	    in_size += db_size / 1024;
+	    output_will_exist = true;
+	    ++inputs_present;
+	} else if (errno != ENOENT) {
+	    // We get ENOENT for an optional table.
+	    bad_stat = true;
+	    output_will_exist = true;
+	    ++inputs_present;
 	}
+	inputs.push_back(s);
+    }
 
-	out.set_full_compaction(compaction != compactor.STANDARD);
-	if (compaction == compactor.FULLER) out.set_max_item_size(1);
+    // If any inputs lack a termlist table, suppress it in the output.
+    if (t->type == TERMLIST && inputs_present != sources.size()) {
+	if (inputs_present != 0) {
+	    string m = str(inputs_present);
+	    m += " of ";
+	    m += str(sources.size());
+	    m += " inputs present, so suppressing output";
+	    compactor.set_status(t->name, m);
+	    return;
+	}
+	output_will_exist = false;
+    }
 
-	switch (t->type) {
-	    case POSTLIST:
-		if (multipass && inputs.size() > 3) {
-		    multimerge_postlists(compactor, &out, destdir, last_docid,
-					 inputs, offset);
-		} else {
-		    merge_postlists(compactor, &out, offset.begin(),
-				    inputs.begin(), inputs.end(),
-				    last_docid);
-		}
-		break;
-	    case SPELLING:
-		merge_spellings(&out, inputs.begin(), inputs.end());
-		break;
-	    case SYNONYM:
-		merge_synonyms(&out, inputs.begin(), inputs.end());
-		break;
-	    default:
-		// Position, Record, Termlist
-		merge_docid_keyed(t->name, &out, inputs, offset, t->lazy);
-		break;
-	}
-
-	// Commit as revision 1.
-	out.flush_db();
-	out.commit(1);
-
-	off_t out_size = 0;
-	if (!bad_stat) {
-	    off_t db_size = file_size(dest + "DB");
-	    if (errno == 0) {
-		out_size = db_size / 1024;
+    if (!output_will_exist) {
+	compactor.set_status(t->name, "doesn't exist");
+	return;
+    }
+
+    BrassTable out(t->name, dest, false, t->compress_strategy, t->lazy);
+    if (!t->lazy) {
+	out.create_and_open(Xapian::DB_DANGEROUS, block_size);
+    } else {
+	out.erase();
+	out.set_block_size(Xapian::DB_DANGEROUS, block_size);
+    }
+
+    out.set_full_compaction(compaction != Xapian::Compactor::STANDARD);
+    // Every table is written in ascending key order.
+    out.set_sorted_append();
+    if (compaction == Xapian::Compactor::FULLER) out.set_max_item_size(1);
+
+    switch (t->type) {
+	case POSTLIST:
+	    if (multipass && inputs.size() > 3) {
+		multimerge_postlists(compactor, &out, destdir, last_docid,
+				     inputs, offset, *params.budget);
 	    } else {
-		bad_stat = (errno != ENOENT);
+		merge_postlists(compactor, &out, offset.begin(),
+				inputs.begin(), inputs.end(),
+				last_docid);
 	    }
+	    break;
+	case SPELLING:
+	    merge_spellings(&out, inputs.begin(), inputs.end());
+	    break;
+	case SYNONYM:
+	    merge_synonyms(&out, inputs.begin(), inputs.end());
+	    break;
+	case POSITION:
+	    merge_positions(&out, inputs, offset);
+	    break;
+	default:
+	    // Record, Termlist
+	    merge_docid_keyed(t->name, &out, inputs, offset, t->lazy);
+	    break;
+    }
+
+    // Commit as revision 1.
+    out.flush_db();
+    out.commit(1);
+
+    off_t out_size = 0;
+    if (!bad_stat) {
+	off_t db_size = file_size(dest + "DB");
+	if (errno == 0) {
+	    out_size = db_size / 1024;
+	} else {
+	    bad_stat = (errno != ENOENT);
 	}
-	if (bad_stat) {
-	    compactor.set_status(t->name, "Done (couldn't stat all the DB files)");
+    }
+    if (bad_stat) {
+	compactor.set_status(t->name, "Done (couldn't stat all the DB files)");
+    } else {
+	string status;
+	if (out_size == in_size) {
+	    status = "Size unchanged (";
 	} else {
-	    string status;
-	    if (out_size == in_size) {
-		status = "Size unchanged (";
+	    off_t delta;
+	    if (out_size < in_size) {
+		delta = in_size - out_size;
+		status = "Reduced by ";
 	    } else {
-		off_t delta;
-		if (out_size < in_size) {
-		    delta = in_size - out_size;
-		    status = "Reduced by ";
-		} else {
-		    delta = out_size - in_size;
-		    status = "INCREASED by ";
-		}
-		if (in_size) {
-		    status += str(100 * delta / in_size);
-		    status += "% ";
-		}
-		status += str(delta);
-		status += "K (";
-		status += str(in_size);
-		status += "K -> ";
+		delta = out_size - in_size;
+		status = "INCREASED by ";
+	    }
+	    if (in_size) {
+		status += str(100 * delta / in_size);
+		status += "% ";
 	    }
-	    status += str(out_size);
-	    status += "K)";
-	    compactor.set_status(t->name, status);
+	    status += str(delta);
+	    status += "K (";
+	    status += str(in_size);
+	    status += "K -> ";
+	}
+	status += str(out_size);
+	status += "K)";
+	compactor.set_status(t->name, status);
+    }
+}
+
+/// Compact one table in a worker thread.
+class TableJob : public ThreadJob {
+    CompactorCalls & compactor;
+
+    const table_list * t;
+
+    const CompactParams & params;
+
+  public:
+    /// Any exception thrown compacting the table.
+    ThreadJobError error;
+
+    TableJob(CompactorCalls & compactor_, const table_list * t_,
+	     const CompactParams & params_)
+	: compactor(compactor_), t(t_), params(params_) { }
+
+    void run() {
+	try {
+	    compact_table(compactor, t, params);
+	} catch (...) {
+	    error.record();
+	}
+    }
+};
+
+}
+
+using namespace BrassCompact;
+
+void
+compact_brass(Xapian::Compactor & compactor,
+	      const char * destdir, const vector<string> & sources,
+	      const vector<Xapian::docid> & offset, size_t block_size,
+	      Xapian::Compactor::compaction_level compaction, bool multipass,
+	      Xapian::docid last_docid, unsigned n_threads) {
+    const table_list * tables_end = tables +
+	(sizeof(tables) / sizeof(tables[0]));
+
+    CompactorCalls calls(compactor);
+    // The threads are shared between compacting the tables and the passes
+    // of merging the postlist table.
+    ThreadBudget budget(n_threads);
+    CompactParams params;
+    params.destdir = destdir;
+    params.sources = &sources;
+    params.offset = &offset;
+    params.block_size = block_size;
+    params.compaction = compaction;
+    params.multipass = multipass;
+    params.last_docid = last_docid;
+    params.budget = &budget;
+
+    if (n_threads <= 1) {
+	for (const table_list * t = tables; t < tables_end; ++t) {
+	    compact_table(calls, t, params);
+	}
+	return;
+    }
+
+    // Each table is written to its own files, so they can be compacted in
+    // parallel.  The postlist table is usually much the largest and comes
+    // first, so it gets started straight away.
+    vector<ThreadJob *> jobs;
+    try {
+	for (const table_list * t = tables; t < tables_end; ++t) {
+	    jobs.push_back(new TableJob(calls, t, params));
+	}
+	run_jobs(jobs, budget);
+	for (size_t i = 0; i != jobs.size(); ++i) {
+	    static_cast<TableJob *>(jobs[i])->error.rethrow();
 	}
+    } catch (...) {
+	for (size_t i = 0; i != jobs.size(); ++i) delete jobs[i];
+	throw;
     }
+    for (size_t i = 0; i != jobs.size(); ++i) delete jobs[i];
 }
@@ -58,7 +58,8 @@ BrassCursor::BrassCursor(const BrassTable *B_, const Brass::Cursor * C_)
 	  tag_status(UNREAD),
 	  B(B_),
 	  version(B_->cursor_version),
-	  level(B_->level)
+	  level(B_->level),
+	  query_stats(NULL)
 {
     B->cursor_created_since_last_modification = true;
     C = new Brass::Cursor[level + 1];
@@ -86,6 +87,9 @@ BrassCursor::rebuild()
 	for (int j = level; j < new_level; j++) {
 	    C[j].init(B->block_size);
 	}
+	for (int j = 0; j <= new_level; j++) {
+	    C[j].query_stats = query_stats;
+	}
     }
     level = new_level;
     C[level].clone(B->C[level]);
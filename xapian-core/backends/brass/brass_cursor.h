@@ -27,6 +27,8 @@
 
 #include "omassert.h"
 
+#include "api/querystatsinternal.h"
+
 #include <algorithm>
 #include <cstring>
 #include <string>
@@ -36,6 +38,42 @@ using std::string;
 
 namespace Brass {
 
+/** A reference counted read-only memory mapping of a table's DB file.
+ *
+ *  The table holds a reference while the mapping is current, and each
+ *  cursor pointing into it holds one, so the file is unmapped once nothing
+ *  uses it, even if the table has since been reopened.
+ */
+class Mapping {
+	/// Don't allow copying.
+	Mapping(const Mapping &);
+
+	/// Don't allow assignment.
+	void operator=(const Mapping &);
+
+	/// The number of references to this object.
+	unsigned refs;
+
+	/// Unmap the file.  Only called by release().
+	~Mapping();
+
+    public:
+	/// The start of the mapping.
+	const byte * p;
+
+	/// The size of the mapping in bytes.
+	size_t size;
+
+	/// Construct with a single reference.
+	Mapping(const byte * p_, size_t size_) : refs(1), p(p_), size(size_) { }
+
+	void acquire() { ++refs; }
+
+	void release() {
+	    if (--refs == 0) delete this;
+	}
+};
+
 class Cursor {
     private:
         // Prevent copying
@@ -45,9 +83,32 @@ class Cursor {
 	/// Pointer to reference counted data.
 	char * data;
 
+	/** Pointer to the block in a read-only memory mapping.
+	 *
+	 *  If non-NULL, this is used instead of the block in data (see
+	 *  set_mapped()).
+	 */
+	const byte * mapped;
+
+	/// The mapping which mapped points into (we hold a reference to it).
+	Mapping * mapping;
+
+	/// The block number of mapped.
+	uint4 mapped_n;
+
+	/// Change the mapping we hold a reference to.
+	void set_mapping(Mapping * mapping_) {
+	    if (mapping_ == mapping) return;
+	    if (mapping_) mapping_->acquire();
+	    if (mapping) mapping->release();
+	    mapping = mapping_;
+	}
+
     public:
 	/// Constructor.
-	Cursor() : data(0), c(-1), rewrite(false) { }
+	Cursor()
+	    : data(0), mapped(0), mapping(0), mapped_n(0), c(-1),
+	      rewrite(false), query_stats(0) { }
 
 	~Cursor() { destroy(); }
 
@@ -59,23 +120,50 @@ class Cursor {
 	    if (!data)
 		data = new char[block_size + 8];
 	    refs() = 1;
+	    set_mapping(NULL);
+	    mapped = NULL;
 	    set_n(BLK_UNUSED);
 	    rewrite = false;
 	    c = -1;
 	    return reinterpret_cast<byte*>(data + 8);
 	}
 
+	/** Point at block @a n at address @a p in read-only mapping @a m.
+	 *
+	 *  The block isn't copied, and the cursor holds a reference to @a m
+	 *  until it's pointed elsewhere.  Any buffer the cursor already has is
+	 *  kept for reuse, but one isn't allocated.
+	 */
+	void set_mapped(const byte * p, uint4 n, Mapping * m) {
+	    set_mapping(m);
+	    mapped = p;
+	    mapped_n = n;
+	    rewrite = false;
+	    c = -1;
+	}
+
 	const byte * clone(const Cursor & o) {
+	    if (o.mapped) {
+		set_mapping(o.mapping);
+		mapped = o.mapped;
+		mapped_n = o.mapped_n;
+		return mapped;
+	    }
 	    if (data != o.data) {
 		destroy();
 		data = o.data;
 		++refs();
 	    }
-	    return reinterpret_cast<byte*>(data + 8);
+	    set_mapping(NULL);
+	    mapped = NULL;
+	    return get_p();
 	}
 
 	void swap(Cursor & o) {
 	    std::swap(data, o.data);
+	    std::swap(mapped, o.mapped);
+	    std::swap(mapping, o.mapping);
+	    std::swap(mapped_n, o.mapped_n);
 	    std::swap(c, o.c);
 	    std::swap(rewrite, o.rewrite);
 	}
@@ -87,6 +175,8 @@ class Cursor {
 		data = NULL;
 		rewrite = false;
 	    }
+	    set_mapping(NULL);
+	    mapped = NULL;
 	}
 
 	uint4 & refs() const {
@@ -99,11 +189,16 @@ class Cursor {
 	 *  Returns BLK_UNUSED if no block is currently loaded.
 	 */
 	uint4 get_n() const {
+	    if (mapped) return mapped_n;
 	    Assert(data);
 	    return *reinterpret_cast<uint4*>(data + 4);
 	}
 
 	void set_n(uint4 n) {
+	    if (mapped) {
+		mapped_n = n;
+		return;
+	    }
 	    Assert(data);
 	    //Assert(refs() == 1);
 	    *reinterpret_cast<uint4*>(data + 4) = n;
@@ -114,12 +209,14 @@ class Cursor {
 	 * Returns NULL if no block is currently loaded.
 	 */
 	const byte * get_p() const {
+	    if (mapped) return mapped;
 	    if (rare(!data)) return NULL;
 	    return reinterpret_cast<byte*>(data + 8);
 	}
 
 	byte * get_modifiable_p(unsigned block_size) {
 	    if (rare(!data)) return NULL;
+	    Assert(!mapped);
 	    if (refs() > 1) {
 		char * new_data = new char[block_size + 8];
 		std::memcpy(new_data, data, block_size + 8);
@@ -135,6 +232,13 @@ class Cursor {
 
 	/// true if the block is not the same as on disk, and so needs rewriting
 	bool rewrite;
+
+	/** Where to count blocks read into this cursor, or NULL.
+	 *
+	 *  This belongs to the BrassCursor which owns this level, so init(),
+	 *  clone() and swap() leave it alone.
+	 */
+	Xapian::QueryStats::Internal * query_stats;
 };
 
 }
@@ -187,6 +291,9 @@ class BrassCursor {
 	/** The value of level in the Btree structure. */
 	int level;
 
+	/// Where to count the blocks this cursor reads, or NULL.
+	Xapian::QueryStats::Internal * query_stats;
+
 	/** Get the key.
 	 *
 	 *  The key of the item at the cursor is copied into key.
@@ -228,7 +335,9 @@ class BrassCursor {
 	 *  The new cursor is initially *unpositioned*.
 	 */
 	BrassCursor * clone() const {
-	    return new BrassCursor(B, C);
+	    BrassCursor * res = new BrassCursor(B, C);
+	    res->set_query_stats(query_stats);
+	    return res;
 	}
 
 	/** Destroy the BrassCursor */
@@ -339,6 +448,20 @@ class BrassCursor {
 
 	/// Return a pointer to the BrassTable we're a cursor for.
 	const BrassTable * get_table() const { return B; }
+
+	/** Count the blocks this cursor reads in @a stats.
+	 *
+	 *  @param stats	The statistics to update, or NULL to stop.
+	 */
+	void set_query_stats(Xapian::QueryStats::Internal * stats) {
+	    query_stats = stats;
+	    for (int j = 0; j <= level; ++j) C[j].query_stats = stats;
+	}
+
+	/// The object block reads are being counted in, or NULL.
+	Xapian::QueryStats::Internal * get_query_stats() const {
+	    return query_stats;
+	}
 };
 
 class MutableBrassCursor : public BrassCursor {
@@ -36,6 +36,7 @@
 #include "backends/contiguousalldocspostlist.h"
 #include "brass_alldocspostlist.h"
 #include "brass_alltermslist.h"
+#include "brass_blockcache.h"
 #include "brass_replicate_internal.h"
 #include "brass_document.h"
 #include "../flint_lock.h"
@@ -58,6 +59,7 @@
 #include "posixy_wrapper.h"
 #include "str.h"
 #include "stringutils.h"
+#include "threadpool.h"
 #include "backends/valuestats.h"
 
 #include "safeerrno.h"
@@ -95,6 +97,13 @@ using Xapian::Internal::intrusive_ptr;
  */
 const int MAX_OPEN_RETRIES = 100;
 
+/** Default limit on the memory used by buffered changes before we flush.
+ *
+ *  This is only an estimate of the memory used, so is set well below the
+ *  memory a typical indexing process can afford.
+ */
+const size_t DEFAULT_FLUSH_MEMORY = 256 * 1024 * 1024;
+
 /* This finds the tables, opens them at consistent revisions, manages
  * determining the current and next revision numbers, and stores handles
  * to the tables.
@@ -102,7 +111,8 @@ const int MAX_OPEN_RETRIES = 100;
 BrassDatabase::BrassDatabase(const string &brass_dir, int flags,
 			     unsigned int block_size)
 	: db_dir(brass_dir),
-	  readonly(flags == Xapian::DB_READONLY_),
+	  readonly(flags == Xapian::DB_READONLY_ ||
+		   flags == Xapian::DB_READONLY_MMAP_),
 	  version_file(db_dir),
 	  postlist_table(db_dir, readonly),
 	  position_table(db_dir, readonly),
@@ -112,12 +122,16 @@ BrassDatabase::BrassDatabase(const string &brass_dir, int flags,
 	  spelling_table(db_dir, readonly),
 	  record_table(db_dir, readonly),
 	  lock(db_dir),
-	  changes(db_dir)
+	  changes(db_dir),
+	  pins(db_dir)
 {
     LOGCALL_CTOR(DB, "BrassDatabase", brass_dir | flags | block_size);
 
     if (readonly) {
-	open_tables_consistent(0);
+	// The flags are remembered by the tables, so will also be used if
+	// the database is reopened.
+	open_tables_consistent(flags == Xapian::DB_READONLY_MMAP_ ?
+			       Xapian::DB_MMAP : 0);
 	return;
     }
 
@@ -156,6 +170,10 @@ BrassDatabase::BrassDatabase(const string &brass_dir, int flags,
 	return;
     }
 
+    // Find out which blocks we can reuse before the tables read their
+    // freelists.
+    update_oldest_pinned_revision();
+
     // Get latest consistent version
     open_tables_consistent(0);
 
@@ -223,8 +241,21 @@ BrassDatabase::open_tables_consistent(int flags)
 
     brass_revision_number_t cur_rev = record_table.get_open_revision_number();
 
-    // Check the version file unless we're reopening.
-    if (cur_rev == 0) version_file.read_and_check();
+    // Check the version file unless we're reopening.  If blocks are being
+    // cached, we always reread it as the cache relies on the UUID to tell
+    // apart different databases which have been at the same path.
+    bool use_block_cache = readonly &&
+	BrassBlockCache::get_instance().enabled();
+    if (cur_rev == 0 || use_block_cache) version_file.read_and_check();
+    if (use_block_cache) {
+	string uuid(version_file.get_uuid(), 16);
+	postlist_table.set_uuid(uuid);
+	position_table.set_uuid(uuid);
+	termlist_table.set_uuid(uuid);
+	synonym_table.set_uuid(uuid);
+	spelling_table.set_uuid(uuid);
+	record_table.set_uuid(uuid);
+    }
 
     record_table.open(flags);
     brass_revision_number_t revision = record_table.get_open_revision_number();
@@ -386,6 +417,25 @@ BrassDatabase::get_changeset_revisions(const string & path,
 				    "changeset at " + path);
 }
 
+/// Flush one table's commit to disk in a worker thread.
+class TableSyncJob : public ThreadJob {
+    BrassTable & table;
+
+  public:
+    /// Any exception thrown flushing the table.
+    ThreadJobError error;
+
+    explicit TableSyncJob(BrassTable & table_) : table(table_) { }
+
+    void run() {
+	try {
+	    table.sync_commit();
+	} catch (...) {
+	    error.record();
+	}
+    }
+};
+
 void
 BrassDatabase::set_revision_number(int flags, brass_revision_number_t new_revision)
 {
@@ -400,13 +450,80 @@ BrassDatabase::set_revision_number(int flags, brass_revision_number_t new_revisi
     spelling_table.flush_db();
     record_table.flush_db();
 
-    postlist_table.commit(new_revision);
-    position_table.commit(new_revision);
-    termlist_table.commit(new_revision);
-    synonym_table.commit(new_revision);
-    spelling_table.commit(new_revision);
-    record_table.commit(new_revision);
+    // The record table must be last, as its revision is used to determine
+    // the revision of the database as a whole.
+    BrassTable * tables[] = {
+	&postlist_table,
+	&position_table,
+	&termlist_table,
+	&synonym_table,
+	&spelling_table,
+	&record_table
+    };
+    const size_t n_tables = sizeof(tables) / sizeof(tables[0]);
+
+    for (size_t i = 0; i != n_tables; ++i) {
+	tables[i]->start_commit(new_revision);
+    }
+
+    // Waiting for each fsync() in turn is slow, so wait for them all at once.
+    if ((flags & Xapian::DB_NO_SYNC) == 0) {
+	vector<ThreadJob *> jobs;
+	jobs.reserve(n_tables);
+	try {
+	    for (size_t i = 0; i != n_tables; ++i) {
+		if (tables[i]->is_open())
+		    jobs.push_back(new TableSyncJob(*tables[i]));
+	    }
+	    run_jobs(jobs, jobs.size());
+	    for (size_t i = 0; i != jobs.size(); ++i) {
+		static_cast<TableSyncJob *>(jobs[i])->error.rethrow();
+	    }
+	} catch (...) {
+	    for (size_t i = 0; i != jobs.size(); ++i) delete jobs[i];
+	    throw;
+	}
+	for (size_t i = 0; i != jobs.size(); ++i) delete jobs[i];
+    }
+
+    // Any failure to sync is reported here.
+    for (size_t i = 0; i != n_tables; ++i) {
+	tables[i]->finish_commit();
+    }
     changes.commit(new_revision, flags);
+
+    // Now the new revision is visible to readers, we can check which
+    // revisions are pinned to see if the blocks freed can be reused.
+    update_oldest_pinned_revision();
+}
+
+void
+BrassDatabase::update_oldest_pinned_revision()
+{
+    LOGCALL_VOID(DB, "BrassDatabase::update_oldest_pinned_revision", NO_ARGS);
+    brass_revision_number_t oldest;
+    if (!pins.get_oldest(oldest))
+	oldest = brass_revision_number_t(-1);
+    postlist_table.set_oldest_pinned_revision(oldest);
+    position_table.set_oldest_pinned_revision(oldest);
+    termlist_table.set_oldest_pinned_revision(oldest);
+    synonym_table.set_oldest_pinned_revision(oldest);
+    spelling_table.set_oldest_pinned_revision(oldest);
+    record_table.set_oldest_pinned_revision(oldest);
+}
+
+void
+BrassDatabase::pin_revision()
+{
+    LOGCALL_VOID(DB, "BrassDatabase::pin_revision", NO_ARGS);
+    Assert(readonly);
+    // Until we know which revision we'll end up with, pin revision 0 to stop
+    // the writer reusing any blocks.  The writer only reuses blocks freed by
+    // a commit after it has checked the pins, so the latest revision once
+    // our pin exists is safe, but the one we already have open may not be.
+    pins.pin(0);
+    (void)open_tables_consistent(postlist_table.get_flags());
+    pins.pin(get_revision_number());
 }
 
 bool
@@ -414,7 +531,11 @@ BrassDatabase::reopen()
 {
     LOGCALL(DB, bool, "BrassDatabase::reopen", NO_ARGS);
     if (!readonly) return false;
-    return open_tables_consistent(postlist_table.get_flags());
+    // If we have a revision pinned, we keep it pinned until the new revision
+    // is open, which protects the new revision too.
+    if (!open_tables_consistent(postlist_table.get_flags())) RETURN(false);
+    if (pins.pinned()) pins.pin(get_revision_number());
+    RETURN(true);
 }
 
 void
@@ -428,6 +549,7 @@ BrassDatabase::close()
     spelling_table.close(true);
     record_table.close(true);
     lock.release();
+    pins.unpin();
 }
 
 void
@@ -809,9 +931,10 @@ BrassDatabase::has_positions() const
 }
 
 LeafPostList *
-BrassDatabase::open_post_list(const string& term) const
+BrassDatabase::open_post_list(const string& term,
+			      Xapian::QueryStats::Internal * query_stats) const
 {
-    LOGCALL(DB, LeafPostList *, "BrassDatabase::open_post_list", term);
+    LOGCALL(DB, LeafPostList *, "BrassDatabase::open_post_list", term | (void*)query_stats);
     intrusive_ptr<const BrassDatabase> ptrtothis(this);
 
     if (term.empty()) {
@@ -822,7 +945,7 @@ BrassDatabase::open_post_list(const string& term) const
 	RETURN(new BrassAllDocsPostList(ptrtothis, doccount));
     }
 
-    RETURN(new BrassPostList(ptrtothis, term, true));
+    RETURN(new BrassPostList(ptrtothis, term, true, query_stats));
 }
 
 ValueList *
@@ -858,6 +981,35 @@ BrassDatabase::open_document(Xapian::docid did, bool lazy) const
     RETURN(new BrassDocument(ptrtothis, did, &value_manager, &record_table));
 }
 
+void
+BrassDatabase::open_documents(const vector<Xapian::docid> & dids,
+			      vector<Xapian::Document> & docs) const
+{
+    LOGCALL_VOID(DB, "BrassDatabase::open_documents", dids | docs);
+    // This will throw DocNotFoundError if any of the documents don't exist.
+    vector<string> records;
+    records.reserve(dids.size());
+    record_table.get_records(dids, records);
+
+    // If there's no termlist table, leave the values to be read lazily so
+    // that an exception is only thrown if they're actually wanted.
+    vector<map<Xapian::valueno, string> > values;
+    if (termlist_table.is_open()) {
+	values.reserve(dids.size());
+	value_manager.get_all_values(dids, values);
+    }
+
+    intrusive_ptr<const Database::Internal> ptrtothis(this);
+    for (size_t i = 0; i != dids.size(); ++i) {
+	Xapian::Document::Internal * doc;
+	doc = new BrassDocument(ptrtothis, dids[i], &value_manager,
+				&record_table);
+	docs.push_back(Xapian::Document(doc));
+	doc->set_data(records[i]);
+	if (!values.empty()) doc->set_all_values(values[i]);
+    }
+}
+
 PositionList *
 BrassDatabase::open_position_list(Xapian::docid did, const string & term) const
 {
@@ -954,6 +1106,31 @@ BrassDatabase::get_uuid() const
     RETURN(version_file.get_uuid_string());
 }
 
+Xapian::Database::Internal *
+BrassDatabase::get_snapshot(size_t n) const
+{
+    LOGCALL(DB, Xapian::Database::Internal *, "BrassDatabase::get_snapshot", n);
+    // A writable database may have changes which aren't on disk yet.
+    if (!readonly || !postlist_table.is_open()) RETURN(NULL);
+
+    brass_revision_number_t revision = get_revision_number();
+    if (n >= snapshots.size()) snapshots.resize(n + 1);
+    Xapian::Internal::intrusive_ptr<BrassDatabase> & snapshot = snapshots[n];
+    if (!snapshot.get()) {
+	int flags = Xapian::DB_READONLY_;
+	if (postlist_table.get_flags() & Xapian::DB_MMAP)
+	    flags = Xapian::DB_READONLY_MMAP_;
+	snapshot = new BrassDatabase(db_dir, flags);
+    } else if (snapshot->get_revision_number() != revision) {
+	(void)snapshot->reopen();
+    }
+
+    // We can only open the latest revision, which may have moved on since
+    // this object was opened.
+    if (snapshot->get_revision_number() != revision) RETURN(NULL);
+    RETURN(snapshot.get());
+}
+
 void
 BrassDatabase::throw_termlist_table_close_exception() const
 {
@@ -971,6 +1148,7 @@ BrassWritableDatabase::BrassWritableDatabase(const string &dir, int flags,
 	: BrassDatabase(dir, flags, block_size),
 	  change_count(0),
 	  flush_threshold(0),
+	  flush_memory(DEFAULT_FLUSH_MEMORY),
 	  modify_shortcut_document(NULL),
 	  modify_shortcut_docid(0)
 {
@@ -1003,8 +1181,8 @@ BrassWritableDatabase::flush_postlist_changes() const
 {
     stats.set_oldest_changeset(changes.get_oldest_changeset());
     stats.write(postlist_table);
-    inverter.flush(postlist_table);
-    inverter.flush_pos_lists(position_table);
+    inverter.flush(postlist_table, position_table);
+    value_manager.merge_changes();
 
     change_count = 0;
 }
@@ -1086,10 +1264,7 @@ BrassWritableDatabase::add_document_(Xapian::docid did,
 	throw;
     }
 
-    // FIXME: this should be done by checking memory usage, not the number of
-    // changes.  We could also look at the amount of data the inverter object
-    // currently holds.
-    if (++change_count >= flush_threshold) {
+    if (++change_count >= flush_threshold || flush_memory_exceeded()) {
 	flush_postlist_changes();
 	if (!transaction_active()) apply();
     }
@@ -1153,7 +1328,7 @@ BrassWritableDatabase::delete_document(Xapian::docid did)
 	throw;
     }
 
-    if (++change_count >= flush_threshold) {
+    if (++change_count >= flush_threshold || flush_memory_exceeded()) {
 	flush_postlist_changes();
 	if (!transaction_active()) apply();
     }
@@ -1313,7 +1488,7 @@ BrassWritableDatabase::replace_document(Xapian::docid did,
 	throw;
     }
 
-    if (++change_count >= flush_threshold) {
+    if (++change_count >= flush_threshold || flush_memory_exceeded()) {
 	flush_postlist_changes();
 	if (!transaction_active()) apply();
     }
@@ -1403,9 +1578,10 @@ BrassWritableDatabase::has_positions() const
 }
 
 LeafPostList *
-BrassWritableDatabase::open_post_list(const string& tname) const
+BrassWritableDatabase::open_post_list(const string& tname,
+				      Xapian::QueryStats::Internal * query_stats) const
 {
-    LOGCALL(DB, LeafPostList *, "BrassWritableDatabase::open_post_list", tname);
+    LOGCALL(DB, LeafPostList *, "BrassWritableDatabase::open_post_list", tname | (void*)query_stats);
     intrusive_ptr<const BrassWritableDatabase> ptrtothis(this);
 
     if (tname.empty()) {
@@ -1421,7 +1597,7 @@ BrassWritableDatabase::open_post_list(const string& tname) const
     // iterate from the flushed state.
     inverter.flush_post_list(postlist_table, tname);
     inverter.flush_pos_lists(position_table);
-    RETURN(new BrassPostList(ptrtothis, tname, true));
+    RETURN(new BrassPostList(ptrtothis, tname, true, query_stats));
 }
 
 ValueList *
@@ -1563,3 +1739,17 @@ BrassWritableDatabase::invalidate_doc_object(Xapian::Document::Internal * obj) c
 	modify_shortcut_docid = 0;
     }
 }
+
+void
+BrassWritableDatabase::set_flush_memory(size_t bytes)
+{
+    flush_memory = bytes;
+}
+
+size_t
+BrassWritableDatabase::get_buffered_memory() const
+{
+    // Termlist entries are written straight to the table, but the value slots
+    // used by each changed document are buffered in the value manager.
+    return inverter.get_memory_used() + value_manager.get_memory_used();
+}
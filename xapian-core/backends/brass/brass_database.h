@@ -29,6 +29,7 @@
 #include "brass_changes.h"
 #include "brass_dbstats.h"
 #include "brass_inverter.h"
+#include "brass_pins.h"
 #include "brass_positionlist.h"
 #include "brass_postlist.h"
 #include "brass_record.h"
@@ -46,6 +47,7 @@
 #include "xapian/constants.h"
 
 #include <map>
+#include <vector>
 
 class BrassTermList;
 class BrassAllDocsPostList;
@@ -121,6 +123,13 @@ class BrassDatabase : public Xapian::Database::Internal {
 	/// Replication changesets.
 	BrassChanges changes;
 
+	/// Revisions pinned by readers (see Xapian::DB_PIN_REVISION).
+	BrassPins pins;
+
+	/// Snapshots of this database handed out by get_snapshot().
+	mutable std::vector<Xapian::Internal::intrusive_ptr<BrassDatabase> >
+	    snapshots;
+
 	/** Return true if a database exists at the path specified for this
 	 *  database.
 	 */
@@ -176,6 +185,14 @@ class BrassDatabase : public Xapian::Database::Internal {
 	 */
 	void set_revision_number(int flags, brass_revision_number_t new_revision);
 
+	/** Tell the tables the oldest revision which a reader has pinned.
+	 *
+	 *  This needs to be called before a writer opens the tables, and after
+	 *  each commit, as the blocks freed by a commit can't be reused until
+	 *  then.
+	 */
+	void update_oldest_pinned_revision();
+
 	/** Re-open tables to recover from an overwritten condition,
 	 *  or just get most up-to-date version.
 	 */
@@ -233,6 +250,11 @@ class BrassDatabase : public Xapian::Database::Internal {
 	 *
 	 *  @param dbdir directory holding brass tables
 	 *
+	 *  @param flags  Xapian::DB_READONLY_ to open read-only,
+	 *		  Xapian::DB_READONLY_MMAP_ to open read-only with the
+	 *		  tables memory mapped, otherwise the flags to open
+	 *		  for writing with.
+	 *
 	 *  @param block_size Block size, in bytes, to use when creating
 	 *                    tables.  This is only important, and has the
 	 *                    correct value, when the database is being
@@ -248,6 +270,14 @@ class BrassDatabase : public Xapian::Database::Internal {
 	    return postlist_table.cursor_get();
 	}
 
+	/** Pin the revision of a read-only database.
+	 *
+	 *  The database is moved to the latest revision, which the writer then
+	 *  won't overwrite until the pin is moved by reopen() or released when
+	 *  this object is destroyed.  See Xapian::DB_PIN_REVISION.
+	 */
+	void pin_revision();
+
 	/** Get an object holding the revision number which the tables are
 	 *  opened at.
 	 *
@@ -274,9 +304,12 @@ class BrassDatabase : public Xapian::Database::Internal {
 	bool term_exists(const string & tname) const;
 	bool has_positions() const;
 
-	LeafPostList * open_post_list(const string & tname) const;
+	LeafPostList * open_post_list(const string & tname,
+				      Xapian::QueryStats::Internal * stats) const;
 	ValueList * open_value_list(Xapian::valueno slot) const;
 	Xapian::Document::Internal * open_document(Xapian::docid did, bool lazy) const;
+	void open_documents(const std::vector<Xapian::docid> & dids,
+			    std::vector<Xapian::Document> & docs) const;
 
 	PositionList * open_position_list(Xapian::docid did, const string & term) const;
 	TermList * open_term_list(Xapian::docid did) const;
@@ -297,6 +330,7 @@ class BrassDatabase : public Xapian::Database::Internal {
 				    Xapian::ReplicationInfo * info);
 	string get_revision_info() const;
 	string get_uuid() const;
+	Xapian::Database::Internal * get_snapshot(size_t n) const;
 	//@}
 
 	XAPIAN_NORETURN(void throw_termlist_table_close_exception() const);
@@ -317,6 +351,18 @@ class BrassWritableDatabase : public BrassDatabase {
 	/// If change_count reaches this threshold we automatically flush.
 	Xapian::doccount flush_threshold;
 
+	/** If the buffered changes use this much memory we automatically flush.
+	 *
+	 *  This stops big documents using lots of memory before flush_threshold
+	 *  is reached.  If 0, only flush_threshold is used.
+	 */
+	size_t flush_memory;
+
+	/// Are the buffered changes using more memory than flush_memory?
+	bool flush_memory_exceeded() const {
+	    return flush_memory && get_buffered_memory() >= flush_memory;
+	}
+
 	/** A pointer to the last document which was returned by
 	 *  open_document(), or NULL if there is no such valid document.  This
 	 *  is used purely for comparing with a supplied document to help with
@@ -394,7 +440,8 @@ class BrassWritableDatabase : public BrassDatabase {
 	bool term_exists(const string & tname) const;
 	bool has_positions() const;
 
-	LeafPostList * open_post_list(const string & tname) const;
+	LeafPostList * open_post_list(const string & tname,
+				      Xapian::QueryStats::Internal * stats) const;
 	ValueList * open_value_list(Xapian::valueno slot) const;
 	PositionList * open_position_list(Xapian::docid did, const string & term) const;
 	TermList * open_term_list(Xapian::docid did) const;
@@ -411,6 +458,9 @@ class BrassWritableDatabase : public BrassDatabase {
 
 	void set_metadata(const string & key, const string & value);
 	void invalidate_doc_object(Xapian::Document::Internal * obj) const;
+
+	void set_flush_memory(size_t bytes);
+	size_t get_buffered_memory() const;
 	//@}
 };
 
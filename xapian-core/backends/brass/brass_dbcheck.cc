@@ -32,6 +32,7 @@
 #include "brass_cursor.h"
 #include "brass_table.h"
 #include "brass_types.h"
+#include "brass_values.h"
 #include "pack.h"
 #include "backends/valuestats.h"
 
@@ -214,6 +215,13 @@ check_brass_table(const char * tablename, string filename,
 		    continue;
 		}
 		lastdid += did;
+		Xapian::termcount max_doclen;
+		if (!unpack_uint(&pos, end, &max_doclen)) {
+		    if (out)
+			*out << "Failed to unpack max doclen in chunk" << endl;
+		    ++errors;
+		    continue;
+		}
 		bool bad = false;
 		while (true) {
 		    Xapian::termcount doclen;
@@ -225,6 +233,14 @@ check_brass_table(const char * tablename, string filename,
 			break;
 		    }
 
+		    if (doclen > max_doclen) {
+			if (out)
+			    *out << "document id " << did << ": length "
+				 << doclen << " > max length in chunk "
+				 << max_doclen << endl;
+			++errors;
+		    }
+
 		    if (did > db_last_docid) {
 			if (out)
 			    *out << "document id " << did << " in doclen "
@@ -365,65 +381,95 @@ check_brass_table(const char * tablename, string filename,
 		VStats & v = valuestats[slot];
 
 		cursor->read_tag();
-		p = cursor->current_tag.data();
-		end = p + cursor->current_tag.size();
-
-		while (true) {
-		    string value;
-		    if (!unpack_string(&p, end, value)) {
-			if (out)
-			    *out << "Failed to unpack value from chunk" << endl;
-			++errors;
-			break;
-		    }
-
-		    ++v.freq_real;
+		const string & tag = cursor->current_tag;
+
+		try {
+		    Brass::ValueChunkReader reader(tag.data(), tag.size(), did);
+		    double lo = 0, hi = 0;
+		    bool have_bounds = reader.get_numeric_bounds(lo, hi);
+		    string chunk_lo, chunk_hi;
+		    Xapian::docid chunk_last;
+		    bool have_chunk_bounds =
+			reader.get_bounds(chunk_lo, chunk_hi, chunk_last);
+		    while (true) {
+			const string & value = reader.get_value();
+
+			++v.freq_real;
+
+			// FIXME: Cross-check that docid did has value slot
+			// (and vice versa - that there's a value here if the
+			// slot entry says so).
+
+			// FIXME: Check if the bounds are tight?  Or is that
+			// better as a separate tool which can also update the
+			// bounds?
+			if (value < v.lower_bound) {
+			    if (out)
+				*out << "Value slot " << slot << " has value "
+					"below lower bound: '" << value
+				     << "' < '" << v.lower_bound << "'" << endl;
+			    ++errors;
+			} else if (value > v.upper_bound) {
+			    if (out)
+				*out << "Value slot " << slot << " has value "
+					"above upper bound: '" << value
+				     << "' > '" << v.upper_bound << "'" << endl;
+			    ++errors;
+			}
 
-		    // FIXME: Cross-check that docid did has value slot (and
-		    // vice versa - that there's a value here if the slot entry
-		    // says so).
+			if (have_chunk_bounds &&
+			    (value < chunk_lo || value > chunk_hi)) {
+			    if (out)
+				*out << "Value slot " << slot << " has value '"
+				     << value << "' outside the bounds of its "
+					"chunk" << endl;
+			    ++errors;
+			}
 
-		    // FIXME: Check if the bounds are tight?  Or is that better
-		    // as a separate tool which can also update the bounds?
-		    if (value < v.lower_bound) {
-			if (out)
-			    *out << "Value slot " << slot << " has value "
-				    "below lower bound: '" << value << "' < '"
-				 << v.lower_bound << "'" << endl;
-			++errors;
-		    } else if (value > v.upper_bound) {
-			if (out)
-			    *out << "Value slot " << slot << " has value "
-				    "above upper bound: '" << value << "' > '"
-				 << v.upper_bound << "'" << endl;
-			++errors;
-		    }
+			if (have_bounds) {
+			    double num = reader.get_numeric_value();
+			    if (num < lo || num > hi) {
+				if (out)
+				    *out << "Value slot " << slot << " has value "
+					 << num << " outside the bounds of its "
+					    "chunk" << endl;
+				++errors;
+			    }
+			}
 
-		    if (p == end) break;
-		    Xapian::docid delta;
-		    if (!unpack_uint(&p, end, &delta)) {
-			if (out)
-			    *out << "Failed to unpack docid delta from chunk"
-				 << endl;
-			++errors;
-			break;
-		    }
-		    Xapian::docid new_did = did + delta + 1;
-		    if (new_did <= did) {
-			if (out)
-			    *out << "docid overflowed in value chunk" << endl;
-			++errors;
-			break;
-		    }
-		    did = new_did;
+			reader.next();
+			if (reader.at_end()) {
+			    if (have_chunk_bounds && did != chunk_last) {
+				if (out)
+				    *out << "Value chunk ends with document id "
+					 << did << " not " << chunk_last
+					 << endl;
+				++errors;
+			    }
+			    break;
+			}
+			Xapian::docid new_did = reader.get_docid();
+			if (new_did <= did) {
+			    if (out)
+				*out << "docid overflowed in value chunk" << endl;
+			    ++errors;
+			    break;
+			}
+			did = new_did;
 
-		    if (did > db_last_docid) {
-			if (out)
-			    *out << "document id " << did << " in value chunk "
-				    "is larger than get_last_docid() "
-				 << db_last_docid << endl;
-			++errors;
+			if (did > db_last_docid) {
+			    if (out)
+				*out << "document id " << did << " in value "
+					"chunk is larger than get_last_docid() "
+				     << db_last_docid << endl;
+			    ++errors;
+			}
 		    }
+		} catch (const Xapian::DatabaseCorruptError & e) {
+		    if (out)
+			*out << "Failed to read value chunk: " << e.get_msg()
+			     << endl;
+		    ++errors;
 		}
 		continue;
 	    }
@@ -541,6 +587,13 @@ check_brass_table(const char * tablename, string filename,
 		continue;
 	    }
 	    lastdid += did;
+	    Xapian::termcount max_wdf;
+	    if (!unpack_uint(&pos, end, &max_wdf)) {
+		if (out)
+		    *out << "Failed to unpack max wdf in chunk" << endl;
+		++errors;
+		continue;
+	    }
 	    bool bad = false;
 	    while (true) {
 		Xapian::termcount wdf;
@@ -551,6 +604,12 @@ check_brass_table(const char * tablename, string filename,
 		    bad = true;
 		    break;
 		}
+		if (wdf > max_wdf) {
+		    if (out)
+			*out << "wdf " << wdf << " > max wdf in chunk "
+			     << max_wdf << endl;
+		    ++errors;
+		}
 		++tf;
 		cf += wdf;
 
@@ -177,7 +177,7 @@ BrassFreeList::commit(BrassTable * B)
 	SET_REVISION(pw, revision);
 	write_block(B, flw.n, pw);
 	flw_appending = true;
-	fl_end = flw;
+	freed_by.push_back(make_pair(revision, flw));
 	if (p && flw.n == fl.n) {
 	    // FIXME: share and refcount?
 	    memcpy(p, pw, block_size);
@@ -25,6 +25,9 @@
 #include "brass_types.h"
 #include "pack.h"
 
+#include <utility>
+#include <vector>
+
 class BrassTable;
 
 class BrassFLCursor {
@@ -83,6 +86,22 @@ class BrassFreeList {
 
     bool flw_appending;
 
+    /** Blocks freed by a revision which may still be in use.
+     *
+     *  Each entry is a committed revision and the end of the freelist after
+     *  the blocks it freed, in ascending order of revision.  Blocks freed by
+     *  revision R were used by revision R - 1 so can only be reused once no
+     *  reader has a revision before R pinned.
+     */
+    std::vector<std::pair<uint4, BrassFLCursor> > freed_by;
+
+    /** The oldest revision pinned by a reader.
+     *
+     *  This describes the users of the table rather than the freelist on
+     *  disk, so swap() leaves it alone.
+     */
+    uint4 oldest_pinned;
+
   private:
     /// Current freelist block.
     byte * p;
@@ -93,7 +112,7 @@ class BrassFreeList {
   public:
     BrassFreeList()
 	: revision(0), block_size(0), first_unused_block(0),
-	  flw_appending(false), p(0), pw(0) { }
+	  flw_appending(false), oldest_pinned(uint4(-1)), p(0), pw(0) { }
 
     ~BrassFreeList() { delete [] p; delete [] pw; }
 
@@ -113,8 +132,36 @@ class BrassFreeList {
 
     uint4 get_first_unused_block() const { return first_unused_block; }
 
+    /** Write out the freelist for a commit.
+     *
+     *  The blocks freed by the revision being committed aren't available for
+     *  reuse until release_freed_blocks() is called, which the caller must
+     *  only do once it has checked which revisions are pinned.
+     */
     void commit(BrassTable * B);
 
+    /** Set the oldest revision pinned by a reader.
+     *
+     *  Any blocks which this allows to be reused are released.
+     *
+     *  @param rev  The oldest pinned revision, or uint4(-1) if there isn't
+     *		    one.
+     */
+    void set_oldest_pinned_revision(uint4 rev) {
+	oldest_pinned = rev;
+	release_freed_blocks();
+    }
+
+    /// Allow reuse of blocks freed by revisions which aren't pinned.
+    void release_freed_blocks() {
+	std::vector<std::pair<uint4, BrassFLCursor> >::iterator i;
+	for (i = freed_by.begin(); i != freed_by.end(); ++i) {
+	    if (i->first > oldest_pinned) break;
+	    fl_end = i->second;
+	}
+	freed_by.erase(freed_by.begin(), i);
+    }
+
     void swap(BrassFreeList &o) {
 	std::swap(revision, o.revision);
 	std::swap(block_size, o.block_size);
@@ -123,6 +170,7 @@ class BrassFreeList {
 	std::swap(fl_end, o.fl_end);
 	std::swap(flw, o.flw);
 	std::swap(flw_appending, o.flw_appending);
+	std::swap(freed_by, o.freed_by);
 	std::swap(p, o.p);
 	std::swap(pw, o.pw);
     }
@@ -142,7 +190,11 @@ class BrassFreeList {
 		 fl.unpack(pstart, end) &&
 		 flw.unpack(pstart, end);
 	if (r) {
-	    fl_end = flw;
+	    // We don't know which revision freed which blocks, so we treat them
+	    // all as freed by the current revision.
+	    fl_end = fl;
+	    freed_by.clear();
+	    if (fl != flw) freed_by.push_back(std::make_pair(revision, flw));
 	    block_size *= 2048;
 	}
 	return r;
@@ -27,11 +27,112 @@
 
 #include "api/termlist.h"
 
+#include <algorithm>
+#include <cstring>
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 using namespace std;
 
+namespace {
+
+/// Order entries in the run by term, and then by position in the run.
+class RunOrder {
+    const string & terms;
+
+    const vector<size_t> & term_ends;
+
+    const char * get_term(size_t i, size_t & len) const {
+	size_t start = i ? term_ends[i - 1] : 0;
+	len = term_ends[i] - start;
+	return terms.data() + start;
+    }
+
+  public:
+    RunOrder(const string & terms_, const vector<size_t> & term_ends_)
+	: terms(terms_), term_ends(term_ends_) { }
+
+    /// Compare the terms of entries @a a and @a b.
+    int compare(size_t a, size_t b) const {
+	size_t a_len, b_len;
+	const char * a_term = get_term(a, a_len);
+	const char * b_term = get_term(b, b_len);
+	int r = memcmp(a_term, b_term, min(a_len, b_len));
+	if (r) return r;
+	return a_len < b_len ? -1 : (a_len > b_len);
+    }
+
+    bool operator()(size_t a, size_t b) const {
+	int r = compare(a, b);
+	// Keep the entries for each term in docid order.
+	return r < 0 || (r == 0 && a < b);
+    }
+};
+
+}
+
+bool
+Inverter::is_last_in_run(Xapian::docid did, const string & term) const
+{
+    if (run_dids.empty() || run_dids.back() != did) return false;
+    return run_entry_is_for(run_dids.size() - 1, term);
+}
+
+Xapian::termcount_diff
+Inverter::take_from_run(const string & term,
+			vector<pair<Xapian::docid, Xapian::termcount> > & postings)
+{
+    // Shuffle the entries we keep down over those we remove, in one pass.
+    Xapian::termcount_diff cf_delta = 0;
+    size_t n = run_dids.size();
+    size_t out = 0, term_out = 0, pos_out = 0;
+    size_t term_start = 0, pos_start = 0;
+    for (size_t i = 0; i != n; ++i) {
+	size_t term_end = run_term_ends[i];
+	size_t pos_end = run_pos_ends[i];
+	if (run_entry_is_for(i, term)) {
+	    Xapian::docid did = run_dids[i];
+	    postings.push_back(make_pair(did, run_wdfs[i]));
+	    cf_delta += run_wdfs[i];
+	    if (pos_end != pos_start) {
+		changes_size += term.size() + (pos_end - pos_start) +
+				MAP_NODE_SIZE;
+		pos_changes.insert(make_pair(term, map<Xapian::docid, string>()))
+		    .first->second[did].assign(run_positions, pos_start,
+					       pos_end - pos_start);
+	    }
+	} else {
+	    if (out != i) {
+		memmove(&run_terms[term_out], run_terms.data() + term_start,
+			term_end - term_start);
+		if (pos_end != pos_start) {
+		    memmove(&run_positions[pos_out],
+			    run_positions.data() + pos_start,
+			    pos_end - pos_start);
+		}
+		run_dids[out] = run_dids[i];
+		run_wdfs[out] = run_wdfs[i];
+	    }
+	    term_out += term_end - term_start;
+	    pos_out += pos_end - pos_start;
+	    run_term_ends[out] = term_out;
+	    run_pos_ends[out] = pos_out;
+	    ++out;
+	}
+	term_start = term_end;
+	pos_start = pos_end;
+    }
+    run_terms.resize(term_out);
+    run_term_ends.resize(out);
+    run_dids.resize(out);
+    run_wdfs.resize(out);
+    run_positions.resize(pos_out);
+    run_pos_ends.resize(out);
+    return cf_delta;
+}
+
 void
 Inverter::store_positions(const BrassPositionListTable & position_table,
 			  Xapian::docid did,
@@ -41,6 +142,12 @@ Inverter::store_positions(const BrassPositionListTable & position_table,
 {
     string s;
     position_table.pack(s, posvec);
+    if (!modifying && is_last_in_run(did, tname)) {
+	run_positions += s;
+	run_pos_ends.back() = run_positions.size();
+	return;
+    }
+    change_in_maps(did);
     if (modifying) {
 	map<string, map<Xapian::docid, string> >::iterator i;
 	i = pos_changes.find(tname);
@@ -96,6 +203,8 @@ Inverter::set_positionlist(Xapian::docid did,
 			   const string & term,
 			   const string & s)
 {
+    change_in_maps(did);
+    changes_size += term.size() + s.size() + MAP_NODE_SIZE;
     pos_changes.insert(make_pair(term, map<Xapian::docid, string>()))
 	.first->second[did] = s;
 }
@@ -110,8 +219,9 @@ Inverter::delete_positionlist(Xapian::docid did,
 bool
 Inverter::get_positionlist(Xapian::docid did,
 			   const string & term,
-			   string & s) const
+			   string & s)
 {
+    if (!run_dids.empty() && did >= run_dids.front()) fold_run();
     map<string, map<Xapian::docid, string> >::const_iterator i;
     i = pos_changes.find(term);
     if (i == pos_changes.end())
@@ -128,6 +238,10 @@ Inverter::get_positionlist(Xapian::docid did,
 bool
 Inverter::has_positions(const BrassPositionListTable & position_table) const
 {
+    // Entries in the run are all for new documents.
+    if (!run_positions.empty())
+	return true;
+
     if (pos_changes.empty())
 	return !position_table.empty();
 
@@ -150,6 +264,33 @@ Inverter::has_positions(const BrassPositionListTable & position_table) const
     return changes != position_table.get_entry_count();
 }
 
+bool
+Inverter::get_deltas(const string & term,
+		     Xapian::termcount_diff & tf_delta,
+		     Xapian::termcount_diff & cf_delta) const
+{
+    bool found = false;
+    tf_delta = 0;
+    cf_delta = 0;
+    map<string, PostingChanges>::const_iterator i;
+    i = postlist_changes.find(term);
+    if (i != postlist_changes.end()) {
+	tf_delta = i->second.get_tfdelta();
+	cf_delta = i->second.get_cfdelta();
+	found = true;
+    }
+
+    // Scan the run rather than folding it into the maps.
+    for (size_t e = 0; e != run_dids.size(); ++e) {
+	if (run_entry_is_for(e, term)) {
+	    ++tf_delta;
+	    cf_delta += run_wdfs[e];
+	    found = true;
+	}
+    }
+    return found;
+}
+
 void
 Inverter::flush_doclengths(BrassPostListTable & table)
 {
@@ -157,21 +298,136 @@ Inverter::flush_doclengths(BrassPostListTable & table)
     doclen_changes.clear();
 }
 
+void
+Inverter::fold_run()
+{
+    if (run_dids.empty()) return;
+
+    // Take the run's buffers, and feed the entries in it through the methods
+    // which buffer changes in the maps.
+    string terms, positions;
+    vector<size_t> term_ends, pos_ends;
+    vector<Xapian::docid> dids;
+    vector<Xapian::termcount> wdfs;
+    swap(terms, run_terms);
+    swap(term_ends, run_term_ends);
+    swap(dids, run_dids);
+    swap(wdfs, run_wdfs);
+    swap(positions, run_positions);
+    swap(pos_ends, run_pos_ends);
+
+    // Make sure none of the entries goes back into the run.
+    if (dids.back() > max_changed_did) max_changed_did = dids.back();
+
+    size_t term_start = 0, pos_start = 0;
+    for (size_t i = 0; i != dids.size(); ++i) {
+	string term(terms, term_start, term_ends[i] - term_start);
+	add_posting(dids[i], term, wdfs[i]);
+	if (pos_ends[i] != pos_start) {
+	    set_positionlist(dids[i], term,
+			     string(positions, pos_start, pos_ends[i] - pos_start));
+	}
+	term_start = term_ends[i];
+	pos_start = pos_ends[i];
+    }
+}
+
+void
+Inverter::flush_run(BrassPostListTable & table,
+		    BrassPositionListTable & pos_table)
+{
+    size_t n = run_dids.size();
+    if (n == 0) return;
+
+    // Sort the entries by term.  First distribute them by the first byte of
+    // the term, which keeps each bucket in docid order, then sort each bucket.
+    vector<size_t> order(n);
+    {
+	size_t bucket_start[257] = { 0 };
+	for (size_t i = 0; i != n; ++i) {
+	    size_t start = i ? run_term_ends[i - 1] : 0;
+	    unsigned char ch = run_terms[start];
+	    ++bucket_start[ch + 1];
+	}
+	for (int b = 1; b != 257; ++b) {
+	    bucket_start[b] += bucket_start[b - 1];
+	}
+	size_t next[256];
+	copy(bucket_start, bucket_start + 256, next);
+	for (size_t i = 0; i != n; ++i) {
+	    size_t start = i ? run_term_ends[i - 1] : 0;
+	    unsigned char ch = run_terms[start];
+	    order[next[ch]++] = i;
+	}
+	RunOrder cmp(run_terms, run_term_ends);
+	for (int b = 0; b != 256; ++b) {
+	    if (bucket_start[b + 1] - bucket_start[b] > 1) {
+		sort(order.begin() + bucket_start[b],
+		     order.begin() + bucket_start[b + 1], cmp);
+	    }
+	}
+    }
+
+    // Now write the postings for each term with a single merge, and the
+    // positional data in key order.
+    RunOrder cmp(run_terms, run_term_ends);
+    vector<pair<Xapian::docid, Xapian::termcount> > postings;
+    size_t i = 0;
+    while (i != n) {
+	size_t first = order[i];
+	size_t term_start = first ? run_term_ends[first - 1] : 0;
+	string term(run_terms, term_start, run_term_ends[first] - term_start);
+	postings.clear();
+	Xapian::termcount_diff cf_delta = 0;
+	do {
+	    size_t e = order[i];
+	    Xapian::docid did = run_dids[e];
+	    Xapian::termcount wdf = run_wdfs[e];
+	    postings.push_back(make_pair(did, wdf));
+	    cf_delta += wdf;
+	    size_t pos_start = e ? run_pos_ends[e - 1] : 0;
+	    if (run_pos_ends[e] != pos_start) {
+		pos_table.set_positionlist(did, term,
+					   string(run_positions, pos_start,
+						  run_pos_ends[e] - pos_start));
+	    }
+	} while (++i != n && cmp.compare(first, order[i]) == 0);
+	table.merge_changes(term, cf_delta, postings);
+    }
+
+    // Release the memory rather than just clearing the buffers, since the
+    // caller is trying to reduce memory use.
+    string().swap(run_terms);
+    vector<size_t>().swap(run_term_ends);
+    vector<Xapian::docid>().swap(run_dids);
+    vector<Xapian::termcount>().swap(run_wdfs);
+    string().swap(run_positions);
+    vector<size_t>().swap(run_pos_ends);
+}
+
 void
 Inverter::flush_post_list(BrassPostListTable & table, const string & term)
 {
+    // Flush buffered changes for just this term's postlist.  The run and the
+    // maps never have changes for the same posting, and the run's are all
+    // for later documents, so merge the map's changes first.
     map<string, PostingChanges>::iterator i;
     i = postlist_changes.find(term);
-    if (i == postlist_changes.end()) return;
+    if (i != postlist_changes.end()) {
+	table.merge_changes(term, i->second);
+	postlist_changes.erase(i);
+    }
 
-    // Flush buffered changes for just this term's postlist.
-    table.merge_changes(term, i->second);
-    postlist_changes.erase(i);
+    vector<pair<Xapian::docid, Xapian::termcount> > postings;
+    Xapian::termcount_diff cf_delta = take_from_run(term, postings);
+    if (!postings.empty())
+	table.merge_changes(term, cf_delta, postings);
 }
 
 void
 Inverter::flush_all_post_lists(BrassPostListTable & table)
 {
+    fold_run();
     map<string, PostingChanges>::const_iterator i;
     for (i = postlist_changes.begin(); i != postlist_changes.end(); ++i) {
 	table.merge_changes(i->first, i->second);
@@ -185,6 +441,8 @@ Inverter::flush_post_lists(BrassPostListTable & table, const string & pfx)
     if (pfx.empty())
 	return flush_all_post_lists(table);
 
+    fold_run();
+
     map<string, PostingChanges>::iterator i, begin, end;
     begin = postlist_changes.lower_bound(pfx);
     end = postlist_changes.upper_bound(pfx);
@@ -199,15 +457,40 @@ Inverter::flush_post_lists(BrassPostListTable & table, const string & pfx)
 }
 
 void
-Inverter::flush(BrassPostListTable & table)
+Inverter::flush(BrassPostListTable & table,
+		BrassPositionListTable & pos_table)
 {
     flush_doclengths(table);
+    // The run and the maps never have changes for the same posting, so the
+    // order we write them in doesn't matter.
+    flush_run(table, pos_table);
     flush_all_post_lists(table);
+    flush_pos_lists(pos_table);
+    max_changed_did = 0;
+    changes_size = 0;
 }
 
 void
 Inverter::flush_pos_lists(BrassPositionListTable & table)
 {
+    // Write out the positional data in the run, leaving its postings there.
+    if (!run_positions.empty()) {
+	size_t term_start = 0, pos_start = 0;
+	for (size_t e = 0; e != run_dids.size(); ++e) {
+	    size_t pos_end = run_pos_ends[e];
+	    if (pos_end != pos_start) {
+		string term(run_terms, term_start, run_term_ends[e] - term_start);
+		table.set_positionlist(run_dids[e], term,
+				       string(run_positions, pos_start,
+					      pos_end - pos_start));
+	    }
+	    term_start = run_term_ends[e];
+	    pos_start = pos_end;
+	    run_pos_ends[e] = 0;
+	}
+	run_positions.resize(0);
+    }
+
     map<string, map<Xapian::docid, string> >::const_iterator i;
     for (i = pos_changes.begin(); i != pos_changes.end(); ++i) {
 	const string & term = i->first;
@@ -41,7 +41,19 @@ class TermIterator;
 /** Magic wdf value used for a deleted posting. */
 const Xapian::termcount DELETED_POSTING = Xapian::termcount(-1);
 
-/** Class which "inverts the file". */
+/** Rough size of a std::map node, used to estimate memory use. */
+const size_t MAP_NODE_SIZE = 48;
+
+/** Class which "inverts the file".
+ *
+ *  Changes are buffered in two forms.  Postings for documents added in
+ *  ascending docid order (the usual case when bulk indexing) are appended to
+ *  a "run" of flat buffers, which costs no allocations per posting, and are
+ *  only sorted by term when flushed.  Other changes are kept in maps so that
+ *  they can be updated in place.  If a change affects a document in the run,
+ *  or the buffered changes need to be looked up, the run is first folded into
+ *  the maps.
+ */
 class Inverter {
     friend class BrassPostListTable;
 
@@ -117,6 +129,82 @@ class Inverter {
     /// Buffered changes to positional data.
     std::map<std::string, std::map<Xapian::docid, std::string> > pos_changes;
 
+    /// The highest docid with changes in postlist_changes or pos_changes.
+    Xapian::docid max_changed_did;
+
+    /// Approximate memory used by postlist_changes and pos_changes.
+    size_t changes_size;
+
+    /** The terms of the postings in the run, one after another.
+     *
+     *  The term for entry i ends at run_term_ends[i] and starts where the
+     *  previous entry's term ends.
+     */
+    std::string run_terms;
+
+    /// The end of each entry's term in run_terms.
+    std::vector<size_t> run_term_ends;
+
+    /// The docid of each entry in the run (in ascending order).
+    std::vector<Xapian::docid> run_dids;
+
+    /// The wdf of each entry in the run.
+    std::vector<Xapian::termcount> run_wdfs;
+
+    /// Encoded positional data for the entries in the run.
+    std::string run_positions;
+
+    /// The end of each entry's positional data in run_positions.
+    std::vector<size_t> run_pos_ends;
+
+    /// Append a posting for a new document to the run.
+    void append_to_run(Xapian::docid did, const std::string & term,
+		       Xapian::termcount wdf) {
+	run_terms += term;
+	run_term_ends.push_back(run_terms.size());
+	run_dids.push_back(did);
+	run_wdfs.push_back(wdf);
+	run_pos_ends.push_back(run_positions.size());
+    }
+
+    /// Can a posting for document @a did be appended to the run?
+    bool can_append_to_run(Xapian::docid did) const {
+	return did > max_changed_did &&
+	       (run_dids.empty() || did >= run_dids.back());
+    }
+
+    /// Is the last entry in the run for @a term in document @a did?
+    bool is_last_in_run(Xapian::docid did, const std::string & term) const;
+
+    /// Is entry @a i in the run for @a term?
+    bool run_entry_is_for(size_t i, const std::string & term) const {
+	size_t start = i ? run_term_ends[i - 1] : 0;
+	return run_terms.compare(start, run_term_ends[i] - start, term) == 0;
+    }
+
+    /** Remove the entries for @a term from the run.
+     *
+     *  The postings are appended to @a postings, and any positional data is
+     *  moved to pos_changes.
+     *
+     *  @return The total wdf of the postings removed.
+     */
+    Xapian::termcount_diff take_from_run(const std::string & term,
+	    std::vector<std::pair<Xapian::docid, Xapian::termcount> > & postings);
+
+    /// Prepare to buffer a change for @a did in the maps.
+    void change_in_maps(Xapian::docid did) {
+	if (!run_dids.empty() && did >= run_dids.front()) fold_run();
+	if (did > max_changed_did) max_changed_did = did;
+    }
+
+    /// Move all the changes in the run into the maps.
+    void fold_run();
+
+    /// Write the changes in the run to the tables.
+    void flush_run(BrassPostListTable & table,
+		   BrassPositionListTable & pos_table);
+
     void store_positions(const BrassPositionListTable & position_table,
 			 Xapian::docid did,
 			 const std::string & tname,
@@ -132,41 +220,56 @@ class Inverter {
     std::map<Xapian::docid, Xapian::termcount> doclen_changes;
 
   public:
+    Inverter() : max_changed_did(0), changes_size(0) { }
+
     void add_posting(Xapian::docid did, const std::string & term,
 		     Xapian::doccount wdf) {
+	if (can_append_to_run(did)) {
+	    append_to_run(did, term, wdf);
+	    return;
+	}
+	change_in_maps(did);
 	std::map<std::string, PostingChanges>::iterator i;
 	i = postlist_changes.find(term);
 	if (i == postlist_changes.end()) {
 	    postlist_changes.insert(
 		std::make_pair(term, PostingChanges(did, wdf)));
+	    changes_size += term.size() + sizeof(PostingChanges);
 	} else {
 	    i->second.add_posting(did, wdf);
 	}
+	changes_size += MAP_NODE_SIZE;
     }
 
     void remove_posting(Xapian::docid did, const std::string & term,
 			Xapian::doccount wdf) {
+	change_in_maps(did);
 	std::map<std::string, PostingChanges>::iterator i;
 	i = postlist_changes.find(term);
 	if (i == postlist_changes.end()) {
 	    postlist_changes.insert(
 		std::make_pair(term, PostingChanges(did, wdf, false)));
+	    changes_size += term.size() + sizeof(PostingChanges);
 	} else {
 	    i->second.remove_posting(did, wdf);
 	}
+	changes_size += MAP_NODE_SIZE;
     }
 
     void update_posting(Xapian::docid did, const std::string & term,
 			Xapian::termcount old_wdf,
 			Xapian::termcount new_wdf) {
+	change_in_maps(did);
 	std::map<std::string, PostingChanges>::iterator i;
 	i = postlist_changes.find(term);
 	if (i == postlist_changes.end()) {
 	    postlist_changes.insert(
 		std::make_pair(term, PostingChanges(did, old_wdf, new_wdf)));
+	    changes_size += term.size() + sizeof(PostingChanges);
 	} else {
 	    i->second.update_posting(did, old_wdf, new_wdf);
 	}
+	changes_size += MAP_NODE_SIZE;
     }
 
     void set_positionlist(const BrassPositionListTable & position_table,
@@ -180,7 +283,7 @@ class Inverter {
 
     bool get_positionlist(Xapian::docid did,
 			  const std::string & term,
-			  std::string & s) const;
+			  std::string & s);
 
     bool has_positions(const BrassPositionListTable & position_table) const;
 
@@ -188,6 +291,27 @@ class Inverter {
 	doclen_changes.clear();
 	postlist_changes.clear();
 	pos_changes.clear();
+	max_changed_did = 0;
+	changes_size = 0;
+	run_terms.resize(0);
+	run_term_ends.clear();
+	run_dids.clear();
+	run_wdfs.clear();
+	run_positions.resize(0);
+	run_pos_ends.clear();
+    }
+
+    /** Approximate amount of memory used by the buffered changes, in bytes.
+     *
+     *  Like changes_size, this counts the size of the data stored, not the
+     *  capacity allocated for it.
+     */
+    size_t get_memory_used() const {
+	return changes_size +
+	       doclen_changes.size() * MAP_NODE_SIZE +
+	       run_terms.size() + run_positions.size() +
+	       run_dids.size() * (2 * sizeof(size_t) + sizeof(Xapian::docid) +
+				  sizeof(Xapian::termcount));
     }
 
     void set_doclength(Xapian::docid did, Xapian::termcount doclen, bool add) {
@@ -225,24 +349,20 @@ class Inverter {
     /// Flush postlist changes for all terms which start with @a pfx.
     void flush_post_lists(BrassPostListTable & table, const std::string & pfx);
 
-    /// Flush all postlist table changes.
-    void flush(BrassPostListTable & table);
+    /// Flush all postlist and position table changes.
+    void flush(BrassPostListTable & table,
+	       BrassPositionListTable & pos_table);
 
     /// Flush position changes.
     void flush_pos_lists(BrassPositionListTable & table);
 
+    /** Get the changes to the frequencies of @a term.
+     *
+     *  @return false if there are no buffered changes for @a term.
+     */
     bool get_deltas(const std::string & term,
 		    Xapian::termcount_diff & tf_delta,
-		    Xapian::termcount_diff & cf_delta) const {
-	std::map<std::string, PostingChanges>::const_iterator i;
-	i = postlist_changes.find(term);
-	if (i == postlist_changes.end()) {
-	    return false;
-	}
-	tf_delta = i->second.get_tfdelta();
-	cf_delta = i->second.get_cfdelta();
-	return true;
-    }
+		    Xapian::termcount_diff & cf_delta) const;
 };
 
 #endif // XAPIAN_INCLUDED_BRASS_INVERTER_H
@@ -0,0 +1,198 @@
+/** @file brass_pins.cc
+ * @brief Revisions of a brass database pinned by readers.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "brass_pins.h"
+
+#include "xapian/error.h"
+
+#include "safedirent.h"
+#include "safeerrno.h"
+#include "safefcntl.h"
+#include "safeunistd.h"
+#ifdef __WIN32__
+# include "safewindows.h"
+#else
+# include <signal.h>
+#endif
+#include <sys/types.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "posixy_wrapper.h"
+#include "str.h"
+#include "stringutils.h"
+
+using namespace std;
+
+/// The prefix of the names of pin files.
+#define PIN_PREFIX "pin."
+
+class dircloser {
+    DIR * dir;
+  public:
+    dircloser(DIR * dir_) : dir(dir_) {}
+    ~dircloser() {
+	if (dir != NULL) {
+	    closedir(dir);
+	    dir = NULL;
+	}
+    }
+};
+
+/** Parse the name of a pin file.
+ *
+ *  @return true if @a name is a valid pin file name.
+ */
+static bool
+parse_pin_name(const char * name, brass_revision_number_t & revision,
+	       unsigned long & pid)
+{
+    if (strncmp(name, PIN_PREFIX, CONST_STRLEN(PIN_PREFIX)) != 0)
+	return false;
+    name += CONST_STRLEN(PIN_PREFIX);
+    char * end;
+    errno = 0;
+    unsigned long rev = strtoul(name, &end, 10);
+    if (end == name || *end != '.' || errno)
+	return false;
+    revision = brass_revision_number_t(rev);
+    name = end + 1;
+    pid = strtoul(name, &end, 10);
+    if (end == name || *end != '.' || errno)
+	return false;
+    return true;
+}
+
+/// Is there still a process with ID @a pid?
+static bool
+process_exists(unsigned long pid)
+{
+#ifdef __WIN32__
+    HANDLE h = OpenProcess(SYNCHRONIZE, FALSE, DWORD(pid));
+    if (h == NULL) {
+	// If we aren't allowed to open it, the process must exist.
+	return GetLastError() != ERROR_INVALID_PARAMETER;
+    }
+    // A handle can be opened for a process which has exited but which
+    // another process still has a handle open on.
+    bool exited = (WaitForSingleObject(h, 0) == WAIT_OBJECT_0);
+    CloseHandle(h);
+    return !exited;
+#else
+    return !(kill(pid_t(pid), 0) < 0 && errno == ESRCH);
+#endif
+}
+
+void
+BrassPins::pin(brass_revision_number_t revision)
+{
+    string path = db_dir;
+    path += "/" PIN_PREFIX;
+    path += str(revision);
+    path += '.';
+    unsigned long pid = static_cast<unsigned long>(getpid());
+    path += str(pid);
+    path += '.';
+    // Our address is enough to tell apart pins from the same process.
+    path += str(reinterpret_cast<size_t>(this));
+
+    if (path == pin_path) return;
+
+    // A pin inherited across fork() belongs to the parent, so we need our
+    // own rather than moving it.
+    if (pin_pid != pid) pin_path.resize(0);
+
+    if (pin_path.empty()) {
+	int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_BINARY | O_CLOEXEC,
+			0666);
+	if (fd < 0) {
+	    throw Xapian::DatabaseOpeningError("Couldn't create pin file '" +
+					       path + "'", errno);
+	}
+	(void)::close(fd);
+    } else if (posixy_rename(pin_path.c_str(), path.c_str()) < 0) {
+	throw Xapian::DatabaseError("Couldn't rename pin file '" + pin_path +
+				    "' to '" + path + "'", errno);
+    }
+    pin_path = path;
+    pin_pid = pid;
+}
+
+void
+BrassPins::unpin()
+{
+    if (pin_path.empty()) return;
+    // If we've been forked since pinning, the pin belongs to our parent.
+    //
+    // If the file has already gone (e.g. the database has been deleted)
+    // there's nothing to do, and there's nothing useful we can do about any
+    // other errors.
+    if (pin_pid == static_cast<unsigned long>(getpid()))
+	(void)unlink(pin_path.c_str());
+    pin_path.resize(0);
+}
+
+bool
+BrassPins::get_oldest(brass_revision_number_t & oldest) const
+{
+    DIR * dir = opendir(db_dir.c_str());
+    if (dir == NULL) {
+	throw Xapian::DatabaseError("Cannot open directory '" + db_dir + "'",
+				    errno);
+    }
+
+    bool found = false;
+    dircloser dc(dir);
+    while (true) {
+	errno = 0;
+	struct dirent * entry = readdir(dir);
+	if (entry == NULL) {
+	    if (errno == 0)
+		break;
+	    throw Xapian::DatabaseError("Cannot read entry from directory at '" +
+					db_dir + "'", errno);
+	}
+
+	brass_revision_number_t revision;
+	unsigned long pid;
+	if (!parse_pin_name(entry->d_name, revision, pid))
+	    continue;
+
+	if (!process_exists(pid)) {
+	    // The process which pinned this revision has gone away.
+	    string path = db_dir;
+	    path += '/';
+	    path += entry->d_name;
+	    (void)unlink(path.c_str());
+	    continue;
+	}
+
+	if (!found || revision < oldest) {
+	    oldest = revision;
+	    found = true;
+	}
+    }
+
+    return found;
+}
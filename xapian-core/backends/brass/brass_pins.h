@@ -0,0 +1,89 @@
+/** @file brass_pins.h
+ * @brief Revisions of a brass database pinned by readers.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_BRASS_PINS_H
+#define XAPIAN_INCLUDED_BRASS_PINS_H
+
+#include "brass_types.h"
+
+#include <string>
+
+/** Revisions of a brass database pinned by readers.
+ *
+ *  A reader opened with Xapian::DB_PIN_REVISION pins the revision it has
+ *  open, and the writer only reuses blocks freed by revisions up to the
+ *  oldest pinned revision, so a pinned revision stays readable however many
+ *  times the writer commits.
+ *
+ *  Each pin is an empty file in the database directory called
+ *  "pin.<revision>.<pid>.<id>".  Moving a pin to a newer revision renames
+ *  the file, so there's no point at which the reader has no pin.  The
+ *  writer removes the pins of processes which no longer exist, which only
+ *  works if the readers are on the same machine as the writer.
+ *
+ *  A pin is only removed by the process which created it, so a child
+ *  process which inherits a pin across fork() leaves it for its parent.
+ */
+class BrassPins {
+    /// Don't allow copying.
+    BrassPins(const BrassPins &);
+
+    /// Don't allow assignment.
+    void operator=(const BrassPins &);
+
+    /// The database directory.
+    std::string db_dir;
+
+    /// The path of our pin, or empty if we don't have one.
+    std::string pin_path;
+
+    /// The ID of the process which created our pin.
+    unsigned long pin_pid;
+
+  public:
+    explicit BrassPins(const std::string & db_dir_)
+	: db_dir(db_dir_), pin_pid(0) { }
+
+    ~BrassPins() { unpin(); }
+
+    /// Do we have a revision pinned?
+    bool pinned() const { return !pin_path.empty(); }
+
+    /** Pin @a revision, replacing any revision we already have pinned.
+     *
+     *  Pinning revision 0 stops the writer reusing any blocks, which is
+     *  useful while working out which revision to pin.
+     */
+    void pin(brass_revision_number_t revision);
+
+    /// Release our pin, if we have one.
+    void unpin();
+
+    /** Find the oldest revision pinned by any reader.
+     *
+     *  Any pins left by processes which no longer exist are removed.
+     *
+     *  @param[out] oldest  Set to the oldest pinned revision, if any.
+     *
+     *  @return true if any revision is pinned.
+     */
+    bool get_oldest(brass_revision_number_t & oldest) const;
+};
+
+#endif // XAPIAN_INCLUDED_BRASS_PINS_H
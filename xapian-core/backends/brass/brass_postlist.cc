@@ -32,6 +32,8 @@
 #include "str.h"
 #include "unicode/description_append.h"
 
+#include <algorithm>
+
 using Xapian::Internal::intrusive_ptr;
 
 void
@@ -102,14 +104,25 @@ class Brass::PostlistChunkWriter {
 	void append(BrassTable * table, Xapian::docid did,
 		    Xapian::termcount wdf);
 
-	/// Append a block of raw entries to this chunk.
+	/** Append the remaining entries from a PostlistChunkReader.
+	 *
+	 *  Where possible, the encoded entries are copied without being
+	 *  decoded.  On return, @a from is at end.
+	 */
+	void append(BrassTable * table, Brass::PostlistChunkReader & from);
+
+	/** Append a block of raw entries to this chunk.
+	 *
+	 *  The contents of @a s are swapped in, so it's left empty.
+	 */
 	void raw_append(Xapian::docid first_did_, Xapian::docid current_did_,
-			const string & s) {
+			Xapian::termcount max_wdf_, string & s) {
 	    Assert(!started);
 	    first_did = first_did_;
 	    current_did = current_did_;
+	    max_wdf = max_wdf_;
 	    if (!s.empty()) {
-		chunk.append(s);
+		chunk.swap(s);
 		started = true;
 	    }
 	}
@@ -130,6 +143,9 @@ class Brass::PostlistChunkWriter {
 	Xapian::docid first_did;
 	Xapian::docid current_did;
 
+	/// The largest wdf in the chunk.
+	Xapian::termcount max_wdf;
+
 	string chunk;
 };
 
@@ -223,12 +239,34 @@ read_wdf(const char ** posptr, const char * end, Xapian::termcount * wdf_ptr)
     if (!unpack_uint(posptr, end, wdf_ptr)) report_read_error(*posptr);
 }
 
+/// Read the docid increase and the wdf for an entry.
+static inline void
+read_entry(const char ** posptr, const char * end,
+	   Xapian::docid * did_ptr, Xapian::termcount * wdf_ptr)
+{
+    const char * p = *posptr;
+    // In most postlists, the docid increase and the wdf are both small
+    // enough to be encoded in a single byte each, so check for that case
+    // first and avoid the general decoding loop.
+    if (usual(end - p >= 2) &&
+	(static_cast<unsigned char>(p[0]) |
+	 static_cast<unsigned char>(p[1])) < 128) {
+	*did_ptr += static_cast<unsigned char>(p[0]) + 1;
+	*wdf_ptr = static_cast<unsigned char>(p[1]);
+	*posptr = p + 2;
+	return;
+    }
+    read_did_increase(posptr, end, did_ptr);
+    read_wdf(posptr, end, wdf_ptr);
+}
+
 /// Read the start of a chunk.
 static Xapian::docid
 read_start_of_chunk(const char ** posptr,
 		    const char * end,
 		    Xapian::docid first_did_in_chunk,
-		    bool * is_last_chunk_ptr)
+		    bool * is_last_chunk_ptr,
+		    Xapian::termcount * max_wdf_ptr)
 {
     LOGCALL_STATIC(DB, Xapian::docid, "read_start_of_chunk", reinterpret_cast<const void*>(posptr) | reinterpret_cast<const void*>(end) | first_did_in_chunk | reinterpret_cast<const void*>(is_last_chunk_ptr));
     Assert(is_last_chunk_ptr);
@@ -244,6 +282,10 @@ read_start_of_chunk(const char ** posptr,
 	report_read_error(*posptr);
     Xapian::docid last_did_in_chunk = first_did_in_chunk + increase_to_last;
     LOGVALUE(DB, last_did_in_chunk);
+
+    // Read the largest wdf in this chunk.
+    if (!unpack_uint(posptr, end, max_wdf_ptr))
+	report_read_error(*posptr);
     RETURN(last_did_in_chunk);
 }
 
@@ -262,15 +304,29 @@ class Brass::PostlistChunkReader {
     Xapian::docid did;
     Xapian::termcount wdf;
 
+    /// The last document id in this chunk.
+    Xapian::docid last_did;
+
+    /// The largest wdf in this chunk (from the chunk header).
+    Xapian::termcount max_wdf;
+
   public:
     /** Initialise the postlist chunk reader.
      *
      *  @param first_did  First document id in this chunk.
-     *  @param data       The tag string with the header removed.
+     *  @param last_did_  Last document id in this chunk.
+     *  @param max_wdf_   The largest wdf in this chunk.
+     *  @param data_      The tag string with the header removed.  Its
+     *			  contents are swapped in, so it's left empty.
      */
-    PostlistChunkReader(Xapian::docid first_did, const string & data_)
-	: data(data_), pos(data.data()), end(pos + data.length()), at_end(data.empty()), did(first_did)
+    PostlistChunkReader(Xapian::docid first_did, Xapian::docid last_did_,
+			Xapian::termcount max_wdf_, string & data_)
+	: at_end(data_.empty()), did(first_did), last_did(last_did_),
+	  max_wdf(max_wdf_)
     {
+	data.swap(data_);
+	pos = data.data();
+	end = pos + data.size();
 	if (!at_end) read_wdf(&pos, end, &wdf);
     }
 
@@ -281,6 +337,30 @@ class Brass::PostlistChunkReader {
 	return wdf;
     }
 
+    Xapian::docid get_last_did() const {
+	return last_did;
+    }
+    Xapian::termcount get_max_wdf() const {
+	return max_wdf;
+    }
+
+    /// The encoded size of all the entries in this chunk.
+    size_t get_chunk_size() const {
+	return data.size();
+    }
+
+    /** The encoded entries after the current one.
+     *
+     *  These are encoded relative to the current entry, so can be copied
+     *  unchanged to follow it in another chunk.
+     */
+    const char * get_rest() const {
+	return pos;
+    }
+    size_t get_rest_size() const {
+	return end - pos;
+    }
+
     bool is_at_end() const {
 	return at_end;
     }
@@ -288,6 +368,12 @@ class Brass::PostlistChunkReader {
     /** Advance to the next entry.  Set at_end if we run off the end.
      */
     void next();
+
+    /// Skip the remaining entries.
+    void skip_to_end() {
+	pos = end;
+	at_end = true;
+    }
 };
 
 using Brass::PostlistChunkReader;
@@ -298,8 +384,7 @@ PostlistChunkReader::next()
     if (pos == end) {
 	at_end = true;
     } else {
-	read_did_increase(&pos, end, &did);
-	read_wdf(&pos, end, &wdf);
+	read_entry(&pos, end, &did, &wdf);
     }
 }
 
@@ -310,7 +395,8 @@ PostlistChunkWriter::PostlistChunkWriter(const string &orig_key_,
 	: orig_key(orig_key_),
 	  tname(tname_), is_first_chunk(is_first_chunk_),
 	  is_last_chunk(is_last_chunk_),
-	  started(false)
+	  started(false),
+	  max_wdf(0)
 {
     LOGCALL_CTOR(DB, "PostlistChunkWriter", orig_key_ | is_first_chunk_ | tname_ | is_last_chunk_);
 }
@@ -332,6 +418,7 @@ PostlistChunkWriter::append(BrassTable * table, Xapian::docid did,
 	    is_last_chunk = save_is_last_chunk;
 	    is_first_chunk = false;
 	    first_did = did;
+	    max_wdf = 0;
 	    chunk.resize(0);
 	    orig_key = BrassPostListTable::make_key(tname, first_did);
 	} else {
@@ -339,9 +426,36 @@ PostlistChunkWriter::append(BrassTable * table, Xapian::docid did,
 	}
     }
     current_did = did;
+    if (wdf > max_wdf) max_wdf = wdf;
     pack_uint(chunk, wdf);
 }
 
+void
+PostlistChunkWriter::append(BrassTable * table, PostlistChunkReader & from)
+{
+    if (from.is_at_end()) return;
+    append(table, from.get_docid(), from.get_wdf());
+
+    // If the rest will fit without making the chunk bigger than either we'd
+    // normally make it or it already was, copy the entries as they are.
+    size_t rest_size = from.get_rest_size();
+    if (chunk.size() + rest_size <= max(size_t(CHUNKSIZE),
+					 from.get_chunk_size())) {
+	chunk.append(from.get_rest(), rest_size);
+	current_did = from.get_last_did();
+	// The chunk header only gives an upper bound, which is all we need.
+	if (from.get_max_wdf() > max_wdf) max_wdf = from.get_max_wdf();
+	from.skip_to_end();
+	return;
+    }
+
+    from.next();
+    while (!from.is_at_end()) {
+	append(table, from.get_docid(), from.get_wdf());
+	from.next();
+    }
+}
+
 /** Make the data to go at the start of the very first chunk.
  */
 static inline string
@@ -361,12 +475,14 @@ make_start_of_first_chunk(Xapian::doccount entries,
 static inline string
 make_start_of_chunk(bool new_is_last_chunk,
 		    Xapian::docid new_first_did,
-		    Xapian::docid new_final_did)
+		    Xapian::docid new_final_did,
+		    Xapian::termcount new_max_wdf)
 {
     Assert(new_final_did >= new_first_did);
     string chunk;
     pack_bool(chunk, new_is_last_chunk);
     pack_uint(chunk, new_final_did - new_first_did);
+    pack_uint(chunk, new_max_wdf);
     return chunk;
 }
 
@@ -376,14 +492,15 @@ write_start_of_chunk(string & chunk,
 		     unsigned int end_of_chunk_header,
 		     bool is_last_chunk,
 		     Xapian::docid first_did_in_chunk,
-		     Xapian::docid last_did_in_chunk)
+		     Xapian::docid last_did_in_chunk,
+		     Xapian::termcount max_wdf)
 {
     Assert((size_t)(end_of_chunk_header - start_of_chunk_header) <= chunk.size());
 
     chunk.replace(start_of_chunk_header,
 		  end_of_chunk_header - start_of_chunk_header,
 		  make_start_of_chunk(is_last_chunk, first_did_in_chunk,
-				      last_did_in_chunk));
+				      last_did_in_chunk, max_wdf));
 }
 
 void
@@ -474,9 +591,10 @@ PostlistChunkWriter::flush(BrassTable *table)
 
 	    // Read the chunk header
 	    bool new_is_last_chunk;
+	    Xapian::termcount new_max_wdf;
 	    Xapian::docid new_last_did_in_chunk =
 		read_start_of_chunk(&tagpos, tagend, new_first_did,
-				    &new_is_last_chunk);
+				    &new_is_last_chunk, &new_max_wdf);
 
 	    string chunk_data(tagpos, tagend);
 
@@ -488,7 +606,8 @@ PostlistChunkWriter::flush(BrassTable *table)
 	    tag = make_start_of_first_chunk(num_ent, coll_freq, new_first_did);
 	    tag += make_start_of_chunk(new_is_last_chunk,
 					      new_first_did,
-					      new_last_did_in_chunk);
+					      new_last_did_in_chunk,
+					      new_max_wdf);
 	    tag += chunk_data;
 	    table->add(orig_key, tag);
 	    return;
@@ -536,10 +655,11 @@ PostlistChunkWriter::flush(BrassTable *table)
 		    report_read_error(keypos);
 	    }
 	    bool wrong_is_last_chunk;
+	    Xapian::termcount prev_max_wdf;
 	    string::size_type start_of_chunk_header = tagpos - tag.data();
 	    Xapian::docid last_did_in_chunk =
 		read_start_of_chunk(&tagpos, tagend, first_did_in_chunk,
-				    &wrong_is_last_chunk);
+				    &wrong_is_last_chunk, &prev_max_wdf);
 	    string::size_type end_of_chunk_header = tagpos - tag.data();
 
 	    // write new is_last flag
@@ -548,7 +668,8 @@ PostlistChunkWriter::flush(BrassTable *table)
 				 end_of_chunk_header,
 				 true, // is_last_chunk
 				 first_did_in_chunk,
-				 last_did_in_chunk);
+				 last_did_in_chunk,
+				 prev_max_wdf);
 	    table->add(cursor->current_key, tag);
 	}
     } else {
@@ -586,7 +707,8 @@ PostlistChunkWriter::flush(BrassTable *table)
 
 	    tag = make_start_of_first_chunk(num_ent, coll_freq, first_did);
 
-	    tag += make_start_of_chunk(is_last_chunk, first_did, current_did);
+	    tag += make_start_of_chunk(is_last_chunk, first_did, current_did,
+				       max_wdf);
 	    tag += chunk;
 	    table->add(key, tag);
 	    return;
@@ -626,7 +748,8 @@ PostlistChunkWriter::flush(BrassTable *table)
 	}
 
 	// ...and write the start of this chunk.
-	tag = make_start_of_chunk(is_last_chunk, first_did, current_did);
+	tag = make_start_of_chunk(is_last_chunk, first_did, current_did,
+				  max_wdf);
 
 	tag += chunk;
 	table->add(new_key, tag);
@@ -669,14 +792,16 @@ void BrassPostList::read_number_of_entries(const char ** posptr,
  */
 BrassPostList::BrassPostList(intrusive_ptr<const BrassDatabase> this_db_,
 			     const string & term_,
-			     bool keep_reference)
+			     bool keep_reference,
+			     Xapian::QueryStats::Internal * query_stats)
 	: LeafPostList(term_),
 	  this_db(keep_reference ? this_db_ : NULL),
 	  have_started(false),
 	  is_at_end(false),
 	  cursor(this_db_->postlist_table.cursor_get())
 {
-    LOGCALL_CTOR(DB, "BrassPostList", this_db_.get() | term_ | keep_reference);
+    LOGCALL_CTOR(DB, "BrassPostList", this_db_.get() | term_ | keep_reference | (void*)query_stats);
+    cursor->set_query_stats(query_stats);
     init();
 }
 
@@ -693,6 +818,12 @@ BrassPostList::BrassPostList(intrusive_ptr<const BrassDatabase> this_db_,
     init();
 }
 
+inline Xapian::QueryStats::Internal *
+BrassPostList::get_query_stats() const
+{
+    return cursor->get_query_stats();
+}
+
 void
 BrassPostList::init()
 {
@@ -706,6 +837,8 @@ BrassPostList::init()
 	end = 0;
 	first_did_in_chunk = 0;
 	last_did_in_chunk = 0;
+	max_wdf_in_chunk = 0;
+	max_weight_in_chunk = 0.0;
 	return;
     }
     cursor->read_tag();
@@ -715,8 +848,11 @@ BrassPostList::init()
     did = read_start_of_first_chunk(&pos, end, &number_of_entries, NULL);
     first_did_in_chunk = did;
     last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
-					    &is_last_chunk);
+					    &is_last_chunk, &max_wdf_in_chunk);
+    max_weight_in_chunk = -1.0;
     read_wdf(&pos, end, &wdf);
+    Xapian::QueryStats::Internal * stats = get_query_stats();
+    if (stats) ++stats->postings_decoded;
     LOGLINE(DB, "Initial docid " << did);
 }
 
@@ -751,8 +887,9 @@ BrassPostList::next_in_chunk()
     LOGCALL(DB, bool, "BrassPostList::next_in_chunk", NO_ARGS);
     if (pos == end) RETURN(false);
 
-    read_did_increase(&pos, end, &did);
-    read_wdf(&pos, end, &wdf);
+    read_entry(&pos, end, &did, &wdf);
+    Xapian::QueryStats::Internal * stats = get_query_stats();
+    if (stats) ++stats->postings_decoded;
 
     // Either not at last doc in chunk, or pos == end, but not both.
     Assert(did <= last_did_in_chunk);
@@ -804,8 +941,11 @@ BrassPostList::next_chunk()
 
     first_did_in_chunk = did;
     last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
-					    &is_last_chunk);
+					    &is_last_chunk, &max_wdf_in_chunk);
+    max_weight_in_chunk = -1.0;
     read_wdf(&pos, end, &wdf);
+    Xapian::QueryStats::Internal * stats = get_query_stats();
+    if (stats) ++stats->postings_decoded;
 }
 
 PositionList *
@@ -825,11 +965,28 @@ BrassPostList::open_position_list() const
     RETURN(new BrassPositionList(&this_db->position_table, did, term));
 }
 
+void
+BrassPostList::skip_low_weight_chunks(double w_min)
+{
+    LOGCALL_VOID(DB, "BrassPostList::skip_low_weight_chunks", w_min);
+    // The doclen list (which the all documents postlist uses) stores the
+    // document lengths in place of wdfs, so the maximum doesn't apply.
+    if (!weight || term.empty()) return;
+    while (!is_at_end) {
+	if (max_weight_in_chunk < 0.0)
+	    max_weight_in_chunk = weight->get_maxpart_for_wdf_(max_wdf_in_chunk);
+	if (max_weight_in_chunk >= w_min) return;
+	LOGLINE(DB, "Skipping chunk with max weight " << max_weight_in_chunk);
+	pos = end;
+	did = last_did_in_chunk;
+	next_chunk();
+    }
+}
+
 PostList *
 BrassPostList::next(double w_min)
 {
     LOGCALL(DB, PostList *, "BrassPostList::next", w_min);
-    (void)w_min; // no warning
 
     if (!have_started) {
 	have_started = true;
@@ -837,6 +994,8 @@ BrassPostList::next(double w_min)
 	if (!next_in_chunk()) next_chunk();
     }
 
+    if (w_min > 0.0) skip_low_weight_chunks(w_min);
+
     if (is_at_end) {
 	LOGLINE(DB, "Moved to end");
     } else {
@@ -897,8 +1056,11 @@ BrassPostList::move_to_chunk_containing(Xapian::docid desired_did)
 
     first_did_in_chunk = did;
     last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
-					    &is_last_chunk);
+					    &is_last_chunk, &max_wdf_in_chunk);
+    max_weight_in_chunk = -1.0;
     read_wdf(&pos, end, &wdf);
+    Xapian::QueryStats::Internal * stats = get_query_stats();
+    if (stats) ++stats->postings_decoded;
 
     // Possible, since desired_did might be after end of this chunk and before
     // the next.
@@ -913,10 +1075,14 @@ BrassPostList::move_forward_in_chunk_to_at_least(Xapian::docid desired_did)
 	RETURN(true);
 
     if (desired_did <= last_did_in_chunk) {
+	unsigned long decoded = 0;
 	while (pos != end) {
+	    ++decoded;
 	    read_did_increase(&pos, end, &did);
 	    if (did >= desired_did) {
 		read_wdf(&pos, end, &wdf);
+		Xapian::QueryStats::Internal * stats = get_query_stats();
+		if (stats) stats->postings_decoded += decoded;
 		RETURN(true);
 	    }
 	    // It's faster to just skip over the wdf than to decode it.
@@ -935,11 +1101,13 @@ PostList *
 BrassPostList::skip_to(Xapian::docid desired_did, double w_min)
 {
     LOGCALL(DB, PostList *, "BrassPostList::skip_to", desired_did | w_min);
-    (void)w_min; // no warning
     // We've started now - if we hadn't already, we're already positioned
     // at start so there's no need to actually do anything.
     have_started = true;
 
+    Xapian::QueryStats::Internal * stats = get_query_stats();
+    if (stats) ++stats->skip_to_calls;
+
     // Don't skip back, and don't need to do anything if already there.
     if (is_at_end || desired_did <= did) RETURN(NULL);
 
@@ -956,6 +1124,8 @@ BrassPostList::skip_to(Xapian::docid desired_did, double w_min)
     (void)have_document;
     Assert(have_document);
 
+    if (w_min > 0.0) skip_low_weight_chunks(w_min);
+
     if (is_at_end) {
 	LOGLINE(DB, "Skipped to end");
     } else {
@@ -1055,19 +1225,25 @@ BrassPostListTable::get_chunk(const string &tname,
     }
 
     bool is_last_chunk;
+    Xapian::termcount max_wdf;
     Xapian::docid last_did_in_chunk;
-    last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk, &is_last_chunk);
+    last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
+					    &is_last_chunk, &max_wdf);
     *to = new PostlistChunkWriter(cursor->current_key, is_first_chunk, tname,
 				  is_last_chunk);
+    // Strip the header and hand over the encoded entries, which avoids
+    // copying them.
+    string & data = cursor->current_tag;
+    data.erase(0, pos - data.data());
     if (did > last_did_in_chunk) {
 	// This is the shortcut.  Not very pretty, but I'll leave refactoring
 	// until I've a clearer picture of everything which needs to be done.
 	// (FIXME)
 	*from = NULL;
-	(*to)->raw_append(first_did_in_chunk, last_did_in_chunk,
-			  string(pos, end));
+	(*to)->raw_append(first_did_in_chunk, last_did_in_chunk, max_wdf, data);
     } else {
-	*from = new PostlistChunkReader(first_did_in_chunk, string(pos, end));
+	*from = new PostlistChunkReader(first_did_in_chunk, last_did_in_chunk,
+					max_wdf, data);
     }
     if (is_last_chunk) RETURN(Xapian::docid(-1));
 
@@ -1106,7 +1282,7 @@ BrassPostListTable::merge_doclen_changes(const map<Xapian::docid, Xapian::termco
     if (!key_exists(current_key)) {
 	LOGLINE(DB, "Adding dummy first chunk");
 	string newtag = make_start_of_first_chunk(0, 0, 0);
-	newtag += make_start_of_chunk(true, 0, 0);
+	newtag += make_start_of_chunk(true, 0, 0, 0);
 	add(current_key, newtag);
     }
 
@@ -1124,7 +1300,10 @@ BrassPostListTable::merge_doclen_changes(const map<Xapian::docid, Xapian::termco
 
 next_doclen_chunk:
 	LOGLINE(DB, "Updating doclens, did=" << did);
-	if (from) while (!from->is_at_end()) {
+	if (from && from->get_last_did() < did) {
+	    // None of the rest of this chunk is changing.
+	    to->append(this, *from);
+	} else if (from) while (!from->is_at_end()) {
 	    Xapian::docid copy_did = from->get_docid();
 	    if (copy_did >= did) {
 		if (copy_did == did) from->next();
@@ -1148,10 +1327,7 @@ next_doclen_chunk:
     }
 
     if (from) {
-	while (!from->is_at_end()) {
-	    to->append(this, from->get_docid(), from->get_wdf());
-	    from->next();
-	}
+	to->append(this, *from);
 	delete from;
     }
     to->flush(this);
@@ -1161,6 +1337,26 @@ next_doclen_chunk:
 void
 BrassPostListTable::merge_changes(const string &term,
 				  const Inverter::PostingChanges & changes)
+{
+    merge_postings(term, changes.get_tfdelta(), changes.get_cfdelta(),
+		   changes.pl_changes.begin(), changes.pl_changes.end());
+}
+
+void
+BrassPostListTable::merge_changes(const string &term,
+				  Xapian::termcount_diff cf_delta,
+				  const vector<pair<Xapian::docid, Xapian::termcount> > & postings)
+{
+    merge_postings(term, postings.size(), cf_delta,
+		   postings.begin(), postings.end());
+}
+
+template<typename I>
+void
+BrassPostListTable::merge_postings(const string &term,
+				   Xapian::termcount_diff tf_delta,
+				   Xapian::termcount_diff cf_delta,
+				   I first, I last)
 {
     {
 	// Rewrite the first chunk of this posting list with the updated
@@ -1176,20 +1372,23 @@ BrassPostListTable::merge_changes(const string &term,
 	Xapian::termcount collfreq;
 	Xapian::docid firstdid, lastdid;
 	bool islast;
+	Xapian::termcount max_wdf;
 	if (pos == end) {
 	    termfreq = 0;
 	    collfreq = 0;
 	    firstdid = 0;
 	    lastdid = 0;
 	    islast = true;
+	    max_wdf = 0;
 	} else {
 	    firstdid = read_start_of_first_chunk(&pos, end,
 						 &termfreq, &collfreq);
 	    // Handle the generic start of chunk header.
-	    lastdid = read_start_of_chunk(&pos, end, firstdid, &islast);
+	    lastdid = read_start_of_chunk(&pos, end, firstdid, &islast,
+					  &max_wdf);
 	}
 
-	termfreq += changes.get_tfdelta();
+	termfreq += tf_delta;
 	if (termfreq == 0) {
 	    // All postings deleted!  So we can shortcut by zapping the
 	    // posting list.
@@ -1209,11 +1408,11 @@ BrassPostListTable::merge_changes(const string &term,
 	    }
 	    return;
 	}
-	collfreq += changes.get_cfdelta();
+	collfreq += cf_delta;
 
 	// Rewrite start of first chunk to update termfreq and collfreq.
 	string newhdr = make_start_of_first_chunk(termfreq, collfreq, firstdid);
-	newhdr += make_start_of_chunk(islast, firstdid, lastdid);
+	newhdr += make_start_of_chunk(islast, firstdid, lastdid, max_wdf);
 	if (pos == end) {
 	    add(current_key, newhdr);
 	} else {
@@ -1222,20 +1421,22 @@ BrassPostListTable::merge_changes(const string &term,
 	    add(current_key, tag);
 	}
     }
-    map<Xapian::docid, Xapian::termcount>::const_iterator j;
-    j = changes.pl_changes.begin();
-    Assert(j != changes.pl_changes.end()); // This case is caught above.
+    I j = first;
+    Assert(j != last); // This case is caught above.
 
     Xapian::docid max_did;
     PostlistChunkReader *from;
     PostlistChunkWriter *to;
     max_did = get_chunk(term, j->first, false, &from, &to);
-    for ( ; j != changes.pl_changes.end(); ++j) {
+    for ( ; j != last; ++j) {
 	Xapian::docid did = j->first;
 
 next_chunk:
 	LOGLINE(DB, "Updating term=" << term << ", did=" << did);
-	if (from) while (!from->is_at_end()) {
+	if (from && from->get_last_did() < did) {
+	    // None of the rest of this chunk is changing.
+	    to->append(this, *from);
+	} else if (from) while (!from->is_at_end()) {
 	    Xapian::docid copy_did = from->get_docid();
 	    if (copy_did >= did) {
 		if (copy_did == did) {
@@ -1261,10 +1462,7 @@ next_chunk:
     }
 
     if (from) {
-	while (!from->is_at_end()) {
-	    to->append(this, from->get_docid(), from->get_wdf());
-	    from->next();
-	}
+	to->append(this, *from);
 	delete from;
     }
     to->flush(this);
@@ -36,6 +36,8 @@
 #include "autoptr.h"
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 using namespace std;
 
@@ -79,9 +81,29 @@ class BrassPostListTable : public BrassTable {
 	/// Merge changes for a term.
 	void merge_changes(const string &term, const Inverter::PostingChanges & changes);
 
+	/** Merge postings for a term from newly added documents.
+	 *
+	 *  @param term	     The term.
+	 *  @param cf_delta  The total wdf of the postings.
+	 *  @param postings  The (docid, wdf) pairs, in ascending docid order.
+	 */
+	void merge_changes(const string &term, Xapian::termcount_diff cf_delta,
+			   const vector<pair<Xapian::docid, Xapian::termcount> > & postings);
+
 	/// Merge document length changes.
 	void merge_doclen_changes(const map<Xapian::docid, Xapian::termcount> & doclens);
 
+	/** Merge changes to a term's postlist.
+	 *
+	 *  @a first and @a last are iterators over (docid, wdf) pairs in
+	 *  ascending docid order - a wdf of DELETED_POSTING removes the posting.
+	 */
+	template<typename I>
+	void merge_postings(const string &term,
+			    Xapian::termcount_diff tf_delta,
+			    Xapian::termcount_diff cf_delta,
+			    I first, I last);
+
 	Xapian::docid get_chunk(const string &tname,
 		Xapian::docid did, bool adding,
 		Brass::PostlistChunkReader ** from,
@@ -167,6 +189,15 @@ class BrassPostList : public LeafPostList {
 	/// The number of entries in the posting list.
 	Xapian::doccount number_of_entries;
 
+	/// The largest wdf in the current chunk.
+	Xapian::termcount max_wdf_in_chunk;
+
+	/** Upper bound on the weight of any entry in the current chunk.
+	 *
+	 *  This is calculated when first needed - until then it is negative.
+	 */
+	double max_weight_in_chunk;
+
 	/// Copying is not allowed.
 	BrassPostList(const BrassPostList &);
 
@@ -218,6 +249,21 @@ class BrassPostList : public LeafPostList {
 	 */
 	bool move_forward_in_chunk_to_at_least(Xapian::docid desired_did);
 
+	/** Skip any chunks in which no entry can have a weight >= w_min.
+	 *
+	 *  If the current chunk can contain such an entry, this does nothing.
+	 *  Otherwise it moves to the first entry of the next chunk which can,
+	 *  or to the end of the postlist.
+	 */
+	void skip_low_weight_chunks(double w_min);
+
+	/** Return the object to count the work done in, or NULL.
+	 *
+	 *  This is set when the postlist is opened for a match, and carried
+	 *  over to postlists opened with open_nearby_postlist().
+	 */
+	Xapian::QueryStats::Internal * get_query_stats() const;
+
 	BrassPostList(Xapian::Internal::intrusive_ptr<const BrassDatabase> this_db_,
 		      const string & term,
 		      BrassCursor * cursor_);
@@ -225,10 +271,15 @@ class BrassPostList : public LeafPostList {
 	void init();
 
     public:
-	/// Default constructor.
+	/** Default constructor.
+	 *
+	 *  @param query_stats	Where to count the blocks read and postings
+	 *			decoded, or NULL.
+	 */
 	BrassPostList(Xapian::Internal::intrusive_ptr<const BrassDatabase> this_db_,
 		      const string & term,
-		      bool keep_reference);
+		      bool keep_reference,
+		      Xapian::QueryStats::Internal * query_stats = NULL);
 
 	/// Destructor.
 	~BrassPostList();
@@ -24,12 +24,15 @@
 #include "brass_record.h"
 
 #include <xapian/error.h>
+#include "autoptr.h"
+#include "brass_cursor.h"
 #include "debuglog.h"
 #include "omassert.h"
 #include "pack.h"
 #include "str.h"
 
 using std::string;
+using std::vector;
 
 inline string
 make_key(Xapian::docid did)
@@ -52,6 +55,27 @@ BrassRecordTable::get_record(Xapian::docid did) const
     RETURN(tag);
 }
 
+void
+BrassRecordTable::get_records(const vector<Xapian::docid> & dids,
+			      vector<string> & records) const
+{
+    LOGCALL_VOID(DB, "BrassRecordTable::get_records", dids | records);
+    if (dids.empty()) return;
+    AutoPtr<BrassCursor> cursor(cursor_get());
+    vector<Xapian::docid>::const_iterator i;
+    for (i = dids.begin(); i != dids.end(); ++i) {
+	AssertRel(*i,!=,0);
+	// The cursor keeps the blocks it last used, so looking up docids in
+	// ascending order mostly avoids reading blocks again.
+	if (!cursor.get() || !cursor->find_entry(make_key(*i))) {
+	    throw Xapian::DocNotFoundError("Document " + str(*i) + " not found.");
+	}
+	cursor->read_tag();
+	records.push_back(string());
+	swap(records.back(), cursor->current_tag);
+    }
+}
+
 Xapian::doccount
 BrassRecordTable::get_doccount() const
 {   
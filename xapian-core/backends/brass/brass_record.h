@@ -25,6 +25,7 @@
 #define OM_HGUARD_BRASS_RECORD_H
 
 #include <string>
+#include <vector>
 
 #include <xapian/types.h>
 #include "brass_types.h"
@@ -55,6 +56,17 @@ class BrassRecordTable : public BrassTable {
 	 */
 	string get_record(Xapian::docid did) const;
 
+	/** Retrieve several documents from the table.
+	 *
+	 *  This walks the table with a single cursor, so is cheaper than
+	 *  calling get_record() for each document.
+	 *
+	 *  @param dids	    The document ids, in ascending order.
+	 *  @param records  The records are appended to this, in the same order.
+	 */
+	void get_records(const vector<Xapian::docid> & dids,
+			 vector<string> & records) const;
+
 	/** Get the number of records in the table.
 	 */
 	Xapian::doccount get_doccount() const;
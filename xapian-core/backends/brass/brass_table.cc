@@ -35,11 +35,15 @@
 #include "stringutils.h" // For STRINGIZE().
 
 #include <sys/types.h>
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+#endif
 
 #include <cstdio>    /* for rename */
 #include <cstring>   /* for memmove */
 #include <climits>   /* for CHAR_BIT */
 
+#include "brass_blockcache.h"
 #include "brass_btreebase.h"
 #include "brass_changes.h"
 #include "brass_cursor.h"
@@ -49,6 +53,8 @@
 #include "io_utils.h"
 #include "omassert.h"
 #include "pack.h"
+#include "safefcntl.h"
+#include "safesysstat.h"
 #include "unaligned.h"
 
 #include <algorithm>  // for std::min()
@@ -153,9 +159,30 @@ static inline byte *zeroed_new(size_t size)
 
 #define BYTE_PAIR_RANGE (1 << 2 * CHAR_BIT)
 
-/// read_block(n, p) reads block n of the DB file to address p.
+/// The size of the buffer used to collect consecutive blocks to write.
+const unsigned WRITE_BUF_SIZE = 256 * 1024;
+
+/// Check the directory end of block n at p is sane.
+static void
+check_dir_end(uint4 n, const byte * p, unsigned block_size)
+{
+    if (GET_LEVEL(p) != LEVEL_FREELIST) {
+	int dir_end = DIR_END(p);
+	if (rare(dir_end < DIR_START || unsigned(dir_end) > block_size)) {
+	    string msg("dir_end invalid in block ");
+	    msg += str(n);
+	    throw Xapian::DatabaseCorruptError(msg);
+	}
+    }
+}
+
+/** read_block(n, p) reads block n of the DB file to address p.
+ *
+ *  If @a stats is non-NULL, the read is counted in it.
+ */
 void
-BrassTable::read_block(uint4 n, byte * p) const
+BrassTable::read_block(uint4 n, byte * p,
+		       Xapian::QueryStats::Internal * stats) const
 {
     // Log the value of p, not the contents of the block it points to...
     LOGCALL_VOID(DB, "BrassTable::read_block", n | (void*)p);
@@ -163,18 +190,123 @@ BrassTable::read_block(uint4 n, byte * p) const
 	BrassTable::throw_database_closed();
     AssertRel(n,<,base.get_first_unused_block());
 
+    if (n - write_buf_first < write_buf_count) {
+	// The block hasn't been written out yet.
+	memcpy(p, write_buf + size_t(n - write_buf_first) * block_size,
+	       block_size);
+	return;
+    }
+
+    if (stats) ++stats->blocks_read[stats_table];
+
+    if (cache_table_id) {
+	BrassBlockCache & cache = BrassBlockCache::get_instance();
+	if (cache.read(cache_table_id, revision_number, n, p, block_size)) {
+	    if (stats) ++stats->block_cache_hits[stats_table];
+	    return;
+	}
+    }
+
     io_read_block(handle, reinterpret_cast<char *>(p), block_size, n);
+    check_dir_end(n, p, block_size);
 
-    if (GET_LEVEL(p) != LEVEL_FREELIST) {
-	int dir_end = DIR_END(p);
-	if (rare(dir_end < DIR_START || unsigned(dir_end) > block_size)) {
-	    string msg("dir_end invalid in block ");
-	    msg += str(n);
-	    throw Xapian::DatabaseCorruptError(msg);
+    // Don't cache a block which has been overwritten since the revision
+    // we're reading - the caller will notice this and throw
+    // DatabaseModifiedError.
+    if (cache_table_id && REVISION(p) <= revision_number) {
+	BrassBlockCache & cache = BrassBlockCache::get_instance();
+	cache.add(cache_table_id, revision_number, n, p, block_size);
+    }
+}
+
+/** read_block(n, cursor) loads block n of the DB file into cursor.
+ *
+ *  If the DB file is memory mapped, the cursor is pointed at the block in the
+ *  mapping, otherwise the block is read into the cursor's buffer.  The read is
+ *  counted in the cursor's query_stats, if set.
+ *
+ *  Returns a pointer to the block.
+ */
+const byte *
+BrassTable::read_block(uint4 n, Brass::Cursor & cursor) const
+{
+#ifdef HAVE_MMAP
+    if (mapping && (size_t(n) + 1) * block_size <= mapping->size &&
+	n - write_buf_first >= write_buf_count) {
+	if (rare(handle == -2))
+	    BrassTable::throw_database_closed();
+	AssertRel(n,<,base.get_first_unused_block());
+	const byte * p = mapping->p + size_t(n) * block_size;
+	check_dir_end(n, p, block_size);
+	cursor.set_mapped(p, n, mapping);
+	if (cursor.query_stats) ++cursor.query_stats->blocks_read[stats_table];
+	return p;
+    }
+#endif
+    byte * p = cursor.init(block_size);
+    read_block(n, p, cursor.query_stats);
+    cursor.set_n(n);
+    return p;
+}
+
+/// Memory map the DB file, if it isn't already.
+void
+BrassTable::map_file()
+{
+    LOGCALL_VOID(DB, "BrassTable::map_file", NO_ARGS);
+#ifdef HAVE_MMAP
+    struct stat statbuf;
+    if (fstat(handle, &statbuf) < 0) {
+	string message("Couldn't stat ");
+	message += name;
+	message += "DB: ";
+	message += strerror(errno);
+	throw Xapian::DatabaseOpeningError(message);
+    }
+    size_t size = statbuf.st_size;
+    if (mapping) {
+	if (statbuf.st_dev == mapping_dev && statbuf.st_ino == mapping_ino &&
+	    size == mapping->size) {
+	    // The file is unchanged, so keep using the current mapping.
+	    return;
 	}
+	// Cursors may still point into the old mapping, in which case it
+	// stays mapped until they've all moved on.
+	mapping->release();
+	mapping = NULL;
+    }
+    // If the file is too large to map in our address space, or the mapping
+    // fails, we just read blocks as usual.
+    if (size == 0 || off_t(size) != statbuf.st_size) return;
+    void * p = mmap(NULL, size, PROT_READ, MAP_SHARED, handle, 0);
+    if (p == MAP_FAILED) return;
+    mapping = new Brass::Mapping(static_cast<const byte *>(p), size);
+    mapping_dev = statbuf.st_dev;
+    mapping_ino = statbuf.st_ino;
+#endif
+}
+
+/** Release the table's memory mapping of the DB file.
+ *
+ *  The file is unmapped once no cursors point into it.
+ */
+void
+BrassTable::unmap_files()
+{
+    LOGCALL_VOID(DB, "BrassTable::unmap_files", NO_ARGS);
+    if (mapping) {
+	mapping->release();
+	mapping = NULL;
     }
 }
 
+Brass::Mapping::~Mapping()
+{
+#ifdef HAVE_MMAP
+    (void)munmap(const_cast<byte *>(p), size);
+#endif
+}
+
 /** write_block(n, p, appending) writes block n in the DB file from address p.
  *
  *  If appending is false (the default if not specified), then we check to see
@@ -228,7 +360,23 @@ BrassTable::write_block(uint4 n, const byte * p, bool appending) const
 	latest_revision_number = revision_number;
     } // FIXME: replicate removal of old bases?
 
-    io_write_block(handle, p, block_size, n);
+    uint4 write_buf_max = WRITE_BUF_SIZE / block_size;
+    if (n - write_buf_first < write_buf_count) {
+	// Replace a block we haven't written out yet.
+	memcpy(write_buf + size_t(n - write_buf_first) * block_size, p,
+	       block_size);
+    } else {
+	if (write_buf_count &&
+	    (n != write_buf_first + write_buf_count ||
+	     write_buf_count == write_buf_max)) {
+	    flush_write_buf();
+	}
+	if (!write_buf) write_buf = new byte[WRITE_BUF_SIZE];
+	if (write_buf_count == 0) write_buf_first = n;
+	memcpy(write_buf + size_t(write_buf_count) * block_size, p,
+	       block_size);
+	++write_buf_count;
+    }
 
     if (!changes_obj) return;
 
@@ -275,6 +423,45 @@ BrassTable::write_block(uint4 n, const byte * p, bool appending) const
     changes_obj->write_block(reinterpret_cast<const char *>(p), block_size);
 }
 
+void
+BrassTable::read_ahead(uint4 n) const
+{
+#ifdef HAVE_POSIX_FADVISE
+    if (readahead_blocks == 0 || handle < 0) return;
+
+    // Only ask for more once we've used up half of what we asked for last
+    // time, unless we've moved somewhere else in the file.
+    uint4 start = n;
+    if (readahead_end > n && readahead_end - n <= readahead_blocks) {
+	if (readahead_end - n > readahead_blocks / 2) return;
+	start = readahead_end;
+    }
+
+    uint4 end = base.get_first_unused_block();
+    if (end - n > readahead_blocks) end = n + readahead_blocks;
+    if (start >= end) return;
+
+    (void)posix_fadvise(handle, off_t(start) * block_size,
+			off_t(end - start) * block_size,
+			POSIX_FADV_WILLNEED);
+    readahead_end = end;
+#else
+    (void)n;
+#endif
+}
+
+void
+BrassTable::flush_write_buf() const
+{
+    LOGCALL_VOID(DB, "BrassTable::flush_write_buf", NO_ARGS);
+    if (write_buf_count == 0) return;
+    // Empty the buffer first, so we don't try to write it again if there's
+    // an error.
+    uint4 count = write_buf_count;
+    write_buf_count = 0;
+    io_write_blocks(handle, write_buf, block_size, write_buf_first, count);
+}
+
 /* A note on cursors:
 
    Each B-tree level has a corresponding array element C[j] in a
@@ -335,10 +522,7 @@ BrassTable::block_to_cursor(Brass::Cursor * C_, int j, uint4 n) const
     if (n == C[j].get_n()) {
 	p = C_[j].clone(C[j]);
     } else {
-	byte * q = C_[j].init(block_size);
-	read_block(n, q);
-	p = q;
-	C_[j].set_n(n);
+	p = read_block(n, C_[j]);
     }
 
     if (j < level) {
@@ -694,6 +878,7 @@ BrassTable::add_item(Item_wr kt_, int j)
     uint4 n;
 
     int needed = kt_.size() + D2;
+    bool seq = (seq_count >= 0 || sorted_append);
     if (TOTAL_FREE(p) < needed) {
 	int m;
 	// Prepare to split p. After splitting, the block is in two halves, the
@@ -701,7 +886,7 @@ BrassTable::add_item(Item_wr kt_, int j)
 	// becomes true when the item gets added to p, false when it gets added
 	// to split_p.
 
-	if (seq_count < 0) {
+	if (!seq) {
 	    // If we're not in sequential mode, we split at the mid point
 	    // of the node.
 	    m = mid_point(p);
@@ -727,7 +912,7 @@ BrassTable::add_item(Item_wr kt_, int j)
 	compact(p);      /* to reset TOTAL_FREE, MAX_FREE */
 
 	bool add_to_upper_half;
-	if (seq_count < 0) {
+	if (!seq) {
 	    add_to_upper_half = (c >= m);
 	} else {
 	    // And add item to lower half if split_p has room, otherwise upper
@@ -737,7 +922,7 @@ BrassTable::add_item(Item_wr kt_, int j)
 
 	if (add_to_upper_half) {
 	    c -= (m - DIR_START);
-	    Assert(seq_count < 0 || c <= DIR_START + D2);
+	    Assert(!seq || c <= DIR_START + D2);
 	    Assert(c >= DIR_START);
 	    Assert(c <= DIR_END(p));
 	    add_item_to_block(p, kt_, c);
@@ -1270,6 +1455,25 @@ BrassTable::set_full_compaction(bool parity)
     full_compaction = parity;
 }
 
+void
+BrassTable::set_uuid(const string & uuid)
+{
+    LOGCALL_VOID(DB, "BrassTable::set_uuid", uuid);
+    release_cache_table_id();
+    BrassBlockCache & cache = BrassBlockCache::get_instance();
+    if (writable || !cache.enabled()) return;
+    cache_table_id = cache.get_table_id(uuid, name);
+}
+
+void
+BrassTable::release_cache_table_id()
+{
+    if (cache_table_id) {
+	BrassBlockCache::get_instance().release_table_id(cache_table_id);
+	cache_table_id = 0;
+    }
+}
+
 BrassCursor * BrassTable::cursor_get() const {
     LOGCALL(DB, BrassCursor *, "BrassTable::cursor_get", NO_ARGS);
     if (handle < 0) {
@@ -1378,6 +1582,7 @@ BrassTable::basic_open(bool revision_supplied, brass_revision_number_t revision_
 	 * object in the vector, since it'll be destroyed anyway soon.
 	 */
 	base.swap(*basep);
+	base.release_freed_blocks();
 
 	revision_number =  base.get_revision();
 	block_size =       base.get_block_size();
@@ -1531,11 +1736,24 @@ BrassTable::BrassTable(const char * tablename_, const string & path_,
 	  max_item_size(0),
 	  Btree_modified(false),
 	  full_compaction(false),
+	  sorted_append(false),
 	  writable(!readonly_),
 	  cursor_created_since_last_modification(false),
 	  cursor_version(0),
 	  changes_obj(NULL),
+	  cache_table_id(0),
+	  stats_table(Xapian::QueryStats::Internal::get_table_id(tablename_)),
+	  mapping(NULL),
+	  mapping_dev(0),
+	  mapping_ino(0),
 	  split_p(0),
+	  write_buf(0),
+	  write_buf_first(0),
+	  write_buf_count(0),
+	  sync_failed(false),
+	  tmp_base_fd(-1),
+	  readahead_blocks(DEFAULT_READAHEAD_BLOCKS),
+	  readahead_end(0),
 	  compress_strategy(compress_strategy_),
 	  comp_stream(compress_strategy_),
 	  lazy(lazy_)
@@ -1613,20 +1831,28 @@ BrassTable::create_and_open(int flags_, unsigned int block_size_)
 BrassTable::~BrassTable() {
     LOGCALL_DTOR(DB, "BrassTable");
     BrassTable::close();
+    unmap_files();
+    release_cache_table_id();
 }
 
 void BrassTable::close(bool permanent) {
     LOGCALL_VOID(DB, "BrassTable::close", NO_ARGS);
 
+    // Any blocks not yet written out are discarded - they can't be part of
+    // a committed revision.
+    write_buf_count = 0;
+
     if (handle >= 0) {
 	// If an error occurs here, we just ignore it, since we're just
 	// trying to free everything.
 	(void)::close(handle);
 	handle = -1;
     }
+    close_tmp_base();
 
     if (permanent) {
 	handle = -2;
+	release_cache_table_id();
 	// Don't delete the resources in the table, since they may
 	// still be used to look up cached content.
 	return;
@@ -1636,6 +1862,8 @@ void BrassTable::close(bool permanent) {
     }
     delete [] split_p;
     split_p = 0;
+    delete [] write_buf;
+    write_buf = 0;
 
     delete [] kt.get_address();
     kt = 0;
@@ -1643,6 +1871,29 @@ void BrassTable::close(bool permanent) {
     buffer = 0;
 }
 
+void
+BrassTable::close_tmp_base()
+{
+    if (tmp_base_fd >= 0) {
+	(void)::close(tmp_base_fd);
+	tmp_base_fd = -1;
+    }
+}
+
+void
+BrassTable::close_keeping_handle()
+{
+    LOGCALL_VOID(DB, "BrassTable::close_keeping_handle", NO_ARGS);
+    if (writable || handle < 0) {
+	close();
+	return;
+    }
+    int fd = handle;
+    handle = -1;
+    close();
+    handle = fd;
+}
+
 void
 BrassTable::flush_db()
 {
@@ -1660,6 +1911,7 @@ BrassTable::flush_db()
 	    write_block(C[j].get_n(), C[j].get_p());
 	}
     }
+    flush_write_buf();
 
     if (Btree_modified) {
 	faked_root_block = false;
@@ -1670,6 +1922,15 @@ void
 BrassTable::commit(brass_revision_number_t revision)
 {
     LOGCALL_VOID(DB, "BrassTable::commit", revision);
+    start_commit(revision);
+    sync_commit();
+    finish_commit();
+}
+
+void
+BrassTable::start_commit(brass_revision_number_t revision)
+{
+    LOGCALL_VOID(DB, "BrassTable::start_commit", revision);
     Assert(writable);
 
     if (revision <= revision_number) {
@@ -1705,30 +1966,64 @@ BrassTable::commit(brass_revision_number_t revision)
 
 	// Write the freelist into "<table>.DB" first.
 	base.commit(this);
+	flush_write_buf();
 
 	latest_revision_number = revision_number = revision;
 
 	// Save to "<table>.tmp" and then rename to "<table>.base<letter>" so
 	// that a reader can't try to read a partially written base file.
+	// sync_commit() flushes it to disk.
 	string tmp = name;
 	tmp += "tmp";
+	close_tmp_base();
+	base.write_to_file(tmp, base_letter, tablename, changes_obj,
+			   &tmp_base_fd);
+	sync_failed = false;
+    } catch (...) {
+	BrassTable::close();
+	throw;
+    }
+}
+
+void
+BrassTable::sync_commit()
+{
+    LOGCALL_VOID(DB, "BrassTable::sync_commit", NO_ARGS);
+    // This is done as late as possible to allow maximum time for writes to
+    // happen.
+    if (handle < 0 || (flags & Xapian::DB_NO_SYNC)) return;
+
+    if (!io_sync(handle) || tmp_base_fd < 0 || !io_sync(tmp_base_fd))
+	sync_failed = true;
+}
+
+void
+BrassTable::finish_commit()
+{
+    LOGCALL_VOID(DB, "BrassTable::finish_commit", NO_ARGS);
+    if (handle < 0) {
+	if (handle == -2) {
+	    BrassTable::throw_database_closed();
+	}
+	return;
+    }
+
+    try {
+	string tmp = name;
+	tmp += "tmp";
+	// The file must be closed before it can be renamed on some platforms.
+	if (tmp_base_fd >= 0 && ::close(tmp_base_fd) < 0) sync_failed = true;
+	tmp_base_fd = -1;
+	if (sync_failed) {
+	    (void)::close(handle);
+	    handle = -1;
+	    (void)unlink(tmp.c_str());
+	    throw Xapian::DatabaseError("Can't commit new revision - failed to flush DB to disk");
+	}
+
 	string basefile = name;
 	basefile += "base";
 	basefile += char(base_letter);
-	base.write_to_file(tmp, base_letter, tablename, changes_obj);
-
-	// Do this as late as possible to allow maximum time for writes to
-	// happen, and so the calls to io_sync() are adjacent which may be
-	// more efficient, at least with some Linux kernel versions.
-	if ((flags & Xapian::DB_NO_SYNC) == 0) {
-	    if (!io_sync(handle)) {
-		(void)::close(handle);
-		handle = -1;
-		(void)unlink(tmp.c_str());
-		throw Xapian::DatabaseError("Can't commit new revision - failed to flush DB to disk");
-	    }
-	}
-
 	if (posixy_rename(tmp.c_str(), basefile.c_str()) < 0) {
 	    // With NFS, rename() failing may just mean that the server crashed
 	    // after successfully renaming, but before reporting this, and then
@@ -1772,6 +2067,9 @@ BrassTable::cancel()
 
     // This causes problems: if (!Btree_modified) return;
 
+    // Any buffered blocks belong to the revision being abandoned.
+    write_buf_count = 0;
+
     if (flags & Xapian::DB_DANGEROUS)
 	throw Xapian::InvalidOperationError("cancel() not supported under Xapian::DB_DANGEROUS");
 
@@ -1779,6 +2077,7 @@ BrassTable::cancel()
     if (!base.read(name, base_letter, err_msg)) {
 	throw Xapian::DatabaseCorruptError(string("Couldn't reread base ") + base_letter);
     }
+    base.release_freed_blocks();
 
     revision_number =  base.get_revision();
     block_size =       base.get_block_size();
@@ -1812,7 +2111,20 @@ BrassTable::do_open_to_read(bool revision_supplied, brass_revision_number_t revi
     if (handle == -2) {
 	BrassTable::throw_database_closed();
     }
-    handle = ::open((name + "DB").c_str(), O_RDONLY | O_BINARY | O_CLOEXEC);
+    if (handle >= 0) {
+	// We've been reopened - keep using the file we already have open
+	// unless it has been replaced (e.g. by compacting over it).
+	struct stat fd_stat, path_stat;
+	if (fstat(handle, &fd_stat) < 0 ||
+	    stat((name + "DB").c_str(), &path_stat) < 0 ||
+	    fd_stat.st_dev != path_stat.st_dev ||
+	    fd_stat.st_ino != path_stat.st_ino) {
+	    (void)::close(handle);
+	    handle = -1;
+	}
+    }
+    if (handle < 0)
+	handle = ::open((name + "DB").c_str(), O_RDONLY | O_BINARY | O_CLOEXEC);
     if (handle < 0) {
 	if (lazy) {
 	    // This table is optional when reading!
@@ -1839,6 +2151,10 @@ BrassTable::do_open_to_read(bool revision_supplied, brass_revision_number_t revi
 	throw Xapian::DatabaseOpeningError("Failed to open table for reading");
     }
 
+    // The base file has been read, so all the blocks of this revision will
+    // be within the file as it is now.
+    if (flags & Xapian::DB_MMAP) map_file();
+
     for (int j = 0; j <= level; j++) {
 	C[j].init(block_size);
     }
@@ -1852,7 +2168,7 @@ BrassTable::open(int flags_)
 {
     LOGCALL_VOID(DB, "BrassTable::open", flags_);
     LOGLINE(DB, "opening at path " << name);
-    close();
+    close_keeping_handle();
 
     flags = flags_;
 
@@ -1871,7 +2187,7 @@ BrassTable::open(int flags_, brass_revision_number_t revision)
 {
     LOGCALL(DB, bool, "BrassTable::open", flags_|revision);
     LOGLINE(DB, "opening for particular revision at path " << name);
-    close();
+    close_keeping_handle();
 
     flags = flags_;
 
@@ -1927,10 +2243,7 @@ BrassTable::prev_for_sequential(Brass::Cursor * C_, int /*dummy*/) const
 		// Block isn't in the built-in cursor, so the form on disk
 		// is valid, so read it to check if it's the next level 0
 		// block.
-		byte * q = C_[0].init(block_size);
-		read_block(n, q);
-		p = q;
-		C_[0].set_n(n);
+		p = read_block(n, C_[0]);
 	    }
 	    if (writable) AssertEq(revision_number, latest_revision_number);
 	    if (REVISION(p) > revision_number + writable) {
@@ -1957,6 +2270,7 @@ BrassTable::next_for_sequential(Brass::Cursor * C_, int /*dummy*/) const
     Assert((unsigned)c < block_size);
     if (c == DIR_END(p)) {
 	uint4 n = C_[0].get_n();
+	read_ahead(n + 1);
 	while (true) {
 	    n++;
 	    if (n >= base.get_first_unused_block()) RETURN(false);
@@ -1981,13 +2295,11 @@ BrassTable::next_for_sequential(Brass::Cursor * C_, int /*dummy*/) const
 		    // is valid, so read it to check if it's the next level 0
 		    // block.
 		    byte * q = C_[0].init(block_size);
-		    read_block(n, q);
+		    read_block(n, q, C_[0].query_stats);
 		    p = q;
 		}
 	    } else {
-		byte * q = C_[0].init(block_size);
-		read_block(n, q);
-		p = q;
+		p = read_block(n, C_[0]);
 	    }
 	    if (writable) AssertEq(revision_number, latest_revision_number);
 	    if (REVISION(p) > revision_number + writable) {
@@ -36,11 +36,14 @@
 #include "stringutils.h"
 #include "unaligned.h"
 
+#include "api/querystatsinternal.h"
 #include "common/compression_stream.h"
 
 #include <algorithm>
 #include <string>
 
+#include <sys/types.h>
+
 #define DONT_COMPRESS -1
 
 /** Even for items of at maximum size, it must be possible to get this number of
@@ -57,6 +60,9 @@
 // FIXME: This named constant probably isn't used everywhere it should be...
 #define BYTES_PER_BLOCK_NUMBER 4
 
+/// How many blocks to read ahead by default when scanning a sequential table.
+#define DEFAULT_READAHEAD_BLOCKS 16
+
 /*  The B-tree blocks have a number of internal lengths and offsets held in 1, 2
     or 4 bytes. To make the coding a little clearer,
        we use  for
@@ -404,6 +410,34 @@ class BrassTable {
 	 */
 	void commit(brass_revision_number_t revision);
 
+	/** Start committing outstanding changes to the table.
+	 *
+	 *  commit() is equivalent to calling start_commit(), sync_commit()
+	 *  and then finish_commit().  Splitting it up allows the tables of a
+	 *  database to be flushed to disk concurrently.
+	 *
+	 *  This writes the new revision to the DB file and a temporary base
+	 *  file, but doesn't wait for them to reach the disk.
+	 *
+	 *  @param new_revision  As for commit().
+	 */
+	void start_commit(brass_revision_number_t revision);
+
+	/** Wait for the data written by start_commit() to reach the disk.
+	 *
+	 *  This doesn't throw exceptions, and only touches this table's
+	 *  files, so it can be called from another thread - any error is
+	 *  reported by finish_commit().
+	 */
+	void sync_commit();
+
+	/** Finish committing by switching to the new base file.
+	 *
+	 *  If an error occurs here or earlier in the commit, this will be
+	 *  signalled by an exception and the table will be closed.
+	 */
+	void finish_commit();
+
 	/** Cancel any outstanding changes.
 	 *
 	 *  This will discard any modifications which haven't been committed
@@ -527,6 +561,31 @@ class BrassTable {
 
 	void set_full_compaction(bool parity);
 
+	/** Set sorted append mode.
+	 *
+	 *  In this mode the caller promises to add keys in ascending order
+	 *  (as when compacting or merging tables), so blocks are split at the
+	 *  insertion point from the first addition, rather than once a run of
+	 *  sequential additions has been spotted, and so are filled completely.
+	 *  Keys added out of order are still handled correctly, but may leave
+	 *  blocks less full.
+	 */
+	void set_sorted_append() { sorted_append = true; }
+
+	/** Set how far ahead to read when scanning a sequential table.
+	 *
+	 *  When a cursor moving through a table in sequential mode reaches
+	 *  the end of a leaf block, the OS is asked to start reading the
+	 *  next @a blocks blocks, so that a full scan isn't held up by a
+	 *  synchronous read at each block.  This has no effect on platforms
+	 *  without posix_fadvise().
+	 *
+	 *  @param blocks	The number of blocks to read ahead (0 turns off
+	 *			read-ahead).  The default is
+	 *			DEFAULT_READAHEAD_BLOCKS.
+	 */
+	void set_readahead(unsigned blocks) { readahead_blocks = blocks; }
+
 	/** Get the latest revision number stored in this table.
 	 *
 	 *  This gives the higher of the revision numbers held in the base
@@ -605,6 +664,25 @@ class BrassTable {
 	    changes_obj = changes;
 	}
 
+	/** Set the oldest revision pinned by a reader.
+	 *
+	 *  Blocks freed by later revisions won't be reused.  If the table is
+	 *  open and no reader has a revision pinned, @a rev should be
+	 *  uint4(-1).
+	 */
+	void set_oldest_pinned_revision(brass_revision_number_t rev) {
+	    base.set_oldest_pinned_revision(rev);
+	}
+
+	/** Set the UUID of the database this table is part of.
+	 *
+	 *  This is used to identify the table in the process-wide block
+	 *  cache, so blocks read by a read-only table can be shared with
+	 *  other readers of the same database.  It must be called before
+	 *  the table is opened to have any effect.
+	 */
+	void set_uuid(const std::string & uuid);
+
 	/// Throw an exception indicating that the database is closed.
 	XAPIAN_NORETURN(static void throw_database_closed());
 
@@ -616,6 +694,19 @@ class BrassTable {
 	 */
 	bool do_open_to_read(bool revision_supplied, brass_revision_number_t revision_);
 
+	/** Close the table before reopening it.
+	 *
+	 *  If the table is open read-only, the file handle is kept so that
+	 *  do_open_to_read() can reuse it rather than opening the file again.
+	 */
+	void close_keeping_handle();
+
+	/// Close tmp_base_fd if it's open, ignoring any error.
+	void close_tmp_base();
+
+	/// Release cache_table_id (if set) and reset it to 0.
+	void release_cache_table_id();
+
 	/** Perform the opening operation to write.
 	 *
 	 *  Return true iff the open succeeded.
@@ -627,8 +718,24 @@ class BrassTable {
 
 	bool find(Brass::Cursor *) const;
 	int delete_kt();
-	void read_block(uint4 n, byte *p) const;
+	void read_block(uint4 n, byte *p,
+			Xapian::QueryStats::Internal * stats = NULL) const;
+	const byte * read_block(uint4 n, Brass::Cursor & cursor) const;
+	void map_file();
+	void unmap_files();
 	void write_block(uint4 n, const byte *p, bool appending = false) const;
+
+	/** Write out the blocks collected in write_buf.
+	 *
+	 *  Note: this is called from write_block(), so needs to be const.
+	 */
+	void flush_write_buf() const;
+
+	/** Ask the OS to read the blocks after block @a n in advance.
+	 *
+	 *  Used by next_for_sequential().
+	 */
+	void read_ahead(uint4 n) const;
 	XAPIAN_NORETURN(void set_overwritten() const);
 	void block_to_cursor(Brass::Cursor *C_, int j, uint4 n) const;
 	void alter();
@@ -736,6 +843,9 @@ class BrassTable {
 	/// set to true when full compaction is to be achieved
 	bool full_compaction;
 
+	/// True if keys are promised to be added in ascending order.
+	bool sorted_append;
+
 	/// Set to true when the database is opened to write.
 	bool writable;
 
@@ -751,6 +861,28 @@ class BrassTable {
 	 */
 	BrassChanges * changes_obj;
 
+	/** The id of this table in the BrassBlockCache.
+	 *
+	 *  0 means blocks from this table aren't cached.
+	 */
+	unsigned cache_table_id;
+
+	/// Which table block reads are counted against in a QueryStats.
+	Xapian::QueryStats::Internal::table_id stats_table;
+
+	/** Read-only memory mapping of the DB file, or NULL.
+	 *
+	 *  This is only used if the table is opened read-only with DB_MMAP.
+	 *  We hold a reference to it, as do cursors pointing into it.
+	 */
+	Brass::Mapping * mapping;
+
+	/// The device of the file mapping is of.
+	dev_t mapping_dev;
+
+	/// The inode of the file mapping is of.
+	ino_t mapping_ino;
+
 	/* B-tree navigation functions */
 	bool prev(Brass::Cursor *C_, int j) const {
 	    if (sequential) return prev_for_sequential(C_, j);
@@ -786,6 +918,39 @@ class BrassTable {
 	 */
 	byte * split_p;
 
+	/** Blocks which write_block() hasn't passed to the OS yet.
+	 *
+	 *  Blocks with consecutive numbers are collected here, so that a run
+	 *  of them (as written by a sequential addition) can be written with
+	 *  a single system call.
+	 */
+	mutable byte * write_buf;
+
+	/// The number of the first block in write_buf.
+	mutable uint4 write_buf_first;
+
+	/// The number of blocks in write_buf (0 if it's empty).
+	mutable uint4 write_buf_count;
+
+	/// Set if sync_commit() failed.
+	bool sync_failed;
+
+	/** The temporary base file written by start_commit(), or -1.
+	 *
+	 *  It's kept open for sync_commit() to flush, and closed by
+	 *  finish_commit().
+	 */
+	int tmp_base_fd;
+
+	/// How many blocks to read ahead when scanning (0 for none).
+	unsigned readahead_blocks;
+
+	/** The block after the last one read-ahead was requested for.
+	 *
+	 *  This is used to avoid repeatedly requesting the same blocks.
+	 */
+	mutable uint4 readahead_end;
+
 	/** DONT_COMPRESS or Z_DEFAULT_STRATEGY, Z_FILTERED, Z_HUFFMAN_ONLY,
 	 *  Z_RLE. */
 	int compress_strategy;
@@ -67,6 +67,21 @@ BrassValueList::get_value() const
     return reader.get_value();
 }
 
+double
+BrassValueList::get_numeric_value() const
+{
+    Assert(!at_end());
+    return reader.get_numeric_value();
+}
+
+bool
+BrassValueList::get_block_bounds(string & lo, string & hi,
+				 Xapian::docid & last) const
+{
+    Assert(!at_end());
+    return reader.get_bounds(lo, hi, last);
+}
+
 bool
 BrassValueList::at_end() const
 {
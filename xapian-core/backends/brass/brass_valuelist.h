@@ -59,6 +59,11 @@ class BrassValueList : public Xapian::ValueIterator::Internal {
 
     std::string get_value() const;
 
+    double get_numeric_value() const;
+
+    bool get_block_bounds(std::string & lo, std::string & hi,
+			  Xapian::docid & last) const;
+
     bool at_end() const;
 
     void next();
@@ -24,10 +24,12 @@
 #include "brass_values.h"
 
 #include "brass_cursor.h"
+#include "brass_inverter.h"
 #include "brass_postlist.h"
 #include "brass_termlist.h"
 #include "debuglog.h"
 #include "backends/document.h"
+#include "internaltypes.h"
 #include "pack.h"
 
 #include "xapian/error.h"
@@ -35,6 +37,9 @@
 
 #include <algorithm>
 #include "autoptr.h"
+#include <cfloat>
+#include <cmath>
+#include <cstring>
 
 using namespace Brass;
 using namespace std;
@@ -68,16 +73,190 @@ make_valuestats_key(Xapian::valueno slot)
     RETURN(key);
 }
 
+/// Read a big-endian integer of @a width bytes from @a p.
+static inline uint8
+read_fixed(const char * p, size_t width)
+{
+    uint8 v = 0;
+    for (size_t i = 0; i != width; ++i)
+	v = (v << 8) | static_cast<unsigned char>(p[i]);
+    return v;
+}
+
+/// Append @a v to @a s as a big-endian integer of @a width bytes.
+static inline void
+append_fixed(string & s, uint8 v, size_t width)
+{
+    while (width--) {
+	s += char((v >> (width * 8)) & 0xff);
+    }
+}
+
+/// Convert a double to an integer with the same bit pattern.
+static inline uint8
+double_to_bits(double d)
+{
+    uint8 bits;
+    memcpy(&bits, &d, sizeof(bits));
+    return bits;
+}
+
+/// Convert an integer from double_to_bits() back to a double.
+static inline double
+bits_to_double(uint8 bits)
+{
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+/** Can we store values as the bits of a double?
+ *
+ *  This needs a double to be the same size as uint8, and the bits to mean
+ *  the same on every platform which could read the database.
+ */
+static const bool can_store_doubles =
+    (sizeof(double) == sizeof(uint8) && FLT_RADIX == 2 &&
+     DBL_MANT_DIG == 53 && DBL_MAX_EXP == 1024);
+
+/** Integers must be less than this in magnitude to use VALUE_CHUNK_INT.
+ *
+ *  This ensures that the values, and their offsets from the smallest value,
+ *  are all exactly representable as doubles.
+ */
+static const double MAX_CHUNK_INT = 4503599627370496.0; // 2**52
+
+/// Unpack a length and find that many bytes, without copying them.
+static inline bool
+unpack_bound(const char ** p, const char * end,
+	     const char *& ptr, size_t & len)
+{
+    if (!unpack_uint(p, end, &len) || len > size_t(end - *p))
+	return false;
+    ptr = *p;
+    *p += len;
+    return true;
+}
+
 void
 ValueChunkReader::assign(const char * p_, size_t len, Xapian::docid did_)
 {
-    p = p_;
-    end = p_ + len;
     did = did_;
+    lo_ptr = NULL;
+    last_did = 0;
+    end = p_ + len;
+    p = p_;
+    if (len && *p == '\0') {
+	++p;
+	if (p == end)
+	    throw Xapian::DatabaseCorruptError("Value chunk format missing");
+	format = value_chunk_format(static_cast<unsigned char>(*p++));
+	Xapian::docid last_offset;
+	if (!unpack_uint(&p, end, &last_offset) || did + last_offset < did)
+	    throw Xapian::DatabaseCorruptError("Bad value chunk header");
+	last_did = did + last_offset;
+	if (format != VALUE_CHUNK_STRINGS) {
+	    assign_column();
+	    return;
+	}
+	if (!unpack_bound(&p, end, lo_ptr, lo_len) ||
+	    !unpack_bound(&p, end, hi_ptr, hi_len))
+	    throw Xapian::DatabaseCorruptError("Bad value chunk bounds");
+    }
+    format = VALUE_CHUNK_STRINGS;
+    have_value = true;
     if (!unpack_string(&p, end, value))
 	throw Xapian::DatabaseCorruptError("Failed to unpack first value");
 }
 
+void
+ValueChunkReader::assign_column()
+{
+    const char * chunk_end = end;
+    size_t deltas_len;
+    if (!unpack_uint(&p, chunk_end, &deltas_len))
+	throw Xapian::DatabaseCorruptError("Bad value chunk header");
+    switch (format) {
+	case VALUE_CHUNK_FIXED:
+	    if (!unpack_uint(&p, chunk_end, &width) || width == 0 ||
+		width > size_t(chunk_end - p) / 2)
+		throw Xapian::DatabaseCorruptError("Bad value chunk width");
+	    lo_ptr = p;
+	    hi_ptr = p + width;
+	    lo_len = hi_len = width;
+	    p += width * 2;
+	    break;
+	case VALUE_CHUNK_INT: {
+	    uint8 zz, range;
+	    if (!unpack_uint(&p, chunk_end, &zz) ||
+		!unpack_uint(&p, chunk_end, &range))
+		throw Xapian::DatabaseCorruptError("Bad value chunk bounds");
+	    if (zz & 1) {
+		num_min = -double((zz >> 1) + 1);
+	    } else {
+		num_min = double(zz >> 1);
+	    }
+	    num_max = num_min + double(range);
+	    width = 0;
+	    while (range) {
+		++width;
+		range >>= 8;
+	    }
+	    break;
+	}
+	case VALUE_CHUNK_DOUBLE:
+	    if (size_t(chunk_end - p) < 16)
+		throw Xapian::DatabaseCorruptError("Bad value chunk bounds");
+	    num_min = bits_to_double(read_fixed(p, 8));
+	    num_max = bits_to_double(read_fixed(p + 8, 8));
+	    p += 16;
+	    width = 8;
+	    break;
+	default:
+	    throw Xapian::DatabaseCorruptError("Unknown value chunk format");
+    }
+    if (deltas_len > size_t(chunk_end - p))
+	throw Xapian::DatabaseCorruptError("Bad value chunk docid deltas");
+    end = p + deltas_len;
+    vp = end;
+    // There's one more value than there are deltas, and it must fit.
+    if (width > size_t(chunk_end - vp))
+	throw Xapian::DatabaseCorruptError("Value chunk too short");
+    have_value = false;
+    decode_num();
+}
+
+bool
+ValueChunkReader::get_bounds(string & lo, string & hi,
+			     Xapian::docid & last) const
+{
+    if (last_did == 0) {
+	// A chunk without a header.
+	last = did;
+	return false;
+    }
+    last = last_did;
+    if (lo_ptr) {
+	if (hi_len == 0) return false;
+	lo.assign(lo_ptr, lo_len);
+	hi.assign(hi_ptr, hi_len);
+    } else {
+	lo = Xapian::sortable_serialise(num_min);
+	hi = Xapian::sortable_serialise(num_max);
+    }
+    return true;
+}
+
+void
+ValueChunkReader::decode_num()
+{
+    if (format == VALUE_CHUNK_INT) {
+	num = num_min + double(read_fixed(vp, width));
+    } else if (format == VALUE_CHUNK_DOUBLE) {
+	num = bits_to_double(read_fixed(vp, 8));
+    }
+}
+
 void
 ValueChunkReader::next()
 {
@@ -90,6 +269,12 @@ ValueChunkReader::next()
     if (!unpack_uint(&p, end, &delta))
 	throw Xapian::DatabaseCorruptError("Failed to unpack streamed value docid");
     did += delta + 1;
+    if (format != VALUE_CHUNK_STRINGS) {
+	vp += width;
+	have_value = false;
+	decode_num();
+	return;
+    }
     if (!unpack_string(&p, end, value))
 	throw Xapian::DatabaseCorruptError("Failed to unpack streamed value");
 }
@@ -100,6 +285,24 @@ ValueChunkReader::skip_to(Xapian::docid target)
     if (p == NULL || target <= did)
 	return;
 
+    if (format != VALUE_CHUNK_STRINGS) {
+	// Only the docid deltas need to be decoded to find the target.
+	while (p != end) {
+	    Xapian::docid delta;
+	    if (rare(!unpack_uint(&p, end, &delta)))
+		throw Xapian::DatabaseCorruptError("Failed to unpack streamed value docid");
+	    did += delta + 1;
+	    vp += width;
+	    if (did >= target) {
+		have_value = false;
+		decode_num();
+		return;
+	    }
+	}
+	p = NULL;
+	return;
+    }
+
     size_t value_len;
     while (p != end) {
 	// Get the next docid
@@ -129,6 +332,162 @@ ValueChunkReader::skip_to(Xapian::docid target)
     p = NULL;
 }
 
+/** The largest fraction of a chunk worth spending on its bounds.
+ *
+ *  If a few long values make up most of the chunk, storing copies of two of
+ *  them would make it much bigger for little gain.
+ */
+static const size_t MAX_BOUNDS_FRACTION = 4;
+
+/// Add a header with the bounds to a chunk in VALUE_CHUNK_STRINGS format.
+static void
+add_strings_chunk_header(string & chunk, Xapian::docid last_offset,
+			 const string & lo, const string & hi)
+{
+    string result(1, '\0');
+    result += char(VALUE_CHUNK_STRINGS);
+    pack_uint(result, last_offset);
+    if ((lo.size() + hi.size()) * MAX_BOUNDS_FRACTION > chunk.size()) {
+	// Values can't be empty, so empty bounds mean there aren't any.
+	result += '\0';
+	result += '\0';
+    } else {
+	pack_string(result, lo);
+	pack_string(result, hi);
+    }
+    result += chunk;
+    swap(chunk, result);
+}
+
+void
+Brass::encode_value_chunk(string & chunk, Xapian::docid first_did)
+{
+    // Work out which formats the values would fit, and find the bounds.
+    bool fixed = true, numeric = true, integers = true;
+    size_t fixed_width = 0;
+    double lo = 0, hi = 0;
+    string lo_str, hi_str;
+    string deltas;
+    size_t count = 0;
+    ValueChunkReader reader(chunk.data(), chunk.size(), first_did);
+    Xapian::docid prev_did = first_did;
+    for ( ; !reader.at_end(); reader.next()) {
+	const string & value = reader.get_value();
+	Xapian::docid did = reader.get_docid();
+	if (count++) {
+	    pack_uint(deltas, did - prev_did - 1);
+	    prev_did = did;
+	    if (value.size() != fixed_width) fixed = false;
+	    if (value < lo_str) {
+		lo_str = value;
+	    } else if (value > hi_str) {
+		hi_str = value;
+	    }
+	} else {
+	    fixed_width = value.size();
+	    lo_str = hi_str = value;
+	}
+	if (!numeric) continue;
+	double d = Xapian::sortable_unserialise(value);
+	if (Xapian::sortable_serialise(d) != value) {
+	    // Not a number, or not in the canonical form.
+	    numeric = integers = false;
+	    continue;
+	}
+	if (count == 1) {
+	    lo = hi = d;
+	} else if (d < lo) {
+	    lo = d;
+	} else if (d > hi) {
+	    hi = d;
+	}
+	if (integers && (!(fabs(d) < MAX_CHUNK_INT) || d != floor(d)))
+	    integers = false;
+    }
+
+    value_chunk_format format;
+    if (integers) {
+	format = VALUE_CHUNK_INT;
+    } else if (numeric && can_store_doubles) {
+	format = VALUE_CHUNK_DOUBLE;
+    } else if (fixed) {
+	format = VALUE_CHUNK_FIXED;
+    } else {
+	add_strings_chunk_header(chunk, prev_did - first_did, lo_str, hi_str);
+	return;
+    }
+
+    string column(1, '\0');
+    column += char(format);
+    pack_uint(column, prev_did - first_did);
+
+    pack_uint(column, deltas.size());
+    size_t width = 8;
+    uint8 int_min = 0;
+    switch (format) {
+	case VALUE_CHUNK_FIXED:
+	    width = fixed_width;
+	    pack_uint(column, width);
+	    column += lo_str;
+	    column += hi_str;
+	    break;
+	case VALUE_CHUNK_INT: {
+	    // Zigzag encode the smallest value so small negative numbers are
+	    // stored compactly.
+	    if (lo >= 0) {
+		int_min = uint8(lo) << 1;
+	    } else {
+		int_min = ((uint8(-lo) - 1) << 1) | 1;
+	    }
+	    pack_uint(column, int_min);
+	    uint8 range = uint8(hi - lo);
+	    pack_uint(column, range);
+	    width = 0;
+	    while (range) {
+		++width;
+		range >>= 8;
+	    }
+	    break;
+	}
+	case VALUE_CHUNK_DOUBLE:
+	    append_fixed(column, double_to_bits(lo), 8);
+	    append_fixed(column, double_to_bits(hi), 8);
+	    break;
+	default:
+	    Assert(false);
+    }
+    column += deltas;
+
+    for (reader.assign(chunk.data(), chunk.size(), first_did);
+	 !reader.at_end();
+	 reader.next()) {
+	const string & value = reader.get_value();
+	switch (format) {
+	    case VALUE_CHUNK_FIXED:
+		column += value;
+		break;
+	    case VALUE_CHUNK_INT:
+		append_fixed(column,
+			     uint8(Xapian::sortable_unserialise(value) - lo),
+			     width);
+		break;
+	    default:
+		append_fixed(column,
+			     double_to_bits(Xapian::sortable_unserialise(value)),
+			     8);
+		break;
+	}
+    }
+
+    // Only use a fixed width format if it saves space, but the numeric
+    // formats are worth using anyway as they're quicker to read numbers from.
+    if (format == VALUE_CHUNK_FIXED && column.size() >= chunk.size()) {
+	add_strings_chunk_header(chunk, prev_did - first_did, lo_str, hi_str);
+	return;
+    }
+    swap(chunk, column);
+}
+
 void
 BrassValueManager::add_value(Xapian::docid did, Xapian::valueno slot,
 			     const string & val)
@@ -139,6 +498,7 @@ BrassValueManager::add_value(Xapian::docid did, Xapian::valueno slot,
 	i = changes.insert(make_pair(slot, map<Xapian::docid, string>())).first;
     }
     i->second[did] = val;
+    changes_size += val.size() + MAP_NODE_SIZE;
 }
 
 void
@@ -150,6 +510,7 @@ BrassValueManager::remove_value(Xapian::docid did, Xapian::valueno slot)
 	i = changes.insert(make_pair(slot, map<Xapian::docid, string>())).first;
     }
     i->second[did] = string();
+    changes_size += MAP_NODE_SIZE;
 }
 
 Xapian::docid
@@ -235,6 +596,7 @@ class ValueUpdater {
 	    table->del(make_valuechunk_key(slot, first_did));
 	}
 	if (!tag.empty()) {
+	    encode_value_chunk(tag, new_first_did);
 	    table->add(make_valuechunk_key(slot, new_first_did), tag);
 	}
 	first_did = 0;
@@ -354,6 +716,7 @@ BrassValueManager::merge_changes()
 	}
 	changes.clear();
     }
+    changes_size = 0;
 }
 
 void
@@ -403,6 +766,7 @@ BrassValueManager::add_document(Xapian::docid did, const Xapian::Document &doc,
     if (slots_used.empty() && slots.find(did) == slots.end()) {
 	// Adding a new document with no values which we didn't just remove.
     } else {
+	changes_size += slots_used.size() + MAP_NODE_SIZE;
 	swap(slots[did], slots_used);
     }
 }
@@ -420,6 +784,7 @@ BrassValueManager::delete_document(Xapian::docid did,
 	// Get from table, making a swift exit if this document has no values.
 	if (!termlist_table->get_exact_entry(make_slot_key(did), s)) return;
 	slots.insert(make_pair(did, string()));
+	changes_size += MAP_NODE_SIZE;
     }
     const char * p = s.data();
     const char * end = p + s.size();
@@ -521,6 +886,88 @@ BrassValueManager::get_all_values(map<Xapian::valueno, string> & values,
     }
 }
 
+namespace {
+
+/// The value chunk for a slot which BrassValueManager is reading from.
+struct SlotChunk {
+    std::string chunk;
+
+    ValueChunkReader reader;
+};
+
+}
+
+void
+BrassValueManager::get_all_values(const vector<Xapian::docid> & dids,
+				  vector<map<Xapian::valueno, string> > & values) const
+{
+    if (!termlist_table->is_open()) {
+	// Either the database has been closed, or else there's no termlist table.
+	// Check if the postlist table is open to determine which is the case.
+	if (!postlist_table->is_open())
+	    BrassTable::throw_database_closed();
+	throw Xapian::FeatureUnavailableError("Database has no termlist");
+    }
+    AutoPtr<BrassCursor> slots_cursor(termlist_table->cursor_get());
+    map<Xapian::valueno, SlotChunk> chunks;
+    vector<Xapian::docid>::const_iterator d;
+    for (d = dids.begin(); d != dids.end(); ++d) {
+	Xapian::docid did = *d;
+	values.push_back(map<Xapian::valueno, string>());
+	map<Xapian::valueno, string> & doc_values = values.back();
+
+	map<Xapian::docid, string>::const_iterator i = slots.find(did);
+	const string * s;
+	if (i != slots.end()) {
+	    s = &i->second;
+	} else {
+	    // Get from table.
+	    if (!slots_cursor->find_entry(make_slot_key(did))) continue;
+	    slots_cursor->read_tag();
+	    s = &slots_cursor->current_tag;
+	}
+	const char * p = s->data();
+	const char * end = p + s->size();
+	Xapian::valueno prev_slot = static_cast<Xapian::valueno>(-1);
+	while (p != end) {
+	    Xapian::valueno slot;
+	    if (!unpack_uint(&p, end, &slot)) {
+		throw Xapian::DatabaseCorruptError("Value slot encoding corrupt");
+	    }
+	    slot += prev_slot + 1;
+	    prev_slot = slot;
+
+	    map<Xapian::valueno, map<Xapian::docid, string> >::const_iterator j;
+	    j = changes.find(slot);
+	    if (j != changes.end()) {
+		map<Xapian::docid, string>::const_iterator k;
+		k = j->second.find(did);
+		if (k != j->second.end()) {
+		    doc_values.insert(make_pair(slot, k->second));
+		    continue;
+		}
+	    }
+
+	    // The docids are ascending, so we only need to read another chunk
+	    // once we've gone past the end of the one we last read.
+	    SlotChunk & c = chunks[slot];
+	    if (!c.reader.at_end()) c.reader.skip_to(did);
+	    if (c.reader.at_end()) {
+		Xapian::docid first_did;
+		first_did = get_chunk_containing_did(slot, did, c.chunk);
+		if (first_did) {
+		    c.reader.assign(c.chunk.data(), c.chunk.size(), first_did);
+		    c.reader.skip_to(did);
+		}
+	    }
+	    string value;
+	    if (!c.reader.at_end() && c.reader.get_docid() == did)
+		value = c.reader.get_value();
+	    doc_values.insert(make_pair(slot, value));
+	}
+    }
+}
+
 void
 BrassValueManager::get_value_stats(Xapian::valueno slot) const
 {
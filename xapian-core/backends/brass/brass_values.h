@@ -26,11 +26,13 @@
 #include "backends/valuestats.h"
 
 #include "xapian/error.h"
+#include "xapian/queryparser.h" // For sortable_serialise().
 #include "xapian/types.h"
 
 #include "autoptr.h"
 #include <map>
 #include <string>
+#include <vector>
 
 class BrassCursor;
 
@@ -93,6 +95,9 @@ class BrassValueManager {
 
     std::map<Xapian::valueno, std::map<Xapian::docid, std::string> > changes;
 
+    /// Approximate memory used by slots and changes.
+    size_t changes_size;
+
     mutable AutoPtr<BrassCursor> cursor;
 
     void add_value(Xapian::docid did, Xapian::valueno slot,
@@ -115,7 +120,8 @@ class BrassValueManager {
 		      BrassTermListTable * termlist_table_)
 	: mru_slot(Xapian::BAD_VALUENO),
 	  postlist_table(postlist_table_),
-	  termlist_table(termlist_table_) { }
+	  termlist_table(termlist_table_),
+	  changes_size(0) { }
 
     // Merge in batched-up changes.
     void merge_changes();
@@ -134,6 +140,18 @@ class BrassValueManager {
     void get_all_values(std::map<Xapian::valueno, std::string> & values,
 			Xapian::docid did) const;
 
+    /** Get all the values for several documents.
+     *
+     *  Each value chunk is only read once, however many of the documents have
+     *  values in it.
+     *
+     *  @param dids	The document ids, in ascending order.
+     *  @param values	The values for each document are appended to this, in
+     *			the same order.
+     */
+    void get_all_values(const std::vector<Xapian::docid> & dids,
+			std::vector<std::map<Xapian::valueno, std::string> > & values) const;
+
     Xapian::doccount get_value_freq(Xapian::valueno slot) const {
 	if (mru_slot != slot) get_value_stats(slot);
 	return mru_valstats.freq;
@@ -167,22 +185,119 @@ class BrassValueManager {
 	return !changes.empty();
     }
 
+    /// Approximate amount of memory used by the batched-up changes, in bytes.
+    size_t get_memory_used() const { return changes_size; }
+
     void cancel() {
 	// Discard batched-up changes.
 	slots.clear();
 	changes.clear();
+	changes_size = 0;
     }
 };
 
 namespace Brass {
 
+/** Formats for value chunks.
+ *
+ *  A chunk may start with a header, which is a zero byte (which can't start
+ *  a chunk without a header as values can't be empty) followed by the format
+ *  byte and the offset of the last docid in the chunk from the first.  A
+ *  chunk without a header is in VALUE_CHUNK_STRINGS format, but has no
+ *  bounds stored.
+ *
+ *  After the header, a chunk in a format other than VALUE_CHUNK_STRINGS has
+ *  the length of the docid deltas, any parameters for the format, then the
+ *  docid deltas, then the values packed in a fixed number of bytes each.
+ *
+ *  Every format with a header stores the smallest and largest values in
+ *  the chunk (directly, or as numbers for the numeric formats), so a range
+ *  check can accept or reject the whole chunk without reading the values.
+ */
+enum value_chunk_format {
+    /** Each value is stored as a string, interleaved with the docid deltas.
+     *
+     *  After the header are the smallest and largest values (or two empty
+     *  strings if storing them wasn't worthwhile), then the values and
+     *  deltas.
+     */
+    VALUE_CHUNK_STRINGS = 0,
+    /** Values all of the same length.
+     *
+     *  The parameters are the length, then the smallest and largest values.
+     */
+    VALUE_CHUNK_FIXED = 1,
+    /** Integers stored as sortable_serialise() strings.
+     *
+     *  The parameters are the smallest value (zigzag encoded) and the
+     *  difference between the largest and smallest values, and each value
+     *  is stored as its offset from the smallest.
+     */
+    VALUE_CHUNK_INT = 2,
+    /** Other numbers stored as sortable_serialise() strings.
+     *
+     *  The parameters are the smallest and largest values, and each value
+     *  is stored as the 8 bytes of a double.
+     */
+    VALUE_CHUNK_DOUBLE = 3
+};
+
+/** Re-encode a chunk of values in the most suitable format.
+ *
+ *  @param chunk	A chunk in VALUE_CHUNK_STRINGS format, which is
+ *			replaced if a different format is chosen.
+ *  @param first_did	The first docid in the chunk.
+ */
+void encode_value_chunk(std::string & chunk, Xapian::docid first_did);
+
 class ValueChunkReader {
     const char *p;
     const char *end;
 
     Xapian::docid did;
 
-    std::string value;
+    mutable std::string value;
+
+    value_chunk_format format;
+
+    /// Is @a value set for the current entry?  (Always true for strings.)
+    mutable bool have_value;
+
+    /// The current value (for VALUE_CHUNK_FIXED and the numeric formats).
+    const char * vp;
+
+    /// Number of bytes per value, if not VALUE_CHUNK_STRINGS.
+    size_t width;
+
+    /// The current value, for the numeric formats.
+    double num;
+
+    /// The smallest value in the chunk, for the numeric formats.
+    double num_min;
+
+    /// The largest value in the chunk, for the numeric formats.
+    double num_max;
+
+    /// The smallest value in the chunk, or NULL if not stored as a string.
+    const char * lo_ptr;
+
+    /// The largest value in the chunk, if stored as a string.
+    const char * hi_ptr;
+
+    /// The length of the smallest value, if stored as a string.
+    size_t lo_len;
+
+    /// The length of the largest value, if stored as a string.
+    size_t hi_len;
+
+    /// The last docid in the chunk, or 0 if the chunk has no header.
+    Xapian::docid last_did;
+
+    /// Read the rest of a chunk in a format other than VALUE_CHUNK_STRINGS.
+    void assign_column();
+
+    /// Decode the current value, if it's numeric.
+    void decode_num();
 
   public:
     /// Create a ValueChunkReader which is already at_end().
@@ -198,7 +313,58 @@ class ValueChunkReader {
 
     Xapian::docid get_docid() const { return did; }
 
-    const std::string & get_value() const { return value; }
+    const std::string & get_value() const {
+	if (!have_value) {
+	    if (format == VALUE_CHUNK_FIXED) {
+		value.assign(vp, width);
+	    } else {
+		value = Xapian::sortable_serialise(num);
+	    }
+	    have_value = true;
+	}
+	return value;
+    }
+
+    /** Get the current value as a number.
+     *
+     *  This is the same as sortable_unserialise(get_value()), but doesn't
+     *  need to convert via a string if the chunk is in a numeric format.
+     */
+    double get_numeric_value() const {
+	if (format == VALUE_CHUNK_INT || format == VALUE_CHUNK_DOUBLE)
+	    return num;
+	return Xapian::sortable_unserialise(get_value());
+    }
+
+    /// The format of the chunk.
+    value_chunk_format get_format() const { return format; }
+
+    /** Get the bounds on the values in the chunk.
+     *
+     *  Only the numeric formats store these.
+     *
+     *  @return true if the bounds are known.
+     */
+    bool get_numeric_bounds(double & lo, double & hi) const {
+	if (format != VALUE_CHUNK_INT && format != VALUE_CHUNK_DOUBLE)
+	    return false;
+	lo = num_min;
+	hi = num_max;
+	return true;
+    }
+
+    /** Get the bounds on the values in the chunk, and its last docid.
+     *
+     *  @param[out] lo	The smallest value in the chunk.
+     *  @param[out] hi	The largest value in the chunk.
+     *  @param[out] last	The last docid in the chunk, or the current docid
+     *			if that isn't known.  This is set even if false is
+     *			returned.
+     *
+     *  @return true if the bounds are known.
+     */
+    bool get_bounds(std::string & lo, std::string & hi,
+		    Xapian::docid & last) const;
 
     void next();
 
@@ -42,7 +42,10 @@
 using namespace std;
 
 // YYYYMMDDX where X allows multiple format revisions in a day
-#define BRASS_VERSION 201311060
+#define BRASS_VERSION 202610172
+// 202610172 1.3.2 Store the bounds and last docid in each value chunk
+// 202610171 1.3.2 Store value chunks of numbers or fixed length values as columns
+// 202610170 1.3.2 Store the max wdf in each postlist chunk header
 // 201311060 1.3.2 Order position table by term first
 // 201103110 1.2.5 Bump for new max changesets dbstats
 // 200912150 1.1.4 Brass debuts.
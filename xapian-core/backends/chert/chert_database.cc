@@ -848,7 +848,8 @@ ChertDatabase::has_positions() const
 }
 
 LeafPostList *
-ChertDatabase::open_post_list(const string& term) const
+ChertDatabase::open_post_list(const string& term,
+			      Xapian::QueryStats::Internal *) const
 {
     LOGCALL(DB, LeafPostList *, "ChertDatabase::open_post_list", term);
     intrusive_ptr<const ChertDatabase> ptrtothis(this);
@@ -1535,7 +1536,8 @@ ChertWritableDatabase::term_exists(const string & tname) const
 }
 
 LeafPostList *
-ChertWritableDatabase::open_post_list(const string& tname) const
+ChertWritableDatabase::open_post_list(const string& tname,
+				      Xapian::QueryStats::Internal *) const
 {
     LOGCALL(DB, LeafPostList *, "ChertWritableDatabase::open_post_list", tname);
     intrusive_ptr<const ChertWritableDatabase> ptrtothis(this);
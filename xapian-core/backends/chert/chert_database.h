@@ -272,7 +272,8 @@ class ChertDatabase : public Xapian::Database::Internal {
 	bool term_exists(const string & tname) const;
 	bool has_positions() const;
 
-	LeafPostList * open_post_list(const string & tname) const;
+	LeafPostList * open_post_list(const string & tname,
+				      Xapian::QueryStats::Internal * stats) const;
 	ValueList * open_value_list(Xapian::valueno slot) const;
 	Xapian::Document::Internal * open_document(Xapian::docid did, bool lazy) const;
 
@@ -436,7 +437,8 @@ class ChertWritableDatabase : public ChertDatabase {
 	std::string get_value_upper_bound(Xapian::valueno slot) const;
 	bool term_exists(const string & tname) const;
 
-	LeafPostList * open_post_list(const string & tname) const;
+	LeafPostList * open_post_list(const string & tname,
+				      Xapian::QueryStats::Internal * stats) const;
 	ValueList * open_value_list(Xapian::valueno slot) const;
 	TermList * open_allterms(const string & prefix) const;
 
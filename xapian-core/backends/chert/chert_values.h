@@ -157,6 +157,8 @@ class ChertValueManager {
     void reset() {
 	/// Ignore any old cached valuestats.
 	mru_slot = Xapian::BAD_VALUENO;
+	/// And any cursor left positioned in the old revision.
+	cursor.reset();
     }
 
     bool is_modified() const {
@@ -189,7 +189,7 @@ void
 Database::Internal::delete_document(const string & unique_term)
 {
     // Default implementation - overridden for remote databases
-    intrusive_ptr<LeafPostList> pl(open_post_list(unique_term));
+    intrusive_ptr<LeafPostList> pl(open_post_list(unique_term, NULL));
     while (pl->next(), !pl->at_end()) {
 	delete_document(pl->get_docid());
     }
@@ -207,7 +207,7 @@ Database::Internal::replace_document(const string & unique_term,
 				     const Xapian::Document & document)
 {
     // Default implementation - overridden for remote databases
-    intrusive_ptr<LeafPostList> pl(open_post_list(unique_term));
+    intrusive_ptr<LeafPostList> pl(open_post_list(unique_term, NULL));
     pl->next();
     if (pl->at_end()) {
 	return add_document(document);
@@ -220,6 +220,18 @@ Database::Internal::replace_document(const string & unique_term,
     return did;
 }
 
+void
+Database::Internal::set_flush_memory(size_t)
+{
+    // Backends which don't buffer changes don't need to do anything here.
+}
+
+size_t
+Database::Internal::get_buffered_memory() const
+{
+    return 0;
+}
+
 ValueList *
 Database::Internal::open_value_list(Xapian::valueno slot) const
 {
@@ -330,6 +342,16 @@ Database::Internal::reopen()
     return false;
 }
 
+void
+Database::Internal::open_documents(const vector<Xapian::docid> & dids,
+				   vector<Xapian::Document> & docs) const
+{
+    vector<Xapian::docid>::const_iterator i;
+    for (i = dids.begin(); i != dids.end(); ++i) {
+	docs.push_back(Xapian::Document(open_document(*i, false)));
+    }
+}
+
 void
 Database::Internal::request_document(Xapian::docid /*did*/) const
 {
@@ -368,6 +390,12 @@ Database::Internal::invalidate_doc_object(Xapian::Document::Internal *) const
     // Do nothing, by default.
 }
 
+Database::Internal *
+Database::Internal::get_snapshot(size_t) const
+{
+    return NULL;
+}
+
 RemoteDatabase *
 Database::Internal::as_remotedatabase()
 {
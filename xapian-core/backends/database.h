@@ -26,6 +26,7 @@
 #define OM_HGUARD_DATABASE_H
 
 #include <string>
+#include <vector>
 
 #include "internaltypes.h"
 
@@ -34,6 +35,7 @@
 #include <xapian/database.h>
 #include <xapian/document.h>
 #include <xapian/positioniterator.h>
+#include <xapian/querystats.h>
 #include <xapian/termiterator.h>
 #include <xapian/valueiterator.h>
 
@@ -210,6 +212,8 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 *  This is a list of all the documents which contain a given term.
 	 *
 	 *  @param tname  The term whose posting list is being requested.
+	 *  @param stats  Where the posting list should count the work it
+	 *		  does (for backends which support this), or NULL.
 	 *
 	 *  @return       A pointer to the newly created posting list.
 	 *		  If the term doesn't exist, a LeafPostList object
@@ -218,7 +222,8 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 *		  This object must be deleted by the caller after
 	 *                use.
 	 */
-	virtual LeafPostList * open_post_list(const string & tname) const = 0;
+	virtual LeafPostList * open_post_list(const string & tname,
+					      Xapian::QueryStats::Internal * stats) const = 0;
 
 	/** Open a value stream.
 	 *
@@ -286,6 +291,24 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	virtual Xapian::Document::Internal *
 	open_document(Xapian::docid did, bool lazy) const = 0;
 
+	/** Open several documents and load their data and values.
+	 *
+	 *  The default implementation just calls open_document() for each
+	 *  document, but backends can override this to read all the documents
+	 *  in one pass.
+	 *
+	 *  @param dids   The document ids, in ascending order with no
+	 *                duplicates.
+	 *
+	 *  @param docs   The documents are appended to this, in the same
+	 *                order as @a dids.
+	 *
+	 *  @exception Xapian::DocNotFoundError  One of the documents doesn't
+	 *		exist.
+	 */
+	virtual void open_documents(const std::vector<Xapian::docid> & dids,
+				    std::vector<Xapian::Document> & docs) const;
+
 	/** Create a termlist tree from trigrams of @a word.
 	 *
 	 *  You can assume word.size() > 1.
@@ -453,6 +476,23 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	virtual Xapian::docid replace_document(const string & unique_term,
 					       const Xapian::Document & document);
 
+	/** Set the memory buffered changes may use before being flushed.
+	 *
+	 *  See WritableDatabase::set_flush_memory() for more information.
+	 *
+	 *  Backends which don't buffer changes can ignore this, which the
+	 *  default implementation does.
+	 */
+	virtual void set_flush_memory(size_t bytes);
+
+	/** Get the approximate memory used by buffered changes, in bytes.
+	 *
+	 *  See WritableDatabase::get_buffered_memory() for more information.
+	 *
+	 *  The default implementation returns 0.
+	 */
+	virtual size_t get_buffered_memory() const;
+
 	/** Request and later collect a document from the database.
 	 *  Multiple documents can be requested with request_document(),
 	 *  and then collected with collect_document().  Allows the backend
@@ -502,6 +542,22 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 */
 	virtual void invalidate_doc_object(Xapian::Document::Internal * obj) const;
 
+	/** Get another object open on the same revision of this database.
+	 *
+	 *  A database object can't safely be used by several threads at once,
+	 *  so this is used to give each thread matching part of the database
+	 *  an object of its own.  Snapshots are kept for reuse while this
+	 *  object stays open at the same revision.
+	 *
+	 *  @param n	Which snapshot to get - the same object is returned for
+	 *		the same @a n while the revision is unchanged.
+	 *
+	 *  @return	The snapshot, or NULL if this isn't supported (the
+	 *		default implementation) or the revision is no longer
+	 *		available.
+	 */
+	virtual Internal * get_snapshot(size_t n) const;
+
 	//////////////////////////////////////////////////////////////////
 	// Introspection methods:
 	// ======================
@@ -38,6 +38,7 @@
 #include <cstdlib> // For atoi().
 
 #ifdef XAPIAN_HAS_BRASS_BACKEND
+# include "brass/brass_blockcache.h"
 # include "brass/brass_database.h"
 #endif
 #ifdef XAPIAN_HAS_CHERT_BACKEND
@@ -65,8 +66,44 @@ InMemory::open() {
 }
 #endif
 
+#ifdef XAPIAN_HAS_BRASS_BACKEND
+/// Open a brass database read-only, honouring DB_MMAP and DB_PIN_REVISION.
+static Database::Internal *
+open_brass_readonly(const string &path, int flags)
+{
+    BrassDatabase * db;
+    if (flags & DB_MMAP)
+	db = new BrassDatabase(path, DB_READONLY_MMAP_);
+    else
+	db = new BrassDatabase(path);
+    if (flags & DB_PIN_REVISION) {
+	try {
+	    db->pin_revision();
+	} catch (...) {
+	    delete db;
+	    throw;
+	}
+    }
+    return db;
+}
+
+void
+Brass::set_block_cache_size(size_t size)
+{
+    LOGCALL_STATIC_VOID(API, "Brass::set_block_cache_size", size);
+    BrassBlockCache::get_instance().set_max_size(size);
+}
+
+size_t
+Brass::get_block_cache_size()
+{
+    LOGCALL_STATIC(API, size_t, "Brass::get_block_cache_size", NO_ARGS);
+    RETURN(BrassBlockCache::get_instance().get_max_size());
+}
+#endif
+
 static void
-open_stub(Database &db, const string &file)
+open_stub(Database &db, const string &file, int flags)
 {
     // A stub database is a text file with one or more lines of this format:
     // <dbtype> <serialised db object>
@@ -95,7 +132,7 @@ open_stub(Database &db, const string &file)
 
 	if (type == "auto") {
 	    resolve_relative_path(line, file);
-	    db.add_database(Database(line));
+	    db.add_database(Database(line, flags & ~DB_BACKEND_MASK_));
 	    continue;
 	}
 
@@ -110,7 +147,7 @@ open_stub(Database &db, const string &file)
 #ifdef XAPIAN_HAS_BRASS_BACKEND
 	if (type == "brass") {
 	    resolve_relative_path(line, file);
-	    db.add_database(Database(new BrassDatabase(line)));
+	    db.add_database(Database(open_brass_readonly(line, flags)));
 	    continue;
 	}
 #endif
@@ -289,13 +326,13 @@ Database::Database(const string &path, int flags)
 #endif
 	case DB_BACKEND_BRASS:
 #ifdef XAPIAN_HAS_BRASS_BACKEND
-	    internal.push_back(new BrassDatabase(path));
+	    internal.push_back(open_brass_readonly(path, flags));
 	    return;
 #else
 	    throw FeatureUnavailableError("Brass backend disabled");
 #endif
 	case DB_BACKEND_STUB:
-	    open_stub(*this, path);
+	    open_stub(*this, path, flags);
 	    return;
     }
 
@@ -306,7 +343,7 @@ Database::Database(const string &path, int flags)
 
     if (S_ISREG(statbuf.st_mode)) {
 	// The path is a file, so assume it is a stub database file.
-	open_stub(*this, path);
+	open_stub(*this, path, flags);
 	return;
     }
 
@@ -323,7 +360,7 @@ Database::Database(const string &path, int flags)
 
 #ifdef XAPIAN_HAS_BRASS_BACKEND
     if (file_exists(path + "/iambrass")) {
-	internal.push_back(new BrassDatabase(path));
+	internal.push_back(open_brass_readonly(path, flags));
 	return;
     }
 #endif
@@ -332,7 +369,7 @@ Database::Database(const string &path, int flags)
     string stub_file = path;
     stub_file += "/XAPIANDB";
     if (usual(file_exists(stub_file))) {
-	open_stub(*this, stub_file);
+	open_stub(*this, stub_file, flags);
 	return;
     }
 
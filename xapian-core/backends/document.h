@@ -82,6 +82,7 @@ class Xapian::Document::Internal : public Xapian::Internal::intrusive_base {
     private:
 	// Functions for backend to implement
 	virtual string do_get_value(Xapian::valueno /*valueno*/) const { return string(); }
+	virtual double do_get_numeric_value(Xapian::valueno slot) const;
 	virtual void do_get_all_values(map<Xapian::valueno, string> & values_) const {
 	    values_.clear();
 	}
@@ -106,6 +107,12 @@ class Xapian::Document::Internal : public Xapian::Internal::intrusive_base {
 	 */
 	string get_value(Xapian::valueno slot) const;
 
+	/** Get a value as a number.
+	 *
+	 *  This is the same as sortable_unserialise(get_value(slot)).
+	 */
+	double get_numeric_value(Xapian::valueno slot) const;
+
 	/** Set all the values.
 	 *
 	 *  @param values_	The values to set - passed by non-const reference, and
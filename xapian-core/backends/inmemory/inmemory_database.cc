@@ -422,7 +422,8 @@ InMemoryDatabase::close()
 }
 
 LeafPostList *
-InMemoryDatabase::open_post_list(const string & tname) const
+InMemoryDatabase::open_post_list(const string & tname,
+				 Xapian::QueryStats::Internal *) const
 {
     if (closed) InMemoryDatabase::throw_database_closed();
     if (tname.empty()) {
@@ -329,7 +329,8 @@ class InMemoryDatabase : public Xapian::Database::Internal {
     bool term_exists(const string & tname) const;
     bool has_positions() const;
 
-    LeafPostList * open_post_list(const string & tname) const;
+    LeafPostList * open_post_list(const string & tname,
+				  Xapian::QueryStats::Internal * stats) const;
     TermList * open_term_list(Xapian::docid did) const;
     Xapian::Document::Internal * open_document(Xapian::docid did, bool lazy) const;
 
@@ -58,6 +58,8 @@ struct SubValueList {
 
     std::string get_value() const { return valuelist->get_value(); }
 
+    double get_numeric_value() const { return valuelist->get_numeric_value(); }
+
     void next() {
 	valuelist->next();
     }
@@ -121,6 +123,13 @@ MultiValueList::get_value() const
     return valuelists.front()->get_value();
 }
 
+double
+MultiValueList::get_numeric_value() const
+{
+    Assert(!at_end());
+    return valuelists.front()->get_numeric_value();
+}
+
 Xapian::valueno
 MultiValueList::get_valueno() const
 {
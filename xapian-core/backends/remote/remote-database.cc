@@ -28,6 +28,7 @@
 
 #include "autoptr.h"
 #include "api/emptypostlist.h"
+#include "api/querystatsinternal.h"
 #include "backends/inmemory/inmemory_positionlist.h"
 #include "net_postlist.h"
 #include "net_termlist.h"
@@ -65,6 +66,7 @@ RemoteDatabase::RemoteDatabase(int fd, double timeout_,
 	  cached_stats_valid(),
 	  mru_valstats(),
 	  mru_slot(Xapian::BAD_VALUENO),
+	  last_request_id(0),
 	  timeout(timeout_)
 {
 #ifndef __WIN32__
@@ -213,7 +215,8 @@ RemoteDatabase::open_allterms(const string & prefix) const {
 }
 
 LeafPostList *
-RemoteDatabase::open_post_list(const string &term) const
+RemoteDatabase::open_post_list(const string &term,
+			       Xapian::QueryStats::Internal *) const
 {
     return new NetworkPostList(intrusive_ptr<const RemoteDatabase>(this), term);
 }
@@ -273,15 +276,52 @@ bool
 RemoteDatabase::reopen()
 {
     mru_slot = Xapian::BAD_VALUENO;
+    // Documents requested so far would be from the old revision.
+    discard_pending_docs();
     return update_stats(MSG_REOPEN);
 }
 
 void
 RemoteDatabase::close()
 {
+    try {
+	discard_pending_docs();
+    } catch (...) {
+	do_close();
+	throw;
+    }
     do_close();
 }
 
+void
+RemoteDatabase::discard_pending_docs() const
+{
+    try {
+	map<Xapian::docid, unsigned>::const_iterator i;
+	for (i = pending_docs.begin(); i != pending_docs.end(); ++i) {
+	    string message;
+	    reply_type type;
+	    do {
+		try {
+		    type = get_tagged_message(i->second, message);
+		} catch (const Xapian::NetworkError &) {
+		    throw;
+		} catch (const Xapian::Error &) {
+		    // The server reported an error for this request (e.g. the
+		    // document doesn't exist), which ends its reply.
+		    break;
+		}
+	    } while (type != REPLY_DONE);
+	}
+    } catch (...) {
+	pending_docs.clear();
+	tagged_replies.clear();
+	throw;
+    }
+    pending_docs.clear();
+    tagged_replies.clear();
+}
+
 // Currently lazy is used when fetching documents from the MSet, and in three
 // cases in multimatch.cc.  One of the latter is when using a MatchDecider,
 // which we don't support with the remote backend currently.  The others are
@@ -294,14 +334,28 @@ RemoteDatabase::open_document(Xapian::docid did, bool /*lazy*/) const
 {
     Assert(did);
 
-    send_message(MSG_DOCUMENT, encode_length(did));
+    unsigned request_id = 0;
+    map<Xapian::docid, unsigned>::iterator i = pending_docs.find(did);
+    if (i != pending_docs.end()) {
+	// We've already asked for this document with request_document().
+	request_id = i->second;
+	pending_docs.erase(i);
+    } else {
+	send_message(MSG_DOCUMENT, encode_length(did));
+    }
+    return read_document(did, request_id);
+}
+
+Xapian::Document::Internal *
+RemoteDatabase::read_document(Xapian::docid did, unsigned request_id) const
+{
     string doc_data;
     map<Xapian::valueno, string> values;
-    get_message(doc_data, REPLY_DOCDATA);
+    get_tagged_message(request_id, doc_data, REPLY_DOCDATA);
 
     reply_type type;
     string message;
-    while ((type = get_message(message)) == REPLY_VALUE) {
+    while ((type = get_tagged_message(request_id, message)) == REPLY_VALUE) {
 	const char * p = message.data();
 	const char * p_end = p + message.size();
 	Xapian::valueno slot = decode_length(&p, p_end, false);
@@ -313,6 +367,80 @@ RemoteDatabase::open_document(Xapian::docid did, bool /*lazy*/) const
     return new RemoteDocument(this, did, doc_data, values);
 }
 
+void
+RemoteDatabase::open_documents(const vector<Xapian::docid> & dids,
+			       vector<Xapian::Document> & docs) const
+{
+    // Collect any documents already requested with request_document(), and
+    // ask for the rest in one message.
+    vector<unsigned> request_ids;
+    request_ids.reserve(dids.size());
+    string message;
+    vector<Xapian::docid>::const_iterator i;
+    for (i = dids.begin(); i != dids.end(); ++i) {
+	map<Xapian::docid, unsigned>::iterator j = pending_docs.find(*i);
+	if (j != pending_docs.end()) {
+	    request_ids.push_back(j->second);
+	    pending_docs.erase(j);
+	} else {
+	    request_ids.push_back(0);
+	    message += encode_length(*i);
+	}
+    }
+    if (!message.empty())
+	send_message(MSG_DOCUMENTS, message);
+
+    size_t k = 0;
+    try {
+	for ( ; k != dids.size(); ++k) {
+	    docs.push_back(Xapian::Document(read_document(dids[k],
+							  request_ids[k])));
+	}
+    } catch (const Xapian::NetworkError &) {
+	throw;
+    } catch (const Xapian::Error &) {
+	// Leave the connection ready for the caller to fetch the documents
+	// individually: put back the pipelined requests we haven't read, and
+	// if the batch reply is still to come, read it (an exception ends it).
+	bool batch_pending = !message.empty() && request_ids[k] != 0;
+	for (size_t l = k + 1; l != dids.size(); ++l) {
+	    if (request_ids[l] != 0) {
+		pending_docs.insert(make_pair(dids[l], request_ids[l]));
+	    } else if (batch_pending) {
+		try {
+		    (void)Xapian::Document(read_document(dids[l], 0));
+		} catch (const Xapian::NetworkError &) {
+		    throw;
+		} catch (const Xapian::Error &) {
+		    batch_pending = false;
+		}
+	    }
+	}
+	throw;
+    }
+}
+
+void
+RemoteDatabase::request_document(Xapian::docid did) const
+{
+    Assert(did);
+
+    // If we're writable, a change made after the request could be missed,
+    // and a close needs to wait for the server, so just fetch documents when
+    // they're collected.
+    if (transaction_state != TRANSACTION_UNIMPLEMENTED) return;
+
+    if (pending_docs.find(did) != pending_docs.end()) return;
+
+    // Request id 0 means "not pipelined", so skip it if we wrap.
+    if (++last_request_id == 0) ++last_request_id;
+    string message = encode_length(last_request_id);
+    message += char(MSG_DOCUMENT);
+    message += encode_length(did);
+    send_message(MSG_REQUEST, message);
+    pending_docs.insert(make_pair(did, last_request_id));
+}
+
 bool
 RemoteDatabase::update_stats(message_type msg_code) const
 {
@@ -515,11 +643,10 @@ RemoteDatabase::get_doclength(Xapian::docid did) const
     return doclen;
 }
 
-reply_type
-RemoteDatabase::get_message(string &result, reply_type required_type) const
+static reply_type
+check_reply(reply_type type, const string & result, reply_type required_type,
+	    const string & context)
 {
-    double end_time = RealTime::end_time(timeout);
-    reply_type type = static_cast<reply_type>(link.get_message(result, end_time));
     if (type == REPLY_EXCEPTION) {
 	unserialise_error(result, "REMOTE:", context);
     }
@@ -534,6 +661,60 @@ RemoteDatabase::get_message(string &result, reply_type required_type) const
     return type;
 }
 
+reply_type
+RemoteDatabase::get_message(string &result, reply_type required_type) const
+{
+    double end_time = RealTime::end_time(timeout);
+    reply_type type;
+    while (true) {
+	type = static_cast<reply_type>(link.get_message(result, end_time));
+	if (type != REPLY_TAGGED) break;
+	// The server replies in order, so replies to pipelined requests sent
+	// before this message come first.
+	stash_tagged_reply(result);
+    }
+    return check_reply(type, result, required_type, context);
+}
+
+void
+RemoteDatabase::stash_tagged_reply(const string & message) const
+{
+    const char * p = message.data();
+    const char * p_end = p + message.size();
+    unsigned request_id = decode_length(&p, p_end, false);
+    if (p == p_end)
+	throw_bad_message(context);
+    reply_type type = static_cast<reply_type>(static_cast<unsigned char>(*p++));
+    tagged_replies[request_id].push_back(make_pair(type, string(p, p_end)));
+}
+
+reply_type
+RemoteDatabase::get_tagged_message(unsigned request_id, string & result,
+				   reply_type required_type) const
+{
+    if (request_id == 0) return get_message(result, required_type);
+
+    double end_time = RealTime::end_time(timeout);
+    while (true) {
+	map<unsigned, deque<pair<reply_type, string> > >::iterator i;
+	i = tagged_replies.find(request_id);
+	if (i != tagged_replies.end()) {
+	    reply_type type = i->second.front().first;
+	    swap(result, i->second.front().second);
+	    i->second.pop_front();
+	    if (i->second.empty()) tagged_replies.erase(i);
+	    return check_reply(type, result, required_type, context);
+	}
+	reply_type type =
+	    static_cast<reply_type>(link.get_message(result, end_time));
+	// Only pipelined requests should be outstanding, but the server may
+	// report an error (such as a timeout) without a tag.
+	if (type != REPLY_TAGGED)
+	    (void)check_reply(type, result, REPLY_TAGGED, context);
+	stash_tagged_reply(result);
+    }
+}
+
 void
 RemoteDatabase::send_message(message_type type, const string &message) const
 {
@@ -646,7 +827,8 @@ RemoteDatabase::send_global_stats(Xapian::doccount first,
 
 void
 RemoteDatabase::get_mset(Xapian::MSet &mset,
-			 const vector<Xapian::MatchSpy *> & matchspies)
+			 const vector<Xapian::MatchSpy *> & matchspies,
+			 Xapian::QueryStats::Internal * query_stats)
 {
     string message;
     get_message(message, REPLY_RESULTS);
@@ -663,6 +845,12 @@ RemoteDatabase::get_mset(Xapian::MSet &mset,
 	(*i)->merge_results(spyresults);
     }
     mset = unserialise_mset(p, p_end);
+
+    if (query_stats) {
+	send_message(MSG_QUERYSTATS, string());
+	get_message(message, REPLY_QUERYSTATS);
+	query_stats->add_serialised_counts(message);
+    }
 }
 
 void
@@ -777,6 +965,24 @@ RemoteDatabase::set_metadata(const string & key, const string & value)
     send_message(MSG_SETMETADATA, data);
 }
 
+void
+RemoteDatabase::set_flush_memory(size_t bytes)
+{
+    send_message(MSG_SETFLUSHMEMORY, encode_length(bytes));
+}
+
+size_t
+RemoteDatabase::get_buffered_memory() const
+{
+    send_message(MSG_BUFFEREDMEMORY, string());
+
+    string message;
+    get_message(message, REPLY_BUFFEREDMEMORY);
+    const char * p = message.data();
+    const char * p_end = p + message.size();
+    return decode_length(&p, p_end, false);
+}
+
 void
 RemoteDatabase::add_spelling(const string & word,
 			     Xapian::termcount freqinc) const
@@ -29,6 +29,10 @@
 #include "backends/valuestats.h"
 #include "xapian/weight.h"
 
+#include <deque>
+#include <map>
+#include <utility>
+
 namespace Xapian {
     class RSet;
 }
@@ -86,8 +90,40 @@ class RemoteDatabase : public Xapian::Database::Internal {
      */
     mutable Xapian::valueno mru_slot;
 
+    /// The id of the most recent pipelined request.
+    mutable unsigned last_request_id;
+
+    /// The request ids of documents requested but not yet collected.
+    mutable std::map<Xapian::docid, unsigned> pending_docs;
+
+    /// Replies to pipelined requests which have arrived but aren't wanted yet.
+    mutable std::map<unsigned, std::deque<std::pair<reply_type, string> > >
+	tagged_replies;
+
     bool update_stats(message_type msg_code = MSG_UPDATE) const;
 
+    /** Read and discard the replies to any documents requested but not yet
+     *  collected.
+     */
+    void discard_pending_docs() const;
+
+    /// Keep a REPLY_TAGGED message until the reply is wanted.
+    void stash_tagged_reply(const string & message) const;
+
+    /** Receive the next reply to pipelined request @a request_id.
+     *
+     *  If @a request_id is 0, this is the same as get_message().
+     */
+    reply_type get_tagged_message(unsigned request_id, string & message,
+				  reply_type required_type = REPLY_MAX) const;
+
+    /** Read the replies for a document.
+     *
+     *  @param request_id  The pipelined request the replies are for, or 0.
+     */
+    Xapian::Document::Internal * read_document(Xapian::docid did,
+					       unsigned request_id) const;
+
   protected:
     /** Constructor.  The constructor is protected so that raw instances
      *  can't be created - a derived class must be instantiated which
@@ -172,9 +208,14 @@ class RemoteDatabase : public Xapian::Database::Internal {
 			   Xapian::doccount check_at_least,
 			   const Xapian::Weight::Internal &stats);
 
-    /// Get the MSet from the remote server.
+    /** Get the MSet from the remote server.
+     *
+     *  @param query_stats	Where to add the statistics for the query
+     *				from the server, or NULL.
+     */
     void get_mset(Xapian::MSet &mset,
-		  const vector<Xapian::MatchSpy *> & matchspies);
+		  const vector<Xapian::MatchSpy *> & matchspies,
+		  Xapian::QueryStats::Internal * query_stats);
 
     /// Get remote metadata key list.
     TermList * open_metadata_keylist(const std::string & prefix) const;
@@ -191,7 +232,8 @@ class RemoteDatabase : public Xapian::Database::Internal {
 
     void close();
 
-    LeafPostList * open_post_list(const string & tname) const;
+    LeafPostList * open_post_list(const string & tname,
+				  Xapian::QueryStats::Internal * stats) const;
 
     Xapian::doccount read_post_list(const string &term, NetworkPostList & pl) const;
 
@@ -201,6 +243,17 @@ class RemoteDatabase : public Xapian::Database::Internal {
     /// Get a remote document.
     Xapian::Document::Internal * open_document(Xapian::docid did, bool lazy) const;
 
+    /** Send a pipelined request for a remote document.
+     *
+     *  The reply is read by open_document() (which collect_document() calls),
+     *  so requests for all the documents in an MSet take one round trip.
+     */
+    void request_document(Xapian::docid did) const;
+
+    /// Get several remote documents with a single message.
+    void open_documents(const std::vector<Xapian::docid> & dids,
+			std::vector<Xapian::Document> & docs) const;
+
     /// Get the document count.
     Xapian::doccount get_doccount() const;
 
@@ -250,6 +303,10 @@ class RemoteDatabase : public Xapian::Database::Internal {
 
     void set_metadata(const string & key, const string & value);
 
+    void set_flush_memory(size_t bytes);
+
+    size_t get_buffered_memory() const;
+
     void add_spelling(const std::string&, Xapian::termcount) const;
 
     void remove_spelling(const std::string&,  Xapian::termcount freqdec) const;
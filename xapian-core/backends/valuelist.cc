@@ -22,10 +22,26 @@
 
 #include "valuelist.h"
 
+#include "xapian/queryparser.h" // For sortable_unserialise().
+
 namespace Xapian {
 
 ValueIterator::Internal::~Internal() { }
 
+double
+ValueIterator::Internal::get_numeric_value() const
+{
+    return sortable_unserialise(get_value());
+}
+
+bool
+ValueIterator::Internal::get_block_bounds(std::string &, std::string &,
+					  Xapian::docid & last) const
+{
+    last = get_docid();
+    return false;
+}
+
 bool
 ValueIterator::Internal::check(Xapian::docid did)
 {
@@ -51,6 +51,33 @@ class Xapian::ValueIterator::Internal : public Xapian::Internal::intrusive_base
     /// Return the value at the current position.
     virtual std::string get_value() const = 0;
 
+    /** Return the value at the current position as a number.
+     *
+     *  This is sortable_unserialise(get_value()), which is what the default
+     *  implementation returns, but backends which store numbers in numeric
+     *  form can avoid converting via a string.
+     */
+    virtual double get_numeric_value() const;
+
+    /** Get bounds on the values in the block containing the current position.
+     *
+     *  Backends which store values in blocks can record the smallest and
+     *  largest value in each, which allows a range check to accept or reject
+     *  a whole block without looking at each value.
+     *
+     *  @param[out] lo	Set to the smallest value in the block.
+     *  @param[out] hi	Set to the largest value in the block.
+     *  @param[out] last	Set to the last docid in the block.  This is set
+     *			even if false is returned, in which case the
+     *			caller shouldn't ask again until it has moved past
+     *			@a last.
+     *
+     *  @return true if the bounds are known.  The default implementation
+     *		sets @a last to the current docid and returns false.
+     */
+    virtual bool get_block_bounds(std::string & lo, std::string & hi,
+				  Xapian::docid & last) const;
+
     /// Return the value slot for the current position/this iterator.
     virtual Xapian::valueno get_valueno() const = 0;
 
@@ -37,6 +37,7 @@ using namespace std;
 #define OPT_HELP 1
 #define OPT_VERSION 2
 #define OPT_NO_RENUMBER 3
+#define OPT_THREADS 4
 
 static void show_usage() {
     cout << "Usage: "PROG_NAME" [OPTIONS] SOURCE_DATABASE... DESTINATION_DATABASE\n\n"
@@ -54,6 +55,7 @@ static void show_usage() {
 "                    unique ids from an external source).  Currently this\n"
 "                    option is only supported when merging databases if they\n"
 "                    have disjoint ranges of used document ids\n"
+"      --threads=N   Compact up to N tables at once (default 1)\n"
 "  --help            display this help and exit\n"
 "  --version         output version information and exit" << endl;
 }
@@ -61,11 +63,15 @@ static void show_usage() {
 class MyCompactor : public Xapian::Compactor {
     bool quiet;
 
+    bool threaded;
+
   public:
-    MyCompactor() : quiet(false) { }
+    MyCompactor() : quiet(false), threaded(false) { }
 
     void set_quiet(bool quiet_) { quiet = quiet_; }
 
+    void set_threaded(bool threaded_) { threaded = threaded_; }
+
     void set_status(const string & table, const string & status);
 
     string
@@ -79,10 +85,16 @@ MyCompactor::set_status(const string & table, const string & status)
 {
     if (quiet)
 	return;
-    if (!status.empty())
-	cout << '\r' << table << ": " << status << endl;
-    else
+    if (!status.empty()) {
+	if (threaded)
+	    cout << table << ": " << status << endl;
+	else
+	    cout << '\r' << table << ": " << status << endl;
+    } else if (!threaded) {
+	// When tables are compacted in parallel, their messages would be
+	// interleaved, so we only report each table once it's done.
 	cout << table << " ..." << flush;
+    }
 }
 
 string
@@ -110,6 +122,7 @@ main(int argc, char **argv)
 	{"multipass",	no_argument, 0, 'm'},
 	{"blocksize",	required_argument, 0, 'b'},
 	{"no-renumber", no_argument, 0, OPT_NO_RENUMBER},
+	{"threads",	required_argument, 0, OPT_THREADS},
 	{"quiet",	no_argument, 0, 'q'},
 	{"help",	no_argument, 0, OPT_HELP},
 	{"version",	no_argument, 0, OPT_VERSION},
@@ -150,6 +163,19 @@ main(int argc, char **argv)
 	    case OPT_NO_RENUMBER:
 		compactor.set_renumber(false);
 		break;
+	    case OPT_THREADS: {
+		char *p;
+		unsigned long n_threads = strtoul(optarg, &p, 10);
+		if (*p || n_threads == 0 || n_threads > 1024) {
+		    cerr << PROG_NAME": Bad value '" << optarg
+			 << "' passed for threads, must be between 1 and 1024"
+			 << endl;
+		    exit(1);
+		}
+		compactor.set_threads(n_threads);
+		compactor.set_threaded(n_threads > 1);
+		break;
+	    }
 	    case 'q':
 		compactor.set_quiet(true);
 		break;
@@ -54,6 +54,7 @@ const int MSECS_ACTIVE_TIMEOUT_DEFAULT = 15000;
 
 #define OPT_HELP 1
 #define OPT_VERSION 2
+#define OPT_THREADS 3
 
 static const char * opts = "I:p:a:i:t:oqw";
 static const struct option long_opts[] = {
@@ -65,6 +66,7 @@ static const struct option long_opts[] = {
     {"one-shot",	no_argument,		0, 'o'},
     {"quiet",		no_argument,		0, 'q'},
     {"writable",	no_argument,		0, 'w'},
+    {"threads",		required_argument,	0, OPT_THREADS},
     {"help",		no_argument,		0, OPT_HELP},
     {"version",		no_argument,		0, OPT_VERSION},
     {NULL, 0, 0, 0}
@@ -82,6 +84,9 @@ static void show_usage() {
 "  --one-shot              serve a single connection and exit\n"
 "  --quiet                 disable information messages to stdout\n"
 "  --writable              allow updates (only one database directory allowed)\n"
+"  --threads N             serve connections using a pool of N threads which\n"
+"                          keep the databases open between connections (the\n"
+"                          default is a new process or thread per connection)\n"
 "  --help                  display this help and exit\n"
 "  --version               output version information and exit" << endl;
 }
@@ -95,6 +100,7 @@ int main(int argc, char **argv) {
     bool one_shot = false;
     bool verbose = true;
     bool writable = false;
+    unsigned threads = 0;
     bool syntax_error = false;
 
     int c;
@@ -131,6 +137,18 @@ int main(int argc, char **argv) {
 	    case 'w':
 		writable = true;
 		break;
+	    case OPT_THREADS: {
+		char *p;
+		unsigned long n_threads = strtoul(optarg, &p, 10);
+		if (*p || n_threads == 0 || n_threads > 1024) {
+		    cerr << PROG_NAME": Bad value '" << optarg
+			 << "' passed for threads, must be between 1 and 1024"
+			 << endl;
+		    exit(1);
+		}
+		threads = n_threads;
+		break;
+	    }
 	    default:
 		syntax_error = true;
 	}
@@ -186,6 +204,8 @@ int main(int argc, char **argv) {
 
 	if (one_shot) {
 	    server.run_once();
+	} else if (threads) {
+	    server.run_threads(threads);
 	} else {
 	    server.run();
 	}
@@ -14,6 +14,7 @@ noinst_HEADERS +=\
 	common/keyword.h\
 	common/log2.h\
 	common/msvc_dirent.h\
+	common/mutex.h\
 	common/noreturn.h\
 	common/omassert.h\
 	common/output.h\
@@ -42,6 +43,7 @@ noinst_HEADERS +=\
 	common/str.h\
 	common/stringutils.h\
 	common/submatch.h\
+	common/threadpool.h\
 	common/unaligned.h
 
 EXTRA_DIST +=\
@@ -66,7 +68,8 @@ lib_src +=\
 	common/serialise-double.cc\
 	common/socket_utils.cc\
 	common/str.cc\
-	common/stringutils.cc
+	common/stringutils.cc\
+	common/threadpool.cc
 
 if BUILD_BACKEND_BRASS_OR_CHERT
 lib_src +=\
@@ -51,6 +51,13 @@ class FD {
 
     operator int() const { return fd; }
 
+    /// Stop managing the file descriptor and return it.
+    int release() {
+	int fd_to_release = fd;
+	fd = -1;
+	return fd_to_release;
+    }
+
     int close() {
 	// Don't check for -1 here, so that close(FD) sets errno as close(int)
 	// would.
@@ -139,9 +139,10 @@ io_read_block(int fd, char * p, size_t n, off_t b)
 }
 
 void
-io_write_block(int fd, const char * p, size_t n, off_t b)
+io_write_blocks(int fd, const char * p, size_t n, off_t b, size_t count)
 {
     off_t o = b * n;
+    n *= count;
 #ifdef HAVE_PWRITE
     while (n) {
 	ssize_t c = pwrite(fd, p, n, o);
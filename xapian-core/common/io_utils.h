@@ -81,11 +81,23 @@ inline void io_write(int fd, const unsigned char * p, size_t n) {
 /// Read block b size n bytes into buffer p from file descriptor fd.
 void io_read_block(int fd, char * p, size_t n, off_t b);
 
+/** Write count blocks of size n bytes, starting with block b, from buffer p
+ *  to file descriptor fd.
+ */
+void io_write_blocks(int fd, const char * p, size_t n, off_t b, size_t count);
+
+inline void io_write_blocks(int fd, const unsigned char * p, size_t n, off_t b,
+			    size_t count) {
+    io_write_blocks(fd, reinterpret_cast<const char *>(p), n, b, count);
+}
+
 /// Write block b size n bytes from buffer p to file descriptor fd.
-void io_write_block(int fd, const char * p, size_t n, off_t b);
+inline void io_write_block(int fd, const char * p, size_t n, off_t b) {
+    io_write_blocks(fd, p, n, b, 1);
+}
 
 inline void io_write_block(int fd, const unsigned char * p, size_t n, off_t b) {
-    io_write_block(fd, reinterpret_cast<const char *>(p), n, b);
+    io_write_blocks(fd, reinterpret_cast<const char *>(p), n, b, 1);
 }
 
 /** Delete a file.
@@ -0,0 +1,94 @@
+/** @file mutex.h
+ * @brief Portable mutex wrapper for protecting shared state.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_MUTEX_H
+#define XAPIAN_INCLUDED_MUTEX_H
+
+#if defined __WIN32__
+# include "safewindows.h"
+#elif defined HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
+/** A non-recursive mutex.
+ *
+ *  If the platform has no threading support, locking is a no-op.
+ */
+class Mutex {
+    /// Don't allow copying.
+    Mutex(const Mutex &);
+
+    /// Don't allow assignment.
+    void operator=(const Mutex &);
+
+#if defined __WIN32__
+    CRITICAL_SECTION cs;
+#elif defined HAVE_PTHREAD
+    pthread_mutex_t mutex;
+#endif
+
+  public:
+#if defined __WIN32__
+    Mutex() { InitializeCriticalSection(&cs); }
+
+    ~Mutex() { DeleteCriticalSection(&cs); }
+
+    void lock() { EnterCriticalSection(&cs); }
+
+    bool try_lock() { return TryEnterCriticalSection(&cs) != 0; }
+
+    void unlock() { LeaveCriticalSection(&cs); }
+#elif defined HAVE_PTHREAD
+    Mutex() { pthread_mutex_init(&mutex, NULL); }
+
+    ~Mutex() { pthread_mutex_destroy(&mutex); }
+
+    void lock() { pthread_mutex_lock(&mutex); }
+
+    bool try_lock() { return pthread_mutex_trylock(&mutex) == 0; }
+
+    void unlock() { pthread_mutex_unlock(&mutex); }
+#else
+    Mutex() { }
+
+    void lock() { }
+
+    bool try_lock() { return true; }
+
+    void unlock() { }
+#endif
+};
+
+/// Hold a Mutex locked for the lifetime of this object.
+class MutexLock {
+    /// Don't allow copying.
+    MutexLock(const MutexLock &);
+
+    /// Don't allow assignment.
+    void operator=(const MutexLock &);
+
+    Mutex & mutex;
+
+  public:
+    explicit MutexLock(Mutex & mutex_) : mutex(mutex_) { mutex.lock(); }
+
+    ~MutexLock() { mutex.unlock(); }
+};
+
+#endif // XAPIAN_INCLUDED_MUTEX_H
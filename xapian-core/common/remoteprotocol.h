@@ -48,7 +48,12 @@
 // 36: 1.3.0 REPLY_UPDATE and REPLY_GREETING merged, and more...
 // 37: 1.3.1 Prefix-compress termlists.
 // 38: 1.3.2 Stats serialisation now includes collection freq, and more...
-#define XAPIAN_REMOTE_PROTOCOL_MAJOR_VERSION 38
+// 38.1: New MSG_REQUEST and REPLY_TAGGED allow requests to be pipelined.
+// 38.2: New MSG_DOCUMENTS fetches several documents at once.
+// 38.3: New MSG_SETFLUSHMEMORY and MSG_BUFFEREDMEMORY.
+// 38.4: New MSG_QUERYSTATS fetches statistics for the last query.
+// 39: 1.3.3 Prefix-compress serialised ValueCountMatchSpy results.
+#define XAPIAN_REMOTE_PROTOCOL_MAJOR_VERSION 39
 #define XAPIAN_REMOTE_PROTOCOL_MINOR_VERSION 0
 
 /** Message types (client -> server).
@@ -87,6 +92,11 @@ enum message_type {
     MSG_SHUTDOWN,		// Shutdown
     MSG_METADATAKEYLIST,	// Iterator for metadata keys
     MSG_FREQS,			// Get termfreq and collfreq
+    MSG_REQUEST,		// Message tagged with a request id
+    MSG_DOCUMENTS,		// Get several documents
+    MSG_SETFLUSHMEMORY,		// Set memory limit for buffered changes
+    MSG_BUFFEREDMEMORY,		// Get memory used by buffered changes
+    MSG_QUERYSTATS,		// Get statistics for the last query
     MSG_MAX
 };
 
@@ -114,6 +124,9 @@ enum reply_type {
     REPLY_METADATA,		// Metadata
     REPLY_METADATAKEYLIST,	// Iterator for metadata keys
     REPLY_FREQS,		// Get termfreq and collfreq
+    REPLY_TAGGED,		// Reply to a message tagged with a request id
+    REPLY_BUFFEREDMEMORY,	// Memory used by buffered changes
+    REPLY_QUERYSTATS,		// Statistics for the last query
     REPLY_MAX
 };
 
@@ -0,0 +1,206 @@
+/** @file threadpool.cc
+ * @brief Run independent jobs on a number of threads.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "threadpool.h"
+
+#include "xapian/error.h"
+
+#if defined __WIN32__
+# include "safewindows.h"
+# include <process.h> // For _beginthreadex().
+#elif defined HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
+#include <new>
+
+using namespace std;
+
+void
+ThreadJobError::record()
+{
+    try {
+	throw;
+    } catch (const Xapian::Error & e) {
+	kind = XAPIAN_ERROR;
+	// The byte before the type name is the type code.
+	type = e.get_type()[-1];
+	msg = e.get_msg();
+	context = e.get_context();
+	const char * err = e.get_error_string();
+	have_error_string = (err != NULL);
+	if (err) error_str = err;
+    } catch (const bad_alloc &) {
+	kind = BAD_ALLOC;
+    } catch (...) {
+	kind = UNKNOWN;
+    }
+}
+
+void
+ThreadJobError::rethrow() const
+{
+    switch (kind) {
+	case NONE:
+	    return;
+	case BAD_ALLOC:
+	    throw bad_alloc();
+	case UNKNOWN:
+	    throw Xapian::InternalError("Unknown exception in worker thread");
+	case XAPIAN_ERROR: {
+	    // The generated cases use msg, context and error_string.
+	    const char * error_string =
+		have_error_string ? error_str.c_str() : NULL;
+	    switch (type) {
+#include "xapian/errordispatch.h"
+	    }
+	    break;
+	}
+    }
+    throw Xapian::InternalError("Unknown exception type in worker thread");
+}
+
+namespace {
+
+/// State shared between the threads working through a list of jobs.
+class JobQueue {
+    const vector<ThreadJob *> & jobs;
+
+    Mutex mutex;
+
+    size_t next_job;
+
+  public:
+    ThreadBudget & budget;
+
+    JobQueue(const vector<ThreadJob *> & jobs_, ThreadBudget & budget_)
+	: jobs(jobs_), next_job(0), budget(budget_) { }
+
+    /// Take the next job, or return NULL if there are none left.
+    ThreadJob * next() {
+	MutexLock lock(mutex);
+	if (next_job == jobs.size()) return NULL;
+	return jobs[next_job++];
+    }
+
+    /// The number of jobs which haven't been started.
+    size_t waiting() {
+	MutexLock lock(mutex);
+	return jobs.size() - next_job;
+    }
+
+    /// Run jobs until there are none left.
+    void work() {
+	while (ThreadJob * job = next()) {
+	    job->run();
+	}
+    }
+};
+
+}
+
+#if defined __WIN32__
+extern "C" {
+static unsigned __stdcall
+thread_main(void * arg)
+{
+    JobQueue * queue = static_cast<JobQueue *>(arg);
+    queue->work();
+    queue->budget.release();
+    return 0;
+}
+}
+
+typedef HANDLE thread_t;
+
+static bool
+start_thread(JobQueue * queue, thread_t & thread)
+{
+    uintptr_t h = _beginthreadex(NULL, 0, thread_main, queue, 0, NULL);
+    if (h == 0) return false;
+    thread = reinterpret_cast<HANDLE>(h);
+    return true;
+}
+
+static void
+join_thread(thread_t thread)
+{
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+#elif defined HAVE_PTHREAD
+extern "C" {
+static void *
+thread_main(void * arg)
+{
+    JobQueue * queue = static_cast<JobQueue *>(arg);
+    queue->work();
+    queue->budget.release();
+    return NULL;
+}
+}
+
+typedef pthread_t thread_t;
+
+static bool
+start_thread(JobQueue * queue, thread_t & thread)
+{
+    return pthread_create(&thread, NULL, thread_main, queue) == 0;
+}
+
+static void
+join_thread(thread_t thread)
+{
+    pthread_join(thread, NULL);
+}
+#endif
+
+void
+run_jobs(const vector<ThreadJob *> & jobs, ThreadBudget & budget)
+{
+    JobQueue queue(jobs, budget);
+#if defined __WIN32__ || defined HAVE_PTHREAD
+    vector<thread_t> threads;
+    while (true) {
+	// Start another thread if there's a job for it besides the one we're
+	// about to take, and the budget allows.
+	while (threads.size() + 1 < jobs.size() && queue.waiting() > 1 &&
+	       budget.acquire()) {
+	    thread_t thread;
+	    // If we can't start a thread, just make do with those we have.
+	    if (!start_thread(&queue, thread)) {
+		budget.release();
+		break;
+	    }
+	    threads.push_back(thread);
+	}
+	ThreadJob * job = queue.next();
+	if (!job) break;
+	job->run();
+    }
+    for (size_t i = 0; i != threads.size(); ++i) {
+	join_thread(threads[i]);
+    }
+#else
+    (void)budget;
+    queue.work();
+#endif
+}
@@ -0,0 +1,150 @@
+/** @file threadpool.h
+ * @brief Run independent jobs on a number of threads.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_THREADPOOL_H
+#define XAPIAN_INCLUDED_THREADPOOL_H
+
+#include <string>
+#include <vector>
+
+#include "mutex.h"
+
+/// A unit of work which can be run by run_jobs().
+class ThreadJob {
+  public:
+    virtual ~ThreadJob() { }
+
+    /** Do the work.
+     *
+     *  This may be called on a thread other than the one which called
+     *  run_jobs(), so it must not throw an exception - any error needs to be
+     *  recorded in the job object (e.g. with a ThreadJobError) and dealt
+     *  with by the caller afterwards.
+     */
+    virtual void run() = 0;
+};
+
+/** An exception caught in ThreadJob::run(), to rethrow in the caller.
+ *
+ *  Xapian::Error objects are recorded by their type, message and context,
+ *  so rethrow() throws an exception of the same class.
+ */
+class ThreadJobError {
+    enum { NONE, XAPIAN_ERROR, BAD_ALLOC, UNKNOWN } kind;
+
+    /// The type code of a Xapian::Error.
+    char type;
+
+    std::string msg;
+
+    std::string context;
+
+    std::string error_str;
+
+    bool have_error_string;
+
+  public:
+    ThreadJobError() : kind(NONE) { }
+
+    /** Record the exception currently being handled.
+     *
+     *  This must be called from within a catch block.
+     */
+    void record();
+
+    /// Has an exception been recorded?
+    bool failed() const { return kind != NONE; }
+
+    /// Throw the recorded exception, if there is one.
+    void rethrow() const;
+};
+
+/** A limit on the number of threads, shared by calls to run_jobs().
+ *
+ *  This allows run_jobs() to be called from within a job, without the
+ *  jobs at the two levels between them using more threads than wanted.
+ */
+class ThreadBudget {
+    /// Don't allow copying.
+    ThreadBudget(const ThreadBudget &);
+
+    /// Don't allow assignment.
+    void operator=(const ThreadBudget &);
+
+    Mutex mutex;
+
+    /// How many more threads may be started.
+    unsigned spare;
+
+  public:
+    /** Construct a budget of @a n_threads threads.
+     *
+     *  This includes the thread which calls run_jobs().
+     */
+    explicit ThreadBudget(unsigned n_threads)
+	: spare(n_threads ? n_threads - 1 : 0) { }
+
+    /// Take a thread from the budget, returning false if there's none left.
+    bool acquire() {
+	MutexLock lock(mutex);
+	if (spare == 0) return false;
+	--spare;
+	return true;
+    }
+
+    /// Return a thread to the budget.
+    void release() {
+	MutexLock lock(mutex);
+	++spare;
+    }
+};
+
+/** Run some jobs using threads from @a budget.
+ *
+ *  The calling thread works through the jobs too, so only extra threads
+ *  are taken from @a budget, and each is returned as soon as it runs out of
+ *  jobs.  Threads are taken whenever more jobs are waiting to start, so
+ *  threads returned by other calls to run_jobs() can be picked up.  Each
+ *  job is run exactly once, and this function returns once all the jobs
+ *  have finished.
+ *
+ *  If threads aren't supported on this platform, or can't be started, the
+ *  jobs are simply run one after another.
+ *
+ *  The threads are started for each call and exit once there are no jobs
+ *  left, rather than being kept in a pool.  Starting a thread takes tens of
+ *  microseconds, which is small next to the matches and table merges
+ *  this is used for, and it means idle threads aren't left lying around
+ *  in every process using the library.
+ */
+void run_jobs(const std::vector<ThreadJob *> & jobs, ThreadBudget & budget);
+
+/** Run some jobs using up to @a n_threads threads.
+ *
+ *  The calling thread works through the jobs too, so at most
+ *  @a n_threads - 1 extra threads are started.
+ */
+inline void
+run_jobs(const std::vector<ThreadJob *> & jobs, unsigned n_threads)
+{
+    ThreadBudget budget(n_threads);
+    run_jobs(jobs, budget);
+}
+
+#endif // XAPIAN_INCLUDED_THREADPOOL_H
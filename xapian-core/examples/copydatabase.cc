@@ -25,9 +25,16 @@
 #include <iomanip>
 #include <iostream>
 
+#include <string>
+#include <vector>
+
 #include <cmath> // For log10().
-#include <cstdlib> // For exit().
-#include <cstring> // For strcmp() and strrchr().
+#include <cstdlib> // For exit() and atoi().
+#include <cstring> // For strcmp(), strncmp() and strrchr().
+
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
 
 using namespace std;
 
@@ -45,16 +52,123 @@ show_usage(int rc)
 "                   databases are specified and the same docid occurs in more\n"
 "                   one, the last occurrence will be the one which ends up in\n"
 "                   the destination database.\n"
+"  --threads=N      Add the documents from N threads at once, each indexing\n"
+"                   into its own temporary database, and then merge these\n"
+"                   using the same code as xapian-compact.  The order of the\n"
+"                   documents isn't preserved.  Can't be used with\n"
+"                   --no-renumber.\n"
 "  --help           display this help and exit\n"
 "  --version        output version information and exit" << endl;
     exit(rc);
 }
 
+/// The documents copied by one thread in --threads mode.
+struct CopyJob {
+    Xapian::ShardedWriter * writer;
+
+    const vector<string> * sources;
+
+    /// Which of the n_threads docid ranges of each source to copy.
+    unsigned n, n_threads;
+
+    /// Set to a description of the error if one occurs.
+    string error;
+};
+
+extern "C" {
+static void *
+copy_documents(void * arg)
+{
+    CopyJob & job = *static_cast<CopyJob *>(arg);
+    try {
+	for (size_t i = 0; i != job.sources->size(); ++i) {
+	    // Each thread needs its own Database object.
+	    Xapian::Database db_in((*job.sources)[i]);
+	    double last = db_in.get_lastdocid();
+	    Xapian::docid first_did = Xapian::docid(last * job.n / job.n_threads) + 1;
+	    Xapian::docid last_did = Xapian::docid(last * (job.n + 1) / job.n_threads);
+	    if (first_did > last_did) continue;
+
+	    Xapian::PostingIterator it = db_in.postlist_begin(string());
+	    it.skip_to(first_did);
+	    while (it != db_in.postlist_end(string()) && *it <= last_did) {
+		job.writer->add_document(db_in.get_document(*it));
+		++it;
+	    }
+	}
+    } catch (const Xapian::Error & e) {
+	job.error = e.get_description();
+    } catch (...) {
+	// An exception mustn't escape from a thread's start function.
+	job.error = "Unknown exception";
+    }
+    return NULL;
+}
+}
+
+/** Copy the documents from @a sources to @a dest using @a n_threads threads.
+ *
+ *  @return A description of the error if one occurs, or an empty string.
+ */
+static string
+copy_documents_threaded(const vector<string> & sources, const char * dest,
+			unsigned n_threads)
+{
+    // Create the destination database, using DB_CREATE so that we don't try
+    // to overwrite or update an existing database in case the user got the
+    // command line argument order wrong.  Merging the shards then replaces
+    // this empty database.
+    Xapian::WritableDatabase(dest, Xapian::DB_CREATE|Xapian::DB_BACKEND_BRASS).close();
+
+    Xapian::ShardedWriter writer(dest, n_threads);
+    cout << "Copying documents using " << n_threads << " threads..." << flush;
+    vector<CopyJob> jobs(n_threads);
+    for (unsigned n = 0; n != n_threads; ++n) {
+	jobs[n].writer = &writer;
+	jobs[n].sources = &sources;
+	jobs[n].n = n;
+	jobs[n].n_threads = n_threads;
+    }
+#ifdef HAVE_PTHREAD
+    vector<pthread_t> threads(n_threads);
+    vector<bool> started(n_threads);
+    for (unsigned n = 1; n != n_threads; ++n) {
+	started[n] = (pthread_create(&threads[n], NULL, copy_documents,
+				     &jobs[n]) == 0);
+    }
+    copy_documents(&jobs[0]);
+    for (unsigned n = 1; n != n_threads; ++n) {
+	if (started[n]) {
+	    pthread_join(threads[n], NULL);
+	} else {
+	    // Couldn't start a thread, so do its share of the work here.
+	    copy_documents(&jobs[n]);
+	}
+    }
+#else
+    // No thread support, so just do each share of the work in turn.
+    for (unsigned n = 0; n != n_threads; ++n) {
+	copy_documents(&jobs[n]);
+    }
+#endif
+    for (unsigned n = 0; n != n_threads; ++n) {
+	// Returning destroys writer, which removes the temporary databases.
+	if (!jobs[n].error.empty()) return jobs[n].error;
+    }
+    cout << " done." << endl;
+
+    cout << "Merging..." << flush;
+    writer.finish();
+    cout << " done." << endl;
+    return string();
+}
+
 int
 main(int argc, char **argv)
 try {
     bool renumber = true;
-    if (argc > 1 && argv[1][0] == '-') {
+    unsigned n_threads = 0;
+    while (argc > 1 && argv[1][0] == '-') {
 	if (strcmp(argv[1], "--help") == 0) {
 	    cout << PROG_NAME" - "PROG_DESC"\n\n";
 	    show_usage(0);
@@ -65,21 +179,23 @@ try {
 	}
 	if (strcmp(argv[1], "--no-renumber") == 0) {
 	    renumber = false;
-	    argv[1] = argv[0];
-	    ++argv;
-	    --argc;
+	} else if (strncmp(argv[1], "--threads=", 10) == 0) {
+	    int n = atoi(argv[1] + 10);
+	    if (n <= 0) show_usage(1);
+	    n_threads = n;
+	} else {
+	    show_usage(1);
 	}
+	argv[1] = argv[0];
+	++argv;
+	--argc;
     }
 
     // We expect two or more arguments: at least one source database path
     // followed by the destination database path.
     if (argc < 3) show_usage(1);
 
-    // Create the destination database, using DB_CREATE so that we don't
-    // try to overwrite or update an existing database in case the user
-    // got the command line argument order wrong.
-    const char *dest = argv[argc - 1];
-    Xapian::WritableDatabase db_out(dest, Xapian::DB_CREATE);
+    if (n_threads && !renumber) show_usage(1);
 
     for (int i = 1; i < argc - 1; ++i) {
 	char * src = argv[i];
@@ -88,6 +204,28 @@ try {
 	    char & ch = src[strlen(src) - 1];
 	    if (ch == '/' || ch == '\\') ch = '\0';
 	}
+    }
+
+    const char *dest = argv[argc - 1];
+    if (n_threads) {
+	string error =
+	    copy_documents_threaded(vector<string>(argv + 1, argv + argc - 1),
+				    dest, n_threads);
+	if (!error.empty()) {
+	    cerr << '\n' << argv[0] << ": " << error << endl;
+	    exit(1);
+	}
+    }
+
+    // Create the destination database, using DB_CREATE so that we don't
+    // try to overwrite or update an existing database in case the user
+    // got the command line argument order wrong.  If the documents have
+    // already been copied, just open it to copy everything else.
+    Xapian::WritableDatabase db_out(dest,
+				    n_threads ? Xapian::DB_OPEN : Xapian::DB_CREATE);
+
+    for (int i = 1; i < argc - 1; ++i) {
+	char * src = argv[i];
 
 	// Open the source database.
 	Xapian::Database db_in(src);
@@ -101,7 +239,9 @@ try {
 
 	// Iterate over all the documents in db_in, copying each to db_out.
 	Xapian::doccount dbsize = db_in.get_doccount();
-	if (dbsize == 0) {
+	if (n_threads) {
+	    // Already copied.
+	} else if (dbsize == 0) {
 	    cout << leaf << ": empty!" << endl;
 	} else {
 	    // Calculate how many decimal digits there are in dbsize.
@@ -29,7 +29,9 @@ xapianinclude_HEADERS =\
 	include/xapian/postingsource.h\
 	include/xapian/query.h\
 	include/xapian/queryparser.h\
+	include/xapian/querystats.h\
 	include/xapian/registry.h\
+	include/xapian/shardedwriter.h\
 	include/xapian/snipper.h\
 	include/xapian/stem.h\
 	include/xapian/termgenerator.h\
@@ -76,6 +76,7 @@
 #include <xapian/postingsource.h>
 #include <xapian/query.h>
 #include <xapian/queryparser.h>
+#include <xapian/querystats.h>
 #include <xapian/valuesetmatchdecider.h>
 #include <xapian/weight.h>
 
@@ -97,6 +98,9 @@
 // Database compaction and merging
 #include <xapian/compactor.h>
 
+// Indexing from several threads
+#include <xapian/shardedwriter.h>
+
 // ELF visibility annotations for GCC.
 #include <xapian/visibility.h>
 
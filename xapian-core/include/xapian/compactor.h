@@ -93,6 +93,24 @@ class XAPIAN_VISIBILITY_DEFAULT Compactor {
      */
     void set_compaction_level(compaction_level compaction);
 
+    /** Set the number of threads to use.
+     *
+     *  Each table is written to separate files, so the tables can be
+     *  compacted concurrently, and with set_multipass() the merges in each
+     *  pass of the postlist table can be run concurrently too.
+     *
+     *  @param n_threads  The maximum number of threads to use, including
+     *		      the calling thread (default: 0, which like 1 means
+     *		      everything runs in the calling thread).
+     *
+     *  Threads are only used for brass databases, and only if the platform
+     *  supports them.  The compacted database is the same whatever the
+     *  number of threads.  Calls to set_status() and
+     *  resolve_duplicate_metadata() are never made concurrently, but the
+     *  status messages for different tables may be interleaved.
+     */
+    void set_threads(unsigned n_threads);
+
     /** Set where to write the output.
      *
      *  @param destdir	Output path.  This can be the same as an input if that
@@ -116,6 +116,48 @@ const int DB_DANGEROUS		 = 0x08;
  */
 const int DB_NO_TERMLIST	 = 0x10;
 
+/** Memory-map tables when opening a database read-only.
+ *
+ *  For backends which support it (currently brass), blocks are read directly
+ *  from a read-only shared memory mapping of each table rather than being
+ *  copied into a buffer for each cursor.  This saves a system call and a copy
+ *  per block read, and means the OS can share a single copy of each block
+ *  between all the processes reading a database.  This flag is ignored when
+ *  opening a WritableDatabase, and on platforms without mmap().
+ *
+ *  This option should only be used if the database isn't being modified
+ *  while open (for example, a database which is built and then swapped into
+ *  place).  If a writer overwrites a block while a reader is using it, the
+ *  reader will see the block change underneath it rather than
+ *  DatabaseModifiedError being thrown, which may lead to incorrect results
+ *  or DatabaseCorruptError.
+ */
+const int DB_MMAP		 = 0x20;
+
+/** Pin the revision opened by a reader so the writer doesn't overwrite it.
+ *
+ *  Normally, a reader gets Xapian::DatabaseModifiedError if the writer has
+ *  committed twice since it was opened, as blocks the reader needs may have
+ *  been reused.  With this flag, the writer won't reuse any blocks which the
+ *  reader's revision uses, so the reader can keep running queries at that
+ *  revision until Database::reopen() is called, which moves the pin to the
+ *  latest revision.  This also makes it safe to use Xapian::DB_MMAP on a
+ *  database which is being modified.
+ *
+ *  The cost is that the database can't reuse any space freed since the
+ *  oldest pinned revision, so will grow faster while readers lag behind.
+ *
+ *  This is currently only supported by the brass backend.  Pins are recorded
+ *  as files in the database directory, so the reader needs to be able to
+ *  create files there, and must be running on the same machine as the writer
+ *  so that pins left by processes which have died can be detected and
+ *  removed (using kill() with signal 0, or OpenProcess() on Microsoft
+ *  Windows).  A pin belongs to the process which opened the database, so a
+ *  child process created by fork() which closes the database doesn't remove
+ *  its parent's pin.  This flag is ignored when opening a WritableDatabase.
+ */
+const int DB_PIN_REVISION	 = 0x40;
+
 /** Use the brass backend.
  *
  *  When opening a WritableDatabase, this means create a brass database if a
@@ -155,6 +197,9 @@ const int DB_BACKEND_MASK_	 = 0x300;
 /** @internal Used internally to signify opening read-only. */
 const int DB_READONLY_		 = -1;
 
+/** @internal Used internally to signify opening read-only with DB_MMAP. */
+const int DB_READONLY_MMAP_	 = -2;
+
 
 /** Show a short-format display of the B-tree contents.
  *
@@ -354,6 +354,28 @@ class XAPIAN_VISIBILITY_DEFAULT Database {
 	 */
 	Xapian::Document get_document(Xapian::docid did) const;
 
+	/** Get several documents from the database, given their document ids.
+	 *
+	 *  This is like calling get_document() for each document id, but the
+	 *  data and values of the documents are read in one pass, which is
+	 *  faster - for example, when displaying a page of search results.
+	 *  For a remote database, all the documents are fetched with a single
+	 *  message.
+	 *
+	 *  @param dids  The document ids of the documents to retrieve (they
+	 *		 don't need to be in any particular order).
+	 *
+	 *  @return      The documents, in the same order as @a dids.
+	 *
+	 *  @exception Xapian::DocNotFoundError      One of the documents
+	 *		specified could not be found in the database.
+	 *
+	 *  @exception Xapian::InvalidArgumentError  One of the document ids
+	 *		was 0, which is not a valid document id.
+	 */
+	std::vector<Xapian::Document>
+	get_documents(const std::vector<Xapian::docid> & dids) const;
+
 	/** Suggest a spelling correction.
 	 *
 	 *  @param word			The potentially misspelled word.
@@ -597,6 +619,8 @@ class XAPIAN_VISIBILITY_DEFAULT WritableDatabase : public Database {
 	 *  conservative, and if you have a machine with plenty of memory,
 	 *  you can improve indexing throughput dramatically by setting
 	 *  XAPIAN_FLUSH_THRESHOLD in the environment to a larger value.
+	 *  Modifications are also flushed once they use more memory than
+	 *  the limit set by set_flush_memory().
 	 *
 	 *  This method was new in Xapian 1.1.0 - in earlier versions it was
 	 *  called flush().
@@ -616,6 +640,38 @@ class XAPIAN_VISIBILITY_DEFAULT WritableDatabase : public Database {
 	 */
 	void flush() { commit(); }
 
+	/** Set how much memory buffered modifications may use.
+	 *
+	 *  Once the modifications buffered in memory are estimated to use
+	 *  at least this many bytes, they are written to the database
+	 *  files, as if XAPIAN_FLUSH_THRESHOLD modifications had been made.
+	 *  This allows large documents to be indexed without running out of
+	 *  memory, while still allowing many small documents to be batched
+	 *  up.  The document count threshold still applies too.
+	 *
+	 *  The estimate covers the buffered changes to posting lists,
+	 *  positional information, document lengths and values.  It is
+	 *  approximate, so the limit should be set somewhat below the memory
+	 *  which is actually available.
+	 *
+	 *  The default limit for the brass backend is 256MB.  Backends which
+	 *  don't buffer modifications ignore this setting.
+	 *
+	 *  @param bytes	The limit in bytes, or 0 for no limit (so only
+	 *			the document count threshold is used).
+	 */
+	void set_flush_memory(size_t bytes);
+
+	/** Get the approximate memory used by buffered modifications.
+	 *
+	 *  This is the estimate which is compared with the limit set by
+	 *  set_flush_memory(), and is intended for monitoring indexing.
+	 *
+	 *  @return The estimated size in bytes (0 if there are no buffered
+	 *	    modifications, or if the backend doesn't buffer them).
+	 */
+	size_t get_buffered_memory() const;
+
 	/** Begin a transaction.
 	 *
 	 *  In Xapian a transaction is a group of modifications to the database
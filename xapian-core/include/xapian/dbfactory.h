@@ -146,6 +146,30 @@ open(const std::string &dir, int action, int block_size)
     return WritableDatabase(dir, action|DB_BACKEND_BRASS, block_size);
 }
 
+/** Set the size of the process-wide brass block cache.
+ *
+ *  Brass databases opened for reading can share a cache of recently read
+ *  blocks.  This cache is disabled by default, unless the environment
+ *  variable XAPIAN_BLOCK_CACHE_SIZE is set when it is first used, in which
+ *  case that gives its initial size.
+ *
+ *  Only databases opened after the cache is enabled will use it.  Reducing
+ *  the size discards blocks as needed to fit.
+ *
+ *  @param size	the maximum number of bytes of block data to cache (0
+ *		disables the cache).
+ */
+XAPIAN_VISIBILITY_DEFAULT
+void set_block_cache_size(size_t size);
+
+/** Get the size of the process-wide brass block cache.
+ *
+ *  @return the maximum number of bytes of block data cached (0 if the cache
+ *	    is disabled).
+ */
+XAPIAN_VISIBILITY_DEFAULT
+size_t get_block_cache_size();
+
 }
 #endif
 
@@ -99,6 +99,20 @@ class XAPIAN_VISIBILITY_DEFAULT Document {
 	 */
 	std::string get_value(Xapian::valueno slot) const;
 
+	/** Get a value as a number.
+	 *
+	 *  This returns the same as
+	 *  Xapian::sortable_unserialise(get_value(slot)), so if there's no
+	 *  value in @a slot the result is negative infinity.  For a value
+	 *  stored by a backend in numeric form (currently brass does this for
+	 *  values which are all sortable_serialise() strings) it avoids
+	 *  converting the value to a string and back, which makes it useful in
+	 *  a KeyMaker or MatchSpy.
+	 *
+	 *  @param slot The number of the value.
+	 */
+	double get_numeric_value(Xapian::valueno slot) const;
+
 	/** Add a new value.
 	 *
 	 *  The new value will replace any existing value with the same number
@@ -49,6 +49,7 @@ class KeyMaker;
 class MatchSpy;
 class MSetIterator;
 class Query;
+class QueryStats;
 class Weight;
 
 /** A match set (MSet).
@@ -990,6 +991,49 @@ class XAPIAN_VISIBILITY_DEFAULT Enquire {
 	 */
 	void set_time_limit(double time_limit);
 
+	/** Set the number of threads to use for the match.
+	 *
+	 *  When searching several local databases, each one can be matched in
+	 *  its own thread, and the results merged.  If there are more threads
+	 *  than local databases, a database opened read-only can also be split
+	 *  into ranges of document ids which are matched in separate threads.
+	 *  The threads share the lowest weight a document needs to make the top
+	 *  results so far, so they can skip documents which can't make the
+	 *  combined results.
+	 *
+	 *  @param n_threads  The maximum number of threads to use, including
+	 *		      the calling thread (default: 0, which like 1 means
+	 *		      the whole match runs in the calling thread).
+	 *
+	 *  Limitations:
+	 *
+	 *  Threads are only used if the platform supports them, and there are
+	 *  at least two local databases or a database which supports being
+	 *  split (currently a brass database opened read-only).  The match runs
+	 *  in the calling thread if a Xapian::MatchDecider, Xapian::KeyMaker or
+	 *  Xapian::PostingSource is in use, if a Xapian::MatchSpy which doesn't
+	 *  implement clone() is in use, or if the same database has been added
+	 *  more than once.  The MSet returned is the same, apart from the
+	 *  statistics such as get_matches_estimated() and get_collapse_count(),
+	 *  which may differ slightly (as they do for remote databases).
+	 *  A Xapian::MatchSpy may see more documents than it otherwise would
+	 *  unless check_at_least is high enough that all matches are checked.
+	 */
+	void set_match_threads(unsigned n_threads);
+
+	/** Collect statistics about the work done by get_mset().
+	 *
+	 *  Each subsequent call to get_mset() resets @a stats and fills it in
+	 *  for that match.  Collecting the statistics costs a little time,
+	 *  so this is off by default.
+	 *
+	 *  @param stats	The object to fill in, or NULL to stop collecting
+	 *			statistics.  The caller must ensure that this
+	 *			remains valid while the Enquire object remains
+	 *			active, or until this method is called again.
+	 */
+	void set_query_stats(Xapian::QueryStats * stats);
+
 	/** Get (a portion of) the match set for the current query.
 	 *
 	 *  @param first     the first item in the result set to return.
@@ -180,41 +180,25 @@ class XAPIAN_VISIBILITY_DEFAULT MatchSpy {
  */
 class XAPIAN_VISIBILITY_DEFAULT ValueCountMatchSpy : public MatchSpy {
   public:
+    /// Class holding the counts.
     struct Internal;
 
-#ifndef SWIG // SWIG doesn't need to know about the internal class
-    struct XAPIAN_VISIBILITY_DEFAULT Internal
-	    : public Xapian::Internal::intrusive_base
-    {
-	/// The slot to count.
-	Xapian::valueno slot;
-
-	/// Total number of documents seen by the match spy.
-	Xapian::doccount total;
-
-	/// The values seen so far, together with their frequency.
-	std::map<std::string, Xapian::doccount> values;
-
-	Internal() : slot(Xapian::BAD_VALUENO), total(0) {}
-	Internal(Xapian::valueno slot_) : slot(slot_), total(0) {}
-    };
-#endif
-
   protected:
+    /// @private @internal Reference counted internals.
     Xapian::Internal::intrusive_ptr<Internal> internal;
 
   public:
     /// Construct an empty ValueCountMatchSpy.
-    ValueCountMatchSpy() : internal() {}
+    ValueCountMatchSpy();
 
     /// Construct a MatchSpy which counts the values in a particular slot.
-    ValueCountMatchSpy(Xapian::valueno slot_)
-	    : internal(new Internal(slot_)) {}
+    ValueCountMatchSpy(Xapian::valueno slot_);
+
+    /// Destructor.
+    ~ValueCountMatchSpy();
 
     /** Return the total number of documents tallied. */
-    size_t XAPIAN_NOTHROW(get_total() const) {
-	return internal.get() ? internal->total : 0;
-    }
+    size_t XAPIAN_NOTHROW(get_total() const);
 
     /** Get an iterator over the values seen in the slot.
      *
@@ -266,6 +250,113 @@ class XAPIAN_VISIBILITY_DEFAULT ValueCountMatchSpy : public MatchSpy {
     virtual std::string get_description() const;
 };
 
+/** Class for building a histogram of numeric values in the matching
+ *  documents.
+ *
+ *  The values in the slot should have been created with
+ *  Xapian::sortable_serialise(), and are decoded with
+ *  Document::get_numeric_value().  A document with no value in the slot
+ *  (which includes a value of -infinity, as that serialises to an empty
+ *  string) is included in get_total() but nothing else.
+ *
+ *  The buckets are either of a fixed width, or logarithmic with each
+ *  bucket a fixed multiple of the width of the previous one, which suits
+ *  values such as prices which range over several orders of magnitude.
+ */
+class XAPIAN_VISIBILITY_DEFAULT NumericHistogramMatchSpy : public MatchSpy {
+  public:
+    /// Class holding the histogram.
+    struct Internal;
+
+  protected:
+    /// @private @internal Reference counted internals.
+    Xapian::Internal::intrusive_ptr<Internal> internal;
+
+  public:
+    /// Construct an empty NumericHistogramMatchSpy.
+    NumericHistogramMatchSpy();
+
+    /** Construct a NumericHistogramMatchSpy.
+     *
+     *  @param slot_	The value slot to look at.
+     *  @param start	The start of the first bucket.
+     *  @param step	For fixed width buckets, the width of each bucket;
+     *			for logarithmic buckets, the ratio of the end of
+     *			each bucket to its start.
+     *  @param num_buckets	The number of buckets.
+     *  @param logarithmic	true for logarithmic buckets.  In this case,
+     *			@a start must be > 0 and @a step must be > 1.
+     *			Default: false.
+     */
+    NumericHistogramMatchSpy(Xapian::valueno slot_,
+			     double start, double step,
+			     unsigned num_buckets,
+			     bool logarithmic = false);
+
+    /// Destructor.
+    ~NumericHistogramMatchSpy();
+
+    /// Return the total number of documents tallied.
+    Xapian::doccount get_total() const;
+
+    /// Return the number of documents with a value in the slot.
+    Xapian::doccount get_count() const;
+
+    /** Return the smallest value seen.
+     *
+     *  If get_count() is 0, this returns +infinity.
+     */
+    double get_min() const;
+
+    /** Return the largest value seen.
+     *
+     *  If get_count() is 0, this returns -infinity.
+     */
+    double get_max() const;
+
+    /// Return the sum of the values seen.
+    double get_sum() const;
+
+    /// Return the number of buckets.
+    unsigned get_num_buckets() const;
+
+    /** Return the start of bucket @a i.
+     *
+     *  Bucket @a i contains values >= get_bucket_start(i) and <
+     *  get_bucket_start(i + 1), so get_bucket_start(get_num_buckets()) is
+     *  the end of the last bucket.
+     */
+    double get_bucket_start(unsigned i) const;
+
+    /// Return the number of values in bucket @a i.
+    Xapian::doccount get_bucket_count(unsigned i) const;
+
+    /// Return the number of values before the first bucket.
+    Xapian::doccount get_underflow_count() const;
+
+    /// Return the number of values after the last bucket.
+    Xapian::doccount get_overflow_count() const;
+
+    /** Implementation of virtual operator().
+     *
+     *  This implementation adds the value for a matching document to the
+     *  histogram.
+     *
+     *  @param doc	The document to tally values for.
+     *  @param wt	The weight of the document (ignored by this class).
+     */
+    void operator()(const Xapian::Document &doc, double wt);
+
+    virtual MatchSpy * clone() const;
+    virtual std::string name() const;
+    virtual std::string serialise() const;
+    virtual MatchSpy * unserialise(const std::string & serialised,
+				   const Registry & context) const;
+    virtual std::string serialise_results() const;
+    virtual void merge_results(const std::string & serialised);
+    virtual std::string get_description() const;
+};
+
 }
 
 #endif // XAPIAN_INCLUDED_MATCHSPY_H
@@ -0,0 +1,135 @@
+/** @file querystats.h
+ * @brief Statistics about the work done to run a query.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_QUERYSTATS_H
+#define XAPIAN_INCLUDED_QUERYSTATS_H
+
+#if !defined XAPIAN_INCLUDED_XAPIAN_H && !defined XAPIAN_LIB_BUILD
+# error "Never use <xapian/querystats.h> directly; include <xapian.h> instead."
+#endif
+
+#include <string>
+#include <xapian/attributes.h>
+#include <xapian/intrusive_ptr.h>
+#include <xapian/types.h>
+#include <xapian/visibility.h>
+
+namespace Xapian {
+
+/** Statistics about the work done to run a query.
+ *
+ *  Pass one of these to Enquire::set_query_stats() and each call to
+ *  Enquire::get_mset() will fill it in, which can help to explain why one
+ *  query is much slower than another.
+ *
+ *  The counts include the work done by remote databases, and by any worker
+ *  threads (see Enquire::set_match_threads()).  The times are measured in
+ *  the calling thread, so for remote databases they include the time spent
+ *  waiting for the server.
+ *
+ *  Block reads and postings decoded are currently only counted for brass
+ *  databases, and only for the postlists the match opens - blocks read to
+ *  look up term statistics or document lengths aren't included.
+ */
+class XAPIAN_VISIBILITY_DEFAULT QueryStats {
+  public:
+    /// Class representing the statistics.
+    class Internal;
+
+    /// @private @internal Reference counted internals.
+    Xapian::Internal::intrusive_ptr<Internal> internal;
+
+    /// Default constructor.
+    QueryStats();
+
+    /// Copy constructor.
+    QueryStats(const QueryStats & other);
+
+    /// Assignment.
+    QueryStats & operator=(const QueryStats & other);
+
+    /// Destructor.
+    ~QueryStats();
+
+    /// Reset all the statistics to zero.
+    void clear();
+
+    /** The number of blocks read from a table.
+     *
+     *  This includes blocks read from a memory mapping (see Xapian::DB_MMAP)
+     *  or found in the block cache, but not blocks which were already in a
+     *  cursor.
+     *
+     *  @param table	The name of the table - "postlist", "position",
+     *			"record", "spelling", "synonym" or "termlist".
+     *			For any other name, 0 is returned.
+     */
+    unsigned long get_blocks_read(const std::string & table) const XAPIAN_PURE_FUNCTION;
+
+    /** The number of blocks read from a table which were found in the
+     *  block cache.
+     *
+     *  @param table	The name of the table, as for get_blocks_read().
+     */
+    unsigned long get_block_cache_hits(const std::string & table) const XAPIAN_PURE_FUNCTION;
+
+    /// The number of postlist entries decoded.
+    unsigned long get_postings_decoded() const XAPIAN_PURE_FUNCTION;
+
+    /// The number of calls to skip_to() on postlists for terms.
+    unsigned long get_skip_to_calls() const XAPIAN_PURE_FUNCTION;
+
+    /// The number of candidate documents the matcher calculated weights for.
+    Xapian::doccount get_documents_scored() const XAPIAN_PURE_FUNCTION;
+
+    /** The number of candidate documents rejected because their weight was
+     *  below the minimum needed to make the results.
+     */
+    Xapian::doccount get_documents_rejected() const XAPIAN_PURE_FUNCTION;
+
+    /** The number of document values fetched during the match.
+     *
+     *  Values are fetched to sort or collapse on, and by any
+     *  Xapian::MatchSpy objects in use.
+     */
+    unsigned long get_values_fetched() const XAPIAN_PURE_FUNCTION;
+
+    /** The time in seconds spent preparing the match.
+     *
+     *  This includes looking up the statistics for the query terms in each
+     *  sub-database.
+     */
+    double get_prepare_time() const XAPIAN_PURE_FUNCTION;
+
+    /// The time in seconds spent building the postlist trees.
+    double get_postlist_time() const XAPIAN_PURE_FUNCTION;
+
+    /// The time in seconds spent finding the matching documents.
+    double get_match_time() const XAPIAN_PURE_FUNCTION;
+
+    /// The time in seconds spent building the MSet from the matches found.
+    double get_mset_time() const XAPIAN_PURE_FUNCTION;
+
+    /// Return a string describing this object.
+    std::string get_description() const XAPIAN_PURE_FUNCTION;
+};
+
+}
+
+#endif /* XAPIAN_INCLUDED_QUERYSTATS_H */
@@ -0,0 +1,119 @@
+/** @file shardedwriter.h
+ * @brief Index documents from several threads, then merge the results.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_SHARDEDWRITER_H
+#define XAPIAN_INCLUDED_SHARDEDWRITER_H
+
+#if !defined XAPIAN_INCLUDED_XAPIAN_H && !defined XAPIAN_LIB_BUILD
+# error "Never use <xapian/shardedwriter.h> directly; include <xapian.h> instead."
+#endif
+
+#include <xapian/intrusive_ptr.h>
+#include <xapian/types.h>
+#include <xapian/visibility.h>
+#include <string>
+
+namespace Xapian {
+
+class Compactor;
+class Document;
+
+/** Index documents from several threads, then merge the results.
+ *
+ *  A WritableDatabase can only be updated by one thread at a time.  This
+ *  class allows documents to be added from any number of threads at once,
+ *  by spreading them over several temporary brass databases ("shards"),
+ *  each of which buffers and writes its changes independently.  Once all
+ *  the documents have been added, finish() merges the shards into a single
+ *  new database using Xapian::Compactor, and removes them.
+ *
+ *  The document ids in the merged database are contiguous, but needn't be
+ *  in the order the documents were added.  If you need to identify
+ *  documents, give each a unique term.
+ */
+class XAPIAN_VISIBILITY_DEFAULT ShardedWriter {
+  public:
+    /// Class containing the implementation.
+    class Internal;
+
+  private:
+    /// @internal Reference counted internals.
+    Xapian::Internal::intrusive_ptr<Internal> internal;
+
+  public:
+    /** Create the shards.
+     *
+     *  @param destdir	Where finish() should write the merged database.
+     *			The shards are created alongside, at @a destdir
+     *			with ".shard" and a number appended, and
+     *			Xapian::DatabaseCreateError is thrown if any of
+     *			those paths already exists.
+     *  @param n_shards	The number of shards to create.  There's no point
+     *			in this being more than the number of threads which
+     *			will be adding documents.
+     */
+    ShardedWriter(const std::string & destdir, unsigned n_shards);
+
+    /** Destroy the ShardedWriter.
+     *
+     *  If finish() hasn't been called, the shards are removed without
+     *  creating the merged database.
+     */
+    ~ShardedWriter();
+
+    /** Add a new document.
+     *
+     *  This method may be called from several threads at once - the
+     *  document is added to a shard which no other thread is currently
+     *  using, if there is one.  The document itself mustn't be in use by
+     *  any other thread during the call.
+     *
+     *  @param document	The new document to be added.
+     */
+    void add_document(const Xapian::Document & document);
+
+    /** Merge the shards into the destination database.
+     *
+     *  This commits the changes to each shard, merges them using
+     *  @a compactor (so its options and progress reporting apply), and
+     *  then removes the shards.  It must only be called once, after all
+     *  the documents have been added.
+     *
+     *  If the merge fails, an exception is thrown and the shards are kept,
+     *  so finish() can be called again (with a compactor which doesn't
+     *  already have the shards added as sources) once the problem has been
+     *  dealt with.  Documents can't be added after a failed call.
+     *
+     *  @param compactor	The compactor to use.  Sources added to it
+     *			before this call are merged too, before the
+     *			shards.
+     */
+    void finish(Xapian::Compactor & compactor);
+
+    /** Merge the shards into the destination database.
+     *
+     *  This is the same as finish(Xapian::Compactor &) with a
+     *  Xapian::Compactor using the default settings.
+     */
+    void finish();
+};
+
+}
+
+#endif /* XAPIAN_INCLUDED_SHARDEDWRITER_H */
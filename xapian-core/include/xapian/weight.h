@@ -268,6 +268,16 @@ class XAPIAN_VISIBILITY_DEFAULT Weight {
 	return stats_needed & WDF;
     }
 
+    /** @private @internal Return an upper bound on what get_sumpart() can
+     *  return for a document in which the wdf is at most @a wdf_max.
+     *
+     *  This calls get_maxpart_for_wdf() if @a wdf_max is lower than the
+     *  upper bound on the wdf for the whole database, and get_maxpart()
+     *  otherwise.  Backends which store the maximum wdf in each block of
+     *  postings can use it to skip blocks which can't score highly enough.
+     */
+    double get_maxpart_for_wdf_(Xapian::termcount wdf_max) const;
+
   protected:
     /** Don't allow copying.
      *
@@ -279,6 +289,15 @@ class XAPIAN_VISIBILITY_DEFAULT Weight {
     /// Default constructor, needed by subclass constructors.
     Weight() : stats_needed() { }
 
+    /** Return an upper bound on what get_sumpart() can return for a
+     *  document in which the wdf is at most @a wdf_max.
+     *
+     *  @a wdf_max is less than get_wdf_upper_bound().  Overriding this
+     *  allows blocks of postings which can't score highly enough to be
+     *  skipped.  The default implementation returns get_maxpart().
+     */
+    virtual double get_maxpart_for_wdf(Xapian::termcount wdf_max) const;
+
     /// The number of documents in the collection.
     Xapian::doccount get_collection_size() const { return collection_size_; }
 
@@ -446,6 +465,9 @@ class XAPIAN_VISIBILITY_DEFAULT TfIdfWeight : public Weight {
 
     double get_sumextra(Xapian::termcount doclen) const;
     double get_maxextra() const;
+
+  protected:
+    double get_maxpart_for_wdf(Xapian::termcount wdf_max) const;
 };
 
 
@@ -549,6 +571,9 @@ class XAPIAN_VISIBILITY_DEFAULT BM25Weight : public Weight {
 
     double get_sumextra(Xapian::termcount doclen) const;
     double get_maxextra() const;
+
+  protected:
+    double get_maxpart_for_wdf(Xapian::termcount wdf_max) const;
 };
 
 /** Xapian::Weight subclass implementing the traditional probabilistic formula.
@@ -608,6 +633,9 @@ class XAPIAN_VISIBILITY_DEFAULT TradWeight : public Weight {
 
     double get_sumextra(Xapian::termcount doclen) const;
     double get_maxextra() const;
+
+  protected:
+    double get_maxpart_for_wdf(Xapian::termcount wdf_max) const;
 };
 
 /** This class implements the InL2 weighting scheme.
@@ -4,6 +4,7 @@ noinst_HEADERS +=\
 	matcher/branchpostlist.h\
 	matcher/collapser.h\
 	matcher/const_database_wrapper.h\
+	matcher/docidrangepostlist.h\
 	matcher/exactphrasepostlist.h\
 	matcher/externalpostlist.h\
 	matcher/extraweightpostlist.h\
@@ -14,6 +15,7 @@ noinst_HEADERS +=\
 	matcher/msetpostlist.h\
 	matcher/multiandpostlist.h\
 	matcher/multimatch.h\
+	matcher/multiorpostlist.h\
 	matcher/multixorpostlist.h\
 	matcher/orpostlist.h\
 	matcher/phrasepostlist.h\
@@ -52,6 +54,7 @@ lib_src +=\
 	matcher/msetpostlist.cc\
 	matcher/multiandpostlist.cc\
 	matcher/multimatch.cc\
+	matcher/multiorpostlist.cc\
 	matcher/multixorpostlist.cc\
 	matcher/orpostlist.cc\
 	matcher/phrasepostlist.cc\
@@ -110,9 +110,10 @@ ConstDatabaseWrapper::has_positions() const
 }
 
 LeafPostList *
-ConstDatabaseWrapper::open_post_list(const string & tname) const
+ConstDatabaseWrapper::open_post_list(const string & tname,
+				     Xapian::QueryStats::Internal * stats) const
 {
-    return realdb->open_post_list(tname);
+    return realdb->open_post_list(tname, stats);
 }
 
 ValueList *
@@ -146,6 +147,13 @@ ConstDatabaseWrapper::open_document(Xapian::docid did, bool lazy) const
     return realdb->open_document(did, lazy);
 }
 
+void
+ConstDatabaseWrapper::open_documents(const std::vector<Xapian::docid> & dids,
+				     std::vector<Xapian::Document> & docs) const
+{
+    realdb->open_documents(dids, docs);
+}
+
 TermList *
 ConstDatabaseWrapper::open_spelling_termlist(const string & word) const
 {
@@ -61,7 +61,8 @@ class ConstDatabaseWrapper : public Xapian::Database::Internal {
     std::string get_value_upper_bound(Xapian::valueno slot) const;
     bool term_exists(const string & tname) const;
     bool has_positions() const;
-    LeafPostList * open_post_list(const string & tname) const;
+    LeafPostList * open_post_list(const string & tname,
+				  Xapian::QueryStats::Internal * stats) const;
     ValueList * open_value_list(Xapian::valueno slot) const;
     TermList * open_term_list(Xapian::docid did) const;
     TermList * open_allterms(const string & prefix) const;
@@ -69,6 +70,8 @@ class ConstDatabaseWrapper : public Xapian::Database::Internal {
 				      const string & tname) const;
     Xapian::Document::Internal *
 	open_document(Xapian::docid did, bool lazy) const;
+    void open_documents(const std::vector<Xapian::docid> & dids,
+			std::vector<Xapian::Document> & docs) const;
     TermList * open_spelling_termlist(const string & word) const;
     TermList * open_spelling_wordlist() const;
     Xapian::doccount get_spelling_frequency(const string & word) const;
@@ -0,0 +1,131 @@
+/** @file docidrangepostlist.h
+ * @brief Return only the documents from a postlist in a range of docids
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_DOCIDRANGEPOSTLIST_H
+#define XAPIAN_INCLUDED_DOCIDRANGEPOSTLIST_H
+
+#include "branchpostlist.h"
+#include "multimatch.h"
+#include "str.h"
+
+/** A postlist which only returns documents in a range of docids.
+ *
+ *  This is used to split the match for a database between several threads.
+ */
+class DocidRangePostList : public PostList {
+    /// Don't allow assignment.
+    void operator=(const DocidRangePostList &);
+
+    /// Don't allow copying.
+    DocidRangePostList(const DocidRangePostList &);
+
+    PostList * pl;
+
+    /// The first docid in the range.
+    Xapian::docid first_did;
+
+    /// The last docid in the range.
+    Xapian::docid last_did;
+
+    /// The fraction of the database's docid space the range covers.
+    double fraction;
+
+    MultiMatch * matcher;
+
+    /// Have we moved to the start of the range yet?
+    bool started;
+
+  public:
+    /** Construct.
+     *
+     *  @param pl_	    The postlist to return documents from.
+     *  @param first_did_   The first docid in the range.
+     *  @param last_did_    The last docid in the range.
+     *  @param db_lastdocid The highest docid in the database (used to scale
+     *			    the termfreq estimate).
+     *  @param matcher_	    The matcher, which is told if pl_ is pruned.
+     */
+    DocidRangePostList(PostList * pl_, Xapian::docid first_did_,
+		       Xapian::docid last_did_, Xapian::docid db_lastdocid,
+		       MultiMatch * matcher_)
+	: pl(pl_), first_did(first_did_), last_did(last_did_),
+	  fraction(1.0), matcher(matcher_), started(false)
+    {
+	if (first_did > 1 || last_did < db_lastdocid)
+	    fraction = double(last_did - first_did + 1) / db_lastdocid;
+    }
+
+    ~DocidRangePostList() { delete pl; }
+
+    Xapian::doccount get_termfreq_min() const {
+	// We don't know how many of the documents are in our range.
+	return 0;
+    }
+
+    Xapian::doccount get_termfreq_max() const {
+	Xapian::doccount range_size = last_did - first_did + 1;
+	return std::min(pl->get_termfreq_max(), range_size);
+    }
+
+    Xapian::doccount get_termfreq_est() const {
+	return Xapian::doccount(pl->get_termfreq_est() * fraction + 0.5);
+    }
+
+    double get_maxweight() const { return pl->get_maxweight(); }
+
+    Xapian::docid get_docid() const { return pl->get_docid(); }
+
+    Xapian::termcount get_doclength() const { return pl->get_doclength(); }
+
+    Xapian::termcount get_wdf() const { return pl->get_wdf(); }
+
+    double get_weight() const { return pl->get_weight(); }
+
+    bool at_end() const {
+	return pl->at_end() || pl->get_docid() > last_did;
+    }
+
+    double recalc_maxweight() { return pl->recalc_maxweight(); }
+
+    PositionList * read_position_list() { return pl->read_position_list(); }
+
+    PostList * next(double w_min) {
+	if (!started) return skip_to(first_did, w_min);
+	(void)next_handling_prune(pl, w_min, matcher);
+	return NULL;
+    }
+
+    PostList * skip_to(Xapian::docid did, double w_min) {
+	started = true;
+	if (did < first_did) did = first_did;
+	(void)skip_to_handling_prune(pl, did, w_min, matcher);
+	return NULL;
+    }
+
+    Xapian::termcount count_matching_subqs() const {
+	return pl->count_matching_subqs();
+    }
+
+    std::string get_description() const {
+	return "(DocidRange " + str(first_did) + ".." + str(last_did) + " " +
+	       pl->get_description() + ")";
+    }
+};
+
+#endif // XAPIAN_INCLUDED_DOCIDRANGEPOSTLIST_H
@@ -27,6 +27,7 @@
 #include "debuglog.h"
 #include "api/emptypostlist.h"
 #include "extraweightpostlist.h"
+#include "multimatch.h"
 #include "api/leafpostlist.h"
 #include "omassert.h"
 #include "queryoptimiser.h"
@@ -65,6 +66,19 @@ LocalSubMatch::start_match(Xapian::doccount first,
     stats = &total_stats;
 }
 
+LocalSubMatch *
+LocalSubMatch::for_snapshot(const Xapian::Database::Internal * db_) const
+{
+    LOGCALL(MATCH, LocalSubMatch *, "LocalSubMatch::for_snapshot", db_);
+    LocalSubMatch * copy =
+	new LocalSubMatch(db_, query, qlen, rset, wt_factory);
+    // Building a postlist tree adds to the max_part statistics, so the copy
+    // needs its own statistics to avoid counting terms twice.
+    copy->snapshot_stats.reset(new Xapian::Weight::Internal(*stats));
+    copy->stats = copy->snapshot_stats.get();
+    RETURN(copy);
+}
+
 PostList *
 LocalSubMatch::get_postlist(MultiMatch * matcher,
 			    Xapian::termcount * total_subqs_ptr)
@@ -78,7 +92,7 @@ LocalSubMatch::get_postlist(MultiMatch * matcher,
     // LocalSubMatch::open_post_list() for each term in the query.
     PostList * pl;
     {
-	QueryOptimiser opt(*db, *this, matcher);
+	QueryOptimiser opt(*db, *this, matcher, matcher->get_query_stats());
 	pl = query.internal->postlist(&opt, 1.0);
 	*total_subqs_ptr = opt.get_total_subqs();
     }
@@ -125,9 +139,10 @@ LeafPostList *
 LocalSubMatch::open_post_list(const string& term,
 			      Xapian::termcount wqf,
 			      double factor,
-			      LeafPostList ** hint)
+			      LeafPostList ** hint,
+			      Xapian::QueryStats::Internal * query_stats)
 {
-    LOGCALL(MATCH, LeafPostList *, "LocalSubMatch::open_post_list", term | wqf | factor | hint);
+    LOGCALL(MATCH, LeafPostList *, "LocalSubMatch::open_post_list", term | wqf | factor | hint | (void*)query_stats);
 
     bool weighted = (factor != 0.0 && !term.empty());
     AutoPtr<Xapian::Weight> wt(weighted ? wt_factory->clone() : NULL);
@@ -146,16 +161,17 @@ LocalSubMatch::open_post_list(const string& term,
 		// documents, we can replace it with the MatchAll postlist,
 		// which is especially efficient if there are no gaps in the
 		// docids.
-		pl = db->open_post_list(string());
+		pl = db->open_post_list(string(), query_stats);
 	    }
 	}
     }
 
     if (!pl) {
+	// A nearby postlist counts its work in the same place as the hint.
 	if (*hint)
 	    pl = (*hint)->open_nearby_postlist(term);
 	if (!pl)
-	    pl = db->open_post_list(term);
+	    pl = db->open_post_list(term, query_stats);
 	*hint = pl;
     }
 
@@ -22,10 +22,12 @@
 #ifndef XAPIAN_INCLUDED_LOCALSUBMATCH_H
 #define XAPIAN_INCLUDED_LOCALSUBMATCH_H
 
+#include "autoptr.h"
 #include "backends/database.h"
 #include "debuglog.h"
 #include "api/queryinternal.h"
 #include "submatch.h"
+#include "weight/weightinternal.h"
 #include "xapian/enquire.h"
 #include "xapian/weight.h"
 
@@ -41,6 +43,9 @@ class LocalSubMatch : public SubMatch {
     /// The statistics for the collection.
     Xapian::Weight::Internal * stats;
 
+    /// Our own copy of the statistics, if set by for_snapshot().
+    AutoPtr<Xapian::Weight::Internal> snapshot_stats;
+
     /// The original query before any rearrangement.
     Xapian::Query query;
 
@@ -72,6 +77,13 @@ class LocalSubMatch : public SubMatch {
 	LOGCALL_CTOR(MATCH, "LocalSubMatch", db_ | query_ | qlen_ | rset_ | wt_factory_);
     }
 
+    /** Make a copy of this submatch which runs against @a db_.
+     *
+     *  @a db_ must be open on the same revision of the same database, since
+     *  the statistics already collated for this submatch are reused.
+     */
+    LocalSubMatch * for_snapshot(const Xapian::Database::Internal * db_) const;
+
     /// Fetch and collate statistics.
     bool prepare_match(bool nowait, Xapian::Weight::Internal & total_stats);
 
@@ -90,10 +102,16 @@ class LocalSubMatch : public SubMatch {
     PostList * make_synonym_postlist(PostList * or_pl, MultiMatch * matcher,
 				     double factor);
 
+    /** Open the postlist for @a term.
+     *
+     *  @param query_stats	Where the postlist should count its work, or
+     *				NULL.
+     */
     LeafPostList * open_post_list(const std::string& term,
 				  Xapian::termcount wqf,
 				  double factor,
-				  LeafPostList ** hint);
+				  LeafPostList ** hint,
+				  Xapian::QueryStats::Internal * query_stats);
 };
 
 #endif /* XAPIAN_INCLUDED_LOCALSUBMATCH_H */
@@ -51,10 +51,19 @@ class MSetPostList : public PostList {
      */
     bool decreasing_relevance;
 
+    /** Do the MSet items have their sort keys set?
+     *
+     *  This is true for an MSet from a local match which sorted by value,
+     *  but sort keys aren't passed back by the remote backend.
+     */
+    bool have_sort_keys;
+
   public:
-    MSetPostList(const Xapian::MSet mset, bool decreasing_relevance_)
+    MSetPostList(const Xapian::MSet mset, bool decreasing_relevance_,
+		 bool have_sort_keys_ = false)
 	: cursor(-1), mset_internal(mset.internal),
-	  decreasing_relevance(decreasing_relevance_) { }
+	  decreasing_relevance(decreasing_relevance_),
+	  have_sort_keys(have_sort_keys_) { }
 
     Xapian::doccount get_termfreq_min() const;
 
@@ -70,6 +79,8 @@ class MSetPostList : public PostList {
 
     const string * get_collapse_key() const;
 
+    const string * get_sort_key() const;
+
     /// Not implemented for MSetPostList.
     Xapian::termcount get_doclength() const;
 
@@ -30,11 +30,16 @@
 #include "autoptr.h"
 #include "collapser.h"
 #include "debuglog.h"
+#include "docidrangepostlist.h"
 #include "submatch.h"
 #include "localsubmatch.h"
+#include "msetpostlist.h"
+#include "mutex.h"
 #include "omassert.h"
 #include "api/omenquireinternal.h"
+#include "api/querystatsinternal.h"
 #include "realtime.h"
+#include "threadpool.h"
 
 #include "api/emptypostlist.h"
 #include "branchpostlist.h"
@@ -265,6 +270,141 @@ MultipleMatchSpy::operator()(const Xapian::Document &doc, double wt) {
     }
 }
 
+/** How often to check the minimum weight shared by other threads.
+ *
+ *  This is a number of candidate documents.  Checking takes a lock, so we
+ *  don't want to do it for every candidate.
+ */
+const unsigned SHARED_MIN_WEIGHT_CHECK_INTERVAL = 64;
+
+/// Minimum weight shared between the matches for several sub-databases.
+class SharedMinWeight {
+    Mutex mutex;
+
+    double min_weight;
+
+  public:
+    SharedMinWeight() : min_weight(0.0) { }
+
+    double get() {
+	MutexLock lock(mutex);
+	return min_weight;
+    }
+
+    void raise(double w) {
+	MutexLock lock(mutex);
+	if (w > min_weight) min_weight = w;
+    }
+};
+
+/// Does @a query use a PostingSource anywhere?
+static bool
+uses_posting_source(const Xapian::Query & query)
+{
+    if (query.get_type() == Xapian::Query::LEAF_POSTING_SOURCE) return true;
+    for (size_t i = 0; i != query.get_num_subqueries(); ++i) {
+	if (uses_posting_source(query.get_subquery(i))) return true;
+    }
+    return false;
+}
+
+/// Match one local sub-database, or a range of docids in it, in a worker thread.
+class ShardMatchJob : public ThreadJob {
+    /// Our own copies of the matchspies, since they can't be shared.
+    vector<Xapian::MatchSpy *> spies;
+
+    /// The matcher for this sub-database.
+    MultiMatch matcher;
+
+    /// The postlist tree (ownership passes to run_match()).
+    vector<PostList *> postlists;
+
+    Xapian::termcount total_subqs;
+
+    Xapian::doccount maxitems, check_at_least;
+
+    double time_limit;
+
+  public:
+    /// The results of the match.
+    Xapian::MSet mset;
+
+    /// Any exception thrown by the match.
+    ThreadJobError error;
+
+    /// The statistics for this job, if the parent is collecting them.
+    Xapian::QueryStats::Internal stats;
+
+    ShardMatchJob(const MultiMatch & parent, size_t shard,
+		  Xapian::Database::Internal * snapshot,
+		  SharedMinWeight * shared_min_weight)
+	: matcher(parent, shard, snapshot, spies, shared_min_weight,
+		  parent.query_stats ? &stats : NULL),
+	  total_subqs(0), maxitems(0), check_at_least(0), time_limit(0)
+    {
+	// MatchSpy::clone() throws UnimplementedError if not supported.
+	try {
+	    spies.reserve(parent.matchspies.size());
+	    for (size_t i = 0; i != parent.matchspies.size(); ++i) {
+		spies.push_back(parent.matchspies[i]->clone());
+	    }
+	} catch (...) {
+	    for (size_t i = 0; i != spies.size(); ++i) delete spies[i];
+	    throw;
+	}
+    }
+
+    ~ShardMatchJob() {
+	// Only non-empty if run() was never called.
+	for (size_t i = 0; i != postlists.size(); ++i) delete postlists[i];
+	for (size_t i = 0; i != spies.size(); ++i) delete spies[i];
+    }
+
+    /** Build the postlist tree.
+     *
+     *  This must be done in the calling thread, as it updates the shared
+     *  statistics.  The results of the match will be merged, so each
+     *  job needs the top first + maxitems documents.
+     *
+     *  If @a last_did is non-zero, only documents with ids from
+     *  @a first_did to @a last_did are matched.
+     */
+    void build_postlist(Xapian::doccount first,
+			Xapian::doccount maxitems_,
+			Xapian::doccount check_at_least_,
+			double time_limit_,
+			Xapian::docid first_did, Xapian::docid last_did) {
+	maxitems = first + maxitems_;
+	check_at_least = first + check_at_least_;
+	time_limit = time_limit_;
+	postlists.push_back(NULL);
+	PostList * pl = matcher.leaves[0]->get_postlist(&matcher, &total_subqs);
+	if (last_did) {
+	    pl = new DocidRangePostList(pl, first_did, last_did,
+					matcher.db.get_lastdocid(), &matcher);
+	}
+	postlists[0] = pl;
+    }
+
+    void run() {
+	try {
+	    TimeOut timeout(time_limit);
+	    matcher.run_match(postlists, total_subqs, 0, timeout,
+			      0, maxitems, check_at_least, mset, NULL, NULL);
+	} catch (...) {
+	    error.record();
+	}
+	postlists.clear();
+    }
+
+    /// Merge the results from our matchspies into @a matchspies.
+    void merge_spies(const vector<Xapian::MatchSpy *> & matchspies) const {
+	for (size_t i = 0; i != spies.size(); ++i) {
+	    matchspies[i]->merge_results(spies[i]->serialise_results());
+	}
+    }
+};
+
 ////////////////////////////////////
 // Initialisation and cleaning up //
 ////////////////////////////////////
@@ -280,10 +420,12 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
 		       Xapian::Enquire::Internal::sort_setting sort_by_,
 		       bool sort_value_forward_,
 		       double time_limit_,
+		       unsigned match_threads_,
 		       Xapian::ErrorHandler * errorhandler_,
 		       Xapian::Weight::Internal & stats,
 		       const Xapian::Weight * weight_,
 		       const vector<Xapian::MatchSpy *> & matchspies_,
+		       Xapian::QueryStats::Internal * query_stats_,
 		       bool have_sorter, bool have_mdecider)
 	: db(db_), query(query_),
 	  collapse_max(collapse_max_), collapse_key(collapse_key_),
@@ -291,15 +433,18 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
 	  order(order_),
 	  sort_key(sort_key_), sort_by(sort_by_),
 	  sort_value_forward(sort_value_forward_),
-	  time_limit(time_limit_),
+	  time_limit(time_limit_), match_threads(match_threads_),
 	  errorhandler(errorhandler_), weight(weight_),
 	  is_remote(db.internal.size()),
-	  matchspies(matchspies_)
+	  matchspies(matchspies_), shared_min_weight(NULL),
+	  query_stats(query_stats_)
 {
-    LOGCALL_CTOR(MATCH, "MultiMatch", db_ | query_ | qlen | omrset | collapse_max_ | collapse_key_ | percent_cutoff_ | weight_cutoff_ | int(order_) | sort_key_ | int(sort_by_) | sort_value_forward_ | time_limit_| errorhandler_ | stats | weight_ | matchspies_ | have_sorter | have_mdecider);
+    LOGCALL_CTOR(MATCH, "MultiMatch", db_ | query_ | qlen | omrset | collapse_max_ | collapse_key_ | percent_cutoff_ | weight_cutoff_ | int(order_) | sort_key_ | int(sort_by_) | sort_value_forward_ | time_limit_ | match_threads_ | errorhandler_ | stats | weight_ | matchspies_ | (void*)query_stats_ | have_sorter | have_mdecider);
 
     if (query.empty()) return;
 
+    double start_time = query_stats ? RealTime::now() : 0.0;
+
     Xapian::doccount number_of_subdbs = db.internal.size();
     vector<Xapian::RSet> subrsets;
     split_rset_by_db(omrset, number_of_subdbs, subrsets);
@@ -352,6 +497,264 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
     stats.mark_wanted_terms(query);
     prepare_sub_matches(leaves, errorhandler, stats);
     stats.set_bounds_from_db(db);
+
+    if (query_stats) query_stats->prepare_time += RealTime::now() - start_time;
+}
+
+MultiMatch::MultiMatch(const MultiMatch & parent, size_t shard,
+		       Xapian::Database::Internal * snapshot,
+		       const vector<Xapian::MatchSpy *> & matchspies_,
+		       SharedMinWeight * shared_min_weight_,
+		       Xapian::QueryStats::Internal * query_stats_)
+	: db(snapshot ? snapshot : parent.db.internal[shard].get()),
+	  query(parent.query),
+	  collapse_max(parent.collapse_max),
+	  collapse_key(parent.collapse_key),
+	  // The percentages depend on the greatest weight over all the
+	  // sub-databases, so the percentage cutoff is applied by the parent.
+	  percent_cutoff(0),
+	  weight_cutoff(parent.weight_cutoff),
+	  order(parent.order),
+	  sort_key(parent.sort_key), sort_by(parent.sort_by),
+	  sort_value_forward(parent.sort_value_forward),
+	  time_limit(parent.time_limit), match_threads(0),
+	  errorhandler(NULL), weight(parent.weight),
+	  recalculate_w_max(false), is_remote(1),
+	  matchspies(matchspies_),
+	  shared_min_weight(shared_min_weight_),
+	  query_stats(query_stats_)
+{
+    LOGCALL_CTOR(MATCH, "MultiMatch", Literal("parent") | shard | snapshot | matchspies_ | shared_min_weight_ | (void*)query_stats_);
+    if (snapshot) {
+	const LocalSubMatch * leaf =
+	    static_cast<const LocalSubMatch *>(parent.leaves[shard].get());
+	leaves.push_back(leaf->for_snapshot(snapshot));
+    } else {
+	leaves.push_back(parent.leaves[shard]);
+    }
+}
+
+bool
+MultiMatch::can_use_threads(bool have_sorter, bool have_mdecider) const
+{
+    LOGCALL(MATCH, bool, "MultiMatch::can_use_threads", have_sorter | have_mdecider);
+    if (match_threads <= 1) RETURN(false);
+
+    // These need objects which we can't safely share between threads.
+    // MatchSpy objects are cloned for each thread if they support that.
+    if (have_sorter || have_mdecider) RETURN(false);
+
+    // Matching the same sub-database in two threads at once isn't safe.
+    set<const Xapian::Database::Internal *> seen;
+    for (size_t i = 0; i != leaves.size(); ++i) {
+	if (!leaves[i].get()) RETURN(false);
+	if (is_remote[i]) continue;
+	if (!seen.insert(db.internal[i].get()).second) RETURN(false);
+    }
+    if (seen.empty()) RETURN(false);
+
+    // A PostingSource which can't be cloned is shared between the postlist
+    // trees for all the sub-databases.
+    RETURN(!uses_posting_source(query));
+}
+
+bool
+MultiMatch::match_in_threads(Xapian::doccount first,
+			     Xapian::doccount maxitems,
+			     Xapian::doccount check_at_least,
+			     vector<PostList *> & postlists,
+			     Xapian::doccount & matches_not_seen)
+{
+    LOGCALL(MATCH, bool, "MultiMatch::match_in_threads", first | maxitems | check_at_least | Literal("postlists") | Literal("matches_not_seen"));
+    // Any document with less weight than the lowest in the top results so
+    // far from one job can't be in the combined top results, so when
+    // sorting primarily by relevance the threads share that minimum.  We
+    // don't share it with a percentage cutoff, as then we need to see each
+    // document which might have the greatest weight.
+    SharedMinWeight shared;
+    bool share = (sort_by == REL || sort_by == REL_VAL) && !percent_cutoff;
+
+    // Share the threads between the local sub-databases.  If there are
+    // more threads than local sub-databases, we split each sub-database into
+    // ranges of docids, each matched using its own snapshot of the database.
+    Xapian::docid n_local = 0;
+    for (size_t i = 0; i != leaves.size(); ++i) {
+	if (!is_remote[i]) ++n_local;
+    }
+    Xapian::docid ranges_per_db = match_threads / n_local;
+    if (ranges_per_db == 0) ranges_per_db = 1;
+
+    // Work out how many ranges to split each sub-database into.
+    vector<vector<Xapian::Database::Internal *> > snapshots(leaves.size());
+    size_t n_jobs = 0;
+    try {
+	for (size_t i = 0; i != leaves.size(); ++i) {
+	    if (is_remote[i]) continue;
+	    Xapian::Database::Internal * subdb = db.internal[i].get();
+	    Xapian::docid n_ranges = min(ranges_per_db, subdb->get_lastdocid());
+	    // The first range uses the sub-database itself.
+	    snapshots[i].push_back(NULL);
+	    while (snapshots[i].size() < n_ranges) {
+		Xapian::Database::Internal * snapshot =
+		    subdb->get_snapshot(snapshots[i].size() - 1);
+		if (!snapshot) break;
+		snapshots[i].push_back(snapshot);
+	    }
+	    n_jobs += snapshots[i].size();
+	}
+    } catch (const Xapian::Error & e) {
+	// Failing to open a snapshot isn't an error for the match, which
+	// can still be run in this thread.
+	LOGLINE(MATCH, "Failed to open snapshot: " << e.get_description());
+	(void)e;
+	RETURN(false);
+    }
+    if (n_jobs < 2) {
+	LOGLINE(MATCH, "Only one job, so not using threads");
+	RETURN(false);
+    }
+
+    // Build the postlist trees here, as that updates the shared statistics
+    // and looks at other sub-databases for bounds on the weights.
+    vector<ThreadJob *> jobs;
+    vector<vector<ShardMatchJob *> > db_jobs(leaves.size());
+    bool ok = true;
+    double start_time = query_stats ? RealTime::now() : 0.0;
+    try {
+	for (size_t i = 0; i != leaves.size(); ++i) {
+	    Xapian::docid n_ranges = snapshots[i].size();
+	    Xapian::docid lastdocid = db.internal[i]->get_lastdocid();
+	    Xapian::docid first_did = 1;
+	    for (Xapian::docid r = 0; r != n_ranges; ++r) {
+		// A single range needs no DocidRangePostList.
+		Xapian::docid last_did = 0;
+		if (n_ranges > 1) {
+		    if (r + 1 == n_ranges) {
+			last_did = lastdocid;
+		    } else {
+			last_did = lastdocid / n_ranges * (r + 1);
+		    }
+		}
+		ShardMatchJob * job = new ShardMatchJob(*this, i,
+							snapshots[i][r],
+							share ? &shared : NULL);
+		db_jobs[i].push_back(job);
+		jobs.push_back(job);
+		job->build_postlist(first, maxitems, check_at_least, time_limit,
+				    first_did, last_did);
+		first_did = last_did + 1;
+	    }
+	}
+    } catch (...) {
+	// Nothing has been matched yet, so build the postlists again in the
+	// calling thread, which reports the error (or passes it to the
+	// ErrorHandler) exactly as it would without threads.
+	ok = false;
+    }
+
+    if (query_stats) {
+	double now = RealTime::now();
+	query_stats->postlist_time += now - start_time;
+	start_time = now;
+    }
+
+    // If a job's match fails, we throw its exception once the jobs have
+    // been cleaned up rather than rerunning the match.
+    const ThreadJobError * error = NULL;
+    if (ok) {
+	run_jobs(jobs, match_threads);
+	for (size_t i = 0; i != jobs.size(); ++i) {
+	    const ThreadJobError & e = static_cast<ShardMatchJob *>(jobs[i])->error;
+	    if (e.failed()) {
+		error = &e;
+		ok = false;
+		break;
+	    }
+	}
+    }
+
+    if (ok) {
+	bool decreasing_relevance = (sort_by == REL || sort_by == REL_VAL);
+	bool sort_forward = (order != Xapian::Enquire::DESCENDING);
+	MSetCmp mcmp(get_msetcmp_function(sort_by, sort_forward,
+					  sort_value_forward));
+	postlists.resize(leaves.size());
+	thread_percent_factors.resize(leaves.size());
+	matches_not_seen = 0;
+	for (size_t i = 0; i != leaves.size(); ++i) {
+	    const vector<ShardMatchJob *> & shard_jobs = db_jobs[i];
+	    if (shard_jobs.empty()) continue;
+	    Xapian::MSet mset = shard_jobs[0]->mset;
+	    if (shard_jobs.size() > 1) {
+		// Combine the results for the ranges of docids.  The combined
+		// results are collapsed again when merged, but a document's
+		// collapse key may be in several ranges, so for the collapsed
+		// lower bound we only know the largest from any range.
+		Xapian::MSet::Internal * m = new Xapian::MSet::Internal;
+		mset = Xapian::MSet(m);
+		double range_max_attained = -1.0;
+		for (size_t j = 0; j != shard_jobs.size(); ++j) {
+		    const Xapian::MSet::Internal & r =
+			*shard_jobs[j]->mset.internal;
+		    if (collapse_max) {
+			m->matches_lower_bound = max(m->matches_lower_bound,
+						     r.matches_lower_bound);
+		    } else {
+			m->matches_lower_bound += r.matches_lower_bound;
+		    }
+		    m->matches_estimated += r.matches_estimated;
+		    m->matches_upper_bound += r.matches_upper_bound;
+		    m->uncollapsed_lower_bound += r.uncollapsed_lower_bound;
+		    m->uncollapsed_estimated += r.uncollapsed_estimated;
+		    m->uncollapsed_upper_bound += r.uncollapsed_upper_bound;
+		    m->max_possible = max(m->max_possible, r.max_possible);
+		    if (r.max_attained > range_max_attained) {
+			range_max_attained = r.max_attained;
+			m->max_attained = r.max_attained;
+			m->percent_factor = r.percent_factor;
+		    }
+		    m->items.insert(m->items.end(),
+				    r.items.begin(), r.items.end());
+		}
+		sort(m->items.begin(), m->items.end(), mcmp);
+	    }
+	    for (size_t j = 0; j != shard_jobs.size(); ++j) {
+		shard_jobs[j]->merge_spies(matchspies);
+	    }
+	    const Xapian::MSet::Internal & m = *mset.internal;
+	    if (m.matches_lower_bound > m.items.size()) {
+		LOGLINE(MATCH, "Found " <<
+			       m.matches_lower_bound - m.items.size() <<
+			       " definite matches in worker threads which "
+			       "aren't passed to local match");
+		matches_not_seen += m.matches_lower_bound - m.items.size();
+	    }
+	    postlists[i] = new MSetPostList(mset, decreasing_relevance,
+					    sort_by != REL);
+	    thread_percent_factors[i] = m.percent_factor;
+	}
+    }
+
+    // If building the postlists failed, that work is counted when it's
+    // redone in the calling thread.  Otherwise count the work done, even if
+    // the match failed, as it still took time.
+    bool count = (ok || error);
+    if (query_stats && count) {
+	for (size_t i = 0; i != jobs.size(); ++i) {
+	    query_stats->add_counts(static_cast<ShardMatchJob *>(jobs[i])->stats);
+	}
+	query_stats->match_time += RealTime::now() - start_time;
+    }
+    if (error) {
+	try {
+	    error->rethrow();
+	} catch (...) {
+	    for (size_t i = 0; i != jobs.size(); ++i) delete jobs[i];
+	    throw;
+	}
+    }
+    for (size_t i = 0; i != jobs.size(); ++i) delete jobs[i];
+    RETURN(ok);
 }
 
 double
@@ -393,6 +796,8 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 
     TimeOut timeout(time_limit);
 
+    double start_time = query_stats ? RealTime::now() : 0.0;
+
 #ifdef XAPIAN_HAS_REMOTE_BACKEND
     // If there's only one database and it's remote, we can just unserialise
     // its MSet and return that.
@@ -400,7 +805,9 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	RemoteSubMatch * rem_match;
 	rem_match = static_cast<RemoteSubMatch*>(leaves[0].get());
 	rem_match->start_match(first, maxitems, check_at_least, stats);
-	rem_match->get_mset(mset);
+	rem_match->get_mset(mset, query_stats);
+	if (query_stats)
+	    query_stats->match_time += RealTime::now() - start_time;
 	return;
     }
 #endif
@@ -424,23 +831,44 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	}
     }
 
+    // If we can, match the local sub-databases in worker threads, and then
+    // merge their results like those from remote sub-databases.
+    vector<PostList *> thread_postlists;
+    Xapian::doccount definite_matches_not_seen = 0;
+    if (check_at_least && can_use_threads(sorter != NULL, mdecider != NULL)) {
+	// match_in_threads() records its own times.
+	if (query_stats) query_stats->postlist_time += RealTime::now() - start_time;
+	if (!match_in_threads(first, maxitems, check_at_least,
+			      thread_postlists, definite_matches_not_seen)) {
+	    LOGLINE(MATCH, "Not matching in threads, running in this thread");
+	    thread_postlists.clear();
+	    thread_percent_factors.clear();
+	    definite_matches_not_seen = 0;
+	}
+	if (query_stats) start_time = RealTime::now();
+    }
+
     // Get postlists and term info
     vector<PostList *> postlists;
     Xapian::termcount total_subqs = 0;
     // Keep a count of matches which we know exist, but we won't see.  This
-    // occurs when a submatch is remote, and returns a lower bound on the
-    // number of matching documents which is higher than the number of
-    // documents it returns (because it wasn't asked for more documents).
-    Xapian::doccount definite_matches_not_seen = 0;
+    // occurs when a submatch is remote (or was matched in a worker thread),
+    // and returns a lower bound on the number of matching documents which is
+    // higher than the number of documents it returns (because it wasn't asked
+    // for more documents).
     for (size_t i = 0; i != leaves.size(); ++i) {
 	PostList *pl;
 	try {
-	    pl = leaves[i]->get_postlist(this, &total_subqs);
+	    if (!thread_postlists.empty() && thread_postlists[i]) {
+		pl = thread_postlists[i];
+	    } else {
+		pl = leaves[i]->get_postlist(this, &total_subqs);
+	    }
 	    if (is_remote[i]) {
 		if (pl->get_termfreq_min() > first + maxitems) {
 		    LOGLINE(MATCH, "Found " <<
 				   pl->get_termfreq_min() - (first + maxitems)
-				   << " definite matches in remote submatch "
+				   << " definite matches in separate submatch "
 				   "which aren't passed to local match");
 		    definite_matches_not_seen += pl->get_termfreq_min();
 		    definite_matches_not_seen -= first + maxitems;
@@ -460,6 +888,26 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     }
     Assert(!postlists.empty());
 
+    if (query_stats) query_stats->postlist_time += RealTime::now() - start_time;
+
+    run_match(postlists, total_subqs, definite_matches_not_seen, timeout,
+	      first, maxitems, check_at_least, mset, mdecider, sorter);
+}
+
+void
+MultiMatch::run_match(vector<PostList *> & postlists,
+		      Xapian::termcount total_subqs,
+		      Xapian::doccount definite_matches_not_seen,
+		      TimeOut & timeout,
+		      Xapian::doccount first, Xapian::doccount maxitems,
+		      Xapian::doccount check_at_least,
+		      Xapian::MSet & mset,
+		      const Xapian::MatchDecider *mdecider,
+		      const Xapian::KeyMaker *sorter)
+{
+    LOGCALL_VOID(MATCH, "MultiMatch::run_match", Literal("postlists") | total_subqs | definite_matches_not_seen | Literal("timeout") | first | maxitems | check_at_least | Literal("mset") | Literal("mdecider") | Literal("sorter"));
+    Assert(!postlists.empty());
+
     ValueStreamDocument vsdoc(db);
     ++vsdoc._refs;
     Xapian::Document doc(&vsdoc);
@@ -478,9 +926,7 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     Xapian::doccount docs_matched = 0;
     double greatest_wt = 0;
     Xapian::termcount greatest_wt_subqs_matched = 0;
-#ifdef XAPIAN_HAS_REMOTE_BACKEND
     unsigned greatest_wt_subqs_db_num = UINT_MAX;
-#endif
     vector<Xapian::Internal::MSetItem> items;
 
     // maximum weight a document could possibly have
@@ -582,9 +1028,37 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     // Is the mset a valid heap?
     bool is_heap = false;
 
+    // Countdown to the next check of the minimum weight shared with matches
+    // for other sub-databases.
+    unsigned shared_check = SHARED_MIN_WEIGHT_CHECK_INTERVAL;
+
+    // Counts for query_stats - cheaper to keep here than to update it as
+    // we go.
+    Xapian::doccount docs_scored = 0;
+    Xapian::doccount docs_rejected = 0;
+    double start_time = query_stats ? RealTime::now() : 0.0;
+
     while (true) {
 	bool pushback;
 
+	if (shared_min_weight && rare(--shared_check == 0)) {
+	    shared_check = SHARED_MIN_WEIGHT_CHECK_INTERVAL;
+	    // Only prune using the shared minimum weight once we're in the
+	    // second stage, so the bounds we calculate below remain valid.
+	    if (items.size() >= max_msize && docs_matched >= check_at_least) {
+		double w = shared_min_weight->get();
+		if (w > min_weight) {
+		    LOGLINE(MATCH, "Setting min_weight to " << w <<
+			    " from " << min_weight << " (shared)");
+		    min_weight = w;
+		    if (rare(getorrecalc_maxweight(pl.get()) < min_weight)) {
+			LOGLINE(MATCH, "*** TERMINATING EARLY (4)");
+			break;
+		    }
+		}
+	    }
+	}
+
 	if (rare(recalculate_w_max)) {
 	    if (min_weight > 0.0) {
 		if (rare(getorrecalc_maxweight(pl.get()) < min_weight)) {
@@ -623,8 +1097,10 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	bool calculated_weight = false;
 	if (sort_by != VAL || min_weight > 0.0) {
 	    wt = pl->get_weight();
+	    ++docs_scored;
 	    if (wt < min_weight) {
 		LOGLINE(MATCH, "Rejecting potential match due to insufficient weight");
+		++docs_rejected;
 		continue;
 	    }
 	    calculated_weight = true;
@@ -639,7 +1115,12 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	}
 
 	if (sort_by != REL) {
-	    if (sorter) {
+	    // The value streams in vsdoc need docids in ascending order, which
+	    // we don't get from an MSetPostList, but it may know the sort key.
+	    const string * key = pl->get_sort_key();
+	    if (key) {
+		new_item.sort_key = *key;
+	    } else if (sorter) {
 		new_item.sort_key = (*sorter)(doc);
 	    } else {
 		new_item.sort_key = vsdoc.get_value(sort_key);
@@ -655,9 +1136,17 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 		    // processing needed.
 		    LOGLINE(MATCH, "Making note of match item which sorts lower than min_item");
 		    ++docs_matched;
-		    if (!calculated_weight) wt = pl->get_weight();
+		    if (!calculated_weight) {
+			wt = pl->get_weight();
+			++docs_scored;
+		    }
 		    if (matchspy) {
-			matchspy->operator()(doc, wt);
+			const unsigned int multiplier = db.internal.size();
+			Xapian::doccount n = (did - 1) % multiplier;
+			// The matchspy will already have seen documents from
+			// a remote database or a worker thread.
+			if (!is_remote[n] && thread_percent_factors.empty())
+			    matchspy->operator()(doc, wt);
 		    }
 		    if (wt > greatest_wt) goto new_greatest_weight;
 		    continue;
@@ -666,7 +1155,10 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 		    // We've seen enough items - we can drop this one.
 		    LOGLINE(MATCH, "Dropping candidate which sorts lower than min_item");
 		    // FIXME: hmm, match decider might have rejected this...
-		    if (!calculated_weight) wt = pl->get_weight();
+		    if (!calculated_weight) {
+			wt = pl->get_weight();
+			++docs_scored;
+		    }
 		    if (wt > greatest_wt) goto new_greatest_weight;
 		    continue;
 		}
@@ -682,9 +1174,10 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	    const unsigned int multiplier = db.internal.size();
 	    Assert(multiplier != 0);
 	    Xapian::doccount n = (did - 1) % multiplier; // which actual database
-	    // If the results are from a remote database, then the functor will
-	    // already have been applied there so we can skip this step.
-	    if (!is_remote[n]) {
+	    // If the results are from a remote database or a worker thread,
+	    // then the functor will already have been applied there so we can
+	    // skip this step.
+	    if (!is_remote[n] && thread_percent_factors.empty()) {
 		++decider_considered;
 		if (mdecider && !mdecider->operator()(doc)) {
 		    ++decider_denied;
@@ -693,6 +1186,7 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 		if (matchspy) {
 		    if (!calculated_weight) {
 			wt = pl->get_weight();
+			++docs_scored;
 			new_item.wt = wt;
 			calculated_weight = true;
 		    }
@@ -704,6 +1198,7 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	if (!calculated_weight) {
 	    // we didn't calculate the weight above, but now we will need it
 	    wt = pl->get_weight();
+	    ++docs_scored;
 	    new_item.wt = wt;
 	}
 
@@ -796,6 +1291,8 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 			    LOGLINE(MATCH, "Setting min_weight to " <<
 				    min_item.wt << " from " << min_weight);
 			    min_weight = min_item.wt;
+			    if (shared_min_weight)
+				shared_min_weight->raise(min_weight);
 			}
 		    }
 		}
@@ -828,20 +1325,15 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	if (wt > greatest_wt) {
 new_greatest_weight:
 	    greatest_wt = wt;
-#ifdef XAPIAN_HAS_REMOTE_BACKEND
 	    const unsigned int multiplier = db.internal.size();
 	    unsigned int db_num = (did - 1) % multiplier;
-	    if (is_remote[db_num]) {
-		// Note that the greatest weighted document came from a remote
-		// database, and which one.
+	    if (is_remote[db_num] || !thread_percent_factors.empty()) {
+		// Note that the greatest weighted document came from a
+		// database which was matched separately, and which one.
 		greatest_wt_subqs_db_num = db_num;
-	    } else
-#endif
-	    {
+	    } else {
 		greatest_wt_subqs_matched = pl->count_matching_subqs();
-#ifdef XAPIAN_HAS_REMOTE_BACKEND
 		greatest_wt_subqs_db_num = UINT_MAX;
-#endif
 	    }
 	    if (percent_cutoff) {
 		double w = wt * percent_cutoff_factor;
@@ -872,17 +1364,30 @@ new_greatest_weight:
     // done with posting list tree
     pl.reset(NULL);
 
+    if (query_stats) {
+	query_stats->documents_scored += docs_scored;
+	query_stats->documents_rejected += docs_rejected;
+	query_stats->values_fetched += vsdoc.values_fetched;
+	double now = RealTime::now();
+	query_stats->match_time += now - start_time;
+	start_time = now;
+    }
+
     double percent_scale = 0;
     if (!items.empty() && greatest_wt > 0) {
-#ifdef XAPIAN_HAS_REMOTE_BACKEND
 	if (greatest_wt_subqs_db_num != UINT_MAX) {
 	    const unsigned int n = greatest_wt_subqs_db_num;
-	    RemoteSubMatch * rem_match;
-	    rem_match = static_cast<RemoteSubMatch*>(leaves[n].get());
-	    percent_scale = rem_match->get_percent_factor() / 100.0;
-	} else
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+	    if (is_remote[n]) {
+		RemoteSubMatch * rem_match;
+		rem_match = static_cast<RemoteSubMatch*>(leaves[n].get());
+		percent_scale = rem_match->get_percent_factor() / 100.0;
+	    } else
 #endif
-	{
+	    {
+		percent_scale = thread_percent_factors[n] / 100.0;
+	    }
+	} else {
 	    percent_scale = greatest_wt_subqs_matched / double(total_subqs);
 	    percent_scale /= greatest_wt;
 	}
@@ -1157,4 +1662,6 @@ new_greatest_weight:
 				       uncollapsed_estimated,
 				       max_possible, greatest_wt, items,
 				       percent_scale * 100.0));
+
+    if (query_stats) query_stats->mset_time += RealTime::now() - start_time;
 }
@@ -29,11 +29,17 @@
 #include <vector>
 
 #include "xapian/query.h"
+#include "xapian/querystats.h"
 #include "xapian/weight.h"
 
+class SharedMinWeight;
+class TimeOut;
+
 class MultiMatch
 {
     private:
+	friend class ShardMatchJob;
+
 	/// Vector of the items.
 	std::vector<Xapian::Internal::intrusive_ptr<SubMatch> > leaves;
 
@@ -59,6 +65,12 @@ class MultiMatch
 
 	double time_limit;
 
+	/** The number of threads to use to match local sub-databases.
+	 *
+	 *  0 or 1 means to run the whole match in the calling thread.
+	 */
+	unsigned match_threads;
+
 	/// ErrorHandler
 	Xapian::ErrorHandler * errorhandler;
 
@@ -76,12 +88,92 @@ class MultiMatch
 	/// The matchspies to use.
 	const vector<Xapian::MatchSpy *> & matchspies;
 
+	/** The percentage factor from the MSet of each local sub-database which
+	 *  was matched in a worker thread (empty if threads weren't used).
+	 */
+	vector<double> thread_percent_factors;
+
+	/** Minimum weight shared with the matches for other sub-databases.
+	 *
+	 *  This is only set for a MultiMatch running in a worker thread, and is
+	 *  NULL otherwise.
+	 */
+	SharedMinWeight * shared_min_weight;
+
+	/// Where to record statistics about the match, or NULL.
+	Xapian::QueryStats::Internal * query_stats;
+
 	/** get the maxweight that the postlist pl may return, calling
 	 *  recalc_maxweight if recalculate_w_max is set, and unsetting it.
 	 *  Must only be called on the top of the postlist tree.
 	 */
 	double getorrecalc_maxweight(PostList *pl);
 
+	/** Can the local sub-databases be matched in worker threads?
+	 *
+	 *  @param have_sorter	 Is there a sorter in use?
+	 *  @param have_mdecider Is there a Xapian::MatchDecider in use?
+	 */
+	bool can_use_threads(bool have_sorter, bool have_mdecider) const;
+
+	/** Match the local sub-databases in worker threads.
+	 *
+	 *  Each local sub-database is matched in one or more worker threads -
+	 *  if we can get snapshots of it, its docid space is split into ranges
+	 *  which are matched separately and the results combined.
+	 *
+	 *  On success, @a postlists has an MSetPostList for each local
+	 *  sub-database, and NULL for each remote one.
+	 *
+	 *  @param[out] matches_not_seen  Set to the number of documents which
+	 *		  are known to match in the worker threads but aren't
+	 *		  returned in @a postlists.
+	 *
+	 *  If the match in a worker thread fails, its exception is rethrown
+	 *  here.
+	 *
+	 *  @return false if building the postlists failed, or there's no work
+	 *		  to share between threads, in which case the match
+	 *		  should be run in the calling thread (so that errors
+	 *		  are reported exactly as they would be otherwise).
+	 */
+	bool match_in_threads(Xapian::doccount first,
+			      Xapian::doccount maxitems,
+			      Xapian::doccount check_at_least,
+			      vector<PostList *> & postlists,
+			      Xapian::doccount & matches_not_seen);
+
+	/** Run the match loop over the postlists for each sub-database.
+	 *
+	 *  Takes ownership of the PostList objects in @a postlists.
+	 */
+	void run_match(vector<PostList *> & postlists,
+		       Xapian::termcount total_subqs,
+		       Xapian::doccount definite_matches_not_seen,
+		       TimeOut & timeout,
+		       Xapian::doccount first,
+		       Xapian::doccount maxitems,
+		       Xapian::doccount check_at_least,
+		       Xapian::MSet & mset,
+		       const Xapian::MatchDecider * mdecider,
+		       const Xapian::KeyMaker * sorter);
+
+	/** Construct a MultiMatch for matching one local sub-database of
+	 *  @a parent in a worker thread.
+	 *
+	 *  @param snapshot	A snapshot of the sub-database to match against,
+	 *			or NULL to use the sub-database itself.
+	 *  @param matchspies_	The matchspies to use (these must not be shared
+	 *			with any other thread).
+	 *  @param query_stats_	Where to record statistics about the match, or
+	 *			NULL.
+	 */
+	MultiMatch(const MultiMatch & parent, size_t shard,
+		   Xapian::Database::Internal * snapshot,
+		   const vector<Xapian::MatchSpy *> & matchspies_,
+		   SharedMinWeight * shared_min_weight_,
+		   Xapian::QueryStats::Internal * query_stats_);
+
 	/// Copying is not permitted.
 	MultiMatch(const MultiMatch &);
 
@@ -97,10 +189,14 @@ class MultiMatch
 	 *  @param omrset    The relevance set (or NULL for no RSet)
 	 *  @param time_limit_ Seconds to reduce check_at_least after (or <= 0
 	 *                     for no limit)
+	 *  @param match_threads_ Number of threads to use to match local
+	 *                     sub-databases (0 or 1 for no extra threads)
 	 *  @param errorhandler Errorhandler object
 	 *  @param stats     The stats object to add our stats to.
 	 *  @param wtscheme  Weighting scheme
 	 *  @param matchspies_ Any the MatchSpy objects in use.
+	 *  @param query_stats_ Where to record statistics about the match (or
+	 *                   NULL)
 	 *  @param have_sorter Is there a sorter in use?
 	 *  @param have_mdecider Is there a Xapian::MatchDecider in use?
 	 */
@@ -117,12 +213,23 @@ class MultiMatch
 		   Xapian::Enquire::Internal::sort_setting sort_by_,
 		   bool sort_value_forward_,
 		   double time_limit_,
+		   unsigned match_threads_,
 		   Xapian::ErrorHandler * errorhandler,
 		   Xapian::Weight::Internal & stats,
 		   const Xapian::Weight *wtscheme,
 		   const vector<Xapian::MatchSpy *> & matchspies_,
+		   Xapian::QueryStats::Internal * query_stats_,
 		   bool have_sorter, bool have_mdecider);
 
+	/** Where to record statistics about the match, or NULL.
+	 *
+	 *  The sub-matches pass this to the postlists they open, so the work
+	 *  done is only counted for this match.
+	 */
+	Xapian::QueryStats::Internal * get_query_stats() const {
+	    return query_stats;
+	}
+
 	/** Run the match and generate an MSet object.
 	 *
 	 *  @param sorter    Xapian::KeyMaker functor (or NULL for no KeyMaker)
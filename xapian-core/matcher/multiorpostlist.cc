@@ -0,0 +1,399 @@
+/** @file multiorpostlist.cc
+ * @brief N-way OR postlist using MaxScore pruning
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "multiorpostlist.h"
+
+#include "debuglog.h"
+#include "multimatch.h"
+#include "omassert.h"
+
+using namespace std;
+
+MultiOrPostList::~MultiOrPostList()
+{
+    for (size_t i = 0; i < n_kids; ++i) {
+	delete plist[i];
+    }
+}
+
+void
+MultiOrPostList::sort_kids()
+{
+    // There aren't usually many sub-postlists, and they're often already in
+    // order, so an insertion sort is a good choice here.
+    for (size_t i = 1; i < n_kids; ++i) {
+	PostList * pl = plist[i];
+	double w = max_wt[i];
+	size_t j = i;
+	while (j != 0 && max_wt[j - 1] > w) {
+	    plist[j] = plist[j - 1];
+	    max_wt[j] = max_wt[j - 1];
+	    --j;
+	}
+	plist[j] = pl;
+	max_wt[j] = w;
+    }
+
+    max_total = 0;
+    for (size_t i = 0; i < n_kids; ++i) {
+	max_total += max_wt[i];
+	max_cum[i] = max_total;
+    }
+}
+
+void
+MultiOrPostList::tidy()
+{
+    LOGCALL_VOID(MATCH, "MultiOrPostList::tidy", NO_ARGS);
+    size_t j = 0;
+    for (size_t i = 0; i < n_kids; ++i) {
+	if (plist[i]->at_end()) {
+	    delete plist[i];
+	} else {
+	    plist[j] = plist[i];
+	    max_wt[j] = plist[j]->recalc_maxweight();
+	    ++j;
+	}
+    }
+    n_kids = j;
+    sort_kids();
+    dirty = false;
+}
+
+void
+MultiOrPostList::next_kid(size_t i, double w_min)
+{
+    PostList * res = plist[i]->next(kid_min(i, w_min));
+    if (res) {
+	delete plist[i];
+	plist[i] = res;
+	dirty = true;
+	if (matcher) matcher->recalc_maxweight();
+    }
+    if (plist[i]->at_end()) {
+	dirty = true;
+	if (matcher) matcher->recalc_maxweight();
+    }
+}
+
+void
+MultiOrPostList::skip_kid(size_t i, Xapian::docid did_min, double w_min)
+{
+    PostList * res = plist[i]->skip_to(did_min, kid_min(i, w_min));
+    if (res) {
+	delete plist[i];
+	plist[i] = res;
+	dirty = true;
+	if (matcher) matcher->recalc_maxweight();
+    }
+    if (plist[i]->at_end()) {
+	dirty = true;
+	if (matcher) matcher->recalc_maxweight();
+    }
+}
+
+Xapian::doccount
+MultiOrPostList::get_termfreq_min() const
+{
+    Xapian::doccount res = plist[0]->get_termfreq_min();
+    for (size_t i = 1; i < n_kids; ++i) {
+	res = std::max(res, plist[i]->get_termfreq_min());
+    }
+    return res;
+}
+
+Xapian::doccount
+MultiOrPostList::get_termfreq_max() const
+{
+    Xapian::doccount res = plist[0]->get_termfreq_max();
+    for (size_t i = 1; i < n_kids; ++i) {
+	Xapian::doccount c = plist[i]->get_termfreq_max();
+	if (db_size - res <= c)
+	    return db_size;
+	res += c;
+    }
+    return res;
+}
+
+Xapian::doccount
+MultiOrPostList::get_termfreq_est() const
+{
+    LOGCALL(MATCH, Xapian::doccount, "MultiOrPostList::get_termfreq_est", NO_ARGS);
+    if (rare(db_size == 0))
+	RETURN(0);
+    // We calculate the estimate assuming independence.  The simplest
+    // way to calculate this seems to be a series of (n_kids - 1) pairwise
+    // calculations, which gives the same answer regardless of the order.
+    double scale = 1.0 / db_size;
+    double P_est = plist[0]->get_termfreq_est() * scale;
+    for (size_t i = 1; i < n_kids; ++i) {
+	double P_i = plist[i]->get_termfreq_est() * scale;
+	P_est += P_i - P_est * P_i;
+    }
+    RETURN(static_cast<Xapian::doccount>(P_est * db_size + 0.5));
+}
+
+TermFreqs
+MultiOrPostList::get_termfreq_est_using_stats(
+	const Xapian::Weight::Internal & stats) const
+{
+    LOGCALL(MATCH, TermFreqs, "MultiOrPostList::get_termfreq_est_using_stats", stats);
+    // We calculate the estimate assuming independence.  The simplest
+    // way to calculate this seems to be a series of (n_kids - 1) pairwise
+    // calculations, which gives the same answer regardless of the order.
+    TermFreqs freqs(plist[0]->get_termfreq_est_using_stats(stats));
+
+    // Our caller should have ensured this.
+    Assert(stats.collection_size);
+    double scale = 1.0 / stats.collection_size;
+    double P_est = freqs.termfreq * scale;
+    double Pr_est = 0;
+    if (stats.rset_size != 0)
+	Pr_est = double(freqs.reltermfreq) / stats.rset_size;
+    double Pc_est = 0;
+    if (stats.total_term_count != 0)
+	Pc_est = double(freqs.collfreq) / stats.total_term_count;
+
+    for (size_t i = 1; i < n_kids; ++i) {
+	freqs = plist[i]->get_termfreq_est_using_stats(stats);
+	double P_i = freqs.termfreq * scale;
+	P_est += P_i - P_est * P_i;
+	if (stats.total_term_count != 0) {
+	    double Pc_i = double(freqs.collfreq) / stats.total_term_count;
+	    Pc_est += Pc_i - Pc_est * Pc_i;
+	}
+	// If the rset is empty, Pr_est should be 0 already, so leave
+	// it alone.
+	if (stats.rset_size != 0) {
+	    double Pr_i = double(freqs.reltermfreq) / stats.rset_size;
+	    Pr_est += Pr_i - Pr_est * Pr_i;
+	}
+    }
+    RETURN(TermFreqs(Xapian::doccount(P_est * stats.collection_size + 0.5),
+		     Xapian::doccount(Pr_est * stats.rset_size + 0.5),
+		     Xapian::termcount(Pc_est * stats.total_term_count + 0.5)));
+}
+
+double
+MultiOrPostList::get_maxweight() const
+{
+    LOGCALL(MATCH, double, "MultiOrPostList::get_maxweight", NO_ARGS);
+    RETURN(max_total);
+}
+
+Xapian::docid
+MultiOrPostList::get_docid() const
+{
+    return did;
+}
+
+Xapian::termcount
+MultiOrPostList::get_doclength() const
+{
+    Assert(did);
+    for (size_t i = 0; i < n_kids; ++i) {
+	if (plist[i]->get_docid() == did)
+	    return plist[i]->get_doclength();
+    }
+    Assert(false);
+    return 0;
+}
+
+double
+MultiOrPostList::get_weight() const
+{
+    Assert(did);
+    double result = 0;
+    for (size_t i = 0; i < n_kids; ++i) {
+	if (plist[i]->get_docid() == did)
+	    result += plist[i]->get_weight();
+    }
+    return result;
+}
+
+bool
+MultiOrPostList::at_end() const
+{
+    return (did == 0);
+}
+
+double
+MultiOrPostList::recalc_maxweight()
+{
+    LOGCALL(MATCH, double, "MultiOrPostList::recalc_maxweight", NO_ARGS);
+    for (size_t i = 0; i < n_kids; ++i) {
+	max_wt[i] = plist[i]->recalc_maxweight();
+    }
+    sort_kids();
+    RETURN(max_total);
+}
+
+PostList *
+MultiOrPostList::find_next_match(Xapian::docid did_min, double w_min)
+{
+    LOGCALL(MATCH, PostList *, "MultiOrPostList::find_next_match", did_min | w_min);
+    while (true) {
+	if (dirty) tidy();
+
+	if (n_kids <= 1) {
+	    if (n_kids == 0) {
+		did = 0;
+		RETURN(NULL);
+	    }
+	    // The remaining sub-postlist may have been non-essential, in which
+	    // case it may not have been advanced yet.
+	    PostList * pl = plist[0];
+	    n_kids = 0;
+	    if (pl->get_docid() < did_min) {
+		PostList * res = pl->skip_to(did_min, w_min);
+		if (res) {
+		    delete pl;
+		    pl = res;
+		}
+	    }
+	    RETURN(pl);
+	}
+
+	size_t e = first_essential(w_min);
+	if (e == n_kids) {
+	    // Even a document matching every sub-postlist can't reach w_min.
+	    did = 0;
+	    RETURN(NULL);
+	}
+
+	// Candidates must match at least one essential sub-postlist.
+	Xapian::docid candidate = plist[e]->get_docid();
+	for (size_t i = e + 1; i < n_kids; ++i) {
+	    candidate = std::min(candidate, plist[i]->get_docid());
+	}
+	AssertRel(candidate,>=,did_min);
+
+	double w_max = e ? max_cum[e - 1] : 0.0;
+	for (size_t i = e; i < n_kids; ++i) {
+	    if (plist[i]->get_docid() == candidate)
+		w_max += max_wt[i];
+	}
+
+	// Move the non-essential sub-postlists up to the candidate, those with
+	// the greatest maxweight first, until we know it can't reach w_min.
+	size_t i = e;
+	while (i != 0 && w_max >= w_min) {
+	    --i;
+	    if (plist[i]->get_docid() < candidate) {
+		skip_kid(i, candidate, w_min);
+		if (plist[i]->at_end()) {
+		    w_max -= max_wt[i];
+		    continue;
+		}
+	    }
+	    if (plist[i]->get_docid() != candidate)
+		w_max -= max_wt[i];
+	}
+
+	if (w_max >= w_min) {
+	    did = candidate;
+	    if (dirty) tidy();
+	    RETURN(NULL);
+	}
+
+	LOGLINE(MATCH, "Candidate " << candidate << " can't reach w_min");
+	for (i = e; i < n_kids; ++i) {
+	    if (plist[i]->get_docid() == candidate)
+		next_kid(i, w_min);
+	}
+	did_min = candidate + 1;
+    }
+}
+
+PostList *
+MultiOrPostList::next(double w_min)
+{
+    LOGCALL(MATCH, PostList *, "MultiOrPostList::next", w_min);
+    Xapian::docid old_did = did;
+    if (old_did == 0) {
+	for (size_t i = 0; i < n_kids; ++i) {
+	    next_kid(i, w_min);
+	}
+    } else {
+	for (size_t i = first_essential(w_min); i < n_kids; ++i) {
+	    Xapian::docid cur_did = plist[i]->get_docid();
+	    if (cur_did == old_did) {
+		next_kid(i, w_min);
+	    } else if (cur_did < old_did) {
+		skip_kid(i, old_did + 1, w_min);
+	    }
+	}
+    }
+    RETURN(find_next_match(old_did + 1, w_min));
+}
+
+PostList *
+MultiOrPostList::skip_to(Xapian::docid did_min, double w_min)
+{
+    LOGCALL(MATCH, PostList *, "MultiOrPostList::skip_to", did_min | w_min);
+    if (did == 0) {
+	for (size_t i = 0; i < n_kids; ++i) {
+	    skip_kid(i, did_min, w_min);
+	}
+    } else {
+	// Don't skip backwards.
+	if (did_min <= did) RETURN(NULL);
+	for (size_t i = first_essential(w_min); i < n_kids; ++i) {
+	    if (plist[i]->get_docid() < did_min)
+		skip_kid(i, did_min, w_min);
+	}
+    }
+    RETURN(find_next_match(did_min, w_min));
+}
+
+string
+MultiOrPostList::get_description() const
+{
+    string desc("(");
+    desc += plist[0]->get_description();
+    for (size_t i = 1; i < n_kids; ++i) {
+	desc += " OR ";
+	desc += plist[i]->get_description();
+    }
+    desc += ')';
+    return desc;
+}
+
+Xapian::termcount
+MultiOrPostList::get_wdf() const
+{
+    Xapian::termcount totwdf = 0;
+    for (size_t i = 0; i < n_kids; ++i) {
+	if (plist[i]->get_docid() == did)
+	    totwdf += plist[i]->get_wdf();
+    }
+    return totwdf;
+}
+
+Xapian::termcount
+MultiOrPostList::count_matching_subqs() const
+{
+    Xapian::termcount total = 0;
+    for (size_t i = 0; i < n_kids; ++i) {
+	if (plist[i]->get_docid() == did)
+	    total += plist[i]->count_matching_subqs();
+    }
+    return total;
+}
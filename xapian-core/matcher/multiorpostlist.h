@@ -0,0 +1,178 @@
+/** @file multiorpostlist.h
+ * @brief N-way OR postlist using MaxScore pruning
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_MULTIORPOSTLIST_H
+#define XAPIAN_INCLUDED_MULTIORPOSTLIST_H
+
+#include "multimatch.h"
+#include "api/postlist.h"
+#include <algorithm>
+#include <vector>
+
+class MultiMatch;
+
+/** N-way OR postlist.
+ *
+ *  The sub-postlists are kept in ascending order of maxweight.  When asked
+ *  for documents with weight at least w_min, the longest prefix of them
+ *  whose maxweights sum to less than w_min is "non-essential" - a document
+ *  which only matches those can't reach w_min, so candidates are only taken
+ *  from the remaining "essential" sub-postlists, and the non-essential ones
+ *  are only skipped to candidates which might still reach w_min (this is
+ *  the "MaxScore" algorithm).
+ *
+ *  When w_min is 0 this is just an n-way OR.
+ */
+class MultiOrPostList : public PostList {
+    /// Don't allow assignment.
+    void operator=(const MultiOrPostList &);
+
+    /// Don't allow copying.
+    MultiOrPostList(const MultiOrPostList &);
+
+    /// The current docid, or zero if we haven't started or are at_end.
+    Xapian::docid did;
+
+    /// The number of sub-postlists.
+    size_t n_kids;
+
+    /// The sub-postlists, in ascending maxweight order.
+    std::vector<PostList *> plist;
+
+    /// The maxweight of each sub-postlist.
+    std::vector<double> max_wt;
+
+    /** The cumulative maxweights.
+     *
+     *  max_cum[i] is the sum of max_wt[0] to max_wt[i].
+     */
+    std::vector<double> max_cum;
+
+    /// Total maximum weight the OR could possibly return.
+    double max_total;
+
+    /** Set if sub-postlists have reached the end or been replaced.
+     *
+     *  tidy() must be called to remove the former and reorder the latter
+     *  before the maxweight information can be relied on.
+     */
+    bool dirty;
+
+    /// The number of documents in the database.
+    Xapian::doccount db_size;
+
+    /// Pointer to the matcher object, so we can report pruning.
+    MultiMatch *matcher;
+
+    /// Sort the sub-postlists by max_wt and calculate max_cum and max_total.
+    void sort_kids();
+
+    /// Erase sub-postlists which are at_end and re-sort if required.
+    void tidy();
+
+    /// Index of the first sub-postlist which is essential for @a w_min.
+    size_t first_essential(double w_min) const {
+	size_t i = 0;
+	while (i != n_kids && max_cum[i] < w_min) ++i;
+	return i;
+    }
+
+    /** The weight sub-postlist @a i needs to contribute for the total to
+     *  reach @a w_min.
+     */
+    double kid_min(size_t i, double w_min) const {
+	return w_min - (max_total - max_wt[i]);
+    }
+
+    /// Call next() on sub-postlist @a i.
+    void next_kid(size_t i, double w_min);
+
+    /// Call skip_to() on sub-postlist @a i.
+    void skip_kid(size_t i, Xapian::docid did_min, double w_min);
+
+    /** Find the first candidate >= @a did_min.
+     *
+     *  All the essential sub-postlists must already be positioned at or
+     *  after @a did_min.
+     */
+    PostList * find_next_match(Xapian::docid did_min, double w_min);
+
+  public:
+    /** Construct from 2 random-access iterators to a container of PostList*,
+     *  a pointer to the matcher, and the document collection size.
+     */
+    template <class RandomItor>
+    MultiOrPostList(RandomItor pl_begin, RandomItor pl_end,
+		    MultiMatch * matcher_, Xapian::doccount db_size_)
+	: did(0), n_kids(pl_end - pl_begin), plist(pl_begin, pl_end),
+	  max_wt(n_kids), max_cum(n_kids), max_total(0), dirty(false),
+	  db_size(db_size_), matcher(matcher_)
+    {
+	// get_maxweight() may not be valid before next() or skip_to(), so
+	// use recalc_maxweight() to get the initial order.  If this throws,
+	// our destructor isn't run, so the caller still owns the
+	// sub-postlists.
+	(void)recalc_maxweight();
+    }
+
+    ~MultiOrPostList();
+
+    Xapian::doccount get_termfreq_min() const;
+
+    Xapian::doccount get_termfreq_max() const;
+
+    Xapian::doccount get_termfreq_est() const;
+
+    TermFreqs get_termfreq_est_using_stats(
+	const Xapian::Weight::Internal & stats) const;
+
+    double get_maxweight() const;
+
+    Xapian::docid get_docid() const;
+
+    Xapian::termcount get_doclength() const;
+
+    double get_weight() const;
+
+    bool at_end() const;
+
+    double recalc_maxweight();
+
+    PositionList * read_position_list() {
+	return NULL;
+    }
+
+    Internal *next(double w_min);
+
+    Internal *skip_to(Xapian::docid, double w_min);
+
+    std::string get_description() const;
+
+    /** get_wdf() for MultiOrPostList returns the sum of the wdfs of the
+     *  sub postlists which match the current docid.
+     *
+     *  The wdf isn't really meaningful in many situations, but if the lists
+     *  are being combined as a synonym we want the sum of the wdfs, so we do
+     *  that in general.
+     */
+    Xapian::termcount get_wdf() const;
+
+    Xapian::termcount count_matching_subqs() const;
+};
+
+#endif // XAPIAN_INCLUDED_MULTIORPOSTLIST_H
@@ -50,6 +50,9 @@ class QueryOptimiser {
 
     LeafPostList * hint;
 
+    /// Where the postlists opened should count their work, or NULL.
+    Xapian::QueryStats::Internal * query_stats;
+
   public:
     const Xapian::Database::Internal & db;
 
@@ -59,8 +62,10 @@ class QueryOptimiser {
 
     QueryOptimiser(const Xapian::Database::Internal & db_,
 		   LocalSubMatch & localsubmatch_,
-		   MultiMatch * matcher_)
+		   MultiMatch * matcher_,
+		   Xapian::QueryStats::Internal * query_stats_)
 	: localsubmatch(localsubmatch_), total_subqs(0), hint(0),
+	  query_stats(query_stats_),
 	  db(db_), db_size(db.get_doccount()), matcher(matcher_) { }
 
     void inc_total_subqs() { ++total_subqs; }
@@ -72,7 +77,8 @@ class QueryOptimiser {
     LeafPostList * open_post_list(const std::string& term,
 				  Xapian::termcount wqf,
 				  double factor) {
-	return localsubmatch.open_post_list(term, wqf, factor, &hint);
+	return localsubmatch.open_post_list(term, wqf, factor, &hint,
+					    query_stats);
     }
 
     PostList * make_synonym_postlist(PostList * pl, double factor) {
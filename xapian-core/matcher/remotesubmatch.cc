@@ -25,6 +25,7 @@
 
 #include "debuglog.h"
 #include "msetpostlist.h"
+#include "multimatch.h"
 #include "backends/remote/remote-database.h"
 #include "weight/weightinternal.h"
 
@@ -64,9 +65,8 @@ RemoteSubMatch::get_postlist(MultiMatch * matcher,
 			     Xapian::termcount * total_subqs_ptr)
 {
     LOGCALL(MATCH, PostList *, "RemoteSubMatch::get_postlist", matcher | total_subqs_ptr);
-    (void)matcher;
     Xapian::MSet mset;
-    db->get_mset(mset, matchspies);
+    db->get_mset(mset, matchspies, matcher->get_query_stats());
     percent_factor = mset.internal->percent_factor;
     // For remote databases we report percent_factor rather than counting the
     // number of subqueries.
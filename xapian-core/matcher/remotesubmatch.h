@@ -76,7 +76,10 @@ class RemoteSubMatch : public SubMatch {
     double get_percent_factor() const { return percent_factor; }
 
     /// Short-cut for single remote match.
-    void get_mset(Xapian::MSet & mset) { db->get_mset(mset, matchspies); }
+    void get_mset(Xapian::MSet & mset,
+		  Xapian::QueryStats::Internal * query_stats) {
+	db->get_mset(mset, matchspies, query_stats);
+    }
 };
 
 #endif /* XAPIAN_INCLUDED_REMOTESUBMATCH_H */
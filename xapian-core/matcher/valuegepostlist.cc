@@ -36,12 +36,7 @@ ValueGePostList::next(double)
     Assert(db);
     if (!valuelist) valuelist = db->open_value_list(slot);
     valuelist->next();
-    while (!valuelist->at_end()) {
-	const string & v = valuelist->get_value();
-	if (v >= begin) return NULL;
-	valuelist->next();
-    }
-    db = NULL;
+    find_match(false);
     return NULL;
 }
 
@@ -51,12 +46,7 @@ ValueGePostList::skip_to(Xapian::docid did, double)
     Assert(db);
     if (!valuelist) valuelist = db->open_value_list(slot);
     valuelist->skip_to(did);
-    while (!valuelist->at_end()) {
-	const string & v = valuelist->get_value();
-	if (v >= begin) return NULL;
-	valuelist->next();
-    }
-    db = NULL;
+    find_match(false);
     return NULL;
 }
 
@@ -70,8 +60,7 @@ ValueGePostList::check(Xapian::docid did, double, bool &valid)
     if (!valid) {
 	return NULL;
     }
-    const string & v = valuelist->get_value();
-    valid = (v >= begin);
+    valid = current_matches(false);
     return NULL;
 }
 
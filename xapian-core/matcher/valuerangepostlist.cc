@@ -36,6 +36,50 @@ ValueRangePostList::~ValueRangePostList()
     delete valuelist;
 }
 
+void
+ValueRangePostList::update_block_state(bool check_end)
+{
+    if (valuelist->get_docid() <= block_last) return;
+    string lo, hi;
+    if (!valuelist->get_block_bounds(lo, hi, block_last)) {
+	block_state = BLOCK_CHECK_EACH;
+    } else if (hi < begin || (check_end && lo > end)) {
+	block_state = BLOCK_NO_MATCH;
+    } else if (lo >= begin && (!check_end || hi <= end)) {
+	block_state = BLOCK_ALL_MATCH;
+    } else {
+	block_state = BLOCK_CHECK_EACH;
+    }
+}
+
+void
+ValueRangePostList::find_match(bool check_end)
+{
+    while (!valuelist->at_end()) {
+	update_block_state(check_end);
+	if (block_state == BLOCK_NO_MATCH) {
+	    if (block_last == Xapian::docid(-1)) break;
+	    valuelist->skip_to(block_last + 1);
+	    continue;
+	}
+	if (block_state == BLOCK_ALL_MATCH) return;
+	const string & v = valuelist->get_value();
+	if (v >= begin && (!check_end || v <= end)) return;
+	valuelist->next();
+    }
+    db = NULL;
+}
+
+bool
+ValueRangePostList::current_matches(bool check_end)
+{
+    update_block_state(check_end);
+    if (block_state != BLOCK_CHECK_EACH)
+	return block_state == BLOCK_ALL_MATCH;
+    const string & v = valuelist->get_value();
+    return (v >= begin && (!check_end || v <= end));
+}
+
 Xapian::doccount
 ValueRangePostList::get_termfreq_min() const
 {
@@ -125,14 +169,7 @@ ValueRangePostList::next(double)
     Assert(db);
     if (!valuelist) valuelist = db->open_value_list(slot);
     valuelist->next();
-    while (!valuelist->at_end()) {
-	const string & v = valuelist->get_value();
-	if (v >= begin && v <= end) {
-	    return NULL;
-	}
-	valuelist->next();
-    }
-    db = NULL;
+    find_match(true);
     return NULL;
 }
 
@@ -142,14 +179,7 @@ ValueRangePostList::skip_to(Xapian::docid did, double)
     Assert(db);
     if (!valuelist) valuelist = db->open_value_list(slot);
     valuelist->skip_to(did);
-    while (!valuelist->at_end()) {
-	const string & v = valuelist->get_value();
-	if (v >= begin && v <= end) {
-	    return NULL;
-	}
-	valuelist->next();
-    }
-    db = NULL;
+    find_match(true);
     return NULL;
 }
 
@@ -163,8 +193,7 @@ ValueRangePostList::check(Xapian::docid did, double, bool &valid)
     if (!valid) {
 	return NULL;
     }
-    const string & v = valuelist->get_value();
-    valid = (v >= begin && v <= end);
+    valid = current_matches(true);
     return NULL;
 }
 
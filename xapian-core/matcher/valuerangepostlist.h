@@ -39,6 +39,40 @@ class ValueRangePostList : public PostList {
 
     ValueList * valuelist;
 
+    /// What the bounds of the current block of values tell us.
+    enum {
+	/// Each value in the block needs to be checked.
+	BLOCK_CHECK_EACH,
+	/// Every value in the block is in the range.
+	BLOCK_ALL_MATCH,
+	/// No value in the block is in the range.
+	BLOCK_NO_MATCH
+    } block_state;
+
+    /// The last docid which block_state applies to.
+    Xapian::docid block_last;
+
+    /** Update block_state for the current position of valuelist.
+     *
+     *  @param check_end	Whether the range has an upper end.
+     */
+    void update_block_state(bool check_end);
+
+    /** Move valuelist forward to the first value in the range.
+     *
+     *  Blocks of values which are all in or all out of the range are
+     *  accepted or skipped without looking at each value.
+     *
+     *  @param check_end	Whether the range has an upper end.
+     */
+    void find_match(bool check_end);
+
+    /** Check if the value at the current position is in the range.
+     *
+     *  @param check_end	Whether the range has an upper end.
+     */
+    bool current_matches(bool check_end);
+
     /// Disallow copying.
     ValueRangePostList(const ValueRangePostList &);
 
@@ -50,7 +84,8 @@ class ValueRangePostList : public PostList {
 		       Xapian::valueno slot_,
 		       const std::string &begin_, const std::string &end_)
 	: db(db_), slot(slot_), begin(begin_), end(end_),
-	  db_size(db->get_doccount()), valuelist(0) { }
+	  db_size(db->get_doccount()), valuelist(0),
+	  block_state(BLOCK_CHECK_EACH), block_last(0) { }
 
     ~ValueRangePostList();
 
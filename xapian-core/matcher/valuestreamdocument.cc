@@ -23,22 +23,24 @@
 #include "valuestreamdocument.h"
 #include "omassert.h"
 
+#include "xapian/queryparser.h" // For sortable_unserialise().
+
 using namespace std;
 
-static void
-clear_valuelists(map<Xapian::valueno, ValueList *> & valuelists)
+void
+ValueStreamDocument::clear_streams()
 {
-    map<Xapian::valueno, ValueList *>::const_iterator i;
-    for (i = valuelists.begin(); i != valuelists.end(); ++i) {
-	delete i->second;
+    vector<ValueStream>::const_iterator i;
+    for (i = streams.begin(); i != streams.end(); ++i) {
+	delete i->valuelist;
     }
-    valuelists.clear();
+    streams.clear();
 }
 
 ValueStreamDocument::~ValueStreamDocument()
 {
     delete doc;
-    clear_valuelists(valuelists);
+    clear_streams();
 }
 
 void
@@ -48,11 +50,11 @@ ValueStreamDocument::new_subdb(int n)
     AssertRel(size_t(n),<,db.internal.size());
     current = unsigned(n);
     database = db.internal[n];
-    clear_valuelists(valuelists);
+    clear_streams();
 }
 
-string
-ValueStreamDocument::do_get_value(Xapian::valueno slot) const
+ValueList *
+ValueStreamDocument::find_value(Xapian::valueno slot) const
 {
 #ifdef XAPIAN_ASSERTIONS_PARANOID
     if (!doc) {
@@ -60,34 +62,58 @@ ValueStreamDocument::do_get_value(Xapian::valueno slot) const
     }
 #endif
 
-    pair<map<Xapian::valueno, ValueList *>::iterator, bool> ret;
-    ret = valuelists.insert(make_pair(slot, static_cast<ValueList*>(NULL)));
-    ValueList * vl;
-    if (ret.second) {
-	// Entry didn't already exist, so open a value list for slot.
-	vl = database->open_value_list(slot);
-	ret.first->second = vl;
-    } else {
-	vl = ret.first->second;
-	if (!vl) {
-	    AssertEqParanoid(string(), doc->get_value(slot));
-	    return string();
-	}
+    ++values_fetched;
+
+    vector<ValueStream>::iterator i;
+    for (i = streams.begin(); i != streams.end(); ++i) {
+	if (i->slot == slot) break;
+    }
+    if (i == streams.end()) {
+	ValueStream stream;
+	stream.slot = slot;
+	stream.valuelist = database->open_value_list(slot);
+	stream.checked_did = 0;
+	stream.found = false;
+	streams.push_back(stream);
+	i = streams.end() - 1;
     }
 
-    if (vl->check(did)) {
-	if (vl->at_end()) {
-	    delete vl;
-	    ret.first->second = NULL;
-	} else if (vl->get_docid() == did) {
-	    Assert(vl);
-	    string v = vl->get_value();
-	    AssertEq(v, doc->get_value(slot));
-	    return v;
+    if (i->checked_did != did) {
+	i->checked_did = did;
+	i->found = false;
+	ValueList * vl = i->valuelist;
+	if (vl && vl->check(did)) {
+	    if (vl->at_end()) {
+		delete vl;
+		i->valuelist = NULL;
+	    } else {
+		i->found = (vl->get_docid() == did);
+	    }
 	}
     }
-    AssertEqParanoid(string(), doc->get_value(slot));
-    return string();
+
+    if (!i->found) {
+	AssertEqParanoid(string(), doc->get_value(slot));
+	return NULL;
+    }
+    AssertEqParanoid(i->valuelist->get_value(), doc->get_value(slot));
+    return i->valuelist;
+}
+
+string
+ValueStreamDocument::do_get_value(Xapian::valueno slot) const
+{
+    ValueList * vl = find_value(slot);
+    if (!vl) return string();
+    return vl->get_value();
+}
+
+double
+ValueStreamDocument::do_get_numeric_value(Xapian::valueno slot) const
+{
+    ValueList * vl = find_value(slot);
+    if (!vl) return Xapian::sortable_unserialise(string());
+    return vl->get_numeric_value();
 }
 
 void
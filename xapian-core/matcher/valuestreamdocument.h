@@ -27,6 +27,7 @@
 #include "xapian/types.h"
 
 #include <map>
+#include <vector>
 
 /// A document which gets its values from a ValueStreamManager.
 class ValueStreamDocument : public Xapian::Document::Internal {
@@ -36,7 +37,29 @@ class ValueStreamDocument : public Xapian::Document::Internal {
     /// Don't allow copying.
     ValueStreamDocument(const ValueStreamDocument &);
 
-    mutable std::map<Xapian::valueno, ValueList *> valuelists;
+    /// A value stream for one slot.
+    struct ValueStream {
+	Xapian::valueno slot;
+
+	/// The value list, or NULL once it has reached its end.
+	ValueList * valuelist;
+
+	/// The document which @a valuelist was last checked for, or 0.
+	Xapian::docid checked_did;
+
+	/// Does document @a checked_did have a value in this slot?
+	bool found;
+    };
+
+    /** The value streams opened so far.
+     *
+     *  Only a few slots are usually needed for a match, so searching this
+     *  linearly is quicker than using a map.
+     */
+    mutable std::vector<ValueStream> streams;
+
+    /// Close all the value streams.
+    void clear_streams();
 
     Xapian::Database db;
 
@@ -44,9 +67,24 @@ class ValueStreamDocument : public Xapian::Document::Internal {
 
     mutable Xapian::Document::Internal * doc;
 
+    /** Find the value list for @a slot, positioned on the current document.
+     *
+     *  The result is remembered, so fetching the same value again for the
+     *  same document (e.g. to sort, collapse and count values on the same
+     *  slot) doesn't have to check the value list again.
+     *
+     *  @return The value list, or NULL if the document has no value in
+     *		@a slot.
+     */
+    ValueList * find_value(Xapian::valueno slot) const;
+
   public:
+    /// The number of values which have been fetched.
+    mutable unsigned long values_fetched;
+
     ValueStreamDocument(const Xapian::Database & db_)
-       	: Internal(db_.internal[0], 0), db(db_), current(0), doc(NULL) { }
+       	: Internal(db_.internal[0], 0), db(db_), current(0), doc(NULL),
+	  values_fetched(0) { }
 
     void new_subdb(int n);
 
@@ -69,6 +107,7 @@ class ValueStreamDocument : public Xapian::Document::Internal {
   private:
     /** Implementation of virtual methods @{ */
     string do_get_value(Xapian::valueno slot) const;
+    double do_get_numeric_value(Xapian::valueno slot) const;
     void do_get_all_values(map<Xapian::valueno, string> & values_) const;
     string do_get_data() const;
     /** @} */
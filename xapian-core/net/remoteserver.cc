@@ -24,6 +24,7 @@
 
 #include "xapian/constants.h"
 #include "xapian/database.h"
+#include "xapian/document.h"
 #include "xapian/enquire.h"
 #include "xapian/error.h"
 #include "xapian/matchspy.h"
@@ -33,7 +34,9 @@
 #include "safeerrno.h"
 #include <signal.h>
 #include <cstdlib>
+#include <vector>
 
+#include "api/querystatsinternal.h"
 #include "autoptr.h"
 #include "length.h"
 #include "matcher/multimatch.h"
@@ -93,6 +96,35 @@ RemoteServer::RemoteServer(const std::vector<std::string> &dbpaths,
 	throw;
     }
 
+    try {
+	start_conversation();
+    } catch (...) {
+	// The destructor won't be called, so clean up here.
+	delete db;
+	throw;
+    }
+}
+
+RemoteServer::RemoteServer(const Xapian::Database & db_,
+			   const std::string & context_,
+			   int fdin_, int fdout_,
+			   double active_timeout_, double idle_timeout_)
+    : RemoteConnection(fdin_, fdout_, context_),
+      db(new Xapian::Database(db_)), wdb(NULL), writable(false),
+      active_timeout(active_timeout_), idle_timeout(idle_timeout_)
+{
+    try {
+	start_conversation();
+    } catch (...) {
+	// The destructor won't be called, so clean up here.
+	delete db;
+	throw;
+    }
+}
+
+void
+RemoteServer::start_conversation()
+{
 #ifndef __WIN32__
     // It's simplest to just ignore SIGPIPE.  We'll still know if the
     // connection dies because we'll get EPIPE back from write().
@@ -137,63 +169,94 @@ RemoteServer::get_message(double timeout, string & result,
 void
 RemoteServer::send_message(reply_type type, const string &message)
 {
-    double end_time = RealTime::end_time(active_timeout);
+    send_message(type, message, RealTime::end_time(active_timeout));
+}
+
+void
+RemoteServer::send_message(reply_type type, const string &message,
+			   double end_time)
+{
+    if (!request_tag.empty()) {
+	// We're handling a pipelined request, so the reply needs wrapping
+	// with its request id.
+	string tagged(request_tag);
+	tagged += char(type);
+	tagged += message;
+	RemoteConnection::send_message(char(REPLY_TAGGED), tagged, end_time);
+	return;
+    }
     unsigned char type_as_char = static_cast<unsigned char>(type);
     RemoteConnection::send_message(type_as_char, message, end_time);
 }
 
 typedef void (RemoteServer::* dispatch_func)(const string &);
 
+void
+RemoteServer::dispatch_message(message_type type, const string & message)
+{
+    /* This list needs to be kept in the same order as the list of
+     * message types in "remoteprotocol.h". Note that messages at the
+     * end of the list in "remoteprotocol.h" can be omitted if they
+     * don't correspond to dispatch actions.
+     */
+    static const dispatch_func dispatch[] = {
+	&RemoteServer::msg_allterms,
+	&RemoteServer::msg_collfreq,
+	&RemoteServer::msg_document,
+	&RemoteServer::msg_termexists,
+	&RemoteServer::msg_termfreq,
+	&RemoteServer::msg_valuestats,
+	&RemoteServer::msg_keepalive,
+	&RemoteServer::msg_doclength,
+	&RemoteServer::msg_query,
+	&RemoteServer::msg_termlist,
+	&RemoteServer::msg_positionlist,
+	&RemoteServer::msg_postlist,
+	&RemoteServer::msg_reopen,
+	&RemoteServer::msg_update,
+	&RemoteServer::msg_adddocument,
+	&RemoteServer::msg_cancel,
+	&RemoteServer::msg_deletedocumentterm,
+	&RemoteServer::msg_commit,
+	&RemoteServer::msg_replacedocument,
+	&RemoteServer::msg_replacedocumentterm,
+	&RemoteServer::msg_deletedocument,
+	&RemoteServer::msg_writeaccess,
+	&RemoteServer::msg_getmetadata,
+	&RemoteServer::msg_setmetadata,
+	&RemoteServer::msg_addspelling,
+	&RemoteServer::msg_removespelling,
+	0, // MSG_GETMSET - used during a conversation.
+	0, // MSG_SHUTDOWN - handled by get_message().
+	&RemoteServer::msg_openmetadatakeylist,
+	&RemoteServer::msg_freqs,
+	&RemoteServer::msg_request,
+	&RemoteServer::msg_documents,
+	&RemoteServer::msg_setflushmemory,
+	&RemoteServer::msg_bufferedmemory,
+	&RemoteServer::msg_querystats,
+    };
+
+    size_t i = type;
+    if (i >= sizeof(dispatch)/sizeof(dispatch[0]) || !dispatch[i]) {
+	string errmsg("Unexpected message type ");
+	errmsg += str(i);
+	throw Xapian::InvalidArgumentError(errmsg);
+    }
+    (this->*(dispatch[i]))(message);
+}
+
 void
 RemoteServer::run()
 {
     while (true) {
+	// Any reply to a pipelined request which failed should have been
+	// tagged, but the next message starts afresh.
+	request_tag.resize(0);
 	try {
-	    /* This list needs to be kept in the same order as the list of
-	     * message types in "remoteprotocol.h". Note that messages at the
-	     * end of the list in "remoteprotocol.h" can be omitted if they
-	     * don't correspond to dispatch actions.
-	     */
-	    static const dispatch_func dispatch[] = {
-		&RemoteServer::msg_allterms,
-		&RemoteServer::msg_collfreq,
-		&RemoteServer::msg_document,
-		&RemoteServer::msg_termexists,
-		&RemoteServer::msg_termfreq,
-		&RemoteServer::msg_valuestats,
-		&RemoteServer::msg_keepalive,
-		&RemoteServer::msg_doclength,
-		&RemoteServer::msg_query,
-		&RemoteServer::msg_termlist,
-		&RemoteServer::msg_positionlist,
-		&RemoteServer::msg_postlist,
-		&RemoteServer::msg_reopen,
-		&RemoteServer::msg_update,
-		&RemoteServer::msg_adddocument,
-		&RemoteServer::msg_cancel,
-		&RemoteServer::msg_deletedocumentterm,
-		&RemoteServer::msg_commit,
-		&RemoteServer::msg_replacedocument,
-		&RemoteServer::msg_replacedocumentterm,
-		&RemoteServer::msg_deletedocument,
-		&RemoteServer::msg_writeaccess,
-		&RemoteServer::msg_getmetadata,
-		&RemoteServer::msg_setmetadata,
-		&RemoteServer::msg_addspelling,
-		&RemoteServer::msg_removespelling,
-		0, // MSG_GETMSET - used during a conversation.
-		0, // MSG_SHUTDOWN - handled by get_message().
-		&RemoteServer::msg_openmetadatakeylist,
-	    };
-
 	    string message;
-	    size_t type = get_message(idle_timeout, message);
-	    if (type >= sizeof(dispatch)/sizeof(dispatch[0]) || !dispatch[type]) {
-		string errmsg("Unexpected message type ");
-		errmsg += str(type);
-		throw Xapian::InvalidArgumentError(errmsg);
-	    }
-	    (this->*(dispatch[type]))(message);
+	    message_type type = get_message(idle_timeout, message);
+	    dispatch_message(type, message);
 	} catch (const Xapian::NetworkTimeoutError & e) {
 	    try {
 		// We've had a timeout, so the client may not be listening, so
@@ -476,10 +539,12 @@ RemoteServer::msg_query(const string &message_in)
     }
 
     Xapian::Weight::Internal local_stats;
+    query_stats.clear();
     MultiMatch match(*db, query, qlen, &rset, collapse_max, collapse_key,
 		     percent_cutoff, weight_cutoff, order,
-		     sort_key, sort_by, sort_value_forward, time_limit, NULL,
-		     local_stats, wt.get(), matchspies.spies, false, false);
+		     sort_key, sort_by, sort_value_forward, time_limit, 0, NULL,
+		     local_stats, wt.get(), matchspies.spies,
+		     query_stats.internal.get(), false, false);
 
     send_message(REPLY_STATS, serialise_stats(local_stats));
 
@@ -521,8 +586,31 @@ RemoteServer::msg_document(const string &message)
     const char *p_end = p + message.size();
     Xapian::docid did = decode_length(&p, p_end, false);
 
-    Xapian::Document doc = db->get_document(did);
+    send_document(db->get_document(did));
+}
 
+void
+RemoteServer::msg_documents(const string &message)
+{
+    const char *p = message.data();
+    const char *p_end = p + message.size();
+    vector<Xapian::docid> dids;
+    while (p != p_end) {
+	dids.push_back(decode_length(&p, p_end, false));
+    }
+
+    // Read all the documents before replying, so that if any is missing, the
+    // only reply is the exception.
+    vector<Xapian::Document> docs = db->get_documents(dids);
+    vector<Xapian::Document>::const_iterator i;
+    for (i = docs.begin(); i != docs.end(); ++i) {
+	send_document(*i);
+    }
+}
+
+void
+RemoteServer::send_document(const Xapian::Document & doc)
+{
     send_message(REPLY_DOCDATA, doc.get_data());
 
     Xapian::ValueIterator i;
@@ -727,6 +815,30 @@ RemoteServer::msg_setmetadata(const string & message)
     wdb->set_metadata(key, val);
 }
 
+void
+RemoteServer::msg_setflushmemory(const string & message)
+{
+    if (!wdb)
+	throw_read_only();
+    const char *p = message.data();
+    const char *p_end = p + message.size();
+    wdb->set_flush_memory(decode_length(&p, p_end, false));
+}
+
+void
+RemoteServer::msg_bufferedmemory(const string &)
+{
+    if (!wdb)
+	throw_read_only();
+    send_message(REPLY_BUFFEREDMEMORY, encode_length(wdb->get_buffered_memory()));
+}
+
+void
+RemoteServer::msg_querystats(const string &)
+{
+    send_message(REPLY_QUERYSTATS, query_stats.internal->serialise_counts());
+}
+
 void
 RemoteServer::msg_addspelling(const string & message)
 {
@@ -748,3 +860,24 @@ RemoteServer::msg_removespelling(const string & message)
     Xapian::termcount freqdec = decode_length(&p, p_end, false);
     wdb->remove_spelling(string(p, p_end - p), freqdec);
 }
+
+void
+RemoteServer::msg_request(const string & message)
+{
+    const char *p = message.data();
+    const char *p_end = p + message.size();
+    (void)decode_length(&p, p_end, false);
+    if (p == p_end)
+	throw Xapian::NetworkError("Bad pipelined request");
+    // Tag all the replies with the encoded request id, including any
+    // exception, which run() sends after we return.
+    request_tag.assign(message.data(), p - message.data());
+    unsigned type = static_cast<unsigned char>(*p++);
+    if (type >= MSG_MAX || type == MSG_REQUEST) {
+	string errmsg("Unexpected pipelined message type ");
+	errmsg += str(type);
+	throw Xapian::InvalidArgumentError(errmsg);
+    }
+    dispatch_message(static_cast<message_type>(type), string(p, p_end - p));
+    request_tag.resize(0);
+}
@@ -24,6 +24,7 @@
 
 #include "xapian/database.h"
 #include "xapian/postingsource.h"
+#include "xapian/querystats.h"
 #include "xapian/registry.h"
 #include "xapian/visibility.h"
 #include "xapian/weight.h"
@@ -69,6 +70,18 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
     /// The registry, which allows unserialisation of user subclasses.
     Xapian::Registry reg;
 
+    /** The encoded id of the pipelined request we're handling.
+     *
+     *  While this is non-empty, replies are wrapped in REPLY_TAGGED.
+     */
+    std::string request_tag;
+
+    /// The statistics for the last query, sent by msg_querystats().
+    Xapian::QueryStats query_stats;
+
+    /// Set things up for the conversation and greet the client.
+    void start_conversation();
+
     /// Accept a message from the client.
     message_type get_message(double timeout, std::string & result,
 			     message_type required_type = MSG_MAX);
@@ -78,10 +91,13 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
 
     /// Send a message to the client, with specific end_time.
     void send_message(reply_type type, const std::string &message,
-		      double end_time) {
-	unsigned char type_as_char = static_cast<unsigned char>(type);
-	RemoteConnection::send_message(type_as_char, message, end_time);
-    }
+		      double end_time);
+
+    /// Call the handler for a message.
+    void dispatch_message(message_type type, const std::string & message);
+
+    // handle a pipelined request
+    void msg_request(const std::string & message);
 
     // all terms
     void msg_allterms(const std::string & message);
@@ -89,6 +105,12 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
     // get document
     void msg_document(const std::string & message);
 
+    // get several documents
+    void msg_documents(const std::string & message);
+
+    // send the replies for a document
+    void send_document(const Xapian::Document & doc);
+
     // term exists?
     void msg_termexists(const std::string & message);
 
@@ -161,6 +183,15 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
     // set metadata
     void msg_setmetadata(const std::string & message);
 
+    // set the memory limit for buffered changes
+    void msg_setflushmemory(const std::string & message);
+
+    // get the memory used by buffered changes
+    void msg_bufferedmemory(const std::string & message);
+
+    // get the statistics for the last query
+    void msg_querystats(const std::string & message);
+
     // add a spelling
     void msg_addspelling(const std::string & message);
 
@@ -186,6 +217,28 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
 		 double idle_timeout_,
 		 bool writable = false);
 
+    /** Construct a read-only RemoteServer for databases which are already
+     *  open.
+     *
+     *  This avoids the cost of opening the databases for each connection.
+     *
+     *  @param db_	The database(s) to use.  This RemoteServer will use a
+     *			copy of the handle, so @a db_ must not be used by any
+     *			other thread while this RemoteServer exists.
+     *  @param context_	Description of the database(s) for error messages.
+     *  @param fdin	The file descriptor to read from.
+     *  @param fdout	The file descriptor to write to (fdin and fdout may be
+     *			the same).
+     *  @param active_timeout_	Timeout for actions during a conversation
+     *			(specified in seconds).
+     *  @param idle_timeout_	Timeout while waiting for a new action from
+     *			the client (specified in seconds).
+     */
+    RemoteServer(const Xapian::Database & db_, const std::string & context_,
+		 int fdin, int fdout,
+		 double active_timeout_,
+		 double idle_timeout_);
+
     /// Destructor.
     ~RemoteServer();
 
@@ -26,7 +26,9 @@
 
 #include <xapian/error.h>
 
+#include "autoptr.h"
 #include "remoteserver.h"
+#include "safeunistd.h"
 
 #include <iostream>
 
@@ -41,21 +43,93 @@ RemoteTcpServer::RemoteTcpServer(const vector<std::string> &dbpaths_,
       dbpaths(dbpaths_), writable(writable_),
       active_timeout(active_timeout_), idle_timeout(idle_timeout_)
 {
+    for (size_t i = 0; i != dbpaths.size(); ++i) {
+	if (i) context += ' ';
+	context += dbpaths[i];
+    }
 }
 
 void
 RemoteTcpServer::handle_one_connection(int socket)
+{
+    serve_connection(socket, NULL);
+}
+
+void
+RemoteTcpServer::serve_connection(int socket, const Xapian::Database * db)
 {
     try {
-	RemoteServer sserv(dbpaths, socket, socket,
-			   active_timeout, idle_timeout, writable);
-	sserv.run();
+	if (db) {
+	    RemoteServer sserv(*db, context, socket, socket,
+			       active_timeout, idle_timeout);
+	    sserv.run();
+	} else {
+	    RemoteServer sserv(dbpaths, socket, socket,
+			       active_timeout, idle_timeout, writable);
+	    sserv.run();
+	}
     } catch (const Xapian::NetworkTimeoutError &e) {
 	if (verbose)
 	    cerr << "Connection timed out: " << e.get_description() << endl;
     } catch (const Xapian::Error &e) {
 	cerr << "Got exception " << e.get_description() << endl;
     } catch (...) {
-	// ignore other exceptions
+	cerr << "Caught exception." << endl;
+    }
+}
+
+Xapian::Database *
+RemoteTcpServer::open_databases() const
+{
+    if (writable) return NULL;
+    AutoPtr<Xapian::Database> db(new Xapian::Database(dbpaths[0]));
+    for (size_t i = 1; i != dbpaths.size(); ++i) {
+	db->add_database(Xapian::Database(dbpaths[i]));
+    }
+    return db.release();
+}
+
+void
+RemoteTcpServer::run_worker()
+{
+    // A Database object can't be used by two threads at once, so each worker
+    // thread has its own.
+    AutoPtr<Xapian::Database> db;
+    while (true) {
+	int socket;
+	try {
+	    socket = accept_connection();
+	} catch (const Xapian::Error &e) {
+	    cerr << "Caught " << e.get_description() << endl;
+	    continue;
+	} catch (...) {
+	    cerr << "Caught exception." << endl;
+	    continue;
+	}
+	if (socket == -1)
+	    return; // Shutdown has happened
+
+	try {
+	    if (db.get()) {
+		(void)db->reopen();
+	    } else {
+		db.reset(open_databases());
+	    }
+	} catch (...) {
+	    // Open the databases afresh for this connection, which will report
+	    // any error to the client.
+	    db.reset();
+	}
+
+	// serve_connection() handles any exception from serving the
+	// connection itself.
+	serve_connection(socket, db.get());
+#ifdef __WIN32__
+	closesocket(socket);
+#else
+	close(socket);
+#endif
+
+	if (verbose) cout << "Closing connection." << endl;
     }
 }
@@ -46,6 +46,9 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteTcpServer : public TcpServer {
      */
     const std::vector<std::string> dbpaths;
 
+    /// Description of the databases for error messages.
+    std::string context;
+
     /** Is this a WritableDatabase? */
     bool writable;
 
@@ -55,8 +58,19 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteTcpServer : public TcpServer {
     /** Timeout between operations (in seconds). */
     double idle_timeout;
 
-    /** Accept a connection and return the filedescriptor for it. */
-    int accept_connection();
+    /** Open the databases for a worker thread to reuse.
+     *
+     *  Returns NULL if we're writable, as a writable database can't be
+     *  shared between connections.
+     */
+    Xapian::Database * open_databases() const;
+
+    /** Serve a connection.
+     *
+     *  @param socket	The connected socket.
+     *  @param db	The databases to use, or NULL to open them afresh.
+     */
+    void serve_connection(int socket, const Xapian::Database * db);
 
   public:
     /** Construct a RemoteTcpServer for a Database and start listening for
@@ -83,6 +97,15 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteTcpServer : public TcpServer {
      *  This method may be called by multiple threads.
      */
     void handle_one_connection(int socket);
+
+    /** Accept connections and handle them in a worker thread.
+     *
+     *  Each worker thread opens the databases once, and reuses them for each
+     *  connection it handles (reopening them first so that each connection
+     *  sees the latest revision).  This saves the cost of opening the
+     *  databases, and means their caches are warm.
+     */
+    void run_worker();
 };
 
 #endif // XAPIAN_INCLUDED_REMOTETCPSERVER_H
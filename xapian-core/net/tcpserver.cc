@@ -32,6 +32,7 @@
 
 #include "noreturn.h"
 #include "remoteconnection.h"
+#include "threadpool.h"
 
 #ifdef __WIN32__
 # include <process.h>    /* _beginthread, _endthread */
@@ -47,6 +48,7 @@
 #endif
 
 #include <iostream>
+#include <vector>
 
 #include <cstring>
 #include <cstdio> // For sprintf() on __WIN32__ or cygwin.
@@ -275,6 +277,55 @@ TcpServer::~TcpServer()
 #endif
 }
 
+void
+TcpServer::run_worker()
+{
+    while (true) {
+	try {
+	    int connected_socket = accept_connection();
+	    if (connected_socket == -1)
+		return; // Shutdown has happened
+
+	    handle_one_connection(connected_socket);
+	    CLOSESOCKET(connected_socket);
+
+	    if (verbose) cout << "Closing connection." << endl;
+	} catch (const Xapian::Error &e) {
+	    // FIXME: better error handling.
+	    cerr << "Caught " << e.get_description() << endl;
+	} catch (...) {
+	    // FIXME: better error handling.
+	    cerr << "Caught exception." << endl;
+	}
+    }
+}
+
+namespace {
+
+/// Job which runs TcpServer::run_worker() in a thread from run_jobs().
+class WorkerJob : public ThreadJob {
+    TcpServer * server;
+
+  public:
+    explicit WorkerJob(TcpServer * server_) : server(server_) { }
+
+    void run() { server->run_worker(); }
+};
+
+}
+
+void
+TcpServer::run_threads(unsigned n_threads)
+{
+    if (n_threads == 0) n_threads = 1;
+    vector<WorkerJob> workers(n_threads, WorkerJob(this));
+    vector<ThreadJob *> jobs;
+    for (unsigned i = 0; i != n_threads; ++i) {
+	jobs.push_back(&workers[i]);
+    }
+    run_jobs(jobs, n_threads);
+}
+
 #ifdef HAVE_FORK
 // A fork() based implementation.
 void
@@ -100,9 +100,29 @@ class XAPIAN_VISIBILITY_DEFAULT TcpServer SOCKET_INITIALIZER_MIXIN {
      */
     void run();
 
+    /** Accept connections and service requests indefinitely using a fixed
+     *  pool of threads.
+     *
+     *  Unlike run(), no process or thread is created per connection - each
+     *  of the @a n_threads threads (including the calling thread) accepts
+     *  connections and handles them one at a time.
+     */
+    void run_threads(unsigned n_threads);
+
     /** Accept a single connection, service requests on it, then stop.  */
     void run_once();
 
+    /** Accept connections and handle them in a worker thread.
+     *
+     *  This is called by each worker thread started by run_threads(), and
+     *  returns only if the server is shut down.  The default implementation
+     *  passes each connection to handle_one_connection() - subclasses can
+     *  override it to keep state between the connections a thread handles.
+     *
+     *  This mustn't throw an exception.
+     */
+    virtual void run_worker();
+
     /// Handle a single connection on an already connected socket.
     virtual void handle_one_connection(int socket) = 0;
 };
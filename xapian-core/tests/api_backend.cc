@@ -28,16 +28,27 @@
 #include <xapian.h>
 
 #include "filetests.h"
+#include "mutex.h"
 #include "str.h"
+#include "stringutils.h"
 #include "testsuite.h"
 #include "testutils.h"
 #include "unixcmds.h"
 
 #include "apitest.h"
 
+#include "safedirent.h"
+#include "safeerrno.h"
 #include "safefcntl.h"
 #include "safesysstat.h"
 #include "safeunistd.h"
+#ifndef __WIN32__
+# include <sys/wait.h>
+#endif
+
+#include <map>
+#include <string>
+#include <vector>
 
 using namespace std;
 
@@ -253,6 +264,193 @@ DEFINE_TESTCASE(matchdecider4, remote) {
     return true;
 }
 
+/// Test pipelined fetching of documents from a remote backend.
+DEFINE_TESTCASE(pipelinedocs1, remote) {
+    Xapian::Database db(get_database("apitest_simpledata"));
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("this"));
+    Xapian::MSet mset = enquire.get_mset(0, 10);
+    TEST(mset.size() > 2);
+
+    // Requests which are never collected shouldn't confuse later replies.
+    {
+	Xapian::MSet abandoned = enquire.get_mset(0, 10);
+	abandoned.fetch();
+    }
+
+    mset.fetch();
+    // Other requests can be made while documents are being fetched.
+    TEST_EQUAL(db.get_termfreq("this"), mset.get_matches_estimated());
+    Xapian::Document doc = db.get_document(*mset[1]);
+    TEST_EQUAL(doc.get_docid(), *mset[1]);
+
+    for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i) {
+	Xapian::Document fetched = i.get_document();
+	Xapian::Document direct = db.get_document(*i);
+	TEST_EQUAL(fetched.get_docid(), *i);
+	TEST_EQUAL(fetched.get_data(), direct.get_data());
+	TEST_EQUAL(fetched.values_count(), direct.values_count());
+    }
+
+    // An error reply while pipelined requests are outstanding.
+    mset.fetch();
+    TEST_EXCEPTION(Xapian::DocNotFoundError, db.get_document(12345));
+    TEST_EQUAL(mset[0].get_document().get_data(),
+	       db.get_document(*mset[0]).get_data());
+
+    // Documents requested before a reopen mustn't be returned after it.
+    Xapian::WritableDatabase wdb = get_writable_database("apitest_simpledata");
+    Xapian::Database rdb = get_writable_database_as_database();
+    Xapian::Enquire renquire(rdb);
+    renquire.set_query(Xapian::Query("this"));
+    Xapian::MSet rmset = renquire.get_mset(0, 10);
+    TEST(rmset.size() > 2);
+    rmset.fetch();
+    Xapian::Document newdoc;
+    newdoc.set_data("new data");
+    wdb.replace_document(*rmset[0], newdoc);
+    wdb.replace_document(*rmset[1], newdoc);
+    wdb.commit();
+    TEST(rdb.reopen());
+    TEST_EQUAL(rdb.get_document(*rmset[0]).get_data(), "new data");
+    TEST_EQUAL(rmset[1].get_document().get_data(), "new data");
+    // Closing with documents still requested shouldn't fail.
+    rmset.fetch();
+    rdb.close();
+
+    return true;
+}
+
+/// Test Database::get_documents().
+DEFINE_TESTCASE(getdocuments1, backend) {
+    Xapian::Database db(get_database("apitest_simpledata"));
+    TEST(db.get_documents(vector<Xapian::docid>()).empty());
+
+    // Docids out of order and repeated.
+    vector<Xapian::docid> dids;
+    dids.push_back(4);
+    dids.push_back(1);
+    dids.push_back(db.get_lastdocid());
+    dids.push_back(4);
+    dids.push_back(2);
+    vector<Xapian::Document> docs = db.get_documents(dids);
+    TEST_EQUAL(docs.size(), dids.size());
+    for (size_t i = 0; i != dids.size(); ++i) {
+	Xapian::Document doc = db.get_document(dids[i]);
+	TEST_EQUAL(docs[i].get_docid(), doc.get_docid());
+	TEST_EQUAL(docs[i].get_data(), doc.get_data());
+	TEST_EQUAL(docs[i].values_count(), doc.values_count());
+	Xapian::ValueIterator v = docs[i].values_begin();
+	Xapian::ValueIterator w = doc.values_begin();
+	while (v != docs[i].values_end()) {
+	    TEST(w != doc.values_end());
+	    TEST_EQUAL(v.get_valueno(), w.get_valueno());
+	    TEST_EQUAL(*v, *w);
+	    ++v;
+	    ++w;
+	}
+	TEST(w == doc.values_end());
+    }
+
+    dids.push_back(db.get_lastdocid() + 1);
+    TEST_EXCEPTION(Xapian::DocNotFoundError, db.get_documents(dids));
+    dids.back() = 0;
+    TEST_EXCEPTION(Xapian::InvalidArgumentError, db.get_documents(dids));
+
+    return true;
+}
+
+/// Test Database::get_documents() sees uncommitted changes.
+DEFINE_TESTCASE(getdocuments2, writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+    for (int i = 1; i <= 5; ++i) {
+	Xapian::Document doc;
+	doc.set_data("doc " + str(i));
+	doc.add_value(i % 2, str(i));
+	doc.add_value(7, "seven");
+	db.add_document(doc);
+    }
+    db.commit();
+    Xapian::Document doc;
+    doc.set_data("new");
+    doc.add_value(1, "one");
+    db.replace_document(3, doc);
+    db.delete_document(4);
+
+    vector<Xapian::docid> dids;
+    dids.push_back(5);
+    dids.push_back(3);
+    dids.push_back(1);
+    vector<Xapian::Document> docs = db.get_documents(dids);
+    TEST_EQUAL(docs[0].get_data(), "doc 5");
+    TEST_EQUAL(docs[0].get_value(1), "5");
+    TEST_EQUAL(docs[0].get_value(7), "seven");
+    TEST_EQUAL(docs[1].get_data(), "new");
+    TEST_EQUAL(docs[1].values_count(), 1);
+    TEST_EQUAL(docs[1].get_value(1), "one");
+    TEST_EQUAL(docs[2].get_data(), "doc 1");
+    TEST_EQUAL(docs[2].values_count(), 2);
+
+    dids.push_back(4);
+    TEST_EXCEPTION(Xapian::DocNotFoundError, db.get_documents(dids));
+
+    return true;
+}
+
+/// Check one document which can't be read doesn't stop the rest of an MSet.
+DEFINE_TESTCASE(fetchdocs2, writable && !inmemory) {
+    Xapian::WritableDatabase wdb = get_writable_database("apitest_simpledata");
+    wdb.commit();
+    Xapian::Database db = get_writable_database_as_database();
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("this"));
+    Xapian::MSet mset = enquire.get_mset(0, 4);
+    TEST_EQUAL(mset.size(), 4);
+    Xapian::MSet mset2 = enquire.get_mset(0, 4);
+    map<Xapian::docid, string> data;
+    for (Xapian::docid did = 1; did <= db.get_lastdocid(); ++did) {
+	data[did] = db.get_document(did).get_data();
+    }
+
+    // Delete the document in the MSet with the lowest docid, and fetch the
+    // documents after the reader sees that.
+    Xapian::doccount bad = 0;
+    for (Xapian::doccount i = 1; i != mset.size(); ++i) {
+	if (*mset[i] < *mset[bad]) bad = i;
+    }
+    Xapian::docid bad_did = *mset[bad];
+    wdb.delete_document(bad_did);
+    wdb.commit();
+    TEST(db.reopen());
+    mset.fetch();
+    Xapian::doccount first = (bad == 0 ? 1 : 0);
+    TEST_EQUAL(mset[first].get_document().get_data(), data[*mset[first]]);
+    TEST_EXCEPTION(Xapian::DocNotFoundError,
+		   mset[bad].get_document().get_data());
+    for (Xapian::doccount i = 0; i != mset.size(); ++i) {
+	if (i == bad) continue;
+	TEST_EQUAL(mset[i].get_document().get_data(), data[*mset[i]]);
+    }
+    TEST_EXCEPTION(Xapian::DocNotFoundError,
+		   mset[bad].get_document().get_data());
+
+    // A batch mixing a requested document which fails with one which
+    // wasn't requested shouldn't leave a reply behind to confuse later
+    // requests.
+    TEST_EQUAL(*mset2[bad], bad_did);
+    mset2.fetch(mset2[bad]);
+    vector<Xapian::docid> dids;
+    dids.push_back(bad_did);
+    dids.push_back(db.get_lastdocid());
+    TEST_EXCEPTION(Xapian::DocNotFoundError, db.get_documents(dids));
+    for (Xapian::docid did = 1; did <= db.get_lastdocid(); ++did) {
+	if (did == bad_did) continue;
+	TEST_EQUAL(db.get_document(did).get_data(), data[did]);
+    }
+
+    return true;
+}
+
 /** Check that replacing an unmodified document doesn't increase the automatic
  *  flush counter.  Regression test for bug fixed in 1.1.4/1.0.18.
  */
@@ -583,6 +781,344 @@ DEFINE_TESTCASE(ordecay2, generated) {
     return true;
 }
 
+/// Check pruning in OR with enough subqueries to use MultiOrPostList.
+DEFINE_TESTCASE(multior1, generated) {
+    Xapian::Database db = get_database("ordecay", make_ordecay_db);
+    Xapian::Enquire enq(db);
+    std::vector<Xapian::Query> q;
+    for (int n = 18; n != 26; ++n) {
+	q.push_back(Xapian::Query("N" + str(n)));
+	q.push_back(Xapian::Query("M" + str(n)));
+    }
+    q.push_back(Xapian::Query(Xapian::Query::OP_AND,
+			      Xapian::Query("N5"), Xapian::Query("M7")));
+
+    Xapian::Query queries[] = {
+	Xapian::Query(Xapian::Query::OP_OR, q.begin(), q.end()),
+	Xapian::Query(Xapian::Query::OP_ELITE_SET, q.begin(), q.end(), 6)
+    };
+    for (size_t j = 0; j != sizeof(queries) / sizeof(queries[0]); ++j) {
+	enq.set_query(queries[j]);
+	Xapian::MSet msetall = enq.get_mset(0, db.get_doccount());
+	for (unsigned int i = 1; i < msetall.size(); ++i) {
+	    Xapian::MSet submset = enq.get_mset(0, i);
+	    TEST(mset_range_is_same(submset, 0, msetall, 0, submset.size()));
+	}
+    }
+    return true;
+}
+
+/// Check that matching sub-databases in threads gives the same results.
+DEFINE_TESTCASE(matchthreads1, generated) {
+    Xapian::Database db = get_database("ordecay", make_ordecay_db);
+    db.add_database(get_database("ordecay", make_ordecay_db));
+    db.add_database(get_database("apitest_simpledata"));
+    Xapian::Enquire enq(db);
+    Xapian::Enquire enq_threads(db);
+    enq_threads.set_match_threads(4);
+
+    std::vector<Xapian::Query> q;
+    for (int n = 18; n != 26; ++n) {
+	q.push_back(Xapian::Query("N" + str(n)));
+	q.push_back(Xapian::Query("M" + str(n)));
+    }
+    q.push_back(Xapian::Query("this"));
+    q.push_back(Xapian::Query("word"));
+    Xapian::Query query(Xapian::Query::OP_OR, q.begin(), q.end());
+    enq.set_query(query);
+    enq_threads.set_query(query);
+
+    for (int mode = 0; mode != 3; ++mode) {
+	if (mode == 1) {
+	    enq.set_cutoff(60);
+	    enq_threads.set_cutoff(60);
+	} else if (mode == 2) {
+	    enq.set_cutoff(0);
+	    enq_threads.set_cutoff(0);
+	    enq.set_sort_by_relevance_then_value(0, false);
+	    enq_threads.set_sort_by_relevance_then_value(0, false);
+	}
+	Xapian::MSet msetall = enq.get_mset(0, db.get_doccount());
+	Xapian::doccount total = msetall.size();
+	for (Xapian::doccount i = 1; i <= total; ++i) {
+	    tout << "mode " << mode << ", maxitems " << i << endl;
+	    Xapian::MSet mset = enq.get_mset(0, i);
+	    Xapian::MSet mset_threads = enq_threads.get_mset(0, i);
+	    TEST_EQUAL(mset.size(), mset_threads.size());
+	    TEST(mset_range_is_same(mset, 0, mset_threads, 0, mset.size()));
+	    TEST_EQUAL(mset.get_max_attained(), mset_threads.get_max_attained());
+	    for (Xapian::MSetIterator j = mset.begin(), k = mset_threads.begin();
+		 j != mset.end(); ++j, ++k) {
+		TEST_EQUAL(j.get_percent(), k.get_percent());
+	    }
+	    if (mode != 1) {
+		TEST_REL(mset_threads.get_matches_lower_bound(),<=,total);
+		TEST_REL(mset_threads.get_matches_upper_bound(),>=,total);
+	    }
+
+	    mset = enq.get_mset(i / 2, 3);
+	    mset_threads = enq_threads.get_mset(i / 2, 3);
+	    TEST(mset_range_is_same(mset, 0, mset_threads, 0, mset.size()));
+	    TEST_EQUAL(mset.size(), mset_threads.size());
+	}
+    }
+    return true;
+}
+
+/// Check that matching ranges of docids in threads gives the same results.
+DEFINE_TESTCASE(matchthreads2, brass) {
+    Xapian::Database db = get_database("apitest_simpledata");
+    Xapian::Enquire enq(db);
+    Xapian::Enquire enq_threads(db);
+    enq_threads.set_match_threads(4);
+
+    static const char * const terms[] = {
+	"this", "word", "paragraph", "search", "simple", "test"
+    };
+    Xapian::Query query(Xapian::Query::OP_OR, terms, terms + 6);
+    enq.set_query(query);
+    enq_threads.set_query(query);
+
+    Xapian::doccount doccount = db.get_doccount();
+    for (int mode = 0; mode != 5; ++mode) {
+	if (mode == 1) {
+	    enq.set_cutoff(60);
+	    enq_threads.set_cutoff(60);
+	} else if (mode == 2) {
+	    enq.set_cutoff(0);
+	    enq_threads.set_cutoff(0);
+	    enq.set_sort_by_value_then_relevance(1, false);
+	    enq_threads.set_sort_by_value_then_relevance(1, false);
+	} else if (mode == 3) {
+	    enq.set_sort_by_relevance();
+	    enq_threads.set_sort_by_relevance();
+	    enq.set_collapse_key(1);
+	    enq_threads.set_collapse_key(1);
+	} else if (mode == 4) {
+	    enq.set_collapse_key(Xapian::BAD_VALUENO);
+	    enq_threads.set_collapse_key(Xapian::BAD_VALUENO);
+	}
+	Xapian::MSet msetall = enq.get_mset(0, doccount);
+	Xapian::doccount total = msetall.size();
+	for (Xapian::doccount i = 1; i <= total; ++i) {
+	    tout << "mode " << mode << ", maxitems " << i << endl;
+	    Xapian::ValueCountMatchSpy spy(1);
+	    Xapian::ValueCountMatchSpy spy_threads(1);
+	    if (mode == 4) {
+		enq.clear_matchspies();
+		enq_threads.clear_matchspies();
+		enq.add_matchspy(&spy);
+		enq_threads.add_matchspy(&spy_threads);
+	    }
+	    Xapian::MSet mset = enq.get_mset(0, i, doccount);
+	    Xapian::MSet mset_threads = enq_threads.get_mset(0, i, doccount);
+	    TEST_EQUAL(mset.size(), mset_threads.size());
+	    TEST(mset_range_is_same(mset, 0, mset_threads, 0, mset.size()));
+	    TEST_EQUAL(mset.get_max_attained(), mset_threads.get_max_attained());
+	    for (Xapian::MSetIterator j = mset.begin(), k = mset_threads.begin();
+		 j != mset.end(); ++j, ++k) {
+		TEST_EQUAL(j.get_percent(), k.get_percent());
+	    }
+	    if (mode != 1 && mode != 3) {
+		TEST_EQUAL(mset_threads.get_matches_lower_bound(), total);
+		TEST_EQUAL(mset_threads.get_matches_upper_bound(), total);
+	    }
+	    if (mode == 4) {
+		TEST_EQUAL(spy.get_total(), spy_threads.get_total());
+		Xapian::TermIterator j = spy.values_begin();
+		Xapian::TermIterator k = spy_threads.values_begin();
+		while (j != spy.values_end()) {
+		    TEST(k != spy_threads.values_end());
+		    TEST_EQUAL(*j, *k);
+		    TEST_EQUAL(j.get_termfreq(), k.get_termfreq());
+		    ++j;
+		    ++k;
+		}
+		TEST(k == spy_threads.values_end());
+	    }
+	}
+    }
+    return true;
+}
+
+static void
+make_matchthreads3_db(Xapian::WritableDatabase &db, const string &)
+{
+    for (unsigned i = 1; i <= 2000; ++i) {
+	Xapian::Document doc;
+	doc.add_term("A", (i * 7) % 13 + 1);
+	if (i % 3) doc.add_term("B", (i * 11) % 17 + 1);
+	if (i % 5 == 0) doc.add_term("C", i % 4 + 1);
+	doc.add_term("F", i % 29 + 1);
+	doc.add_value(0, str(i % 37));
+	db.add_document(doc);
+    }
+}
+
+/** Check matching ranges of docids in threads with check_at_least=0.
+ *
+ *  With enough candidates in each range, the threads share the minimum
+ *  weight needed and can terminate early, which matchthreads2's database is
+ *  too small for.
+ */
+DEFINE_TESTCASE(matchthreads3, brass) {
+    Xapian::Database db = get_database("matchthreads3",
+				       make_matchthreads3_db);
+    Xapian::Enquire enq(db);
+    Xapian::Enquire enq_threads(db);
+    enq_threads.set_match_threads(4);
+    Xapian::QueryStats stats;
+    enq_threads.set_query_stats(&stats);
+
+    static const char * const terms[] = { "A", "B", "C" };
+    Xapian::Query query(Xapian::Query::OP_OR, terms, terms + 3);
+    enq.set_query(query);
+    enq_threads.set_query(query);
+
+    const Xapian::doccount check_at_least = 0;
+    Xapian::doccount total = db.get_termfreq("A");
+    for (int mode = 0; mode != 2; ++mode) {
+	if (mode == 1) {
+	    enq.set_collapse_key(0);
+	    enq_threads.set_collapse_key(0);
+	    total = 37;
+	}
+	static const Xapian::doccount sizes[] = { 1, 2, 10, 30, 100, 500, 0 };
+	for (const Xapian::doccount * p = sizes; *p; ++p) {
+	    tout << "mode " << mode << ", maxitems " << *p << endl;
+	    Xapian::MSet mset = enq.get_mset(0, *p, check_at_least);
+	    Xapian::MSet mset_threads =
+		enq_threads.get_mset(0, *p, check_at_least);
+	    tout << stats.get_description() << endl;
+	    TEST_EQUAL(mset.size(), min(*p, total));
+	    TEST_EQUAL(mset.size(), mset_threads.size());
+	    TEST(mset_range_is_same(mset, 0, mset_threads, 0, mset.size()));
+	    TEST_EQUAL(mset.get_max_attained(), mset_threads.get_max_attained());
+	    TEST_REL(mset_threads.get_matches_lower_bound(),<=,total);
+	    TEST_REL(mset_threads.get_matches_upper_bound(),>=,total);
+	    if (mode == 0 && *p <= 10) {
+		// The shared minimum weight should let some candidates be
+		// skipped without being scored.
+		TEST_REL(stats.get_documents_scored(),<,total);
+	    }
+
+	    mset = enq.get_mset(*p / 2, 5, check_at_least);
+	    mset_threads = enq_threads.get_mset(*p / 2, 5, check_at_least);
+	    TEST_EQUAL(mset.size(), mset_threads.size());
+	    if (!mset.empty())
+		TEST(mset_range_is_same(mset, 0, mset_threads, 0, mset.size()));
+	}
+    }
+    return true;
+}
+
+/// A weighting scheme which throws as soon as it's used.
+class ThrowingWeight : public Xapian::Weight {
+  public:
+    /// Protects calls, as the weight is used from several threads.
+    static Mutex mutex;
+
+    /// How many times get_sumpart() has been called.
+    static unsigned calls;
+
+    ThrowingWeight() { }
+
+    void init(double) { }
+
+    Weight * clone() const { return new ThrowingWeight; }
+
+    double get_sumpart(Xapian::termcount, Xapian::termcount) const {
+	{
+	    MutexLock lock(mutex);
+	    ++calls;
+	}
+	throw Xapian::UnimplementedError("ThrowingWeight");
+    }
+
+    double get_maxpart() const { return 1.0; }
+
+    double get_sumextra(Xapian::termcount) const { return 0; }
+
+    double get_maxextra() const { return 0; }
+};
+
+Mutex ThrowingWeight::mutex;
+
+unsigned ThrowingWeight::calls = 0;
+
+/// Check an exception from a match in a worker thread is rethrown.
+DEFINE_TESTCASE(matchthreads4, brass) {
+    Xapian::Database db = get_database("matchthreads3",
+				       make_matchthreads3_db);
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query("A"));
+    enq.set_weighting_scheme(ThrowingWeight());
+    Xapian::QueryStats stats;
+    enq.set_query_stats(&stats);
+
+    ThrowingWeight::calls = 0;
+    TEST_EXCEPTION(Xapian::UnimplementedError, enq.get_mset(0, 10));
+    TEST_EQUAL(ThrowingWeight::calls, 1);
+
+    // Each of the four ranges of docids fails once, and the match shouldn't
+    // then be run again in the calling thread.
+    enq.set_match_threads(4);
+    ThrowingWeight::calls = 0;
+    TEST_EXCEPTION(Xapian::UnimplementedError, enq.get_mset(0, 10));
+    TEST_EQUAL(ThrowingWeight::calls, 4);
+
+    // Check the threaded match still works afterwards.
+    enq.set_weighting_scheme(Xapian::BoolWeight());
+    TEST_EQUAL(enq.get_mset(0, 10).size(), 10);
+
+    return true;
+}
+
+/// Check that Enquire::set_query_stats() records the work a match does.
+DEFINE_TESTCASE(querystats1, backend) {
+    Xapian::Database db = get_database("apitest_simpledata");
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query(Xapian::Query::OP_OR,
+				Xapian::Query("this"), Xapian::Query("word")));
+    Xapian::ValueCountMatchSpy spy(1);
+    enq.add_matchspy(&spy);
+
+    Xapian::QueryStats stats;
+    enq.set_query_stats(&stats);
+    for (unsigned threads = 0; threads <= 4; threads += 4) {
+	enq.set_match_threads(threads);
+	Xapian::MSet mset = enq.get_mset(0, 3);
+	tout << stats.get_description() << endl;
+	TEST_EQUAL(mset.size(), 3);
+	TEST_REL(stats.get_documents_scored(),>=,mset.size());
+	TEST_REL(stats.get_documents_rejected(),<=,stats.get_documents_scored());
+	TEST_REL(stats.get_values_fetched(),>=,mset.size());
+	TEST_REL(stats.get_prepare_time(),>=,0);
+	TEST_REL(stats.get_match_time(),>=,0);
+	TEST_EQUAL(stats.get_blocks_read("nonsense"), 0);
+	if (get_dbtype().find("brass") != string::npos) {
+	    TEST_REL(stats.get_postings_decoded(),>=,mset.size());
+	}
+    }
+
+    // Each match starts afresh.
+    Xapian::MSet mset = enq.get_mset(0, 3);
+    Xapian::doccount scored = stats.get_documents_scored();
+    mset = enq.get_mset(0, 3);
+    TEST_EQUAL(stats.get_documents_scored(), scored);
+
+    // Stop collecting statistics.
+    enq.set_query_stats(NULL);
+    stats.clear();
+    mset = enq.get_mset(0, 3);
+    TEST_EQUAL(stats.get_documents_scored(), 0);
+    TEST_EQUAL(stats.get_postings_decoded(), 0);
+    TEST_EQUAL(stats.get_blocks_read("postlist"), 0);
+    TEST_EQUAL(stats.get_match_time(), 0);
+
+    return true;
+}
+
 static void
 make_orcheck_db(Xapian::WritableDatabase &db, const string &)
 {
@@ -937,6 +1473,403 @@ DEFINE_TESTCASE(notermlist1, brass) {
     return true;
 }
 
+/// Feature test for Xapian::DB_MMAP.
+DEFINE_TESTCASE(mmap1, brass) {
+    string path = get_database_path("etext");
+    Xapian::Database db(path);
+    Xapian::Database mdb(path, Xapian::DB_MMAP);
+    TEST_EQUAL(db.get_doccount(), mdb.get_doccount());
+
+    Xapian::Query query(Xapian::Query::OP_OR,
+			Xapian::Query("time"), Xapian::Query("flower"));
+    Xapian::Enquire enquire(db);
+    enquire.set_query(query);
+    Xapian::Enquire menquire(mdb);
+    menquire.set_query(query);
+    Xapian::MSet mset = enquire.get_mset(0, 100);
+    Xapian::MSet mmset = menquire.get_mset(0, 100);
+    TEST(!mset.empty());
+    TEST_EQUAL(mset, mmset);
+
+    for (Xapian::docid did = 1; did <= db.get_doccount(); did += 7) {
+	TEST_EQUAL(db.get_document(did).get_data(),
+		   mdb.get_document(did).get_data());
+	TEST_EQUAL(db.get_doclength(did), mdb.get_doclength(did));
+    }
+
+    Xapian::TermIterator t = db.allterms_begin();
+    Xapian::TermIterator mt = mdb.allterms_begin();
+    while (t != db.allterms_end()) {
+	TEST(mt != mdb.allterms_end());
+	TEST_EQUAL(*t, *mt);
+	TEST_EQUAL(t.get_termfreq(), mt.get_termfreq());
+	++t;
+	++mt;
+    }
+    TEST(mt == mdb.allterms_end());
+
+    return true;
+}
+
+/// Restore the brass block cache size when a test exits.
+class BlockCacheSizeRestorer {
+    size_t old_size;
+
+  public:
+    BlockCacheSizeRestorer()
+	: old_size(Xapian::Brass::get_block_cache_size()) { }
+
+    ~BlockCacheSizeRestorer() {
+	Xapian::Brass::set_block_cache_size(old_size);
+    }
+};
+
+/** Make a database with postlists which span several blocks.
+ *
+ *  Only the blocks the match's postlists read are counted, and a short
+ *  postlist's block has already been read to look up the term's frequency.
+ */
+static void
+make_blockcache1_db(Xapian::WritableDatabase &db, const string &)
+{
+    for (Xapian::docid did = 1; did <= 10000; ++did) {
+	Xapian::Document doc;
+	doc.add_term("all", did % 100 + 1);
+	doc.add_term((did & 1) ? "odd" : "even");
+	db.add_document(doc);
+    }
+}
+
+/// Run a query, recording the blocks read in @a stats.
+static Xapian::MSet
+blockcache_query(const string & path, Xapian::QueryStats & stats)
+{
+    Xapian::Database db(path);
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query(Xapian::Query::OP_OR,
+				    Xapian::Query("all"),
+				    Xapian::Query("even")));
+    enquire.set_query_stats(&stats);
+    return enquire.get_mset(0, 100);
+}
+
+/// Feature test for Xapian::Brass::set_block_cache_size().
+DEFINE_TESTCASE(blockcache1, brass) {
+    BlockCacheSizeRestorer restorer;
+    string path = get_database_path("blockcache1", make_blockcache1_db);
+
+    Xapian::Brass::set_block_cache_size(0);
+    TEST_EQUAL(Xapian::Brass::get_block_cache_size(), 0);
+    Xapian::QueryStats stats;
+    Xapian::MSet mset = blockcache_query(path, stats);
+    TEST(!mset.empty());
+    TEST_REL(stats.get_blocks_read("postlist"),>,0);
+    TEST_EQUAL(stats.get_block_cache_hits("postlist"), 0);
+
+    Xapian::Brass::set_block_cache_size(16 * 1024 * 1024);
+    TEST_EQUAL(Xapian::Brass::get_block_cache_size(), 16 * 1024 * 1024);
+
+    // The first run with the cache enabled fills it, and the second should
+    // find everything it reads there.
+    Xapian::QueryStats cstats;
+    TEST_EQUAL(blockcache_query(path, cstats), mset);
+    cstats.clear();
+    TEST_EQUAL(blockcache_query(path, cstats), mset);
+    tout << cstats.get_description() << endl;
+    TEST_REL(cstats.get_block_cache_hits("postlist"),>,0);
+    TEST_EQUAL(cstats.get_block_cache_hits("postlist"),
+	       cstats.get_blocks_read("postlist"));
+
+    // Shrinking the cache to a couple of blocks means most reads miss, and
+    // entries get discarded as others are added, but the results should be
+    // unaffected.
+    Xapian::Brass::set_block_cache_size(2 * 8192);
+    cstats.clear();
+    TEST_EQUAL(blockcache_query(path, cstats), mset);
+    TEST_REL(cstats.get_block_cache_hits("postlist"),<,
+	     cstats.get_blocks_read("postlist"));
+
+    // A database opened with the cache disabled doesn't use it even once
+    // it's enabled again.
+    Xapian::Brass::set_block_cache_size(0);
+    Xapian::Database db(path);
+    Xapian::Brass::set_block_cache_size(16 * 1024 * 1024);
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("all"));
+    cstats.clear();
+    enquire.set_query_stats(&cstats);
+    for (int i = 0; i < 2; ++i) {
+	(void)enquire.get_mset(0, 10);
+    }
+    TEST_REL(cstats.get_blocks_read("postlist"),>,0);
+    TEST_EQUAL(cstats.get_block_cache_hits("postlist"), 0);
+
+    return true;
+}
+
+/** Check iterators from a DB_MMAP database still work after reopen().
+ *
+ *  DB_MMAP is only safe with a concurrent writer if the reader's revision is
+ *  pinned, so this also uses DB_PIN_REVISION.
+ */
+DEFINE_TESTCASE(mmap2, brass) {
+    Xapian::WritableDatabase wdb =
+	get_named_writable_database("mmap2", "apitest_simpledata");
+    wdb.commit();
+    Xapian::Database db(get_named_writable_database_path("mmap2"),
+			Xapian::DB_MMAP | Xapian::DB_PIN_REVISION);
+    Xapian::doccount old_doccount = db.get_doccount();
+    Xapian::PostingIterator p = db.postlist_begin("this");
+    Xapian::doccount old_termfreq = db.get_termfreq("this");
+
+    Xapian::Document doc;
+    doc.add_term("this");
+    doc.set_data("new document");
+    for (int i = 0; i < 100; ++i) {
+	wdb.add_document(doc);
+    }
+    wdb.commit();
+
+    TEST(db.reopen());
+    TEST_EQUAL(db.get_doccount(), old_doccount + 100);
+    TEST_EQUAL(db.get_termfreq("this"), old_termfreq + 100);
+    TEST_EQUAL(db.get_document(old_doccount + 1).get_data(), "new document");
+
+    // Reopen again, so the mapping from the first reopen() is replaced
+    // while nothing points into it, but the original one is still in use.
+    for (int i = 0; i < 100; ++i) {
+	wdb.add_document(doc);
+    }
+    wdb.commit();
+    TEST(db.reopen());
+    TEST_EQUAL(db.get_termfreq("this"), old_termfreq + 200);
+
+    // The iterator was created before reopen(), so should only see the
+    // documents which were there then.
+    Xapian::doccount count = 0;
+    while (p != db.postlist_end("this")) {
+	++count;
+	++p;
+    }
+    TEST_EQUAL(count, old_termfreq);
+
+    return true;
+}
+
+/// Feature test for Xapian::DB_PIN_REVISION.
+DEFINE_TESTCASE(pinrevision1, brass) {
+    Xapian::WritableDatabase wdb = get_named_writable_database("pinrevision1");
+    Xapian::Document doc;
+    doc.set_data("cargo");
+    doc.add_term("abc");
+    doc.add_term("def");
+    doc.add_term("ghi");
+    const int N = 500;
+    for (int i = 0; i < N; ++i) {
+	wdb.add_document(doc);
+    }
+    wdb.commit();
+
+    Xapian::Database db(get_named_writable_database_path("pinrevision1"),
+			Xapian::DB_PIN_REVISION);
+    TEST_EQUAL(db.get_doccount(), N);
+
+    // Without the pin, the reader would get DatabaseModifiedError after the
+    // second of these commits (see databasemodified1).
+    for (int j = 0; j < 5; ++j) {
+	for (int i = 1; i <= N; i += 3) {
+	    wdb.replace_document(i, doc);
+	}
+	wdb.add_document(doc);
+	wdb.commit();
+    }
+
+    TEST_EQUAL(*db.termlist_begin(N - 1), "abc");
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query("abc"));
+    Xapian::MSet mset = enq.get_mset(0, 10);
+    TEST_EQUAL(mset.get_matches_estimated(), N);
+
+    // Reopening should move the pin to the latest revision.
+    TEST(db.reopen());
+    TEST_EQUAL(db.get_doccount(), N + 5);
+    for (int j = 0; j < 5; ++j) {
+	wdb.delete_document(N + 1 + j);
+	wdb.commit();
+    }
+    TEST_EQUAL(db.get_doccount(), N + 5);
+    TEST_EQUAL(db.get_document(N + 5).get_data(), "cargo");
+    mset = enq.get_mset(0, 10);
+    TEST_EQUAL(mset.get_matches_estimated(), N + 5);
+
+    TEST(db.reopen());
+    TEST_EQUAL(db.get_doccount(), N);
+
+    return true;
+}
+
+/// Count the pin files in brass database directory @a path.
+static unsigned
+count_pins(const string & path)
+{
+    DIR * dir = opendir(path.c_str());
+    if (!dir) FAIL_TEST("Couldn't open directory " << path);
+    unsigned count = 0;
+    while (struct dirent * entry = readdir(dir)) {
+	if (startswith(entry->d_name, "pin.")) ++count;
+    }
+    closedir(dir);
+    return count;
+}
+
+/// Check that a child process doesn't remove a pin inherited across fork().
+DEFINE_TESTCASE(pinrevision2, brass) {
+#ifdef __WIN32__
+    SKIP_TEST("Test uses fork()");
+#else
+    Xapian::WritableDatabase wdb =
+	get_named_writable_database("pinrevision2", "apitest_simpledata");
+    wdb.commit();
+    string path = get_named_writable_database_path("pinrevision2");
+    Xapian::Database db(path, Xapian::DB_PIN_REVISION);
+    TEST_EQUAL(count_pins(path), 1);
+    wdb.add_document(Xapian::Document());
+    wdb.commit();
+
+    pid_t child = fork();
+    if (child == 0) {
+	// Reopening at the new revision moves our copy of the pin, and
+	// closing the database releases it, but neither should touch the
+	// parent's pin.
+	db.reopen();
+	db.close();
+	_exit(0);
+    }
+    TEST(child != -1);
+    int status;
+    while (waitpid(child, &status, 0) == -1 && errno == EINTR) { }
+    TEST(WIFEXITED(status));
+    TEST_EQUAL(WEXITSTATUS(status), 0);
+    TEST_EQUAL(count_pins(path), 1);
+
+    db.close();
+    TEST_EQUAL(count_pins(path), 0);
+    return true;
+#endif
+}
+
+/// Check that skipping postlist chunks by their max wdf doesn't lose hits.
+DEFINE_TESTCASE(chunkmaxwdf1, brass) {
+    Xapian::WritableDatabase wdb = get_named_writable_database("chunkmaxwdf1");
+    for (Xapian::docid did = 1; did <= 5000; ++did) {
+	Xapian::Document doc;
+	doc.add_term("common", 1 + (did % 3));
+	if (did % 7 == 0)
+	    doc.add_term("rare", (did % 2000 == 0) ? 50 : 1 + (did % 5));
+	doc.add_term("padding", 1 + (did % 11));
+	wdb.add_document(doc);
+    }
+    wdb.commit();
+
+    // Delete and modify some documents so chunks get rewritten.
+    for (Xapian::docid did = 1; did <= 5000; did += 97) {
+	wdb.delete_document(did);
+    }
+    for (Xapian::docid did = 50; did <= 5000; did += 301) {
+	Xapian::Document doc;
+	doc.add_term("common", 40);
+	doc.add_term("rare", 2);
+	wdb.replace_document(did, doc);
+    }
+    wdb.commit();
+
+    string path = get_named_writable_database_path("chunkmaxwdf1");
+    TEST_EQUAL(Xapian::Database::check(path), 0);
+
+    Xapian::Database db(path);
+    Xapian::Enquire enq(db);
+    static const char * const terms[] = { "common", "rare" };
+    Xapian::Query::op ops[] = { Xapian::Query::OP_OR, Xapian::Query::OP_AND };
+    for (size_t i = 0; i != sizeof(ops) / sizeof(ops[0]); ++i) {
+	enq.set_query(Xapian::Query(ops[i], terms, terms + 2));
+	Xapian::MSet all = enq.get_mset(0, db.get_doccount());
+	Xapian::MSet top = enq.get_mset(0, 10);
+	TEST_EQUAL(top.size(), 10);
+	for (Xapian::doccount j = 0; j != top.size(); ++j) {
+	    TEST_EQUAL(*top[j], *all[j]);
+	    TEST_EQUAL_DOUBLE(top[j].get_weight(), all[j].get_weight());
+	}
+    }
+
+    return true;
+}
+
+/** BM25Weight which can be stopped from skipping postlist chunks.
+ *
+ *  Also counts how often a bound for a chunk was asked for.
+ */
+class ChunkSkipBM25Weight : public Xapian::BM25Weight {
+    bool allow_skip;
+
+  public:
+    static unsigned calls;
+
+    explicit ChunkSkipBM25Weight(bool allow_skip_)
+	: allow_skip(allow_skip_) { }
+
+    ChunkSkipBM25Weight * clone() const {
+	return new ChunkSkipBM25Weight(allow_skip);
+    }
+
+  protected:
+    double get_maxpart_for_wdf(Xapian::termcount wdf_max) const {
+	++calls;
+	if (!allow_skip) wdf_max = get_wdf_upper_bound();
+	return BM25Weight::get_maxpart_for_wdf(wdf_max);
+    }
+};
+
+unsigned ChunkSkipBM25Weight::calls = 0;
+
+static void
+make_chunkmaxwdf2_db(Xapian::WritableDatabase &db, const string &)
+{
+    for (Xapian::docid did = 1; did <= 20000; ++did) {
+	Xapian::Document doc;
+	doc.add_term("common", (did % 1000 == 0) ? 30 : 1 + (did % 3));
+	if (did % 3 == 0)
+	    doc.add_term("other", (did % 4500 == 0) ? 20 : 1);
+	doc.add_term("padding", 1 + (did % 11));
+	db.add_document(doc);
+    }
+}
+
+/// Check skipping postlist chunks gives the same MSet as not skipping.
+DEFINE_TESTCASE(chunkmaxwdf2, brass) {
+    Xapian::Database db = get_database("chunkmaxwdf2", make_chunkmaxwdf2_db);
+    Xapian::Enquire enq(db);
+    static const char * const terms[] = { "common", "other" };
+    Xapian::Query queries[] = {
+	Xapian::Query("common"),
+	Xapian::Query(Xapian::Query::OP_OR, terms, terms + 2),
+	Xapian::Query(Xapian::Query::OP_AND, terms, terms + 2)
+    };
+    for (size_t i = 0; i != sizeof(queries) / sizeof(queries[0]); ++i) {
+	tout << queries[i].get_description() << endl;
+	enq.set_query(queries[i]);
+	enq.set_weighting_scheme(ChunkSkipBM25Weight(false));
+	Xapian::MSet noskip = enq.get_mset(0, 10);
+	ChunkSkipBM25Weight::calls = 0;
+	enq.set_weighting_scheme(ChunkSkipBM25Weight(true));
+	Xapian::MSet skip = enq.get_mset(0, 10);
+	TEST_REL(ChunkSkipBM25Weight::calls,>,0);
+	TEST_EQUAL(skip.size(), 10);
+	TEST_EQUAL(skip, noskip);
+    }
+
+    return true;
+}
+
 /// Regression test for bug starting a new brass freelist block.
 DEFINE_TESTCASE(newfreelistblock1, writable) {
     Xapian::Document doc;
@@ -35,6 +35,11 @@
 #include <cstdlib>
 #include <fstream>
 
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
+#include "safesysstat.h"
 #include "str.h"
 #include "unixcmds.h"
 
@@ -257,6 +262,70 @@ DEFINE_TESTCASE(compactmerge1, brass || chert) {
     TEST_EQUAL(indb.get_doccount() * 2, outdb.get_doccount());
     dbcheck(outdb, outdb.get_doccount(), outdb.get_doccount());
 
+    // Check the positional information was merged correctly (the docids from
+    // the second source need to be offset).
+    Xapian::doccount n = indb.get_doccount();
+    for (Xapian::docid did = 1; did <= n; ++did) {
+	string terms = docterms_to_string(indb, did);
+	TEST_EQUAL(docterms_to_string(outdb, did), terms);
+	TEST_EQUAL(docterms_to_string(outdb, did + n), terms);
+    }
+
+    return true;
+}
+
+static void
+make_positional_db(Xapian::WritableDatabase &db, const string & prefix)
+{
+    // Some terms are in both sources, and some are only in one.
+    for (int i = 1; i <= 30; ++i) {
+	Xapian::Document doc;
+	for (int j = 1; j <= i % 7 + 1; ++j) {
+	    doc.add_posting("common", i * j);
+	    doc.add_posting(prefix + str(j), j + 1);
+	}
+	db.add_document(doc);
+    }
+}
+
+/** Check positions from every source survive merging.
+ *
+ *  Brass position keys start with the term name, so the sources have to be
+ *  merged rather than copied one after another.
+ */
+DEFINE_TESTCASE(compactpositions1, generated) {
+    string apath = get_database_path("compactpositions1a",
+				     make_positional_db, "a");
+    string bpath = get_database_path("compactpositions1b",
+				     make_positional_db, "b");
+    string outdbpath = get_named_writable_database_path("compactpositions1out");
+    rm_rf(outdbpath);
+
+    Xapian::Compactor compact;
+    compact.set_destdir(outdbpath);
+    compact.add_source(apath);
+    compact.add_source(bpath);
+    compact.compact();
+
+    Xapian::Database a(apath);
+    Xapian::Database b(bpath);
+    Xapian::Database outdb(outdbpath);
+    Xapian::doccount n = a.get_doccount();
+    TEST_EQUAL(outdb.get_doccount(), n + b.get_doccount());
+    dbcheck(outdb, outdb.get_doccount(), outdb.get_lastdocid());
+
+    for (Xapian::docid did = 1; did <= n; ++did) {
+	TEST_EQUAL(docterms_to_string(outdb, did), docterms_to_string(a, did));
+	TEST_EQUAL(docterms_to_string(outdb, did + n),
+		   docterms_to_string(b, did));
+    }
+    TEST_EQUAL(outdb.get_collection_freq("common"),
+	       a.get_collection_freq("common") +
+	       b.get_collection_freq("common"));
+    Xapian::PositionIterator p = outdb.positionlist_begin(n + 3, "b1");
+    TEST_EQUAL(positions_to_string(p, outdb.positionlist_end(n + 3, "b1")),
+	       "2");
+
     return true;
 }
 
@@ -297,6 +366,72 @@ DEFINE_TESTCASE(compactmultichunks1, generated) {
     return true;
 }
 
+static void
+make_readahead_db(Xapian::WritableDatabase &db, const string &)
+{
+    for (Xapian::docid did = 1; did <= 20000; ++did) {
+	Xapian::Document doc;
+	doc.add_term("all", did % 5 + 1);
+	doc.add_term("t" + str(did % 1000));
+	doc.add_term("u" + str(did));
+	db.add_document(doc);
+    }
+}
+
+/** Smoke test for reading ahead when scanning a sequential table.
+ *
+ *  A fully compacted table is sequential, so iterating over its terms and
+ *  postlists reads it with next_for_sequential(), which reads ahead of the
+ *  scan.  The table needs to be many times the read-ahead window.
+ */
+DEFINE_TESTCASE(compactreadahead1, brass) {
+    string indbpath = get_database_path("compactreadahead1in",
+					make_readahead_db);
+    string outdbpath = get_named_writable_database_path("compactreadahead1out");
+    rm_rf(outdbpath);
+
+    Xapian::Compactor compact;
+    compact.set_destdir(outdbpath);
+    compact.set_compaction_level(Xapian::Compactor::FULL);
+    compact.add_source(indbpath);
+    compact.compact();
+
+    Xapian::Database indb(indbpath);
+    Xapian::Database outdb(outdbpath);
+    dbcheck(outdb, outdb.get_doccount(), outdb.get_lastdocid());
+
+    // Scan twice, so the second scan starts back before the read-ahead
+    // window.
+    for (int pass = 0; pass < 2; ++pass) {
+	Xapian::TermIterator t = indb.allterms_begin();
+	Xapian::TermIterator ot = outdb.allterms_begin();
+	Xapian::termcount n_terms = 0;
+	while (t != indb.allterms_end()) {
+	    TEST(ot != outdb.allterms_end());
+	    TEST_EQUAL(*ot, *t);
+	    TEST_EQUAL(ot.get_termfreq(), t.get_termfreq());
+	    ++t;
+	    ++ot;
+	    ++n_terms;
+	}
+	TEST(ot == outdb.allterms_end());
+	TEST_EQUAL(n_terms, 1 + 1000 + 20000);
+    }
+
+    Xapian::PostingIterator p = indb.postlist_begin("all");
+    Xapian::PostingIterator op = outdb.postlist_begin("all");
+    while (p != indb.postlist_end("all")) {
+	TEST(op != outdb.postlist_end("all"));
+	TEST_EQUAL(*op, *p);
+	TEST_EQUAL(op.get_wdf(), p.get_wdf());
+	++p;
+	++op;
+    }
+    TEST(op == outdb.postlist_end("all"));
+
+    return true;
+}
+
 // Test compacting from a stub database directory.
 DEFINE_TESTCASE(compactstub1, brass || chert) {
     const char * stubpath = ".stub/compactstub1";
@@ -584,3 +719,366 @@ DEFINE_TESTCASE(compactmultipass1, brass || chert) {
 
     return true;
 }
+
+/// Check compacting with several threads gives the same result.
+static void
+make_valued_db(Xapian::WritableDatabase &db, const string & s)
+{
+    Xapian::docid n = strtoul(s.c_str(), NULL, 10);
+    for (Xapian::docid i = 1; i <= n; ++i) {
+	Xapian::Document doc;
+	doc.set_data(s + ":" + str(i));
+	doc.add_boolean_term("Q" + str(i));
+	doc.add_posting("all", 1);
+	doc.add_posting(string(i % 7 + 1, char((i % 26) + 'a')), 2);
+	doc.add_value(0, str(i));
+	if (i % 3) doc.add_value(1, Xapian::sortable_serialise(i * 0.5));
+	db.add_document(doc);
+    }
+    db.commit();
+}
+
+/// Check that @a db has the same contents as @a ref.
+static void
+check_same_contents(const Xapian::Database & db, const Xapian::Database & ref)
+{
+    TEST_EQUAL(dbstats_to_string(db), dbstats_to_string(ref));
+    Xapian::TermIterator t = db.allterms_begin();
+    Xapian::TermIterator r = ref.allterms_begin();
+    while (r != ref.allterms_end()) {
+	TEST(t != db.allterms_end());
+	TEST_EQUAL(*t, *r);
+	TEST_EQUAL(t.get_termfreq(), r.get_termfreq());
+	TEST_EQUAL(postlist_to_string(db, *t), postlist_to_string(ref, *r));
+	++t;
+	++r;
+    }
+    TEST(t == db.allterms_end());
+
+    for (Xapian::valueno slot = 0; slot != 2; ++slot) {
+	TEST_EQUAL(db.get_value_freq(slot), ref.get_value_freq(slot));
+	TEST_EQUAL(db.get_value_lower_bound(slot),
+		   ref.get_value_lower_bound(slot));
+	TEST_EQUAL(db.get_value_upper_bound(slot),
+		   ref.get_value_upper_bound(slot));
+    }
+
+    Xapian::PostingIterator p = ref.postlist_begin(string());
+    for ( ; p != ref.postlist_end(string()); ++p) {
+	Xapian::Document doc = db.get_document(*p);
+	Xapian::Document refdoc = ref.get_document(*p);
+	TEST_EQUAL(doc.get_data(), refdoc.get_data());
+	TEST_EQUAL(docterms_to_string(db, *p), docterms_to_string(ref, *p));
+	Xapian::ValueIterator v = doc.values_begin();
+	Xapian::ValueIterator rv = refdoc.values_begin();
+	while (rv != refdoc.values_end()) {
+	    TEST(v != doc.values_end());
+	    TEST_EQUAL(v.get_valueno(), rv.get_valueno());
+	    TEST_EQUAL(*v, *rv);
+	    ++v;
+	    ++rv;
+	}
+	TEST(v == doc.values_end());
+    }
+}
+
+/// Check compacting with threads gives the same result as without.
+DEFINE_TESTCASE(compactthreads1, brass) {
+    string sparse[4];
+    sparse[0] = get_database_path("compactnorenumber1a", make_sparse_db,
+				  "5-7 24 76 987 1023-1027 9999 !9999");
+    sparse[1] = get_database_path("compactnorenumber1b", make_sparse_db,
+				  "1027-1030");
+    sparse[2] = get_database_path("compactnorenumber1c", make_sparse_db,
+				  "1028-1040");
+    sparse[3] = get_database_path("compactnorenumber1d", make_sparse_db,
+				  "3000 999999 !999999");
+    // Enough documents for the postlists and values to need several chunks.
+    string valued[4];
+    valued[0] = get_database_path("compactthreads1a", make_valued_db, "800");
+    valued[1] = get_database_path("compactthreads1b", make_valued_db, "1200");
+    valued[2] = get_database_path("compactthreads1c", make_valued_db, "500");
+    valued[3] = get_database_path("compactthreads1d", make_valued_db, "900");
+
+    for (int sources = 0; sources != 2; ++sources) {
+	const string * inputs = sources ? valued : sparse;
+
+	string refdbpath = get_named_writable_database_path("compactthreads1ref");
+	rm_rf(refdbpath);
+	{
+	    Xapian::Compactor compact;
+	    compact.set_destdir(refdbpath);
+	    for (int i = 0; i != 4; ++i) compact.add_source(inputs[i]);
+	    compact.compact();
+	}
+	Xapian::Database refdb(refdbpath);
+
+	for (int multipass = 0; multipass != 2; ++multipass) {
+	    string outdbpath = get_named_writable_database_path("compactthreads1");
+	    rm_rf(outdbpath);
+
+	    Xapian::Compactor compact;
+	    compact.set_destdir(outdbpath);
+	    for (int i = 0; i != 4; ++i) compact.add_source(inputs[i]);
+	    compact.set_multipass(multipass);
+	    compact.set_threads(4);
+	    compact.compact();
+
+	    Xapian::Database outdb(outdbpath);
+	    if (!sources) dbcheck(outdb, 29, 1041);
+	    check_same_contents(outdb, refdb);
+	}
+    }
+
+    return true;
+}
+
+/// Compact and return the description of the error, or "" if none.
+static string
+compact_error(const string * inputs, size_t n_inputs, int threads,
+	      bool multipass)
+{
+    string outdbpath = get_named_writable_database_path("compactthreads2");
+    rm_rf(outdbpath);
+    Xapian::Compactor compact;
+    compact.set_destdir(outdbpath);
+    for (size_t i = 0; i != n_inputs; ++i) compact.add_source(inputs[i]);
+    compact.set_multipass(multipass);
+    compact.set_threads(threads);
+    try {
+	compact.compact();
+    } catch (const Xapian::Error & e) {
+	return e.get_description();
+    }
+    return string();
+}
+
+/// Check errors compacting in threads are reported as without threads.
+DEFINE_TESTCASE(compactthreads2, brass) {
+    string inputs[4];
+    inputs[0] = get_database_path("compactthreads1a", make_valued_db, "800");
+    inputs[1] = get_named_writable_database_path("compactthreads2src");
+    inputs[2] = get_database_path("compactthreads1c", make_valued_db, "500");
+    inputs[3] = get_database_path("compactthreads1d", make_valued_db, "900");
+
+    const char * tables[] = { "postlist", "record", "termlist" };
+    for (size_t t = 0; t != sizeof(tables) / sizeof(tables[0]); ++t) {
+	// Cut a table in one of the inputs short.
+	rm_rf(inputs[1]);
+	cp_R(get_database_path("compactthreads1b", make_valued_db, "1200"),
+	     inputs[1]);
+	string table = inputs[1] + "/" + tables[t] + ".DB";
+	string head;
+	{
+	    ifstream in(table.c_str(), ios::binary);
+	    char buf[8192];
+	    in.read(buf, sizeof(buf));
+	    head.assign(buf, in.gcount());
+	}
+	{
+	    ofstream out(table.c_str(), ios::binary | ios::trunc);
+	    out.write(head.data(), head.size());
+	}
+
+	for (int multipass = 0; multipass != 2; ++multipass) {
+	    string expected = compact_error(inputs, 4, 1, multipass);
+	    TEST(!expected.empty());
+	    TEST_EQUAL(compact_error(inputs, 4, 4, multipass), expected);
+	}
+    }
+
+    return true;
+}
+
+struct ShardedWriterJob {
+    Xapian::ShardedWriter * writer;
+    unsigned first, last;
+    string error;
+};
+
+extern "C" {
+static void *
+add_sharded_documents(void * arg)
+{
+    ShardedWriterJob & job = *static_cast<ShardedWriterJob *>(arg);
+    try {
+	for (unsigned i = job.first; i <= job.last; ++i) {
+	    Xapian::Document doc;
+	    doc.set_data(str(i));
+	    doc.add_boolean_term("Q" + str(i));
+	    doc.add_posting("all", 1);
+	    doc.add_posting(string(i % 7 + 1, char((i % 26) + 'a')), 2);
+	    doc.add_value(0, str(i));
+	    job.writer->add_document(doc);
+	}
+    } catch (const Xapian::Error & e) {
+	job.error = e.get_description();
+    }
+    return NULL;
+}
+}
+
+/// Check ShardedWriter with documents added from several threads.
+DEFINE_TESTCASE(shardedwriter1, brass) {
+    string outdbpath = get_named_writable_database_path("shardedwriter1");
+    rm_rf(outdbpath);
+
+    const unsigned N_THREADS = 4;
+    {
+	Xapian::ShardedWriter writer(outdbpath, 3);
+	TEST(dir_exists(outdbpath + ".shard2"));
+	ShardedWriterJob jobs[N_THREADS];
+	for (unsigned n = 0; n != N_THREADS; ++n) {
+	    jobs[n].writer = &writer;
+	    jobs[n].first = n * 50 + 1;
+	    jobs[n].last = n * 50 + 50;
+	}
+#ifdef HAVE_PTHREAD
+	pthread_t threads[N_THREADS];
+	for (unsigned n = 0; n != N_THREADS; ++n) {
+	    TEST_EQUAL(pthread_create(&threads[n], NULL, add_sharded_documents,
+				      &jobs[n]), 0);
+	}
+	for (unsigned n = 0; n != N_THREADS; ++n) {
+	    pthread_join(threads[n], NULL);
+	}
+#else
+	for (unsigned n = 0; n != N_THREADS; ++n) {
+	    add_sharded_documents(&jobs[n]);
+	}
+#endif
+	for (unsigned n = 0; n != N_THREADS; ++n) {
+	    TEST_EQUAL(jobs[n].error, "");
+	}
+	writer.finish();
+	TEST(!dir_exists(outdbpath + ".shard0"));
+	TEST(!dir_exists(outdbpath + ".shard2"));
+	TEST_EXCEPTION(Xapian::InvalidOperationError, writer.finish());
+    }
+
+    Xapian::Database outdb(outdbpath);
+    dbcheck(outdb, N_THREADS * 50, N_THREADS * 50);
+    TEST_EQUAL(outdb.get_termfreq("all"), N_THREADS * 50);
+    TEST_EQUAL(outdb.get_value_freq(0), N_THREADS * 50);
+    for (unsigned i = 1; i <= N_THREADS * 50; ++i) {
+	string term = "Q" + str(i);
+	TEST_EQUAL(outdb.get_termfreq(term), 1);
+	Xapian::docid did = *outdb.postlist_begin(term);
+	TEST_EQUAL(outdb.get_document(did).get_data(), str(i));
+	TEST_EQUAL(outdb.get_document(did).get_value(0), str(i));
+    }
+
+    // If finish() isn't called, the shards should just be removed.
+    string unfinished = outdbpath + "-unfinished";
+    {
+	Xapian::ShardedWriter writer(unfinished, 2);
+	writer.add_document(Xapian::Document());
+	TEST(dir_exists(unfinished + ".shard1"));
+    }
+    TEST(!dir_exists(unfinished + ".shard0"));
+    TEST(!dir_exists(unfinished + ".shard1"));
+    TEST(!dir_exists(unfinished));
+
+    return true;
+}
+
+/// Check the --threads option of the copydatabase example.
+DEFINE_TESTCASE(copydatabase1, brass) {
+#ifdef __WIN32__
+    SKIP_TEST("Test not supported on this platform");
+#else
+    string indbpath = get_database_path("compactthreads1b", make_valued_db,
+					"1200");
+    string outdbpath = get_named_writable_database_path("copydatabase1");
+    rm_rf(outdbpath);
+
+    string cmd = "../examples/copydatabase --threads=3 ";
+    cmd += indbpath;
+    cmd += ' ';
+    cmd += outdbpath;
+    cmd += " > /dev/null 2>&1";
+    TEST_EQUAL(system(cmd.c_str()), 0);
+
+    // The documents may be renumbered in a different order, so compare the
+    // terms and values rather than the documents.
+    Xapian::Database indb(indbpath);
+    Xapian::Database outdb(outdbpath);
+    TEST_EQUAL(outdb.get_doccount(), indb.get_doccount());
+    TEST_EQUAL(outdb.get_lastdocid(), indb.get_doccount());
+    TEST_EQUAL(outdb.get_avlength(), indb.get_avlength());
+    Xapian::TermIterator t = indb.allterms_begin();
+    Xapian::TermIterator u = outdb.allterms_begin();
+    while (t != indb.allterms_end()) {
+	TEST(u != outdb.allterms_end());
+	TEST_EQUAL(*u, *t);
+	TEST_EQUAL(u.get_termfreq(), t.get_termfreq());
+	TEST_EQUAL(outdb.get_collection_freq(*u), indb.get_collection_freq(*t));
+	++t;
+	++u;
+    }
+    TEST(u == outdb.allterms_end());
+    TEST_EQUAL(outdb.get_value_freq(0), indb.get_value_freq(0));
+    TEST_EQUAL(outdb.get_value_lower_bound(0), indb.get_value_lower_bound(0));
+    TEST_EQUAL(outdb.get_value_upper_bound(0), indb.get_value_upper_bound(0));
+
+    // The temporary shards should have been removed.
+    TEST(!dir_exists(outdbpath + ".shard0"));
+
+    // Refuse to overwrite an existing database.
+    TEST_NOT_EQUAL(system(cmd.c_str()), 0);
+    TEST_EQUAL(Xapian::Database(outdbpath).get_doccount(), indb.get_doccount());
+
+    return true;
+#endif
+}
+
+/// Check ShardedWriter keeps the shards if the merge fails.
+DEFINE_TESTCASE(shardedwriter2, brass) {
+    string outdbpath = get_named_writable_database_path("shardedwriter2");
+    rm_rf(outdbpath);
+    rm_rf(outdbpath + ".shard0");
+    rm_rf(outdbpath + ".shard1");
+
+    {
+	Xapian::ShardedWriter writer(outdbpath, 2);
+	for (unsigned i = 1; i <= 10; ++i) {
+	    Xapian::Document doc;
+	    doc.add_boolean_term("Q" + str(i));
+	    doc.add_term("all");
+	    writer.add_document(doc);
+	}
+
+	// Make the compaction fail by putting a directory where it needs to
+	// write one of the merged tables.
+	mkdir(outdbpath.c_str(), 0755);
+	mkdir((outdbpath + "/postlist.DB").c_str(), 0755);
+	TEST_EXCEPTION(Xapian::DatabaseError, writer.finish());
+	TEST(dir_exists(outdbpath + ".shard0"));
+	TEST(dir_exists(outdbpath + ".shard1"));
+	TEST_EXCEPTION(Xapian::InvalidOperationError,
+		       writer.add_document(Xapian::Document()));
+
+	// Retrying should now work.
+	rm_rf(outdbpath);
+	writer.finish();
+	TEST(!dir_exists(outdbpath + ".shard0"));
+	TEST(!dir_exists(outdbpath + ".shard1"));
+    }
+
+    Xapian::Database outdb(outdbpath);
+    TEST_EQUAL(outdb.get_doccount(), 10);
+    TEST_EQUAL(outdb.get_termfreq("Q7"), 1);
+
+    // A shard path which already exists shouldn't get overwritten.
+    string clash = outdbpath + "-clash";
+    rm_rf(clash + ".shard1");
+    mkdir((clash + ".shard1").c_str(), 0755);
+    touch(clash + ".shard1/keep");
+    TEST_EXCEPTION(Xapian::DatabaseCreateError,
+		   Xapian::ShardedWriter writer(clash, 2));
+    TEST(file_exists(clash + ".shard1/keep"));
+    TEST(!dir_exists(clash + ".shard0"));
+    rm_rf(clash + ".shard1");
+
+    return true;
+}
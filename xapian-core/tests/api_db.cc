@@ -902,6 +902,42 @@ DEFINE_TESTCASE(keepalive1, remote) {
     return true;
 }
 
+/// Check xapian-tcpsrv --threads serves several clients at once.
+DEFINE_TESTCASE(tcpsrvthreads1, remote) {
+    SKIP_TEST_UNLESS_BACKEND("remotetcp");
+#ifdef __WIN32__
+    SKIP_TEST("Test not supported on this platform");
+#endif
+    Xapian::Database ref_db(get_database("apitest_simpledata"));
+    Xapian::Enquire ref_enq(ref_db);
+    ref_enq.set_query(Xapian::Query("word"));
+    Xapian::MSet ref = ref_enq.get_mset(0, 10);
+    TEST(!ref.empty());
+
+    const unsigned N_THREADS = 3;
+    int port = start_threaded_remote_server("apitest_simpledata", N_THREADS);
+
+    // Each thread serves one connection at a time, so if the threads didn't
+    // run at once, opening the later connections would time out.  Do this
+    // twice to check a thread can serve another connection afterwards.
+    for (int round = 0; round != 2; ++round) {
+	vector<Xapian::Database> dbs;
+	for (unsigned i = 0; i != N_THREADS; ++i) {
+	    dbs.push_back(Xapian::Remote::open("127.0.0.1", port));
+	}
+	for (unsigned i = 0; i != N_THREADS; ++i) {
+	    Xapian::Enquire enq(dbs[i]);
+	    enq.set_query(Xapian::Query("word"));
+	    Xapian::MSet mset = enq.get_mset(0, 10);
+	    TEST(mset_range_is_same(mset, 0, ref, 0, ref.size()));
+	    TEST_EQUAL(dbs[i].get_doccount(), ref_db.get_doccount());
+	}
+	for (unsigned i = 0; i != N_THREADS; ++i) dbs[i].close();
+    }
+
+    return true;
+}
+
 // test that iterating through all terms in a database works.
 DEFINE_TESTCASE(allterms1, backend) {
     Xapian::Database db(get_database("apitest_allterms"));
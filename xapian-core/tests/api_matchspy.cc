@@ -28,10 +28,12 @@
 #include <xapian.h>
 
 #include "str.h"
+#include <algorithm>
 #include <cmath>
 #include <map>
 #include <vector>
 
+#include "autoptr.h"
 #include "backendmanager.h"
 #include "testsuite.h"
 #include "testutils.h"
@@ -327,3 +329,236 @@ DEFINE_TESTCASE(matchspy6, !backend)
 
     return true;
 }
+
+/** Merge the serialised results of @a spy into a clone of it twice.
+ *
+ *  Also checks that results with trailing junk are rejected.  The caller
+ *  should check the clone's counts are double @a spy's.
+ */
+template<class S>
+static AutoPtr<S>
+merge_twice_into_clone(const S & spy)
+{
+    string results = spy.serialise_results();
+    {
+	AutoPtr<Xapian::MatchSpy> junk(spy.clone());
+	TEST_EXCEPTION(Xapian::NetworkError, junk->merge_results(results + "x"));
+    }
+
+    AutoPtr<S> clone(static_cast<S *>(spy.clone()));
+    clone->merge_results(results);
+    clone->merge_results(results);
+    return clone;
+}
+
+// Test ValueCountMatchSpy with many different values, and merging results.
+DEFINE_TESTCASE(matchspy7, !backend)
+{
+    Xapian::ValueCountMatchSpy spy(0);
+    map<string, Xapian::doccount> expected;
+    for (unsigned i = 0; i != 5000; ++i) {
+	Xapian::Document doc;
+	// Lots of values seen a few times, and some seen much more often.
+	string value = (i % 5) ? "v" + str(i % 1234) : "common" + str(i % 7);
+	doc.add_value(0, value);
+	spy(doc, 1.0);
+	++expected[value];
+    }
+    // A document without a value is counted in the total only.
+    spy(Xapian::Document(), 1.0);
+    TEST_EQUAL(spy.get_total(), 5001);
+
+    map<string, Xapian::doccount>::const_iterator exp_it = expected.begin();
+    Xapian::TermIterator i;
+    for (i = spy.values_begin(); i != spy.values_end(); ++i) {
+	TEST(exp_it != expected.end());
+	TEST_EQUAL(*i, exp_it->first);
+	TEST_EQUAL(i.get_termfreq(), exp_it->second);
+	++exp_it;
+    }
+    TEST(exp_it == expected.end());
+
+    // Work out the ten most frequent values, with ties broken by putting
+    // values in alphabetical order.
+    vector<pair<Xapian::doccount, string> > by_freq;
+    for (exp_it = expected.begin(); exp_it != expected.end(); ++exp_it) {
+	// Negate the frequency so sorting puts the most frequent first.
+	by_freq.push_back(make_pair(-exp_it->second, exp_it->first));
+    }
+    sort(by_freq.begin(), by_freq.end());
+    i = spy.top_values_begin(10);
+    for (size_t n = 0; n != 10; ++n) {
+	TEST(i != spy.top_values_end(10));
+	TEST_EQUAL(*i, by_freq[n].second);
+	TEST_EQUAL(i.get_termfreq(), -by_freq[n].first);
+	++i;
+    }
+    TEST(i == spy.top_values_end(10));
+    TEST(spy.top_values_begin(0) == spy.top_values_end(0));
+
+    // Merging the serialised results into a clone should give the same
+    // counts, and merging again should double them.
+    AutoPtr<Xapian::ValueCountMatchSpy> spy2 = merge_twice_into_clone(spy);
+    TEST_EQUAL(spy2->get_total(), 10002);
+    exp_it = expected.begin();
+    for (i = spy2->values_begin(); i != spy2->values_end(); ++i) {
+	TEST(exp_it != expected.end());
+	TEST_EQUAL(*i, exp_it->first);
+	TEST_EQUAL(i.get_termfreq(), exp_it->second * 2);
+	++exp_it;
+    }
+    TEST(exp_it == expected.end());
+
+    return true;
+}
+
+// Test NumericHistogramMatchSpy with fixed and logarithmic buckets.
+DEFINE_TESTCASE(matchspy8, !backend)
+{
+    Xapian::NumericHistogramMatchSpy spy(0, 0.0, 10.0, 5);
+    TEST_EQUAL(spy.get_num_buckets(), 5);
+    TEST_EQUAL(spy.get_min(), HUGE_VAL);
+    TEST_EQUAL(spy.get_max(), -HUGE_VAL);
+    for (int i = -5; i != 60; ++i) {
+	Xapian::Document doc;
+	doc.add_value(0, Xapian::sortable_serialise(i));
+	spy(doc, 1.0);
+    }
+    // A document without a value counts towards get_total(), but isn't in
+    // any bucket or in the underflow or overflow counts.
+    spy(Xapian::Document(), 1.0);
+    TEST_EQUAL(spy.get_total(), 66);
+    TEST_EQUAL(spy.get_count(), 65);
+    TEST_EQUAL(spy.get_underflow_count(), 5);
+    TEST_EQUAL(spy.get_overflow_count(), 10);
+    for (unsigned b = 0; b != 5; ++b) {
+	TEST_EQUAL(spy.get_bucket_start(b), b * 10.0);
+	TEST_EQUAL(spy.get_bucket_count(b), 10);
+    }
+    TEST_EQUAL(spy.get_bucket_start(5), 50.0);
+    TEST_EQUAL(spy.get_min(), -5.0);
+    TEST_EQUAL(spy.get_max(), 59.0);
+    TEST_EQUAL(spy.get_sum(), 1755.0);
+    TEST_EXCEPTION(Xapian::RangeError, spy.get_bucket_count(5));
+
+    // Merging adds the counts and sums, but the minimum and maximum are
+    // unchanged.
+    AutoPtr<Xapian::NumericHistogramMatchSpy> spy2 =
+	merge_twice_into_clone(spy);
+    TEST_EQUAL(spy2->get_total(), 132);
+    TEST_EQUAL(spy2->get_count(), 130);
+    TEST_EQUAL(spy2->get_underflow_count(), 10);
+    TEST_EQUAL(spy2->get_overflow_count(), 20);
+    TEST_EQUAL(spy2->get_bucket_count(3), 20);
+    TEST_EQUAL(spy2->get_min(), -5.0);
+    TEST_EQUAL(spy2->get_max(), 59.0);
+    TEST_EQUAL(spy2->get_sum(), 3510.0);
+
+    // Results from a spy with different buckets are rejected, and leave the
+    // counts unchanged.
+    static const struct {
+	double start, step;
+	unsigned num_buckets;
+	bool logarithmic;
+    } others[] = {
+	{ 0.0, 10.0, 4, false },
+	{ 1.0, 10.0, 5, false },
+	{ 0.0, 5.0, 5, false },
+	{ 1.0, 10.0, 5, true }
+    };
+    Xapian::Document doc;
+    doc.add_value(0, Xapian::sortable_serialise(1.0));
+    for (size_t i = 0; i != sizeof(others) / sizeof(others[0]); ++i) {
+	Xapian::NumericHistogramMatchSpy other(0, others[i].start,
+					       others[i].step,
+					       others[i].num_buckets,
+					       others[i].logarithmic);
+	other(doc, 1.0);
+	TEST_EXCEPTION(Xapian::NetworkError,
+		       spy.merge_results(other.serialise_results()));
+	TEST_EQUAL(spy.get_total(), 66);
+	TEST_EQUAL(spy.get_bucket_count(0), 10);
+    }
+
+    // Powers of 10 from 1 to 1000 in three buckets.
+    Xapian::NumericHistogramMatchSpy logspy(1, 1.0, 10.0, 3, true);
+    const double values[] = { -1.0, 0.0, 0.5, 1.0, 9.99, 10.0, 99.0, 100.0,
+			      999.0, 1000.0, 1e9 };
+    for (size_t i = 0; i != sizeof(values) / sizeof(values[0]); ++i) {
+	Xapian::Document d;
+	d.add_value(1, Xapian::sortable_serialise(values[i]));
+	logspy(d, 1.0);
+    }
+    TEST_EQUAL(logspy.get_underflow_count(), 3);
+    TEST_EQUAL(logspy.get_bucket_count(0), 2);
+    TEST_EQUAL(logspy.get_bucket_count(1), 2);
+    TEST_EQUAL(logspy.get_bucket_count(2), 2);
+    TEST_EQUAL(logspy.get_overflow_count(), 2);
+    TEST_EQUAL(logspy.get_min(), -1.0);
+    TEST_EQUAL(logspy.get_max(), 1e9);
+
+    // Check the spy survives being serialised and unserialised.
+    Xapian::Registry reg;
+    const Xapian::MatchSpy * proto = reg.get_match_spy(logspy.name());
+    TEST(proto != NULL);
+    AutoPtr<Xapian::MatchSpy> spy3(proto->unserialise(logspy.serialise(),
+							reg));
+    TEST_EQUAL(spy3->serialise(), logspy.serialise());
+    spy3->merge_results(logspy.serialise_results());
+    TEST_EQUAL(spy3->serialise_results(), logspy.serialise_results());
+    TEST_STRINGS_EQUAL(spy3->get_description(),
+		       "NumericHistogramMatchSpy(11 docs seen, 11 values in 3 "
+		       "logarithmic buckets)");
+
+    // A serialised spy with no buckets is rejected.  The number of buckets
+    // is encoded in the byte before the logarithmic flag.
+    string bad = spy.serialise();
+    TEST_EQUAL(bad[bad.size() - 2], '\x05');
+    bad[bad.size() - 2] = '\0';
+    TEST_EXCEPTION(Xapian::NetworkError, proto->unserialise(bad, reg));
+
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   Xapian::NumericHistogramMatchSpy(0, 0.0, 1.0, 0));
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   Xapian::NumericHistogramMatchSpy(0, 0.0, 0.0, 5));
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   Xapian::NumericHistogramMatchSpy(0, 0.0, 10.0, 5, true));
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   Xapian::NumericHistogramMatchSpy(0, 1.0, 1.0, 5, true));
+
+    return true;
+}
+
+// Test NumericHistogramMatchSpy in a match, including over remote shards.
+DEFINE_TESTCASE(matchspy9, writable)
+{
+    Xapian::WritableDatabase db = get_writable_database();
+    for (int i = 0; i != 100; ++i) {
+	Xapian::Document doc;
+	doc.add_term((i % 2) ? "odd" : "even");
+	doc.add_value(0, Xapian::sortable_serialise(i * 0.5));
+	db.add_document(doc);
+    }
+    db.commit();
+
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("odd"));
+    Xapian::NumericHistogramMatchSpy spy(0, 0.0, 5.0, 5);
+    enquire.add_matchspy(&spy);
+    Xapian::MSet mset = enquire.get_mset(0, 10, 100);
+    TEST_EQUAL(mset.size(), 10);
+
+    // The odd documents have values 0.5, 1.5, ..., 49.5.
+    TEST_EQUAL(spy.get_total(), 50);
+    TEST_EQUAL(spy.get_count(), 50);
+    TEST_EQUAL(spy.get_underflow_count(), 0);
+    TEST_EQUAL(spy.get_overflow_count(), 25);
+    for (unsigned b = 0; b != 5; ++b) {
+	TEST_EQUAL(spy.get_bucket_count(b), 5);
+    }
+    TEST_EQUAL(spy.get_min(), 0.5);
+    TEST_EQUAL(spy.get_max(), 49.5);
+    TEST_EQUAL(spy.get_sum(), 1250.0);
+
+    return true;
+}
@@ -28,6 +28,7 @@
 #include <xapian.h>
 
 #include "apitest.h"
+#include "str.h"
 #include "testsuite.h"
 #include "testutils.h"
 
@@ -247,3 +248,90 @@ DEFINE_TESTCASE(valuerange4, backend) {
     Xapian::MSet mset = enq.get_mset(0, 20);
     return true;
 }
+
+/// The value in slot @a slot of document @a did for valuerange6.
+static string
+valuerange6_value(Xapian::valueno slot, Xapian::docid did)
+{
+    switch (slot) {
+	case 0:
+	    // Dates, in docid order like a log.
+	    return str(20260000 + did / 3);
+	case 1:
+	    // Numbers, not in docid order.
+	    return Xapian::sortable_serialise(did % 1000);
+	default:
+	    // Strings of different lengths.
+	    return string(did % 13 + 1, char('a' + did % 26));
+    }
+}
+
+static void
+make_valuerange6(Xapian::WritableDatabase &db, const string &)
+{
+    for (Xapian::docid did = 1; did <= 4000; ++did) {
+	Xapian::Document doc;
+	doc.add_term("t" + str(did % 3));
+	for (Xapian::valueno slot = 0; slot != 3; ++slot) {
+	    doc.add_value(slot, valuerange6_value(slot, did));
+	}
+	db.add_document(doc);
+    }
+}
+
+// Check OP_VALUE_RANGE and OP_VALUE_GE over enough documents that backends
+// can accept or reject blocks of values using their bounds.
+DEFINE_TESTCASE(valuerange6, generated) {
+    Xapian::Database db = get_database("valuerange6", make_valuerange6);
+    Xapian::Enquire enq(db);
+    static const struct { Xapian::valueno slot; string begin, end; } tests[] = {
+	{ 0, "20260000", "20269999" },
+	{ 0, "20260100", "20260199" },
+	{ 0, "20260500", "20260500" },
+	{ 0, "20261300", "20269999" },
+	{ 0, "2026", "20260000" },
+	{ 1, Xapian::sortable_serialise(0), Xapian::sortable_serialise(999) },
+	{ 1, Xapian::sortable_serialise(100), Xapian::sortable_serialise(250) },
+	{ 1, Xapian::sortable_serialise(1000), Xapian::sortable_serialise(2000) },
+	{ 2, "a", "z" },
+	{ 2, "c", "cccc" },
+	{ 2, "m", "q" }
+    };
+    for (size_t i = 0; i != sizeof(tests) / sizeof(tests[0]); ++i) {
+	Xapian::valueno slot = tests[i].slot;
+	const string & begin = tests[i].begin;
+	const string & end = tests[i].end;
+	for (int ge = 0; ge != 2; ++ge) {
+	    Xapian::Query query;
+	    if (ge) {
+		query = Xapian::Query(Xapian::Query::OP_VALUE_GE, slot, begin);
+	    } else {
+		query = Xapian::Query(Xapian::Query::OP_VALUE_RANGE, slot,
+				      begin, end);
+	    }
+	    // Check on its own, and ANDed with a term so skip_to() and
+	    // check() get used.
+	    for (int and_term = 0; and_term != 2; ++and_term) {
+		if (and_term) {
+		    query = Xapian::Query(Xapian::Query::OP_AND,
+					  Xapian::Query("t1"), query);
+		}
+		tout << query.get_description() << endl;
+		enq.set_query(query);
+		enq.set_docid_order(Xapian::Enquire::ASCENDING);
+		Xapian::MSet mset = enq.get_mset(0, db.get_doccount());
+		Xapian::MSetIterator m = mset.begin();
+		for (Xapian::docid did = 1; did <= 4000; ++did) {
+		    if (and_term && did % 3 != 1) continue;
+		    string v = valuerange6_value(slot, did);
+		    if (v < begin || (!ge && v > end)) continue;
+		    TEST(m != mset.end());
+		    TEST_EQUAL(*m, did);
+		    ++m;
+		}
+		TEST(m == mset.end());
+	    }
+	}
+    }
+    return true;
+}
@@ -29,6 +29,9 @@
 #include "testutils.h"
 
 #include "apitest.h"
+#include "str.h"
+
+#include <cmath>
 
 using namespace std;
 
@@ -154,6 +157,90 @@ DEFINE_TESTCASE(valuestream3, backend) {
     return true;
 }
 
+/// The value test_numericvalues1 expects in @a slot of document @a did.
+static string
+numericvalues1_value(Xapian::valueno slot, Xapian::docid did)
+{
+    switch (slot) {
+	case 0:
+	    // Integers, including negative ones.
+	    return Xapian::sortable_serialise(double(did) * 7 - 10000);
+	case 1:
+	    // Other numbers.
+	    if (did % 7 == 0) return string();
+	    if (did == 1234) return Xapian::sortable_serialise(HUGE_VAL);
+	    return Xapian::sortable_serialise(did * 0.25 + 1e-3);
+	case 2:
+	    // Strings all of the same length.
+	    return "doc" + str(100000 + did);
+	default:
+	    // Strings which don't fit any column format.
+	    if (did % 3) return string();
+	    return string(did % 17 + 1, 'x');
+    }
+}
+
+/// Check values stored in the different value chunk formats round-trip.
+DEFINE_TESTCASE(numericvalues1, writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+    const Xapian::docid N = 3000;
+    for (Xapian::docid did = 1; did <= N; ++did) {
+	Xapian::Document doc;
+	for (Xapian::valueno slot = 0; slot < 4; ++slot) {
+	    string value = numericvalues1_value(slot, did);
+	    if (!value.empty()) doc.add_value(slot, value);
+	}
+	db.add_document(doc);
+    }
+    db.commit();
+
+    // Replace some documents with the same values so existing chunks get
+    // read and rewritten.
+    for (Xapian::docid did = 5; did <= N; did += 97) {
+	db.replace_document(did, db.get_document(did));
+    }
+    db.commit();
+
+    for (Xapian::valueno slot = 0; slot < 4; ++slot) {
+	tout << "slot " << slot << endl;
+	Xapian::docid did = 1;
+	Xapian::ValueIterator it = db.valuestream_begin(slot);
+	while (it != db.valuestream_end(slot)) {
+	    while (numericvalues1_value(slot, did).empty()) ++did;
+	    TEST_EQUAL(it.get_docid(), did);
+	    TEST_EQUAL(*it, numericvalues1_value(slot, did));
+	    Xapian::Document doc = db.get_document(did);
+	    TEST_EQUAL(doc.get_value(slot), *it);
+	    TEST_EQUAL(doc.get_numeric_value(slot),
+		       Xapian::sortable_unserialise(*it));
+	    ++did;
+	    ++it;
+	}
+	while (did <= N && numericvalues1_value(slot, did).empty()) ++did;
+	TEST_EQUAL(did, N + 1);
+
+	it = db.valuestream_begin(slot);
+	it.skip_to(2001);
+	TEST(it != db.valuestream_end(slot));
+	TEST_EQUAL(*it, numericvalues1_value(slot, it.get_docid()));
+    }
+
+    // An unset value should give negative infinity, as from
+    // sortable_unserialise().
+    TEST_EQUAL(db.get_document(7).get_numeric_value(1), -HUGE_VAL);
+
+    // ValueWeightPostingSource reads numbers directly from the value stream.
+    Xapian::ValueWeightPostingSource src(0);
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query(&src));
+    Xapian::MSet mset = enq.get_mset(0, 3);
+    TEST_EQUAL(mset.size(), 3);
+    TEST_EQUAL(*mset[0], N);
+    TEST_EQUAL_DOUBLE(mset[0].get_weight(), double(N) * 7 - 10000);
+
+    return true;
+}
+
 /** Check that valueweightsource handles last_docid of 0xffffffff.
  *
  *  The original implementation went into an infinite loop in this case.
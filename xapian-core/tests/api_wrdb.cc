@@ -2014,3 +2014,311 @@ DEFINE_TESTCASE(modifyvalues1, writable) {
 
     return true;
 }
+
+/// Check buffered changes mixing added documents with other modifications.
+DEFINE_TESTCASE(mixedchanges1, writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+    for (Xapian::docid did = 1; did <= 20; ++did) {
+	Xapian::Document doc;
+	doc.add_posting("all", 1);
+	doc.add_posting("all", 3);
+	doc.add_term("mod" + str(did % 3), did);
+	db.add_document(doc);
+	if (did == 10) {
+	    // Look at the buffered changes part way through.
+	    TEST_EQUAL(db.get_termfreq("all"), 10);
+	    TEST_EQUAL(db.get_collection_freq("mod1"), 1 + 4 + 7 + 10);
+	    TEST_EQUAL(db.positionlist_begin(7, "all").get_description(),
+		       db.positionlist_begin(8, "all").get_description());
+	}
+    }
+    // Modify documents which were just added.
+    Xapian::Document doc;
+    doc.add_posting("all", 2);
+    doc.add_term("new");
+    db.replace_document(15, doc);
+    db.delete_document(16);
+    doc.add_term("mod0", 2);
+    db.add_document(doc);
+
+    for (int i = 0; i < 2; ++i) {
+	TEST_EQUAL(db.get_doccount(), 20);
+	TEST_EQUAL(db.get_termfreq("all"), 20);
+	TEST_EQUAL(db.get_termfreq("new"), 2);
+	TEST_EQUAL(db.get_termfreq("mod0"), 5 + 1);
+	TEST_EQUAL(db.get_collection_freq("mod0"), 3 + 6 + 9 + 12 + 18 + 2);
+	Xapian::PostingIterator p = db.postlist_begin("all");
+	for (Xapian::docid did = 1; did <= 21; ++did) {
+	    if (did == 16) continue;
+	    TEST(p != db.postlist_end("all"));
+	    TEST_EQUAL(*p, did);
+	    Xapian::PositionIterator pos = db.positionlist_begin(did, "all");
+	    if (did == 15 || did == 21) {
+		TEST_EQUAL(*pos, 2);
+	    } else {
+		TEST_EQUAL(*pos, 1);
+		++pos;
+		TEST_EQUAL(*pos, 3);
+	    }
+	    ++p;
+	}
+	TEST(p == db.postlist_end("all"));
+	db.commit();
+    }
+
+    return true;
+}
+
+/// Check WritableDatabase::set_flush_memory() and get_buffered_memory().
+DEFINE_TESTCASE(flushmemory1, writable && !inmemory) {
+    Xapian::WritableDatabase db = get_writable_database();
+    TEST_EQUAL(db.get_buffered_memory(), 0);
+    if (get_dbtype().find("chert") != string::npos)
+	SKIP_TEST("Chert doesn't track the memory used by buffered changes");
+
+    Xapian::Document doc;
+    doc.add_posting("foo", 1);
+    doc.add_value(0, string(1000, 'x'));
+
+    // With no memory limit, changes are buffered until they're committed.
+    db.set_flush_memory(0);
+    db.add_document(doc);
+    size_t one_doc = db.get_buffered_memory();
+    TEST_REL(one_doc, >, 1000);
+    db.add_document(doc);
+    TEST_REL(db.get_buffered_memory(), >, one_doc);
+    db.commit();
+    TEST_EQUAL(db.get_buffered_memory(), 0);
+
+    // With a small limit, changes are flushed long before the document count
+    // threshold is reached.
+    db.set_flush_memory(10 * one_doc);
+    for (int i = 0; i < 100; ++i) {
+	db.add_document(doc);
+	TEST_REL(db.get_buffered_memory(), <, 10 * one_doc);
+    }
+    Xapian::Database reader = get_writable_database_as_database();
+    TEST_REL(reader.get_doccount(), >=, 90);
+    TEST_EQUAL(reader.get_value_freq(0), reader.get_doccount());
+
+    return true;
+}
+
+/// Check updates to the middle of long postlists, which copy unchanged
+/// parts of chunks without decoding them.
+DEFINE_TESTCASE(postlistmerge1, brass || chert) {
+    Xapian::WritableDatabase db;
+    db = get_named_writable_database("postlistmerge1", string());
+
+    const Xapian::docid N = 3000;
+    for (Xapian::docid did = 1; did <= N; ++did) {
+	Xapian::Document doc;
+	doc.add_term("all", did % 7 + 1);
+	doc.add_term("odd" + str(did & 1));
+	db.add_document(doc);
+    }
+    db.commit();
+
+    // Delete documents scattered through the postlists, and change the wdf
+    // for another.
+    for (Xapian::docid did = 5; did <= N; did += 97) {
+	db.delete_document(did);
+    }
+    Xapian::Document doc;
+    doc.add_term("all", 100);
+    doc.add_term("odd0");
+    db.replace_document(1500, doc);
+    db.commit();
+
+    Xapian::PostingIterator p = db.postlist_begin("all");
+    for (Xapian::docid did = 1; did <= N; ++did) {
+	if (did % 97 == 5) continue;
+	TEST(p != db.postlist_end("all"));
+	TEST_EQUAL(*p, did);
+	TEST_EQUAL(p.get_wdf(), did == 1500 ? 100 : did % 7 + 1);
+	TEST_EQUAL(p.get_doclength(), p.get_wdf() + 1);
+	++p;
+    }
+    TEST(p == db.postlist_end("all"));
+    TEST_EQUAL(db.get_termfreq("all"), db.get_doccount());
+    TEST_EQUAL(db.get_wdf_upper_bound("all"), 100);
+
+    const string & db_path = get_named_writable_database_path("postlistmerge1");
+    return Xapian::Database::check(db_path) == 0;
+}
+
+/// Check docid gaps and wdfs either side of the single byte encoding limits
+/// survive being written to a postlist and read back.
+DEFINE_TESTCASE(postlistencoding1, brass || chert) {
+    Xapian::WritableDatabase db = get_writable_database();
+
+    // Docid increases and wdfs which are encoded in one, two and more bytes,
+    // interleaved so that entries alternate between fast and slow decoding.
+    static const Xapian::docid gaps[] = {
+	1, 1, 127, 128, 129, 1, 16384, 2, (1 << 21) + 1, 1, (1 << 28), 1
+    };
+    static const Xapian::termcount wdfs[] = {
+	0, 1, 127, 128, 255, 16383, 16384, 1, 127, (1 << 21), 0, 100000000
+    };
+    const size_t n_wdfs = sizeof(wdfs) / sizeof(wdfs[0]);
+    map<Xapian::docid, Xapian::termcount> expected;
+    Xapian::docid did = 0;
+    for (int rep = 0; rep < 200; ++rep) {
+	for (size_t i = 0; i != sizeof(gaps) / sizeof(gaps[0]); ++i) {
+	    // Keep the large gaps out of the repetitions, so the docids stay
+	    // in range.
+	    Xapian::docid gap = gaps[i];
+	    if (rep && gap > 16384) gap = 1;
+	    did += gap;
+	    Xapian::termcount wdf = wdfs[(i + rep) % n_wdfs];
+	    if (rep && wdf > 16384) wdf = 2;
+	    Xapian::Document doc;
+	    doc.add_term("t", wdf);
+	    db.replace_document(did, doc);
+	    expected[did] = wdf;
+	}
+    }
+    db.commit();
+
+    // Add entries between existing ones, and delete some, so chunks which
+    // were already written are read back and merged with the changes.
+    map<Xapian::docid, Xapian::termcount>::const_iterator e;
+    Xapian::docid prev = 0;
+    int n = 0;
+    for (e = expected.begin(); e != expected.end(); ++e) {
+	if (e->first - prev > 2 && n++ % 3 == 0) {
+	    Xapian::docid new_did = prev + 1;
+	    Xapian::termcount wdf = (n % 2) ? 128 : 3;
+	    Xapian::Document doc;
+	    doc.add_term("t", wdf);
+	    db.replace_document(new_did, doc);
+	    expected[new_did] = wdf;
+	}
+	prev = e->first;
+    }
+    for (e = expected.begin(); e != expected.end(); ) {
+	Xapian::docid del = e->first;
+	++e;
+	if (del % 5 == 0) {
+	    db.delete_document(del);
+	    expected.erase(del);
+	}
+    }
+    db.commit();
+
+    TEST_EQUAL(db.get_termfreq("t"), expected.size());
+    Xapian::PostingIterator p = db.postlist_begin("t");
+    for (e = expected.begin(); e != expected.end(); ++e) {
+	TEST(p != db.postlist_end("t"));
+	TEST_EQUAL(*p, e->first);
+	TEST_EQUAL(p.get_wdf(), e->second);
+	++p;
+    }
+    TEST(p == db.postlist_end("t"));
+
+    // Check skip_to() lands on the right entries too.
+    p = db.postlist_begin("t");
+    for (e = expected.begin(); e != expected.end(); ++e) {
+	if (e->first % 3) continue;
+	p.skip_to(e->first);
+	TEST(p != db.postlist_end("t"));
+	TEST_EQUAL(*p, e->first);
+	TEST_EQUAL(p.get_wdf(), e->second);
+    }
+
+    return true;
+}
+
+/// Check that blocks which haven't been written out yet can be read back, and
+/// that they make it to disk.
+DEFINE_TESTCASE(commitbuffer1, brass) {
+    Xapian::WritableDatabase db;
+    db = get_named_writable_database("commitbuffer1", string());
+
+    const Xapian::docid N = 2000;
+    for (Xapian::docid did = 1; did <= N; ++did) {
+	Xapian::Document doc;
+	doc.set_data(string(500 + did % 300, 'a' + did % 26));
+	doc.add_term("all");
+	db.add_document(doc);
+	if (did % 500 == 0) {
+	    // Read back documents from blocks written since the last commit.
+	    for (Xapian::docid i = did - 499; i <= did; i += 37) {
+		TEST_EQUAL(db.get_document(i).get_data(),
+			   string(500 + i % 300, 'a' + i % 26));
+	    }
+	}
+	if (did == N / 2) db.commit();
+    }
+    db.commit();
+
+    const string & db_path = get_named_writable_database_path("commitbuffer1");
+    Xapian::Database rdb(db_path);
+    TEST_EQUAL(rdb.get_doccount(), N);
+    for (Xapian::docid did = 1; did <= N; ++did) {
+	TEST_EQUAL(rdb.get_document(did).get_data(),
+		   string(500 + did % 300, 'a' + did % 26));
+    }
+    return Xapian::Database::check(db_path) == 0;
+}
+
+/// Check replacing by unique term while added documents are buffered.
+DEFINE_TESTCASE(replaceuniqueterm1, writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+    for (Xapian::docid did = 1; did <= 20; ++did) {
+	Xapian::Document doc;
+	doc.add_term("Q" + str(did));
+	doc.add_posting("all", 1);
+	doc.add_posting("all", did + 1);
+	doc.add_term("mod" + str(did % 3), did);
+	db.add_document(doc);
+	if (did == 10) {
+	    // Reading a postlist part way through shouldn't lose the
+	    // positions of the other buffered documents.
+	    Xapian::PostingIterator p = db.postlist_begin("mod1");
+	    TEST_EQUAL(*p, 1);
+	    TEST_EQUAL(p.get_wdf(), 1);
+	    TEST_EQUAL(db.get_termfreq("Q7"), 1);
+	    TEST_EQUAL(db.get_collection_freq("mod2"), 2 + 5 + 8);
+	}
+    }
+
+    Xapian::Document doc;
+    doc.add_term("Q5");
+    doc.add_posting("all", 4);
+    doc.add_term("mod2", 7);
+    TEST_EQUAL(db.replace_document("Q5", doc), 5);
+    doc.remove_term("Q5");
+    doc.add_term("Q21");
+    TEST_EQUAL(db.replace_document("Q21", doc), 21);
+
+    for (int i = 0; i < 2; ++i) {
+	TEST_EQUAL(db.get_doccount(), 21);
+	TEST_EQUAL(db.get_termfreq("Q5"), 1);
+	TEST_EQUAL(db.get_termfreq("all"), 21);
+	TEST_EQUAL(db.get_termfreq("mod2"), 7 + 1);
+	TEST_EQUAL(db.get_collection_freq("mod2"),
+		   2 + 7 + 8 + 11 + 14 + 17 + 20 + 7);
+	TEST_EQUAL(db.get_termfreq("mod1"), 7);
+	Xapian::PostingIterator p = db.postlist_begin("all");
+	for (Xapian::docid did = 1; did <= 21; ++did) {
+	    TEST(p != db.postlist_end("all"));
+	    TEST_EQUAL(*p, did);
+	    Xapian::PositionIterator pos = db.positionlist_begin(did, "all");
+	    if (did == 5 || did == 21) {
+		TEST_EQUAL(*pos, 4);
+	    } else {
+		TEST_EQUAL(*pos, 1);
+		++pos;
+		TEST_EQUAL(*pos, did + 1);
+	    }
+	    ++pos;
+	    TEST(pos == db.positionlist_end(did, "all"));
+	    ++p;
+	}
+	TEST(p == db.postlist_end("all"));
+	db.commit();
+    }
+
+    return true;
+}
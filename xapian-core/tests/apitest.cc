@@ -108,6 +108,14 @@ get_remote_database(const string &dbname, unsigned int timeout)
     return backendmanager->get_remote_database(dbnames, timeout);
 }
 
+int
+start_threaded_remote_server(const string &dbname, unsigned n_threads)
+{
+    vector<string> dbnames;
+    dbnames.push_back(dbname);
+    return backendmanager->start_threaded_remote_server(dbnames, n_threads);
+}
+
 Xapian::Database
 get_writable_database_as_database()
 {
@@ -318,6 +318,15 @@ BackendManager::get_remote_database(const vector<string> &, unsigned int)
     throw Xapian::InvalidOperationError(msg);
 }
 
+int
+BackendManager::start_threaded_remote_server(const vector<string> &, unsigned)
+{
+    string msg = "BackendManager::start_threaded_remote_server() called for non-remotetcp database (type is ";
+    msg += get_dbtype();
+    msg += ')';
+    throw Xapian::InvalidOperationError(msg);
+}
+
 Xapian::Database
 BackendManager::get_writable_database_as_database()
 {
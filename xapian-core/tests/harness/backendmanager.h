@@ -184,6 +184,15 @@ class BackendManager {
     /// Get a remote database instance with the specified timeout.
     virtual Xapian::Database get_remote_database(const std::vector<std::string> & files, unsigned int timeout);
 
+    /** Start a remote server which uses @a n_threads threads.
+     *
+     *  The server listens on 127.0.0.1 and keeps running until clean_up()
+     *  is called.
+     *
+     *  @return The port the server is listening on.
+     */
+    virtual int start_threaded_remote_server(const std::vector<std::string> & files, unsigned n_threads);
+
     /// Create a Database object for the last opened WritableDatabase.
     virtual Xapian::Database get_writable_database_as_database();
 
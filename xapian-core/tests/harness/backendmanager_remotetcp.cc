@@ -76,6 +76,8 @@ using namespace std;
 struct pid_fd {
     pid_t pid;
     int fd;
+    /// Does clean_up() need to stop this server (because it isn't one-shot)?
+    bool stop;
 };
 
 static pid_fd pid_to_fd[16];
@@ -93,6 +95,7 @@ on_SIGCHLD(int /*sig*/)
 		int fd = pid_to_fd[i].fd;
 		pid_to_fd[i].fd = 0;
 		pid_to_fd[i].pid = 0;
+		pid_to_fd[i].stop = false;
 		// NB close() *is* safe to use in a signal handler.
 		close(fd);
 		break;
@@ -104,7 +107,7 @@ on_SIGCHLD(int /*sig*/)
 }
 
 static int
-launch_xapian_tcpsrv(const string & args)
+launch_xapian_tcpsrv(const string & args, bool one_shot = true)
 {
     int port = DEFAULT_PORT;
 
@@ -112,10 +115,15 @@ launch_xapian_tcpsrv(const string & args)
     // if xapian-tcpsrv doesn't start listening successfully.
     signal(SIGCHLD, SIG_DFL);
 try_next_port:
-    string cmd = XAPIAN_TCPSRV" --one-shot --interface "LOCALHOST" --port " + str(port) + " " + args;
+    string cmd = XAPIAN_TCPSRV;
+    if (one_shot) cmd += " --one-shot";
+    cmd += " --interface "LOCALHOST" --port " + str(port) + " " + args;
 #ifdef HAVE_VALGRIND
     if (RUNNING_ON_VALGRIND) cmd = "./runsrv " + cmd;
 #endif
+    // Use exec so that clean_up() can signal the server itself, rather
+    // than the shell.
+    cmd.insert(0, "exec ");
     int fds[2];
     if (socketpair(AF_UNIX, SOCK_STREAM, PF_UNSPEC, fds) < 0) {
 	string msg("Couldn't create socketpair: ");
@@ -201,6 +209,7 @@ try_next_port:
 	if (pid_to_fd[i].pid == 0) {
 	    pid_to_fd[i].fd = tracked_fd;
 	    pid_to_fd[i].pid = child;
+	    pid_to_fd[i].stop = !one_shot;
 	    break;
 	}
     }
@@ -238,8 +247,13 @@ static void win32_throw_error_string(const char * str)
 // This implementation uses the WIN32 API to start xapian-tcpsrv as a child
 // process and read its output using a pipe.
 static int
-launch_xapian_tcpsrv(const string & args)
+launch_xapian_tcpsrv(const string & args, bool one_shot = true)
 {
+    if (!one_shot) {
+	// We'd need to keep the process handle to stop the server again.
+	throw string("Only one-shot servers are supported on this platform");
+    }
+
     int port = DEFAULT_PORT;
 
 try_next_port:
@@ -350,6 +364,17 @@ BackendManagerRemoteTcp::get_remote_database(const vector<string> & files,
     return Xapian::Remote::open(LOCALHOST, port);
 }
 
+int
+BackendManagerRemoteTcp::start_threaded_remote_server(const vector<string> & files,
+						      unsigned n_threads)
+{
+    string args = "--threads ";
+    args += str(n_threads);
+    args += ' ';
+    args += get_remote_database_args(files, 300000);
+    return launch_xapian_tcpsrv(args, false);
+}
+
 Xapian::Database
 BackendManagerRemoteTcp::get_writable_database_as_database()
 {
@@ -374,6 +399,7 @@ BackendManagerRemoteTcp::clean_up()
     for (unsigned i = 0; i < sizeof(pid_to_fd) / sizeof(pid_fd); ++i) {
 	pid_t child = pid_to_fd[i].pid;
 	if (child) {
+	    if (pid_to_fd[i].stop) kill(child, SIGTERM);
 	    int status;
 	    while (waitpid(child, &status, 0) == -1 && errno == EINTR) { }
 	    // Other possible error from waitpid is ECHILD, which it seems can
@@ -383,6 +409,7 @@ BackendManagerRemoteTcp::clean_up()
 	    int fd = pid_to_fd[i].fd;
 	    pid_to_fd[i].fd = 0;
 	    pid_to_fd[i].pid = 0;
+	    pid_to_fd[i].stop = false;
 	    close(fd);
 	}
     }
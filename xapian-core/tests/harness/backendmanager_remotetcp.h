@@ -58,6 +58,10 @@ class BackendManagerRemoteTcp : public BackendManagerRemote {
     Xapian::Database get_remote_database(const std::vector<std::string> & files,
 					 unsigned int timeout);
 
+    /// Start a remote server using several threads, returning its port.
+    int start_threaded_remote_server(const std::vector<std::string> & files,
+				     unsigned n_threads);
+
     /// Create a Database object for the last opened WritableDatabase.
     Xapian::Database get_writable_database_as_database();
 
@@ -19,6 +19,7 @@ noinst_HEADERS += perftest/perftest.h
 
 collated_perftest_sources = \
  perftest/perftest_matchdecider.cc \
+ perftest/perftest_orquery.cc \
  perftest/perftest_randomidx.cc
 
 perftest_perftest_SOURCES = perftest/perftest.cc $(collated_perftest_sources) \
@@ -0,0 +1,118 @@
+/* perftest_orquery.cc: performance tests for OR queries with many terms
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "perftest/perftest_orquery.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <xapian.h>
+
+#include "backendmanager.h"
+#include "perftest.h"
+#include "str.h"
+#include "testrunner.h"
+#include "testsuite.h"
+#include "testutils.h"
+
+using namespace std;
+
+/// The number of distinct words in the generated documents.
+static const unsigned int VOCAB_SIZE = 5000;
+
+/** Pick a word number from 0 to VOCAB_SIZE - 1.
+ *
+ *  The distribution is skewed so that low numbered words are much more
+ *  common, roughly as word frequencies are in real text.
+ */
+static unsigned int
+rand_word()
+{
+    double r = rand() / (RAND_MAX + 1.0);
+    return static_cast<unsigned int>(pow(double(VOCAB_SIZE), r)) - 1;
+}
+
+static void
+builddb_orquery1(Xapian::WritableDatabase &db, const string & dbname)
+{
+    logger.testcase_begin(dbname);
+    unsigned int runsize = 200000;
+    unsigned int seed = 42;
+    srand(seed);
+
+    std::map<std::string, std::string> params;
+    params["runsize"] = str(runsize);
+    params["seed"] = str(seed);
+    params["vocab_size"] = str(VOCAB_SIZE);
+    logger.indexing_begin(dbname, params);
+    for (unsigned int i = 0; i < runsize; ++i) {
+	Xapian::Document doc;
+	doc.set_data("test document " + str(i));
+	unsigned int len = 20 + rand() % 100;
+	for (unsigned int j = 0; j != len; ++j)
+	    doc.add_term("W" + str(rand_word()));
+	db.add_document(doc);
+	logger.indexing_add();
+    }
+    db.commit();
+    logger.indexing_end();
+    logger.testcase_end();
+}
+
+// Test the performance of OR queries with many terms.
+DEFINE_TESTCASE(orquery1, writable && !remote && !inmemory) {
+    Xapian::Database db;
+    db = backendmanager->get_database("orquery1", builddb_orquery1,
+				      "orquery1");
+
+    logger.testcase_begin("orquery1");
+    Xapian::Enquire enquire(db);
+    Xapian::doccount runsize = db.get_doccount();
+
+    srand(1);
+    static const unsigned int sizes[] = { 2, 5, 10, 20, 30 };
+    for (size_t s = 0; s != sizeof(sizes) / sizeof(sizes[0]); ++s) {
+	vector<string> terms;
+	while (terms.size() != sizes[s])
+	    terms.push_back("W" + str(rand_word()));
+	Xapian::Query query(Xapian::Query::OP_OR, terms.begin(), terms.end());
+	enquire.set_query(query);
+
+	// Asking for all the matches to be counted stops the matcher from
+	// pruning, so this shows how much pruning is saving.
+	logger.searching_start(str(sizes[s]) + " terms, counting all matches");
+	logger.search_start();
+	Xapian::MSet mset_all = enquire.get_mset(0, 10, runsize);
+	logger.search_end(query, mset_all);
+	logger.searching_end();
+
+	logger.searching_start(str(sizes[s]) + " terms, top 10");
+	logger.search_start();
+	Xapian::MSet mset = enquire.get_mset(0, 10);
+	logger.search_end(query, mset);
+	logger.searching_end();
+
+	test_mset_order_equal(mset, mset_all);
+    }
+
+    logger.testcase_end();
+    return true;
+}
@@ -95,10 +95,15 @@ TfIdfWeight::get_sumpart(Xapian::termcount wdf, Xapian::termcount) const
 // and N are constants.
 double
 TfIdfWeight::get_maxpart() const
+{
+    return get_maxpart_for_wdf(get_wdf_upper_bound());
+}
+
+double
+TfIdfWeight::get_maxpart_for_wdf(Xapian::termcount wdf_max) const
 {
     Xapian::doccount termfreq = 1;
     if (normalizations[1] != 'n') termfreq = get_termfreq();
-    Xapian::termcount wdf_max = get_wdf_upper_bound();
     double wt = get_wdfn(wdf_max, normalizations[0]) *
 		get_idfn(termfreq, normalizations[1]);
     return get_wtn(wt, normalizations[2]) * factor;
@@ -116,6 +116,21 @@ Weight::init_(const Internal & stats, Xapian::termcount query_length,
 
 Weight::~Weight() { }
 
+double
+Weight::get_maxpart_for_wdf_(Xapian::termcount wdf_max) const
+{
+    LOGCALL(MATCH, double, "Weight::get_maxpart_for_wdf_", wdf_max);
+    if (!(stats_needed & WDF_MAX) || wdf_max >= wdf_upper_bound_)
+	RETURN(get_maxpart());
+    RETURN(get_maxpart_for_wdf(wdf_max));
+}
+
+double
+Weight::get_maxpart_for_wdf(Xapian::termcount) const
+{
+    return get_maxpart();
+}
+
 string
 Weight::name() const
 {